@@ -0,0 +1,614 @@
+// audio_dsp.c
+#include "audio_dsp.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#if CONFIG_AUDIO_DSP_USE_ESP_DSP
+#include "dsps_dotprod.h"
+#endif
+
+#define DSP_TAPS 16             // par phase ; multiple de 4 pour dsps_dotprod_s16
+#define DSP_IN_FRAMES 256
+#define DSP_MAX_CH 2
+#define DSP_MIN_RATE 8000
+#define DSP_MAX_OUT_FRAMES (DSP_IN_FRAMES * AUDIO_DSP_OUT_RATE / DSP_MIN_RATE + 2)
+#define GAIN_SHIFT 12
+#define GAIN_ONE (1 << GAIN_SHIFT)
+#define LIMIT_KNEE 26000        // environ -2 dBFS
+#define LIMIT_RANGE (32767 - LIMIT_KNEE)
+#define DSP_CUTS 4
+#define DSP_EQ_FRAMES 256       // tronçon égalisé à la fois
+#define GAP_SILENCE_LEVEL 32    // environ -60 dBFS : inaudible sur une enceinte
+#define GAP_MAX_MS 5000         // au-dela, c'est un silence de la piste elle-meme
+
+typedef struct {
+    uint64_t from;              // trames source, to exclu
+    uint64_t to;
+    bool junction;
+} dsp_cut_t;
+
+static const char *TAG = "audio_dsp";
+
+typedef struct {
+    int src_rate;                   // format appliqué
+    int src_ch;
+    volatile int req_rate;          // format demandé, appliqué au bloc suivant
+    volatile int req_ch;
+    volatile bool reconfig;
+    volatile int volume;
+    volatile int32_t track_gain_q12;    // gain ReplayGain de la piste
+    int32_t applied_gain_q12;           // gain du bloc précédent, pour la rampe
+    audio_dsp_meter_cb meter_cb;
+    void *meter_ctx;
+    int up;                         // rapport de conversion up/down
+    int down;
+    int16_t *coefs;                 // up phases de DSP_TAPS coefficients Q15
+    int32_t makeup_q12;             // compense la marge prise sur les coefficients
+    uint32_t pos;                   // position de sortie dans hist, en 1/up d'échantillon
+    int carry;                      // octets d'une trame incomplète en tête du tampon
+    int16_t *hist[DSP_MAX_CH];      // DSP_TAPS - 1 échantillons d'historique + un bloc
+    int16_t *out;                   // sortie stéréo entrelacée
+    audio_eq_handle_t eq;           // NULL : pas d'égaliseur
+    int32_t *eq_out;                // un tronçon égalisé, avant gain
+    uint64_t out_bytes;             // écrits vers l'élément suivant
+    uint64_t busy_us;               // temps de calcul cumulé, hors attente des anneaux
+    portMUX_TYPE cut_lock;
+    dsp_cut_t cuts[DSP_CUTS];       // sous cut_lock, dans l'ordre du flux
+    int cut_count;
+    uint64_t in_bytes;              // octets recus depuis l'ouverture
+    uint32_t silent_run;            // trames silencieuses consecutives en fin de flux
+    bool gap_open;                  // jonction passee, silence de tete en cours de mesure
+    uint32_t gap_tail;
+    uint32_t gap_head;
+    int64_t gap_stall_us;           // sortie interrompue (pipeline relance)
+    int64_t last_out_us;
+    bool fresh;                     // aucun bloc traite depuis l'ouverture
+    volatile uint32_t last_gap;     // dernier gap mesure, en trames de sortie
+} audio_dsp_t;
+
+static void *dsp_alloc(size_t size)
+{
+    void *p = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!p) p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p;
+}
+
+static int gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * Même arithmétique que dsps_dotprod_s16_ansi avec shift = 0 : la voie C
+ * et la voie esp-dsp donnent des échantillons identiques.
+ */
+static inline int16_t dotprod_q15(const int16_t *x, const int16_t *h)
+{
+#if CONFIG_AUDIO_DSP_USE_ESP_DSP
+    int16_t y;
+    dsps_dotprod_s16(x, h, &y, DSP_TAPS, 0);
+    return y;
+#else
+    int64_t acc = 0x7fff;
+    for (int i = 0; i < DSP_TAPS; i++) {
+        acc += (int32_t)x[i] * h[i];
+    }
+    return (int16_t)(acc >> 15);
+#endif
+}
+
+// Courbe douce au-delà du seuil, tend vers la pleine échelle sans l'atteindre
+static inline int16_t soft_limit(int32_t v)
+{
+    int32_t a = v < 0 ? -v : v;
+    if (a > LIMIT_KNEE) {
+        int32_t d = a - LIMIT_KNEE;
+        if (d > (1 << 18)) d = 1 << 18;
+        a = LIMIT_KNEE + d * LIMIT_RANGE / (LIMIT_RANGE + d);
+    }
+    return (int16_t)(v < 0 ? -a : a);
+}
+
+// Échantillon égalisé, au-delà de 16 bits : produit sur 64 bits
+static inline int16_t apply_gain_wide(int32_t v, int32_t g)
+{
+    return soft_limit((int32_t)(((int64_t)v * g + GAIN_ONE / 2) >> GAIN_SHIFT));
+}
+
+/*
+ * Filtre polyphasé up/down : prototype en sinus cardinal fenêtré (Blackman)
+ * de up * DSP_TAPS points, coupé à 90 % de la plus basse des deux
+ * fréquences de Nyquist. Les coefficients sont mis à l'échelle pour que la
+ * somme des valeurs absolues de chaque phase tienne en Q15 : le produit
+ * scalaire ne peut pas déborder, la marge est rendue par le gain.
+ */
+static esp_err_t build_filter(audio_dsp_t *d)
+{
+    free(d->coefs);
+    d->coefs = NULL;
+    d->makeup_q12 = GAIN_ONE;
+
+    int g = gcd(d->src_rate, AUDIO_DSP_OUT_RATE);
+    d->up = AUDIO_DSP_OUT_RATE / g;
+    d->down = d->src_rate / g;
+    d->pos = (DSP_TAPS - 1) * d->up;
+    if (d->up == 1 && d->down == 1) return ESP_OK;
+
+    size_t n = (size_t)d->up * DSP_TAPS;
+    float *proto = heap_caps_malloc(n * sizeof(float), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!proto) proto = malloc(n * sizeof(float));
+    d->coefs = dsp_alloc(n * sizeof(int16_t));
+    if (!proto || !d->coefs) {
+        free(proto);
+        free(d->coefs);
+        d->coefs = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    int nyquist = d->src_rate < AUDIO_DSP_OUT_RATE ? d->src_rate : AUDIO_DSP_OUT_RATE;
+    float fc = 0.45f * nyquist / ((float)d->src_rate * d->up);
+    float center = (n - 1) / 2.0f;
+    for (size_t k = 0; k < n; k++) {
+        float t = k - center;
+        float sinc = t == 0 ? 2 * fc : sinf(2 * (float)M_PI * fc * t) / ((float)M_PI * t);
+        float w = 0.42f - 0.5f * cosf(2 * (float)M_PI * k / (n - 1)) +
+                  0.08f * cosf(4 * (float)M_PI * k / (n - 1));
+        proto[k] = d->up * sinc * w;
+    }
+
+    float worst = 0;
+    for (int p = 0; p < d->up; p++) {
+        float sum = 0;
+        for (int j = 0; j < DSP_TAPS; j++) sum += fabsf(proto[p + j * d->up]);
+        if (sum > worst) worst = sum;
+    }
+    // marge d'un demi pas d'arrondi par coefficient
+    float scale = (32767.0f - DSP_TAPS) / (worst * 32768.0f);
+    for (int p = 0; p < d->up; p++) {
+        for (int j = 0; j < DSP_TAPS; j++) {
+            // ordre inversé : la fenêtre d'historique est lue dans le sens croissant
+            float h = proto[p + (DSP_TAPS - 1 - j) * d->up];
+            d->coefs[p * DSP_TAPS + j] = (int16_t)lrintf(h * scale * 32768.0f);
+        }
+    }
+    d->makeup_q12 = (int32_t)lrintf(GAIN_ONE / scale);
+    free(proto);
+    return ESP_OK;
+}
+
+static void apply_src_info(audio_dsp_t *d)
+{
+    d->reconfig = false;
+    int rate = d->req_rate;
+    int ch = d->req_ch;
+    if (rate < DSP_MIN_RATE || rate > 96000 || ch < 1 || ch > DSP_MAX_CH) {
+        ESP_LOGW(TAG, "Unsupported source %d Hz %d ch", rate, ch);
+        return;
+    }
+    d->src_rate = rate;
+    d->src_ch = ch;
+    d->carry = 0;
+    for (int c = 0; c < DSP_MAX_CH; c++) {
+        memset(d->hist[c], 0, (DSP_TAPS - 1) * sizeof(int16_t));
+    }
+    if (build_filter(d) != ESP_OK) {
+        ESP_LOGE(TAG, "No memory for %d Hz filter, passing through", rate);
+        d->up = d->down = 1;
+    }
+    ESP_LOGI(TAG, "Source %d Hz %d ch, ratio %d/%d", rate, ch, d->up, d->down);
+}
+
+static int32_t current_gain_q12(const audio_dsp_t *d)
+{
+    int v = d->volume;
+    int64_t g = v * v * GAIN_ONE / (AUDIO_DSP_VOLUME_MAX * AUDIO_DSP_VOLUME_MAX);
+    g = (g * d->makeup_q12) >> GAIN_SHIFT;
+    g = (g * d->track_gain_q12) >> GAIN_SHIFT;
+    return (int32_t)g;
+}
+
+static int64_t sum_squares(const int16_t *pcm, int samples)
+{
+    int64_t sum = 0;
+    for (int i = 0; i < samples; i++) sum += (int32_t)pcm[i] * pcm[i];
+    return sum;
+}
+
+/*
+ * Retire du bloc (n octets neufs en buf) les plages coupees par
+ * audio_dsp_cut, en compactant le reste en tete. *junction recoit la
+ * position, en octets du bloc compacte, d'une jonction entre pistes
+ * franchie dans ce bloc (-1 sinon).
+ */
+static int apply_cuts(audio_dsp_t *d, char *buf, int n, int *junction)
+{
+    uint64_t fb = d->src_ch * sizeof(int16_t);
+    uint64_t start = d->in_bytes;
+    uint64_t end = start + n;
+    uint64_t at = start;
+    int kept = 0;
+    d->in_bytes = end;
+    *junction = -1;
+    while (1) {
+        dsp_cut_t c;
+        taskENTER_CRITICAL(&d->cut_lock);
+        bool have = d->cut_count > 0;
+        if (have) c = d->cuts[0];
+        taskEXIT_CRITICAL(&d->cut_lock);
+        if (!have) break;
+        uint64_t from = c.from * fb;
+        uint64_t to = c.to == UINT64_MAX ? UINT64_MAX : c.to * fb;
+        if (from >= end) break;
+        if (from > at) {
+            memmove(buf + kept, buf + (at - start), from - at);
+            kept += (int)(from - at);
+            at = from;
+        }
+        if (to > end) {
+            at = end;
+            break;
+        }
+        if (to > at) at = to;
+        if (c.junction) *junction = kept;
+        taskENTER_CRITICAL(&d->cut_lock);
+        memmove(d->cuts, d->cuts + 1, --d->cut_count * sizeof(d->cuts[0]));
+        taskEXIT_CRITICAL(&d->cut_lock);
+    }
+    if (at < end) {
+        memmove(buf + kept, buf + (at - start), end - at);
+        kept += (int)(end - at);
+    }
+    return kept;
+}
+
+static bool frame_is_silent(const int16_t *pcm, int ch)
+{
+    for (int c = 0; c < ch; c++) {
+        if (pcm[c] > GAP_SILENCE_LEVEL || pcm[c] < -GAP_SILENCE_LEVEL) return false;
+    }
+    return true;
+}
+
+static void open_gap(audio_dsp_t *d)
+{
+    d->gap_open = true;
+    d->gap_tail = d->silent_run;
+    d->gap_head = 0;
+    d->gap_stall_us = d->fresh && d->last_out_us ? esp_timer_get_time() - d->last_out_us : 0;
+}
+
+static void close_gap(audio_dsp_t *d)
+{
+    d->gap_open = false;
+    uint64_t silence = (uint64_t)(d->gap_tail + d->gap_head) * AUDIO_DSP_OUT_RATE / d->src_rate;
+    uint64_t stall = (uint64_t)d->gap_stall_us * AUDIO_DSP_OUT_RATE / 1000000;
+    d->last_gap = (uint32_t)(silence + stall);
+    ESP_LOGI(TAG, "Track gap: %u samples (silence %u + %u, stall %u ms)", (unsigned)d->last_gap,
+             (unsigned)d->gap_tail, (unsigned)d->gap_head, (unsigned)(d->gap_stall_us / 1000));
+}
+
+/*
+ * Mesure le gap a la jonction de deux pistes, sur le PCM qui entre dans la
+ * conversion : silence en fin de la piste precedente, silence en tete de
+ * la suivante et, quand le pipeline a ete relance, l'interruption de la
+ * sortie. Un silence compose dans la piste compte aussi : c'est ce qu'on
+ * entend.
+ */
+static void measure_gap(audio_dsp_t *d, const int16_t *pcm, int frames, int junction)
+{
+    uint32_t cap = (uint32_t)((uint64_t)d->src_rate * GAP_MAX_MS / 1000);
+    for (int i = 0; i < frames; i++) {
+        if (i == junction) open_gap(d);
+        bool silent = frame_is_silent(pcm + i * d->src_ch, d->src_ch);
+        if (silent && d->silent_run < cap) d->silent_run++;
+        if (!silent) d->silent_run = 0;
+        if (d->gap_open && (!silent || ++d->gap_head >= cap)) close_gap(d);
+    }
+    if (junction == frames) open_gap(d);
+}
+
+static esp_err_t dsp_open(audio_element_handle_t self)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    d->in_bytes = 0;
+    d->fresh = true;
+    for (int c = 0; c < DSP_MAX_CH; c++) {
+        d->hist[c] = dsp_alloc((DSP_TAPS - 1 + DSP_IN_FRAMES) * sizeof(int16_t));
+        if (!d->hist[c]) return ESP_ERR_NO_MEM;
+    }
+    d->out = dsp_alloc(DSP_MAX_OUT_FRAMES * AUDIO_DSP_OUT_CHANNELS * sizeof(int16_t));
+    if (!d->out) return ESP_ERR_NO_MEM;
+    if (d->eq) {
+        d->eq_out = dsp_alloc(DSP_EQ_FRAMES * AUDIO_DSP_OUT_CHANNELS * sizeof(int32_t));
+        if (!d->eq_out) return ESP_ERR_NO_MEM;
+        audio_eq_reset(d->eq);
+    }
+    apply_src_info(d);
+    // demarre au gain courant : celui de l'init ignorait la compensation du filtre
+    d->applied_gain_q12 = current_gain_q12(d);
+    audio_element_set_music_info(self, AUDIO_DSP_OUT_RATE, AUDIO_DSP_OUT_CHANNELS, 16);
+    return ESP_OK;
+}
+
+static esp_err_t dsp_close(audio_element_handle_t self)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    for (int c = 0; c < DSP_MAX_CH; c++) {
+        free(d->hist[c]);
+        d->hist[c] = NULL;
+    }
+    free(d->out);
+    free(d->eq_out);
+    free(d->coefs);
+    d->out = NULL;
+    d->eq_out = NULL;
+    d->coefs = NULL;
+    return ESP_OK;
+}
+
+static esp_err_t dsp_destroy(audio_element_handle_t self)
+{
+    free(audio_element_getdata(self));
+    return ESP_OK;
+}
+
+static audio_element_err_t dsp_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    if (d->reconfig) {
+        apply_src_info(d);
+        d->applied_gain_q12 = current_gain_q12(d);
+    }
+
+    int frame_bytes = d->src_ch * (int)sizeof(int16_t);
+    int r = audio_element_input(self, in_buffer + d->carry, DSP_IN_FRAMES * frame_bytes - d->carry);
+    if (r <= 0) return r;
+
+    // delai et remplissage des encodeurs retires avant tout traitement
+    int junction;
+    int n = apply_cuts(d, in_buffer + d->carry, r, &junction);
+    int total = d->carry + n;
+    measure_gap(d, (const int16_t *)in_buffer, total / frame_bytes,
+                junction < 0 ? -1 : (d->carry + junction) / frame_bytes);
+    if (total / frame_bytes > 0) d->fresh = false;
+
+    int32_t gain = current_gain_q12(d);
+    bool eq_on = audio_eq_begin(d->eq);
+    if (d->coefs == NULL && d->src_ch == AUDIO_DSP_OUT_CHANNELS && gain == GAIN_ONE &&
+        d->applied_gain_q12 == GAIN_ONE && d->carry == 0 && !eq_on) {
+        // déjà au bon format : aucun traitement ; une trame coupée attend la suite
+        d->carry = n % frame_bytes;
+        n -= d->carry;
+        if (n == 0) return r;
+        if (d->meter_cb) d->meter_cb(sum_squares((int16_t *)in_buffer, n / 2), n / 4, d->meter_ctx);
+        d->last_out_us = esp_timer_get_time();
+        int ret = audio_element_output(self, in_buffer, n);
+        if (ret > 0) __atomic_add_fetch(&d->out_bytes, (uint64_t)ret, __ATOMIC_RELAXED);
+        if (d->carry) memmove(in_buffer, in_buffer + n, d->carry);
+        return ret;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    int frames = total / frame_bytes;
+    const int16_t *in = (const int16_t *)in_buffer;
+    for (int c = 0; c < d->src_ch; c++) {
+        int16_t *dst = d->hist[c] + DSP_TAPS - 1;
+        for (int i = 0; i < frames; i++) dst[i] = in[i * d->src_ch + c];
+    }
+
+    // 1. conversion vers 44,1 kHz stéréo, avant gain
+    int out_frames = 0;
+    int16_t *out = d->out;
+    if (d->coefs) {
+        uint32_t limit = (uint32_t)(DSP_TAPS - 1 + frames) * d->up;
+        while (d->pos < limit) {
+            uint32_t i = d->pos / d->up;
+            const int16_t *h = d->coefs + (d->pos % d->up) * DSP_TAPS;
+            int16_t l = dotprod_q15(d->hist[0] + i - (DSP_TAPS - 1), h);
+            out[2 * out_frames] = l;
+            out[2 * out_frames + 1] = d->src_ch > 1 ? dotprod_q15(d->hist[1] + i - (DSP_TAPS - 1), h) : l;
+            out_frames++;
+            d->pos += d->down;
+        }
+        d->pos -= (uint32_t)frames * d->up;
+        for (int c = 0; c < d->src_ch; c++) {
+            memmove(d->hist[c], d->hist[c] + frames, (DSP_TAPS - 1) * sizeof(int16_t));
+        }
+    } else {
+        const int16_t *l = d->hist[0] + DSP_TAPS - 1;
+        const int16_t *rr = d->src_ch > 1 ? d->hist[1] + DSP_TAPS - 1 : l;
+        for (; out_frames < frames; out_frames++) {
+            out[2 * out_frames] = l[out_frames];
+            out[2 * out_frames + 1] = rr[out_frames];
+        }
+    }
+    if (d->meter_cb && out_frames > 0) {
+        // niveau ramené à celui de la source : la marge du filtre est retirée
+        int64_t sum = sum_squares(out, out_frames * 2);
+        sum = (((sum >> GAIN_SHIFT) * d->makeup_q12) >> GAIN_SHIFT) * d->makeup_q12;
+        d->meter_cb(sum, out_frames, d->meter_ctx);
+    }
+
+    // 2. égaliseur, avant gain : ses renforcements passent eux aussi par le limiteur
+    // 3. gain (rampe sur le bloc quand il change) et limiteur
+    int32_t g0 = d->applied_gain_q12;
+    int32_t dg = gain - g0;
+    if (eq_on) {
+        for (int done = 0; done < out_frames; done += DSP_EQ_FRAMES) {
+            int n = out_frames - done < DSP_EQ_FRAMES ? out_frames - done : DSP_EQ_FRAMES;
+            audio_eq_process(d->eq, out + 2 * done, d->eq_out, n);
+            for (int i = 0; i < n; i++) {
+                int k = done + i;
+                int32_t g = dg ? g0 + (int32_t)((int64_t)dg * k / out_frames) : gain;
+                out[2 * k] = apply_gain_wide(d->eq_out[2 * i], g);
+                out[2 * k + 1] = apply_gain_wide(d->eq_out[2 * i + 1], g);
+            }
+        }
+    } else {
+        for (int i = 0; i < out_frames; i++) {
+            int32_t g = dg ? g0 + (int32_t)((int64_t)dg * i / out_frames) : gain;
+            out[2 * i] = soft_limit((out[2 * i] * g + GAIN_ONE / 2) >> GAIN_SHIFT);
+            out[2 * i + 1] = soft_limit((out[2 * i + 1] * g + GAIN_ONE / 2) >> GAIN_SHIFT);
+        }
+    }
+    d->applied_gain_q12 = gain;
+
+    d->carry = total - frames * frame_bytes;
+    if (d->carry) memmove(in_buffer, in_buffer + frames * frame_bytes, d->carry);
+    d->last_out_us = esp_timer_get_time();
+    __atomic_add_fetch(&d->busy_us, (uint64_t)(d->last_out_us - t0), __ATOMIC_RELAXED);
+    if (out_frames == 0) return r;
+    int ret = audio_element_output(self, (char *)out, out_frames * AUDIO_DSP_OUT_CHANNELS * sizeof(int16_t));
+    if (ret > 0) __atomic_add_fetch(&d->out_bytes, (uint64_t)ret, __ATOMIC_RELAXED);
+    return ret;
+}
+
+audio_element_handle_t audio_dsp_init(audio_dsp_cfg_t *config)
+{
+    audio_dsp_t *d = calloc(1, sizeof(audio_dsp_t));
+    if (!d) return NULL;
+    d->req_rate = d->src_rate = config->src_rate;
+    d->req_ch = d->src_ch = config->src_ch;
+    d->volume = config->volume;
+    d->eq = config->eq;
+    d->track_gain_q12 = GAIN_ONE;
+    d->up = d->down = 1;
+    portMUX_INITIALIZE(&d->cut_lock);
+    d->applied_gain_q12 = current_gain_q12(d);
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = dsp_open;
+    cfg.close = dsp_close;
+    cfg.process = dsp_process;
+    cfg.destroy = dsp_destroy;
+    cfg.buffer_len = DSP_IN_FRAMES * DSP_MAX_CH * sizeof(int16_t);
+    cfg.task_stack = config->task_stack;
+    cfg.task_prio = config->task_prio;
+    cfg.task_core = config->task_core;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.tag = "dsp";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    if (!el) {
+        free(d);
+        return NULL;
+    }
+    audio_element_setdata(el, d);
+    return el;
+}
+
+esp_err_t audio_dsp_set_src_info(audio_element_handle_t self, int src_rate, int src_ch)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    if (!d) return ESP_ERR_INVALID_ARG;
+    if (src_rate == d->src_rate && src_ch == d->src_ch && !d->reconfig) return ESP_OK;
+    d->req_rate = src_rate;
+    d->req_ch = src_ch;
+    d->reconfig = true;
+    return ESP_OK;
+}
+
+esp_err_t audio_dsp_set_volume(audio_element_handle_t self, int volume)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    if (!d) return ESP_ERR_INVALID_ARG;
+    if (volume < 0) volume = 0;
+    if (volume > AUDIO_DSP_VOLUME_MAX) volume = AUDIO_DSP_VOLUME_MAX;
+    d->volume = volume;
+    return ESP_OK;
+}
+
+esp_err_t audio_dsp_set_track_gain(audio_element_handle_t self, float gain_db)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    if (!d) return ESP_ERR_INVALID_ARG;
+    if (!isfinite(gain_db)) gain_db = 0;    // tag illisible : pas de correction
+    if (gain_db < -24) gain_db = -24;
+    if (gain_db > 12) gain_db = 12;
+    d->track_gain_q12 = (int32_t)lrintf(GAIN_ONE * powf(10, gain_db / 20));
+    return ESP_OK;
+}
+
+esp_err_t audio_dsp_set_meter_cb(audio_element_handle_t self, audio_dsp_meter_cb cb, void *ctx)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    if (!d) return ESP_ERR_INVALID_ARG;
+    d->meter_ctx = ctx;
+    d->meter_cb = cb;
+    return ESP_OK;
+}
+
+uint64_t audio_dsp_get_busy_us(audio_element_handle_t self)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    return d ? __atomic_load_n(&d->busy_us, __ATOMIC_RELAXED) : 0;
+}
+
+uint64_t audio_dsp_get_out_bytes(audio_element_handle_t self)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    return d ? __atomic_load_n(&d->out_bytes, __ATOMIC_RELAXED) : 0;
+}
+
+int audio_dsp_get_volume(audio_element_handle_t self)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    return d ? d->volume : 0;
+}
+
+esp_err_t audio_dsp_cut(audio_element_handle_t self, uint64_t from, uint64_t to, bool junction)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    if (!d || to < from) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_OK;
+    taskENTER_CRITICAL(&d->cut_lock);
+    if (d->cut_count < DSP_CUTS) {
+        d->cuts[d->cut_count++] = (dsp_cut_t) { .from = from, .to = to, .junction = junction };
+    } else {
+        err = ESP_ERR_NO_MEM;
+    }
+    taskEXIT_CRITICAL(&d->cut_lock);
+    return err;
+}
+
+esp_err_t audio_dsp_clear_cuts(audio_element_handle_t self)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    if (!d) return ESP_ERR_INVALID_ARG;
+    taskENTER_CRITICAL(&d->cut_lock);
+    d->cut_count = 0;
+    taskEXIT_CRITICAL(&d->cut_lock);
+    d->gap_open = false;
+    return ESP_OK;
+}
+
+uint32_t audio_dsp_get_last_gap(audio_element_handle_t self)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    return d ? d->last_gap : 0;
+}
+
+size_t audio_dsp_get_memory(audio_element_handle_t self)
+{
+    audio_dsp_t *d = audio_element_getdata(self);
+    if (!d) return 0;
+    size_t n = sizeof(*d) + DSP_IN_FRAMES * DSP_MAX_CH * sizeof(int16_t);
+    if (d->out) {
+        n += DSP_MAX_CH * (DSP_TAPS - 1 + DSP_IN_FRAMES) * sizeof(int16_t);
+        n += DSP_MAX_OUT_FRAMES * AUDIO_DSP_OUT_CHANNELS * sizeof(int16_t);
+    }
+    if (d->coefs) n += (size_t)d->up * DSP_TAPS * sizeof(int16_t);
+    if (d->eq_out) n += DSP_EQ_FRAMES * AUDIO_DSP_OUT_CHANNELS * sizeof(int32_t);
+    return n;
+}
@@ -0,0 +1,127 @@
+// audio_dsp.h
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include "audio_element.h"
+#include "audio_eq.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_DSP_OUT_RATE 44100
+#define AUDIO_DSP_OUT_CHANNELS 2
+#define AUDIO_DSP_VOLUME_MAX 100
+
+/**
+ * Mesure de niveau : somme des carrés des échantillons (avant gain,
+ * après conversion) d'un bloc de frames trames stéréo.
+ */
+typedef void (*audio_dsp_meter_cb)(int64_t sum_squares, int frames, void *ctx);
+
+/**
+ * Configuration de l'élément DSP (PCM 16 bits en entrée et en sortie).
+ */
+typedef struct {
+    int src_rate;       // fréquence initiale de la source
+    int src_ch;         // 1 ou 2 canaux
+    int volume;         // 0..AUDIO_DSP_VOLUME_MAX
+    audio_eq_handle_t eq;   // égaliseur appliqué avant le gain, ou NULL
+    int task_stack;
+    int task_prio;
+    int task_core;
+    int out_rb_size;
+} audio_dsp_cfg_t;
+
+#define DEFAULT_AUDIO_DSP_CONFIG() {    \
+    .src_rate = AUDIO_DSP_OUT_RATE,     \
+    .src_ch = AUDIO_DSP_OUT_CHANNELS,   \
+    .volume = AUDIO_DSP_VOLUME_MAX,     \
+    .task_stack = 3 * 1024,             \
+    .task_prio = 5,                     \
+    .task_core = 1,                     \
+    .out_rb_size = 8 * 1024,            \
+}
+
+/**
+ * @brief Crée l'élément qui convertit la source en 44,1 kHz stéréo,
+ *        applique l'égaliseur, le volume logiciel et un limiteur doux, en
+ *        une passe. Quand la source est déjà au bon format, le volume au
+ *        maximum et l'égaliseur à plat, les données sont transmises sans
+ *        traitement.
+ */
+audio_element_handle_t audio_dsp_init(audio_dsp_cfg_t *config);
+
+/**
+ * @brief Change le format de la source ; pris en compte au bloc suivant.
+ */
+esp_err_t audio_dsp_set_src_info(audio_element_handle_t self, int src_rate, int src_ch);
+
+/**
+ * @brief Règle le volume logiciel (0..AUDIO_DSP_VOLUME_MAX).
+ */
+esp_err_t audio_dsp_set_volume(audio_element_handle_t self, int volume);
+
+/**
+ * @brief Règle le gain propre à la piste (ReplayGain), en dB, borné à
+ *        -24..+12 dB. Le changement est appliqué en rampe sur un bloc.
+ */
+esp_err_t audio_dsp_set_track_gain(audio_element_handle_t self, float gain_db);
+
+/**
+ * @brief Installe (ou retire avec NULL) la fonction de mesure de niveau,
+ *        appelée depuis la tâche de l'élément pour chaque bloc.
+ */
+esp_err_t audio_dsp_set_meter_cb(audio_element_handle_t self, audio_dsp_meter_cb cb, void *ctx);
+
+/**
+ * @brief Retire de l'entrée les trames source [from, to) (to = UINT64_MAX :
+ *        jusqu'à la fin), comptées depuis l'ouverture de l'élément. Les
+ *        coupes sont données dans l'ordre du flux. Avec junction, la fin de
+ *        la coupe est une jonction entre pistes où le gap est mesuré.
+ * @return ESP_ERR_NO_MEM si la file des coupes est pleine.
+ */
+esp_err_t audio_dsp_cut(audio_element_handle_t self, uint64_t from, uint64_t to, bool junction);
+
+/**
+ * @brief Oublie les coupes en attente (pipeline arrêté).
+ */
+esp_err_t audio_dsp_clear_cuts(audio_element_handle_t self);
+
+/**
+ * @brief Dernier gap mesuré à une jonction, en trames de sortie : silence
+ *        de part et d'autre et interruption de la sortie si le pipeline
+ *        a été relancé.
+ */
+uint32_t audio_dsp_get_last_gap(audio_element_handle_t self);
+
+/**
+ * @brief Retourne le volume logiciel courant.
+ */
+int audio_dsp_get_volume(audio_element_handle_t self);
+
+/**
+ * @brief Temps de calcul cumulé de l'élément en µs, hors attente des anneaux.
+ */
+uint64_t audio_dsp_get_busy_us(audio_element_handle_t self);
+
+/**
+ * @brief Octets écrits dans l'anneau de sortie depuis la création.
+ */
+uint64_t audio_dsp_get_out_bytes(audio_element_handle_t self);
+
+/**
+ * @brief Mémoire tenue par l'élément : état, tampon d'entrée et, entre
+ *        open et close, historiques, sortie et coefficients.
+ */
+size_t audio_dsp_get_memory(audio_element_handle_t self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_DSP_H
@@ -0,0 +1,271 @@
+// audio_eq.c
+#include "audio_eq.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#if CONFIG_AUDIO_DSP_USE_ESP_DSP
+#include "dsps_biquad.h"
+#endif
+
+#define EQ_FRAMES 256
+#define EQ_CHANNELS 2
+#define EQ_OUT_MAX (1 << 20)
+
+static const char *TAG = "audio_eq";
+
+// Coefficients {b0, b1, b2, a1, a2} normalisés par a0, format esp-dsp
+typedef struct {
+    int nbands;
+    float gain;                             // préampli linéaire
+    float coef[AUDIO_EQ_MAX_BANDS][5];
+    int8_t slot[AUDIO_EQ_MAX_BANDS];        // indice de la bande dans audio_eq_settings_t
+    float w[AUDIO_EQ_MAX_BANDS][EQ_CHANNELS][2];
+} eq_chain_t;
+
+struct audio_eq {
+    eq_chain_t cur;
+    eq_chain_t next;                        // chaîne de transition pendant un fondu
+    eq_chain_t staged;                      // écrit par audio_eq_set()
+    volatile bool staged_ready;
+    bool fading;                            // fondu à faire sur le bloc en cours
+    portMUX_TYPE lock;
+    float buf[EQ_CHANNELS][EQ_FRAMES];
+    float fade[EQ_CHANNELS][EQ_FRAMES];
+    volatile uint32_t cycles_per_sample_band;
+};
+
+bool audio_eq_band_is_valid(const audio_eq_band_t *b)
+{
+    // NaN echoue a toutes les comparaisons : chaque borne est ecrite pour le refuser
+    if (!isfinite(b->freq) || !isfinite(b->q) || !isfinite(b->gain_db)) return false;
+    if (b->type == AUDIO_EQ_OFF) return true;
+    return b->type <= AUDIO_EQ_HIGH_SHELF && b->freq >= 20 && b->freq < AUDIO_EQ_RATE / 2 &&
+           b->q >= 0.1f && b->q <= 20 && b->gain_db >= -24 && b->gain_db <= 24;
+}
+
+static void band_coefs(const audio_eq_band_t *b, float c[5])
+{
+    float a = powf(10, b->gain_db / 40);
+    float w0 = 2 * (float)M_PI * b->freq / AUDIO_EQ_RATE;
+    float cw = cosf(w0);
+    float alpha = sinf(w0) / (2 * b->q);
+    float sa = 2 * sqrtf(a) * alpha;
+    float b0, b1, b2, a0, a1, a2;
+
+    switch (b->type) {
+        case AUDIO_EQ_LOW_SHELF:
+            b0 = a * ((a + 1) - (a - 1) * cw + sa);
+            b1 = 2 * a * ((a - 1) - (a + 1) * cw);
+            b2 = a * ((a + 1) - (a - 1) * cw - sa);
+            a0 = (a + 1) + (a - 1) * cw + sa;
+            a1 = -2 * ((a - 1) + (a + 1) * cw);
+            a2 = (a + 1) + (a - 1) * cw - sa;
+            break;
+        case AUDIO_EQ_HIGH_SHELF:
+            b0 = a * ((a + 1) + (a - 1) * cw + sa);
+            b1 = -2 * a * ((a - 1) + (a + 1) * cw);
+            b2 = a * ((a + 1) + (a - 1) * cw - sa);
+            a0 = (a + 1) - (a - 1) * cw + sa;
+            a1 = 2 * ((a - 1) - (a + 1) * cw);
+            a2 = (a + 1) - (a - 1) * cw - sa;
+            break;
+        default: // AUDIO_EQ_PEAKING
+            b0 = 1 + alpha * a;
+            b1 = -2 * cw;
+            b2 = 1 - alpha * a;
+            a0 = 1 + alpha / a;
+            a1 = -2 * cw;
+            a2 = 1 - alpha / a;
+            break;
+    }
+    c[0] = b0 / a0;
+    c[1] = b1 / a0;
+    c[2] = b2 / a0;
+    c[3] = a1 / a0;
+    c[4] = a2 / a0;
+}
+
+static inline void biquad(float *x, int len, const float *c, float *w)
+{
+#if CONFIG_AUDIO_DSP_USE_ESP_DSP
+    dsps_biquad_f32(x, x, len, (float *)c, w);
+#else
+    // même récurrence que dsps_biquad_f32_ansi (forme directe II)
+    for (int i = 0; i < len; i++) {
+        float d0 = x[i] - c[3] * w[0] - c[4] * w[1];
+        float y = c[0] * d0 + c[1] * w[0] + c[2] * w[1];
+        w[1] = w[0];
+        w[0] = d0;
+        x[i] = y;
+    }
+#endif
+}
+
+static void run_chain(eq_chain_t *ch, float *buf[EQ_CHANNELS], int frames)
+{
+    for (int c = 0; c < EQ_CHANNELS; c++) {
+        float *x = buf[c];
+        if (ch->gain != 1.0f) {
+            for (int i = 0; i < frames; i++) x[i] *= ch->gain;
+        }
+        for (int b = 0; b < ch->nbands; b++) {
+            biquad(x, frames, ch->coef[b], ch->w[b][c]);
+        }
+    }
+}
+
+// L'état d'un filtre suit sa bande de réglage, pas son rang dans la chaîne
+// compactée : activer ou couper une bande décale les rangs des suivantes.
+static void carry_state(eq_chain_t *to, const eq_chain_t *from)
+{
+    for (int b = 0; b < to->nbands; b++) {
+        int k = 0;
+        while (k < from->nbands && from->slot[k] != to->slot[b]) k++;
+        if (k < from->nbands) {
+            memcpy(to->w[b], from->w[k], sizeof(to->w[b]));
+        } else {
+            memset(to->w[b], 0, sizeof(to->w[b]));
+        }
+    }
+}
+
+static bool chain_is_identity(const eq_chain_t *ch)
+{
+    return ch->nbands == 0 && ch->gain == 1.0f;
+}
+
+// Échelle 16 bits sans écrêtage ; la borne (environ +30 dBFS) protège le gain qui suit
+static inline int32_t to_s32(float v)
+{
+    v *= 32768.0f;
+    if (v > EQ_OUT_MAX) return EQ_OUT_MAX;
+    if (v < -EQ_OUT_MAX) return -EQ_OUT_MAX;
+    return (int32_t)lrintf(v);
+}
+
+audio_eq_handle_t audio_eq_create(void)
+{
+    audio_eq_handle_t eq = calloc(1, sizeof(struct audio_eq));
+    if (!eq) return NULL;
+    eq->cur.gain = 1.0f;
+    portMUX_INITIALIZE(&eq->lock);
+    return eq;
+}
+
+void audio_eq_destroy(audio_eq_handle_t eq)
+{
+    free(eq);
+}
+
+void audio_eq_reset(audio_eq_handle_t eq)
+{
+    if (eq) memset(eq->cur.w, 0, sizeof(eq->cur.w));
+}
+
+bool audio_eq_begin(audio_eq_handle_t eq)
+{
+    if (!eq) return false;
+    if (eq->staged_ready) {
+        taskENTER_CRITICAL(&eq->lock);
+        eq->next.nbands = eq->staged.nbands;
+        eq->next.gain = eq->staged.gain;
+        memcpy(eq->next.coef, eq->staged.coef, sizeof(eq->next.coef));
+        memcpy(eq->next.slot, eq->staged.slot, sizeof(eq->next.slot));
+        eq->staged_ready = false;
+        taskEXIT_CRITICAL(&eq->lock);
+        // la nouvelle chaîne repart de l'état de l'ancienne, bande par bande
+        carry_state(&eq->next, &eq->cur);
+        eq->fading = true;
+    }
+    return eq->fading || !chain_is_identity(&eq->cur);
+}
+
+// Un tronçon d'au plus EQ_FRAMES trames
+static void process_part(audio_eq_handle_t eq, const int16_t *pcm, int32_t *out, int frames)
+{
+    bool fading = eq->fading;
+    for (int i = 0; i < frames; i++) {
+        float l = pcm[2 * i] * (1.0f / 32768.0f);
+        float rr = pcm[2 * i + 1] * (1.0f / 32768.0f);
+        eq->buf[0][i] = l;
+        eq->buf[1][i] = rr;
+        if (fading) {
+            eq->fade[0][i] = l;
+            eq->fade[1][i] = rr;
+        }
+    }
+
+    float *buf[EQ_CHANNELS] = { eq->buf[0], eq->buf[1] };
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    run_chain(&eq->cur, buf, frames);
+    if (fading) {
+        float *fade[EQ_CHANNELS] = { eq->fade[0], eq->fade[1] };
+        run_chain(&eq->next, fade, frames);
+        // fondu linéaire de l'ancienne vers la nouvelle réponse sur le tronçon
+        float step = frames > 0 ? 1.0f / frames : 1.0f;
+        for (int c = 0; c < EQ_CHANNELS; c++) {
+            for (int i = 0; i < frames; i++) {
+                float t = i * step;
+                eq->buf[c][i] += (eq->fade[c][i] - eq->buf[c][i]) * t;
+            }
+        }
+        eq->cur = eq->next;
+        eq->fading = false;
+        ESP_LOGI(TAG, "EQ updated: %d band(s)", eq->cur.nbands);
+    } else if (eq->cur.nbands > 0 && frames > 0) {
+        uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+        eq->cycles_per_sample_band = cycles / (frames * EQ_CHANNELS * eq->cur.nbands);
+    }
+
+    for (int i = 0; i < frames; i++) {
+        out[2 * i] = to_s32(eq->buf[0][i]);
+        out[2 * i + 1] = to_s32(eq->buf[1][i]);
+    }
+}
+
+void audio_eq_process(audio_eq_handle_t eq, const int16_t *in, int32_t *out, int frames)
+{
+    for (int done = 0; done < frames; done += EQ_FRAMES) {
+        int n = frames - done < EQ_FRAMES ? frames - done : EQ_FRAMES;
+        process_part(eq, in + 2 * done, out + 2 * done, n);
+    }
+}
+
+esp_err_t audio_eq_set(audio_eq_handle_t eq, const audio_eq_settings_t *settings)
+{
+    if (!eq || !settings || !isfinite(settings->preamp_db)) return ESP_ERR_INVALID_ARG;
+
+    // calculé hors section critique, seule la copie est protégée
+    eq_chain_t chain = { .gain = powf(10, settings->preamp_db / 20) };
+    for (int i = 0; i < AUDIO_EQ_MAX_BANDS; i++) {
+        const audio_eq_band_t *b = &settings->bands[i];
+        if (b->type == AUDIO_EQ_OFF || !audio_eq_band_is_valid(b)) continue;
+        if (b->gain_db == 0) continue;
+        chain.slot[chain.nbands] = (int8_t)i;
+        band_coefs(b, chain.coef[chain.nbands++]);
+    }
+    if (settings->preamp_db == 0) chain.gain = 1.0f;
+
+    taskENTER_CRITICAL(&eq->lock);
+    eq->staged.nbands = chain.nbands;
+    eq->staged.gain = chain.gain;
+    memcpy(eq->staged.coef, chain.coef, sizeof(chain.coef));
+    memcpy(eq->staged.slot, chain.slot, sizeof(chain.slot));
+    eq->staged_ready = true;
+    taskEXIT_CRITICAL(&eq->lock);
+    return ESP_OK;
+}
+
+uint32_t audio_eq_get_cycles_per_sample_band(audio_eq_handle_t eq)
+{
+    return eq ? eq->cycles_per_sample_band : 0;
+}
+
+size_t audio_eq_get_memory(audio_eq_handle_t eq)
+{
+    return eq ? sizeof(*eq) : 0;
+}
@@ -0,0 +1,107 @@
+// audio_eq.h
+#ifndef AUDIO_EQ_H
+#define AUDIO_EQ_H
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_AUDIO_EQ_MAX_BANDS
+#define CONFIG_AUDIO_EQ_MAX_BANDS 5
+#endif
+
+#define AUDIO_EQ_MAX_BANDS CONFIG_AUDIO_EQ_MAX_BANDS
+#define AUDIO_EQ_RATE 44100
+
+typedef enum {
+    AUDIO_EQ_OFF,
+    AUDIO_EQ_PEAKING,
+    AUDIO_EQ_LOW_SHELF,
+    AUDIO_EQ_HIGH_SHELF,
+} audio_eq_type_t;
+
+/**
+ * Réglage d'une bande (filtres biquad du « cookbook » RBJ).
+ */
+typedef struct {
+    audio_eq_type_t type;
+    float freq;         // Hz
+    float gain_db;
+    float q;
+} audio_eq_band_t;
+
+/**
+ * Réglage complet de l'égaliseur.
+ */
+typedef struct {
+    float preamp_db;    // gain appliqué avant les bandes, pour garder de la marge
+    audio_eq_band_t bands[AUDIO_EQ_MAX_BANDS];
+} audio_eq_settings_t;
+
+typedef struct audio_eq *audio_eq_handle_t;
+
+/**
+ * @brief Crée l'égaliseur (PCM stéréo à 44,1 kHz). Il n'est pas un élément
+ *        du pipeline : l'élément DSP l'applique après la conversion de
+ *        fréquence, avant le volume et le limiteur (voir audio_dsp_cfg_t).
+ */
+audio_eq_handle_t audio_eq_create(void);
+
+/**
+ * @brief Libère l'égaliseur.
+ */
+void audio_eq_destroy(audio_eq_handle_t eq);
+
+/**
+ * @brief Applique un nouveau réglage. Le passage des anciens aux nouveaux
+ *        coefficients se fait par fondu sur un bloc, sans clic.
+ */
+esp_err_t audio_eq_set(audio_eq_handle_t eq, const audio_eq_settings_t *settings);
+
+/**
+ * @brief Début d'un bloc : prend le dernier réglage posé par audio_eq_set.
+ * @return false quand le bloc peut passer sans filtrage (ni bande active,
+ *         ni préampli, ni fondu en cours).
+ */
+bool audio_eq_begin(audio_eq_handle_t eq);
+
+/**
+ * @brief Filtre frames trames stéréo entrelacées. La sortie garde l'échelle
+ *        de l'entrée sans être écrêtée à 16 bits : un renforcement dépasse
+ *        la pleine échelle, le limiteur qui suit le ramène.
+ */
+void audio_eq_process(audio_eq_handle_t eq, const int16_t *in, int32_t *out, int frames);
+
+/**
+ * @brief Oublie l'état des filtres (pipeline relancé).
+ */
+void audio_eq_reset(audio_eq_handle_t eq);
+
+/**
+ * @brief Coût mesuré du filtrage, en cycles CPU par échantillon et par bande
+ *        (0 tant qu'aucun bloc n'a été filtré).
+ */
+uint32_t audio_eq_get_cycles_per_sample_band(audio_eq_handle_t eq);
+
+/**
+ * @brief Mémoire tenue par l'égaliseur : état et tampons de calcul.
+ */
+size_t audio_eq_get_memory(audio_eq_handle_t eq);
+
+/**
+ * @brief Vérifie un réglage de bande : valeurs finies, et pour une bande
+ *        active fréquence, Q et gain dans les bornes.
+ */
+bool audio_eq_band_is_valid(const audio_eq_band_t *band);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_EQ_H
@@ -3,22 +3,437 @@
 #include "esp_log.h"
 #include "audio_pipeline.h"
 #include "audio_element.h"
-#include "fatfs_stream.h"
 #include "mp3_decoder.h"
 #include "a2dp_stream.h"
-#include "filter_resample.h"
+#include "bt_control.h"
+#include "audio_dsp.h"
+#include "audio_eq.h"
 #include "playlist_manager.h"
+#include "replaygain.h"
+#include "track_index.h"
+#include "track_reader.h"
+#include "status_push.h"
+#include "http_chunk.h"
+#include "link_quality.h"
+#include "mem_budget.h"
+#include "playback_state.h"
+#include "sdkconfig.h"
+#include "path_config.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
+#include "ringbuf.h"
+#if CONFIG_ESP_COEX_SW_COEXIST_ENABLE
+#include "esp_coexist.h"
+#endif
+
+#define CMD_QUEUE_LEN 8
+#define CTL_TASK_STACK 4096
+#define EVT_TASK_STACK 3072
+#define PREBUFFER_MAX_US 3000000    // sans enceinte, decodage borne meme si l'anneau ne se remplit pas
+
+#ifndef CONFIG_AUDIO_PREBUFFER_PCT
+#define CONFIG_AUDIO_PREBUFFER_PCT 90
+#endif
+
+// Format attendu par la source A2DP (SBC)
+#define SINK_RATE AUDIO_DSP_OUT_RATE
+#define SINK_CHANNELS AUDIO_DSP_OUT_CHANNELS
 
 static const char *TAG = "audio_mgr";
 
 static audio_pipeline_handle_t pipeline = NULL;
-static audio_element_handle_t fatfs_reader = NULL;
 static audio_element_handle_t mp3_decoder = NULL;
 static audio_element_handle_t bt_stream_writer = NULL;
-static audio_element_handle_t rsp_handle = NULL;
+static audio_element_handle_t dsp_handle = NULL;
+static audio_eq_handle_t eq_handle = NULL;        // applique par l'element DSP
 static audio_event_iface_handle_t evt = NULL;
+static volatile bool paused = false;
+static volatile bool stopped = false;   // pipeline garde mais arrete
+static uint32_t stop_pos_ms = 0;        // position de reprise apres un stop
+
+/*
+ * Sans enceinte, le pipeline ne joue pas dans le vide : l'emetteur A2DP est
+ * suspendu pour garder ce qui est deja decode, les anneaux se remplissent,
+ * puis le decodeur est suspendu a son tour (plus de lecture SD ni de
+ * calcul). A la connexion, tout repart de la trame ou il s'etait arrete.
+ */
+typedef enum {
+    GATE_OPEN,          // enceinte connectee
+    GATE_FILLING,       // pas d'enceinte : les anneaux se remplissent
+    GATE_CLOSED,        // prebuffer pret, decodeur suspendu
+} gate_state_t;
+
+static bool sink_up = false;            // dernier etat du lien annonce par bt_control
+static gate_state_t gate = GATE_OPEN;
+static int64_t gate_since_us = 0;
+static int volume = AUDIO_DSP_VOLUME_MAX;
+static audio_eq_settings_t eq_settings;
+
+// Vrai si la piste courante n'est pas deja au format de la sortie A2DP
+static bool resampling = false;
+static int src_rate = SINK_RATE;
+static int src_channels = SINK_CHANNELS;
+static audio_rsp_stats_t rsp_stats;
+static uint32_t rsp_track_start_ms = 0;
+
+// Mesures : ecrites par la tache de controle, copiees sous stats_lock
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_pipeline_stats_t pipe_stats = {
+    .links = { { .name = "mp3" }, { .name = "filter" } },
+};
+static link_quality_t link_q;           // etat du lien A2DP, sous stats_lock
+static uint64_t source_read_us = 0;     // cumule par la tache du decodeur
+static int64_t last_sample_us = 0;
+static size_t stack_bytes = 0;         // piles des taches du pipeline
+static uint32_t resume_offset = 0;      // position de reprise de la premiere piste
+static volatile bool playlist_ahead = false;    // get_next() deja appele pour la piste suivante
+
+/*
+ * Toutes les commandes de transport passent par cette file : seule la tache
+ * de controle touche au pipeline, les appelants (httpd, Bluedroid) ne
+ * bloquent jamais sur audio_pipeline_wait_for_stop.
+ */
+typedef struct {
+    audio_cmd_type_t type;
+    uint32_t serial;            // AUDIO_CMD_TRACK_END, AUDIO_CMD_FORMAT : piste concernee
+    int rate;                   // AUDIO_CMD_FORMAT
+    int channels;
+    int32_t seek_ms;            // AUDIO_CMD_SEEK
+    bool relative;
+    bool connected;             // AUDIO_CMD_SINK
+    int64_t queued_us;
+    char path[TRACK_PATH_MAX];  // AUDIO_CMD_PLAY
+} audio_cmd_t;
+
+static QueueHandle_t cmd_queue = NULL;
+static volatile uint32_t track_serial = 0;
+static uint32_t ended_in_pause = 0;     // piste finie pendant la pause : suivante a la reprise
+static bool halted_in_pause = false;    // seek pendant la pause : pipeline relance a la reprise
+static audio_cmd_stats_t cmd_stats[AUDIO_CMD_MAX];
+
+static const char *const cmd_names[AUDIO_CMD_MAX] = {
+    [AUDIO_CMD_START] = "start",
+    [AUDIO_CMD_STOP] = "stop",
+    [AUDIO_CMD_PLAY] = "play",
+    [AUDIO_CMD_NEXT] = "next",
+    [AUDIO_CMD_PREV] = "prev",
+    [AUDIO_CMD_PAUSE] = "pause",
+    [AUDIO_CMD_RESUME] = "resume",
+    [AUDIO_CMD_TRACK_END] = "track_end",
+    [AUDIO_CMD_FORMAT] = "format",
+    [AUDIO_CMD_SEEK] = "seek",
+    [AUDIO_CMD_SINK] = "sink",
+};
+
+/*
+ * Le decodeur lit directement la piste via track_reader. En mode gapless,
+ * la piste suivante est pre-ouverte a l'approche de la fin et ses donnees
+ * sont enchainees dans le flux MP3 sans arreter le pipeline.
+ */
+static void apply_track_gain(const char *uri);
+
+// Delai et remplissage des encodeurs : retires par l'element DSP
+static void forward_cuts(void)
+{
+    track_cut_t cut;
+    while (track_reader_take_cut(&cut)) {
+        if (audio_dsp_cut(dsp_handle, cut.from, cut.to, cut.junction) != ESP_OK) {
+            ESP_LOGW(TAG, "Cut %llu..%llu dropped", (unsigned long long)cut.from,
+                     (unsigned long long)cut.to);
+        }
+    }
+}
+
+static audio_element_err_t mp3_read_cb(audio_element_handle_t el, char *buf, int len,
+                                       TickType_t wait_time, void *ctx)
+{
+#if CONFIG_AUDIO_GAPLESS
+    if (track_reader_wants_next()) {
+        const char *next_uri = playlist_manager_get_next();
+        playlist_ahead = true;
+        if (track_reader_prepare_next(next_uri) == ESP_OK) {
+            ESP_LOGI(TAG, "Prepared next track: %s", next_uri);
+        }
+    }
+#endif
+    bool had_pending = track_reader_get_pending_uri() != NULL;
+    int64_t t0 = esp_timer_get_time();
+    int r = track_reader_read(buf, len);
+    __atomic_add_fetch(&source_read_us, (uint64_t)(esp_timer_get_time() - t0), __ATOMIC_RELAXED);
+    forward_cuts();
+    if (had_pending && !track_reader_get_pending_uri()) {
+        // enchainement gapless : nouvelle piste, son gain s'applique des
+        // que ses premiers echantillons atteignent l'element DSP (a peu pres)
+        playlist_ahead = false;
+        replaygain_analysis_end(true);
+        apply_track_gain(track_reader_get_current_uri());
+        playback_state_set_track(track_reader_get_current_uri(), 0);
+        status_push_notify();
+    }
+    return r > 0 ? r : AEL_IO_DONE;
+}
+
+/*
+ * Prochaine piste a jouer : si une piste a deja ete preparee, l'index de la
+ * playlist a deja avance, on la reprend au lieu d'appeler get_next().
+ * Pipeline arrete uniquement : la tache du decodeur avance aussi la playlist.
+ */
+static const char *take_next_uri(char *buf, size_t size)
+{
+    const char *pending = track_reader_get_pending_uri();
+    if (pending) {
+        strlcpy(buf, pending, size);
+        return buf;
+    }
+    return playlist_manager_get_next();
+}
+
+static bool needs_resampler(int rate, int channels)
+{
+    return rate != SINK_RATE || channels != SINK_CHANNELS;
+}
+
+// Cumule le temps de lecture de la piste qui se termine selon le chemin suivi
+static void account_track(void)
+{
+    uint32_t played_ms = (uint32_t)(esp_timer_get_time() / 1000) - rsp_track_start_ms;
+    if (resampling) {
+        rsp_stats.resampled_ms += played_ms;
+    } else {
+        rsp_stats.bypassed_ms += played_ms;
+        ESP_LOGI(TAG, "Resampler bypassed for %u ms of audio", (unsigned)played_ms);
+    }
+}
+
+/*
+ * Adapte l'element DSP au format de la piste : aux pistes deja en
+ * 44,1 kHz stereo il ne fait que le volume, ou rien a volume maximal.
+ */
+static void configure_chain(int rate, int channels)
+{
+    resampling = needs_resampler(rate, channels);
+    audio_dsp_set_src_info(dsp_handle, rate, channels);
+    src_rate = rate;
+    src_channels = channels;
+    rsp_track_start_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    ESP_LOGI(TAG, "Track format %d Hz %d ch: resampler %s", rate, channels,
+             resampling ? "active" : "bypassed");
+}
+
+// Nom de la piste relatif a MP3_DIR, NULL si uri est hors de la bibliotheque
+static const char *track_name(const char *uri)
+{
+    size_t dir_len = strlen(MP3_DIR);
+    return uri && strncmp(uri, MP3_DIR "/", dir_len + 1) == 0 ? uri + dir_len + 1 : NULL;
+}
+
+/*
+ * Gain de normalisation de la piste : celui de son tag ReplayGain, sinon
+ * celui mesure lors d'une ecoute precedente, sinon 0 dB et la piste est
+ * mesuree pendant cette ecoute.
+ */
+static void apply_track_gain(const char *uri)
+{
+#if CONFIG_AUDIO_REPLAYGAIN
+    float gain = 0;
+    const char *source = "none";
+    const char *name = track_name(uri);
+    int id = name ? track_index_find(name) : -1;
+
+    if (track_reader_get_tag_gain(&gain)) {
+        source = "tag";
+    } else if (id >= 0 && replaygain_lookup(name, track_index_size(id), &gain)) {
+        source = "cache";
+    } else if (id >= 0) {
+        replaygain_analysis_begin(name, track_index_size(id));
+        source = "analysis";
+    }
+    audio_dsp_set_track_gain(dsp_handle, gain);
+    ESP_LOGI(TAG, "Track gain %.2f dB (%s)", gain, source);
+#endif
+}
+
+// Ouvre la piste et adapte la chaine a son format (pipeline arrete)
+static void open_track(const char *uri)
+{
+    int rate, channels;
+    replaygain_analysis_end(false);
+    track_reader_open(uri);
+    playlist_ahead = false;
+    apply_track_gain(uri);
+    playback_state_set_track(uri, 0);
+    if (!track_reader_get_format(&rate, &channels)) {
+        rate = src_rate;    // format inconnu : on garde la config courante,
+        channels = src_channels; // corrigee par l'info du decodeur
+    }
+    configure_chain(rate, channels);
+    if (resampling) {
+        rsp_stats.resampled_tracks++;
+    } else {
+        rsp_stats.bypassed_tracks++;
+    }
+}
+
+// Lien perdu pendant la lecture : l'emetteur garde ses donnees
+static void gate_begin(void)
+{
+    if (!pipeline || stopped || paused || sink_up || gate != GATE_OPEN) return;
+    if (audio_element_pause(bt_stream_writer) != ESP_OK) {
+        ESP_LOGW(TAG, "A2DP writer not paused");
+    }
+    gate = GATE_FILLING;
+    gate_since_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "No sink, prebuffering");
+    status_push_notify();
+}
+
+// Prebuffer pret (ou delai ecoule) : le decodeur s'arrete a son tour
+static void gate_check(const audio_link_stats_t *tx)
+{
+    if (gate != GATE_FILLING) return;
+    bool ready = tx->size && (uint64_t)tx->fill * 100 >= (uint64_t)tx->size * CONFIG_AUDIO_PREBUFFER_PCT;
+    if (!ready && esp_timer_get_time() - gate_since_us < PREBUFFER_MAX_US) return;
+    audio_element_pause(mp3_decoder);
+    gate = GATE_CLOSED;
+    playback_state_set_offset((uint32_t)track_reader_get_offset());
+    playback_state_flush(true);
+    ESP_LOGI(TAG, "Prebuffer %s (%u bytes), decoder suspended", ready ? "ready" : "timed out",
+             (unsigned)tx->fill);
+}
+
+// Enceinte connectee : reprise immediate sur les anneaux pleins
+static void gate_open(void)
+{
+    if (gate == GATE_OPEN) return;
+    if (gate == GATE_CLOSED) audio_element_resume(mp3_decoder, 0, 0);
+    audio_element_resume(bt_stream_writer, 0, 0);
+    gate = GATE_OPEN;
+    ESP_LOGI(TAG, "Sink connected, %u ms after the link loss",
+             (unsigned)((esp_timer_get_time() - gate_since_us) / 1000));
+    status_push_notify();
+}
+
+static void halt_pipeline(void)
+{
+    audio_pipeline_stop(pipeline);
+    audio_pipeline_wait_for_stop(pipeline);
+    audio_dsp_clear_cuts(dsp_handle);
+}
+
+// Relance le pipeline vide sur la position courante du lecteur de piste
+static void rerun_pipeline(void)
+{
+    forward_cuts();
+    audio_pipeline_reset_ringbuffer(pipeline);
+    audio_pipeline_reset_elements(pipeline);
+    audio_pipeline_change_state(pipeline, AEL_STATE_INIT);
+    audio_pipeline_run(pipeline);
+    track_serial++;
+    paused = false;
+    stopped = false;
+    halted_in_pause = false;
+    gate = GATE_OPEN;
+    gate_begin();
+    status_push_notify();
+}
+
+// Pipeline arrete depuis t0 : charge uri et relance
+static void load_track(const char *uri, int64_t t0)
+{
+    if (!stopped) account_track();
+    open_track(uri);
+    ESP_LOGI(TAG, "Loading: %s", uri);
+    rerun_pipeline();
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    taskENTER_CRITICAL(&stats_lock);
+    pipe_stats.switch_recent_us[pipe_stats.switch_count % AUDIO_SWITCH_WINDOW] = us;
+    pipe_stats.switch_count++;
+    pipe_stats.switch_total_us += us;
+    if (pipe_stats.switch_recent_len < AUDIO_SWITCH_WINDOW) pipe_stats.switch_recent_len++;
+    taskEXIT_CRITICAL(&stats_lock);
+    ESP_LOGI(TAG, "Track switch in %u ms", (unsigned)(us / 1000));
+}
+
+/*
+ * Lit uri tout de suite. Comme pour do_skip, la playlist n'est placee sur
+ * la piste qu'une fois le pipeline arrete : la tache du decodeur ne peut
+ * plus l'avancer pour preparer la piste suivante, et l'avance deja faite
+ * est remplacee par la position de uri.
+ */
+static void restart_with(const char *uri)
+{
+    int64_t t0 = esp_timer_get_time();
+    halt_pipeline();
+    const char *name = track_name(uri);
+    if (name) playlist_manager_set_current_by_name(name);
+    load_track(uri, t0);
+}
+
+/*
+ * Repositionne la piste courante : meme arret du pipeline qu'un changement
+ * de piste, sans reouvrir le fichier. La mesure ReplayGain en cours est
+ * abandonnee, la piste n'ayant pas ete ecoutee en entier. En pause, le
+ * pipeline reste arrete et ne repart qu'a la reprise.
+ */
+static void do_seek(int64_t ms)
+{
+    uint32_t duration = track_reader_get_duration_ms();
+    if (ms < 0) ms = 0;
+    if (duration && ms >= duration) ms = duration - 1;
+    halt_pipeline();
+    esp_err_t err = track_reader_seek_ms((uint32_t)ms);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Seek to %u ms", (unsigned)ms);
+        replaygain_analysis_end(false);
+        playback_state_set_offset((uint32_t)track_reader_get_offset());
+    } else {
+        ESP_LOGW(TAG, "Seek to %u ms failed: %s", (unsigned)ms, esp_err_to_name(err));
+    }
+    if (paused) {
+        track_serial++;     // fin de piste deja signalee : ignoree
+        halted_in_pause = true;
+        status_push_notify();
+        return;
+    }
+    rerun_pipeline();
+}
+
+/*
+ * Format reel annonce par le decodeur. Il ne differe de celui lu dans
+ * l'en-tete que pour un fichier mal forme ; l'element DSP s'y adapte
+ * au bloc suivant.
+ */
+static void apply_decoded_format(int rate, int channels)
+{
+    if (rate <= 0 || channels <= 0 || (rate == src_rate && channels == src_channels)) return;
+    ESP_LOGW(TAG, "Decoder reports %d Hz %d ch (expected %d Hz %d ch)",
+             rate, channels, src_rate, src_channels);
+    account_track();
+    configure_chain(rate, channels);
+}
+
+static esp_err_t post(audio_cmd_t *cmd)
+{
+    if (!cmd_queue) return ESP_ERR_INVALID_STATE;
+    cmd->queued_us = esp_timer_get_time();
+    if (xQueueSend(cmd_queue, cmd, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Command queue full, dropping %s", cmd_names[cmd->type]);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t post_cmd(audio_cmd_type_t type, const char *path, uint32_t serial)
+{
+    audio_cmd_t cmd = {
+        .type = type,
+        .serial = serial,
+    };
+    if (path) strlcpy(cmd.path, path, sizeof(cmd.path));
+    return post(&cmd);
+}
 
 static void audio_event_task(void *param)
 {
@@ -29,27 +444,47 @@ static void audio_event_task(void *param)
         }
 
         if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT &&
-            msg.source == (void *)fatfs_reader &&
+            msg.cmd == AEL_MSG_CMD_REPORT_STATUS &&
+            (intptr_t)msg.data >= AEL_STATUS_ERROR_OPEN &&
+            (intptr_t)msg.data <= AEL_STATUS_ERROR_UNKNOWN) {
+            bool decoder = msg.source == (void *)mp3_decoder;
+            ESP_LOGW(TAG, "%s error, status %d", decoder ? "Decoder" : "Element", (int)(intptr_t)msg.data);
+            taskENTER_CRITICAL(&stats_lock);
+            if (decoder) {
+                pipe_stats.decoder_errors++;
+            } else {
+                pipe_stats.element_errors++;
+            }
+            taskEXIT_CRITICAL(&stats_lock);
+        } else if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT &&
+            msg.source == (void *)mp3_decoder &&
             msg.cmd == AEL_MSG_CMD_REPORT_STATUS &&
             (intptr_t)msg.data == AEL_STATUS_STATE_FINISHED) {
             ESP_LOGI(TAG, "Track finished. Loading next track.");
-            audio_pipeline_stop(pipeline);
-            audio_pipeline_wait_for_stop(pipeline);
-            const char *next_uri = playlist_manager_get_next();
-            audio_element_set_uri(fatfs_reader, next_uri);
-            ESP_LOGI(TAG, "Next track: %s", next_uri);
-            audio_pipeline_reset_ringbuffer(pipeline);
-            audio_pipeline_reset_elements(pipeline);
-            audio_pipeline_change_state(pipeline, AEL_STATE_INIT);
-            audio_pipeline_run(pipeline);
+            post_cmd(AUDIO_CMD_TRACK_END, NULL, track_serial);
+        } else if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT &&
+                   msg.source == (void *)mp3_decoder &&
+                   msg.cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO) {
+            audio_element_info_t info = { 0 };
+            audio_element_getinfo(mp3_decoder, &info);
+            audio_cmd_t cmd = {
+                .type = AUDIO_CMD_FORMAT,
+                .serial = track_serial,
+                .rate = info.sample_rates,
+                .channels = info.channels,
+            };
+            post(&cmd);
         }
     }
 }
 
-esp_err_t audio_manager_start(void)
+/*
+ * Construit le pipeline une fois pour toutes : stop, pause et changements
+ * de piste reutilisent ensuite les memes elements, anneaux et taches.
+ */
+static esp_err_t build_pipeline(void)
 {
-    ESP_LOGI(TAG, "Starting audio pipeline");
-
+    ESP_LOGI(TAG, "Building audio pipeline");
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     pipeline = audio_pipeline_init(&pipeline_cfg);
     if (!pipeline) {
@@ -57,121 +492,560 @@ esp_err_t audio_manager_start(void)
         return ESP_FAIL;
     }
 
-    fatfs_stream_cfg_t fatfs_cfg = FATFS_STREAM_CFG_DEFAULT();
-    fatfs_cfg.type = AUDIO_STREAM_READER;
-    fatfs_reader = fatfs_stream_init(&fatfs_cfg);
-
     mp3_decoder_cfg_t mp3_cfg = DEFAULT_MP3_DECODER_CONFIG();
     mp3_decoder = mp3_decoder_init(&mp3_cfg);
+    audio_element_set_read_cb(mp3_decoder, mp3_read_cb, NULL);
 
-      rsp_filter_cfg_t rsp_cfg = DEFAULT_RESAMPLE_FILTER_CONFIG();
-    rsp_cfg.dest_rate = 44100;
-    rsp_cfg.dest_ch = 2;
-    rsp_cfg.src_rate = 48000;
-    rsp_handle = rsp_filter_init(&rsp_cfg);
+    // Reechantillonnage, egaliseur, volume et limiteur en une passe : les
+    // renforcements de l'egaliseur passent par le limiteur, sans ecretage
+    eq_handle = audio_eq_create();
+    audio_eq_set(eq_handle, &eq_settings);
+    audio_dsp_cfg_t dsp_cfg = DEFAULT_AUDIO_DSP_CONFIG();
+    dsp_cfg.volume = volume;
+    dsp_cfg.eq = eq_handle;
+    dsp_handle = audio_dsp_init(&dsp_cfg);
+#if CONFIG_AUDIO_REPLAYGAIN
+    audio_dsp_set_meter_cb(dsp_handle, replaygain_analysis_feed, NULL);
+#endif
+    src_rate = dsp_cfg.src_rate;
+    src_channels = dsp_cfg.src_ch;
 
+    // Le flux prend le callback A2DP : bt_control doit continuer a voir les
+    // connexions, et nous les signale en retour (voir gate_begin)
     a2dp_stream_config_t a2dp_config = {
         .type = AUDIO_STREAM_WRITER,
-        .user_callback = { 0 },
+        .user_callback = {
+            .user_a2d_cb = bt_control_a2dp_cb,
+        },
     };
     bt_stream_writer = a2dp_stream_init(&a2dp_config);
 
-    esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, 5, 0);
-
-    audio_pipeline_register(pipeline, fatfs_reader, "file");
     audio_pipeline_register(pipeline, mp3_decoder, "mp3");
-    audio_pipeline_register(pipeline, rsp_handle, "filter");
+    audio_pipeline_register(pipeline, dsp_handle, "filter");
     audio_pipeline_register(pipeline, bt_stream_writer, "bt");
 
-    audio_pipeline_link(pipeline, (const char *[]) {"file", "mp3", "filter", "bt"}, 4);
+    audio_pipeline_link(pipeline, (const char *[]) {"mp3", "filter", "bt"}, 3);
 
     audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
     evt = audio_event_iface_init(&evt_cfg);
+    xTaskCreatePinnedToCore(audio_event_task, "audio_evt_task", EVT_TASK_STACK, NULL, 5, NULL, 1);
+    stack_bytes = mp3_cfg.task_stack + dsp_cfg.task_stack + EVT_TASK_STACK + CTL_TASK_STACK;
     audio_pipeline_set_listener(pipeline, evt);
+    return ESP_OK;
+}
+
+// Fin de piste : charge la suivante et relance
+static void next_after_end(void)
+{
+    char uri_buf[TRACK_PATH_MAX];
+    int64_t t0 = esp_timer_get_time();
+    replaygain_analysis_end(true);
+    halt_pipeline();
+    load_track(take_next_uri(uri_buf, sizeof(uri_buf)), t0);
+}
+
+static void do_pause(void)
+{
+    if (!pipeline || stopped || paused) return;
+    ESP_LOGI(TAG, "Pausing audio pipeline");
+    audio_pipeline_pause(pipeline);
+    paused = true;
+    gate = GATE_OPEN;   // tout est suspendu, la garde repart a la reprise
+    playback_state_set_offset((uint32_t)track_reader_get_offset());
+    playback_state_flush(true);
+    status_push_notify();
+}
+
+static void do_resume(void)
+{
+    if (!pipeline || stopped || !paused) return;
+    if (halted_in_pause) {
+        ESP_LOGI(TAG, "Resuming at %u ms", (unsigned)track_reader_get_position_ms());
+        rerun_pipeline();
+        return;
+    }
+    if (ended_in_pause == track_serial) {
+        ESP_LOGI(TAG, "Track ended while paused, resuming on the next one");
+        next_after_end();
+        return;
+    }
+    ESP_LOGI(TAG, "Resuming audio pipeline");
+    audio_pipeline_resume(pipeline);
+    paused = false;
+    gate_begin();
+    status_push_notify();
+}
+
+// Apres un stop les anneaux ont ete vides : on repart de la trame d'arret
+static void restart_stopped(void)
+{
+    esp_err_t err = track_reader_seek_ms(stop_pos_ms);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Return to %u ms failed: %s", (unsigned)stop_pos_ms, esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "Restarting at %u ms", (unsigned)stop_pos_ms);
+    rsp_track_start_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    rerun_pipeline();
+}
+
+/*
+ * Sans effet en lecture ; en pause, reprend ; apres un stop, repart de la
+ * position d'arret. Le premier appel construit le pipeline.
+ */
+static esp_err_t do_start(void)
+{
+    if (pipeline && stopped) {
+        restart_stopped();
+        return ESP_OK;
+    }
+    if (pipeline) {
+        do_resume();
+        return ESP_OK;
+    }
+    esp_err_t err = build_pipeline();
+    if (err != ESP_OK) return err;
 
     const char *uri = playlist_manager_get_next();
-    audio_element_set_uri(fatfs_reader, uri);
+    open_track(uri);
+    if (resume_offset && track_reader_seek_offset(resume_offset) == ESP_OK) {
+        ESP_LOGI(TAG, "Resuming at byte %u", (unsigned)resume_offset);
+        playback_state_set_offset(resume_offset);
+    }
+    resume_offset = 0;
 
     ESP_LOGI(TAG, "Playing: %s", uri);
+    forward_cuts();
     audio_pipeline_run(pipeline);
+    track_serial++;
+    paused = false;
+    // au demarrage, l'enceinte n'est en general pas encore connectee
+    sink_up = bt_control_is_connected();
+    gate = GATE_OPEN;
+    gate_begin();
+    status_push_notify();
+    return ESP_OK;
+}
 
-    xTaskCreatePinnedToCore(audio_event_task, "audio_evt_task", 4096, NULL, 5, NULL, 1);
+/*
+ * Evalue le lien A2DP a partir de l'anneau devant l'emetteur : ce que la
+ * pile en retire, sa file d'attente et le signal mesure. Un lien degrade
+ * obtient la priorite radio face au Wi-Fi ; encombre, les reponses HTTP
+ * sont en plus espacees. Agrandir l'anneau n'aiderait pas : la pile perd
+ * les trames apres les avoir prises.
+ */
+static void adapt_link(const audio_link_stats_t *tx)
+{
+    uint64_t out = dsp_handle ? audio_dsp_get_out_bytes(dsp_handle) : 0;
+    link_q_sample_t s = {
+        .now_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .connected = bt_control_is_connected(),
+        .playing = pipeline && !stopped && !paused,
+        .rssi_delta = bt_control_poll_rssi_delta(),
+        .sent_bytes = out > tx->fill ? out - tx->fill : 0,
+        .underruns = tx->empty_events,
+        .queue_fill = tx->fill,
+        .queue_size = tx->size,
+    };
+    taskENTER_CRITICAL(&stats_lock);
+    bool changed = link_quality_update(&link_q, &s);
+    link_q_stats_t st = link_q.stats;
+    taskEXIT_CRITICAL(&stats_lock);
+    if (!changed) return;
 
-    return ESP_OK;
+    ESP_LOGW(TAG, "A2DP link %s (rssi delta %d dB, sent %u%%, queue %u%%)",
+             link_quality_level_name(st.level), st.rssi_delta, st.send_pct, st.queue_pct);
+#if CONFIG_BT_LINK_ADAPT
+#if CONFIG_ESP_COEX_SW_COEXIST_ENABLE
+    esp_coex_preference_set(st.level >= LINK_Q_DEGRADED ? ESP_COEX_PREFER_BT : ESP_COEX_PREFER_BALANCE);
+#endif
+    http_chunk_set_pace(st.level == LINK_Q_CONGESTED ? CONFIG_BT_LINK_HTTP_PACE_MS : 0);
+#endif
 }
 
-static esp_err_t change_track(const char *uri)
+/*
+ * Releve les anneaux et les compteurs des elements (tache de controle :
+ * les elements ne peuvent pas etre detruits pendant la lecture). Un anneau
+ * vu vide alors qu'il ne l'etait pas au releve precedent compte comme un
+ * passage a vide ; pour le dernier, c'est un sous-debit vers l'A2DP.
+ */
+static void sample_pipeline(void)
 {
-    if (!pipeline) return ESP_FAIL;
+    audio_element_handle_t writers[AUDIO_LINK_COUNT] = { mp3_decoder, dsp_handle };
+    audio_link_stats_t links[AUDIO_LINK_COUNT];
+    bool playing = pipeline && !stopped && !paused;
 
-    audio_pipeline_stop(pipeline);
-    audio_pipeline_wait_for_stop(pipeline);
+    for (int i = 0; i < AUDIO_LINK_COUNT; i++) {
+        links[i] = pipe_stats.links[i];
+        ringbuf_handle_t rb = pipeline && writers[i] ? audio_element_get_output_ringbuf(writers[i]) : NULL;
+        if (!rb) {
+            links[i].fill = 0;
+            continue;
+        }
+        uint32_t fill = rb_bytes_filled(rb);
+        if (playing && fill == 0 && links[i].fill > 0) links[i].empty_events++;
+        links[i].size = rb_get_size(rb);
+        links[i].fill = fill;
+    }
+    uint64_t dsp_us = dsp_handle ? audio_dsp_get_busy_us(dsp_handle) : 0;
 
-    audio_element_set_uri(fatfs_reader, uri);
-    ESP_LOGI(TAG, "Loading: %s", uri);
-    audio_pipeline_reset_ringbuffer(pipeline);
-    audio_pipeline_reset_elements(pipeline);
-    audio_pipeline_change_state(pipeline, AEL_STATE_INIT);
-    audio_pipeline_run(pipeline);
+    taskENTER_CRITICAL(&stats_lock);
+    memcpy(pipe_stats.links, links, sizeof(links));
+    pipe_stats.dsp_busy_us = dsp_us;
+    pipe_stats.source_read_us = __atomic_load_n(&source_read_us, __ATOMIC_RELAXED);
+    taskEXIT_CRITICAL(&stats_lock);
+    last_sample_us = esp_timer_get_time();
+    adapt_link(&links[AUDIO_LINK_COUNT - 1]);
+    gate_check(&links[AUDIO_LINK_COUNT - 1]);
+
+    if (playing) {
+        playback_state_set_offset((uint32_t)track_reader_get_offset());
+        playback_state_flush(false);
+    }
+}
+
+/*
+ * Arrete la lecture sans rien liberer : le prochain start reprend a la meme
+ * position avec les memes elements, sans allocation ni nouvelle tache.
+ */
+static esp_err_t do_stop(void)
+{
+    if (!pipeline || stopped) return ESP_OK;
+    ESP_LOGI(TAG, "Stopping audio pipeline");
+    stop_pos_ms = track_reader_get_position_ms();
+    halt_pipeline();
+    track_serial++;     // fin de piste deja signalee : ignoree
+    account_track();
+    replaygain_analysis_end(false);
+    stopped = true;
+    paused = false;
+    halted_in_pause = false;
+    gate = GATE_OPEN;
+    sample_pipeline();
+    playback_state_set_offset((uint32_t)track_reader_get_offset());
+    playback_state_flush(true);
+    status_push_notify();
     return ESP_OK;
 }
 
+/*
+ * Avance ou recule de steps pistes (steps != 0) puis relance une seule fois
+ * le pipeline : une rafale d'appuis sur "suivant" ne coute qu'un changement.
+ * Le pipeline est arrete avant de toucher a la playlist, que la tache du
+ * decodeur avance elle aussi en preparant la piste suivante.
+ */
+static void do_skip(int steps)
+{
+    int64_t t0 = esp_timer_get_time();
+    halt_pipeline();
+    char uri_buf[TRACK_PATH_MAX];
+    const char *uri = NULL;
+    if (steps > 0) {
+        uri = take_next_uri(uri_buf, sizeof(uri_buf));
+        while (--steps > 0) uri = playlist_manager_get_next();
+    } else {
+        if (playlist_ahead) {
+            // annule l'avance faite pour la piste suivante, preparee ou non
+            playlist_manager_get_prev();
+        }
+        for (; steps < 0; steps++) uri = playlist_manager_get_prev();
+    }
+    if (uri) {
+        load_track(uri, t0);
+    } else if (!stopped) {
+        rerun_pipeline();   // playlist vide : la piste courante continue
+    }
+}
+
+static void record_latency(audio_cmd_type_t type, int64_t queued_us, uint32_t merged)
+{
+    audio_cmd_stats_t *st = &cmd_stats[type];
+    uint32_t us = (uint32_t)(esp_timer_get_time() - queued_us);
+    st->count++;
+    st->coalesced += merged;
+    st->last_us = us;
+    if (us > st->max_us) st->max_us = us;
+    ESP_LOGI(TAG, "cmd %s: %u us (%u coalesced)", cmd_names[type], (unsigned)us, (unsigned)merged);
+}
+
+static void audio_control_task(void *param)
+{
+    audio_cmd_t cmd;
+    while (1) {
+        // pendant la lecture, la file est relevee au rythme des mesures
+        bool sampling = pipeline && !stopped && !paused && gate != GATE_CLOSED;
+        TickType_t wait = sampling ? pdMS_TO_TICKS(AUDIO_STATS_PERIOD_MS) : portMAX_DELAY;
+        bool got = xQueueReceive(cmd_queue, &cmd, wait) == pdTRUE;
+        if (pipeline && esp_timer_get_time() - last_sample_us >= AUDIO_STATS_PERIOD_MS * 1000) {
+            sample_pipeline();
+        }
+        if (!got) continue;
+
+        uint32_t merged = 0;
+        switch (cmd.type) {
+            case AUDIO_CMD_START:
+                do_start();
+                break;
+            case AUDIO_CMD_STOP:
+                do_stop();
+                break;
+            case AUDIO_CMD_PLAY:
+                if (pipeline) restart_with(cmd.path);
+                break;
+            case AUDIO_CMD_NEXT:
+            case AUDIO_CMD_PREV: {
+                // regroupe les suivant/precedent deja en file en un seul saut
+                int steps = cmd.type == AUDIO_CMD_NEXT ? 1 : -1;
+                audio_cmd_t more;
+                while (xQueuePeek(cmd_queue, &more, 0) == pdTRUE &&
+                       (more.type == AUDIO_CMD_NEXT || more.type == AUDIO_CMD_PREV)) {
+                    xQueueReceive(cmd_queue, &more, 0);
+                    steps += more.type == AUDIO_CMD_NEXT ? 1 : -1;
+                    merged++;
+                }
+                if (pipeline && steps != 0) do_skip(steps);
+                break;
+            }
+            case AUDIO_CMD_SEEK: {
+                // les deplacements deja en file sont cumules, une position absolue les remplace
+                int64_t ms = cmd.seek_ms;
+                if (cmd.relative) ms += stopped ? stop_pos_ms : track_reader_get_position_ms();
+                audio_cmd_t more;
+                while (xQueuePeek(cmd_queue, &more, 0) == pdTRUE && more.type == AUDIO_CMD_SEEK) {
+                    xQueueReceive(cmd_queue, &more, 0);
+                    ms = more.relative ? ms + more.seek_ms : more.seek_ms;
+                    merged++;
+                }
+                if (pipeline && stopped) {
+                    // arrete : seule la position de reprise change
+                    stop_pos_ms = ms < 0 ? 0 : (uint32_t)ms;
+                } else if (pipeline && track_reader_get_current_uri()) {
+                    do_seek(ms);
+                }
+                break;
+            }
+            case AUDIO_CMD_PAUSE:
+                do_pause();
+                break;
+            case AUDIO_CMD_RESUME:
+                if (pipeline) do_start();
+                break;
+            case AUDIO_CMD_SINK: {
+                // seul le dernier etat du lien compte
+                audio_cmd_t more;
+                while (xQueuePeek(cmd_queue, &more, 0) == pdTRUE && more.type == AUDIO_CMD_SINK) {
+                    xQueueReceive(cmd_queue, &more, 0);
+                    cmd.connected = more.connected;
+                    merged++;
+                }
+                sink_up = cmd.connected;
+                if (sink_up) {
+                    gate_open();
+                } else {
+                    gate_begin();
+                }
+                break;
+            }
+            case AUDIO_CMD_FORMAT:
+                if (pipeline && cmd.serial == track_serial) {
+                    apply_decoded_format(cmd.rate, cmd.channels);
+                }
+                break;
+            case AUDIO_CMD_TRACK_END:
+                // ignore la fin d'une piste deja remplacee par une commande ;
+                // en pause, la piste suivante attend la reprise
+                if (pipeline && cmd.serial == track_serial && paused) {
+                    ended_in_pause = track_serial;
+                } else if (pipeline && cmd.serial == track_serial) {
+                    next_after_end();
+                }
+                break;
+            default:
+                break;
+        }
+        record_latency(cmd.type, cmd.queued_us, merged);
+    }
+}
+
+esp_err_t audio_manager_start(void)
+{
+    if (!cmd_queue) {
+        link_quality_init(&link_q, AUDIO_DSP_OUT_RATE * AUDIO_DSP_OUT_CHANNELS * sizeof(int16_t));
+        cmd_queue = xQueueCreate(CMD_QUEUE_LEN, sizeof(audio_cmd_t));
+        if (!cmd_queue) return ESP_ERR_NO_MEM;
+        if (xTaskCreatePinnedToCore(audio_control_task, "audio_ctl_task", CTL_TASK_STACK, NULL, 6,
+                                    NULL, 1) != pdPASS) {
+            vQueueDelete(cmd_queue);
+            cmd_queue = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return post_cmd(AUDIO_CMD_START, NULL, 0);
+}
+
+void audio_manager_set_resume(uint32_t offset)
+{
+    resume_offset = offset;
+}
+
 esp_err_t audio_manager_next(void)
 {
-    const char *next_uri = playlist_manager_get_next();
-    return change_track(next_uri);
+    return post_cmd(AUDIO_CMD_NEXT, NULL, 0);
 }
 
 esp_err_t audio_manager_prev(void)
 {
-    const char *prev_uri = playlist_manager_get_prev();
-    return change_track(prev_uri);
+    return post_cmd(AUDIO_CMD_PREV, NULL, 0);
 }
 
 esp_err_t audio_manager_pause(void)
 {
-    if (!pipeline) return ESP_FAIL;
-    ESP_LOGI(TAG, "Pausing audio pipeline");
-    return audio_pipeline_pause(pipeline);
+    return post_cmd(AUDIO_CMD_PAUSE, NULL, 0);
 }
 
 esp_err_t audio_manager_resume(void)
 {
-    if (!pipeline) return ESP_FAIL;
-    ESP_LOGI(TAG, "Resuming audio pipeline");
-    return audio_pipeline_resume(pipeline);
+    return post_cmd(AUDIO_CMD_RESUME, NULL, 0);
 }
 
 esp_err_t audio_manager_play(const char *path)
 {
-    return change_track(path);
+    if (!path) return ESP_ERR_INVALID_ARG;
+    return post_cmd(AUDIO_CMD_PLAY, path, 0);
 }
 
-esp_err_t audio_manager_stop(void)
+esp_err_t audio_manager_seek(uint32_t ms)
 {
-    ESP_LOGI(TAG, "Stopping audio pipeline");
-    if (!pipeline) return ESP_FAIL;
+    audio_cmd_t cmd = {
+        .type = AUDIO_CMD_SEEK,
+        .seek_ms = ms > INT32_MAX ? INT32_MAX : (int32_t)ms,
+    };
+    return post(&cmd);
+}
 
-    audio_pipeline_stop(pipeline);
-    audio_pipeline_wait_for_stop(pipeline);
-    audio_pipeline_terminate(pipeline);
+esp_err_t audio_manager_seek_relative(int32_t delta_ms)
+{
+    audio_cmd_t cmd = {
+        .type = AUDIO_CMD_SEEK,
+        .seek_ms = delta_ms,
+        .relative = true,
+    };
+    return post(&cmd);
+}
 
-    audio_pipeline_unregister(pipeline, fatfs_reader);
-    audio_pipeline_unregister(pipeline, mp3_decoder);
-    audio_pipeline_unregister(pipeline, rsp_handle);
-    audio_pipeline_unregister(pipeline, bt_stream_writer);
+esp_err_t audio_manager_set_sink_connected(bool connected)
+{
+    // avant le premier demarrage, do_start lit l'etat du lien lui-meme
+    if (!cmd_queue) return ESP_OK;
+    audio_cmd_t cmd = {
+        .type = AUDIO_CMD_SINK,
+        .connected = connected,
+    };
+    return post(&cmd);
+}
 
-    audio_pipeline_deinit(pipeline);
-    audio_element_deinit(fatfs_reader);
-    audio_element_deinit(mp3_decoder);
+esp_err_t audio_manager_set_volume(int level)
+{
+    if (level < 0 || level > AUDIO_DSP_VOLUME_MAX) return ESP_ERR_INVALID_ARG;
+    volume = level;
+    if (dsp_handle) audio_dsp_set_volume(dsp_handle, level);
+    status_push_notify();
+    return ESP_OK;
+}
 
-    audio_element_deinit(bt_stream_writer);
+int audio_manager_get_volume(void)
+{
+    return volume;
+}
 
-    if (evt) {
-        audio_event_iface_destroy(evt);
-        evt = NULL;
+esp_err_t audio_manager_set_eq(const audio_eq_settings_t *settings)
+{
+    for (int i = 0; i < AUDIO_EQ_MAX_BANDS; i++) {
+        if (!audio_eq_band_is_valid(&settings->bands[i])) return ESP_ERR_INVALID_ARG;
     }
-
-    pipeline = NULL;
+    if (!(settings->preamp_db >= -24 && settings->preamp_db <= 12)) return ESP_ERR_INVALID_ARG;
+    eq_settings = *settings;
+    if (eq_handle) audio_eq_set(eq_handle, &eq_settings);
     return ESP_OK;
 }
+
+/*
+ * Compte element par element : les elements allouent dans leurs taches a
+ * l'ouverture, une difference du tas compterait aussi ce que Wi-Fi, HTTP
+ * et Bluetooth allouent au meme moment. L'etat interne du decodeur MP3
+ * n'est pas visible d'ici et n'est pas compte.
+ */
+size_t audio_manager_get_memory_usage(void)
+{
+    if (!pipeline) return 0;
+    size_t n = stack_bytes + audio_dsp_get_memory(dsp_handle) + audio_eq_get_memory(eq_handle) +
+               track_reader_get_memory_usage();
+    audio_element_handle_t writers[AUDIO_LINK_COUNT] = { mp3_decoder, dsp_handle };
+    for (int i = 0; i < AUDIO_LINK_COUNT; i++) {
+        ringbuf_handle_t rb = audio_element_get_output_ringbuf(writers[i]);
+        if (rb) n += rb_get_size(rb);
+    }
+    return n;
+}
+
+void audio_manager_get_eq(audio_eq_settings_t *settings)
+{
+    *settings = eq_settings;
+}
+
+uint32_t audio_manager_get_eq_cycles(void)
+{
+    return eq_handle ? audio_eq_get_cycles_per_sample_band(eq_handle) : 0;
+}
+
+bool audio_manager_is_playing(void)
+{
+    return pipeline && !stopped && !paused;
+}
+
+const char *audio_manager_get_state_name(void)
+{
+    if (!pipeline || stopped) return "stopped";
+    if (paused) return "paused";
+    return gate == GATE_OPEN ? "playing" : "waiting";
+}
+
+uint32_t audio_manager_get_last_gap_samples(void)
+{
+    return dsp_handle ? audio_dsp_get_last_gap(dsp_handle) : 0;
+}
+
+const char *audio_manager_cmd_name(audio_cmd_type_t type)
+{
+    return type < AUDIO_CMD_MAX ? cmd_names[type] : "?";
+}
+
+void audio_manager_get_rsp_stats(audio_rsp_stats_t *out)
+{
+    if (out) *out = rsp_stats;
+}
+
+void audio_manager_get_pipeline_stats(audio_pipeline_stats_t *out)
+{
+    if (!out) return;
+    taskENTER_CRITICAL(&stats_lock);
+    *out = pipe_stats;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+void audio_manager_get_link_stats(link_q_stats_t *out)
+{
+    if (!out) return;
+    taskENTER_CRITICAL(&stats_lock);
+    *out = link_q.stats;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+void audio_manager_get_cmd_stats(audio_cmd_type_t type, audio_cmd_stats_t *out)
+{
+    if (type < AUDIO_CMD_MAX && out) *out = cmd_stats[type];
+}
+
+esp_err_t audio_manager_stop(void)
+{
+    return post_cmd(AUDIO_CMD_STOP, NULL, 0);
+}
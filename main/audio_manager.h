@@ -3,19 +3,102 @@
 #define AUDIO_MANAGER_H
 
 #include "esp_err.h"
+#include "audio_eq.h"
+#include "link_quality.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Commandes traitées par la tâche de contrôle audio.
+ */
+typedef enum {
+    AUDIO_CMD_START,
+    AUDIO_CMD_STOP,
+    AUDIO_CMD_PLAY,
+    AUDIO_CMD_NEXT,
+    AUDIO_CMD_PREV,
+    AUDIO_CMD_PAUSE,
+    AUDIO_CMD_RESUME,
+    AUDIO_CMD_TRACK_END,
+    AUDIO_CMD_FORMAT,
+    AUDIO_CMD_SEEK,
+    AUDIO_CMD_SINK,
+    AUDIO_CMD_MAX,
+} audio_cmd_type_t;
+
+/**
+ * Latence par type de commande, de la mise en file à la fin du traitement.
+ */
+typedef struct {
+    uint32_t count;         // commandes traitées
+    uint32_t coalesced;     // commandes fusionnées dans une précédente
+    uint32_t last_us;
+    uint32_t max_us;
+} audio_cmd_stats_t;
+
+/**
+ * Utilisation du rééchantillonnage : les pistes déjà à 44,1 kHz stéréo
+ * le contournent.
+ */
+typedef struct {
+    uint32_t bypassed_tracks;
+    uint32_t resampled_tracks;
+    uint32_t bypassed_ms;   // temps de lecture sans rééchantillonnage
+    uint32_t resampled_ms;
+} audio_rsp_stats_t;
+
+#define AUDIO_LINK_COUNT 2          // anneaux mp3 -> filter -> bt
+#define AUDIO_SWITCH_WINDOW 32      // changements de piste gardés pour les quantiles
+#define AUDIO_STATS_PERIOD_MS 100
+
+/**
+ * Anneau en sortie d'un élément du pipeline.
+ */
+typedef struct {
+    const char *name;           // élément qui écrit dans l'anneau
+    uint32_t size;
+    uint32_t fill;              // dernier échantillon, en octets
+    uint32_t empty_events;      // passages à vide constatés pendant la lecture
+} audio_link_stats_t;
+
+/**
+ * Mesures du pipeline, cumulées depuis le démarrage.
+ */
+typedef struct {
+    audio_link_stats_t links[AUDIO_LINK_COUNT];
+    uint32_t decoder_errors;    // erreurs signalées par le décodeur MP3
+    uint32_t element_errors;    // erreurs des autres éléments
+    uint64_t source_read_us;    // temps du décodeur passé à lire la piste
+    uint64_t dsp_busy_us;       // conversion, égaliseur, volume et limiteur
+    uint32_t switch_count;      // changements de piste avec arrêt du pipeline
+    uint64_t switch_total_us;
+    uint32_t switch_recent_us[AUDIO_SWITCH_WINDOW]; // les plus récents, non triés
+    uint32_t switch_recent_len;
+} audio_pipeline_stats_t;
+
+/*
+ * Les commandes de transport (start, stop, next, prev, pause, resume, play, seek)
+ * sont mises en file et exécutées par la tâche de contrôle audio : elles
+ * retournent immédiatement, ESP_ERR_TIMEOUT si la file est pleine.
+ */
+
 /**
  * @brief Démarre le pipeline audio :
  *        lit un fichier MP3 depuis la carte SD et l’envoie en Bluetooth A2DP.
+ *        Crée la tâche de contrôle au premier appel ; le pipeline n'est
+ *        construit qu'une fois. Sans effet en lecture, reprend après une
+ *        pause ou un stop (à la position d'arrêt).
  */
 esp_err_t audio_manager_start(void);
 
 /**
- * @brief Arrête et libère complètement le pipeline audio.
+ * @brief Arrête la lecture sans libérer le pipeline, réutilisé au
+ *        prochain démarrage. Sans effet si la lecture est déjà arrêtée.
  */
 esp_err_t audio_manager_stop(void);
 
@@ -41,9 +124,114 @@ esp_err_t audio_manager_resume(void);
 
 /**
  * @brief Lit immediatement le fichier specifie.
+ *
+ * Si path est dans MP3_DIR, la playlist se place sur ce fichier une fois le
+ * pipeline arrete, "suivant" repart donc de la.
  */
 esp_err_t audio_manager_play(const char *path);
 
+/**
+ * @brief Reprend la piste courante à ms depuis son début. En pause, la
+ *        position change et la lecture attend audio_manager_resume().
+ */
+esp_err_t audio_manager_seek(uint32_t ms);
+
+/**
+ * @brief Avance (delta_ms > 0) ou recule dans la piste courante.
+ *        Les déplacements en file sont cumulés en un seul.
+ */
+esp_err_t audio_manager_seek_relative(int32_t delta_ms);
+
+/**
+ * @brief Signale l'état du lien vers l'enceinte. Sans lien, le pipeline
+ *        remplit ses anneaux puis suspend le décodeur ; à la connexion, la
+ *        lecture reprend à la même trame, anneaux pleins.
+ */
+esp_err_t audio_manager_set_sink_connected(bool connected);
+
+/**
+ * @brief Règle le volume logiciel (0 à 100), appliqué immédiatement.
+ */
+esp_err_t audio_manager_set_volume(int level);
+
+/**
+ * @brief Retourne le volume logiciel (0 à 100).
+ */
+int audio_manager_get_volume(void);
+
+/**
+ * @brief Remplace le réglage de l'égaliseur, appliqué sans coupure.
+ * @return ESP_ERR_INVALID_ARG si une bande ou le préampli est hors bornes.
+ */
+esp_err_t audio_manager_set_eq(const audio_eq_settings_t *settings);
+
+/**
+ * @brief Copie le réglage courant de l'égaliseur.
+ */
+void audio_manager_get_eq(audio_eq_settings_t *settings);
+
+/**
+ * @brief Coût mesuré de l'égaliseur en cycles par échantillon et par bande.
+ */
+uint32_t audio_manager_get_eq_cycles(void);
+
+/**
+ * @brief Indique si le pipeline tourne et n'est pas en pause.
+ */
+bool audio_manager_is_playing(void);
+
+/**
+ * @brief Retourne l'état de lecture : "playing", "paused", "waiting"
+ *        (en attente d'une enceinte) ou "stopped".
+ */
+const char *audio_manager_get_state_name(void);
+
+/**
+ * @brief Retourne le dernier gap mesuré entre deux pistes, en échantillons
+ *        à 44,1 kHz : silence de part et d'autre de la jonction en sortie
+ *        du DSP, plus l'interruption de la sortie quand le pipeline a dû
+ *        être relancé (0 pour un enchaînement gapless sans silence).
+ */
+uint32_t audio_manager_get_last_gap_samples(void);
+
+/**
+ * @brief Copie les compteurs de contournement du rééchantillonneur.
+ */
+void audio_manager_get_rsp_stats(audio_rsp_stats_t *out);
+
+/**
+ * @brief Retourne le nom d'une commande ("next", "play"...).
+ */
+const char *audio_manager_cmd_name(audio_cmd_type_t type);
+
+/**
+ * @brief Copie les statistiques de latence d'un type de commande.
+ */
+void audio_manager_get_cmd_stats(audio_cmd_type_t type, audio_cmd_stats_t *out);
+
+/**
+ * @brief Position (octet du fichier) où reprendre la première piste jouée
+ *        par le prochain démarrage du pipeline.
+ */
+void audio_manager_set_resume(uint32_t offset);
+
+/**
+ * @brief Copie les mesures du pipeline (échantillonnées par la tâche de
+ *        contrôle toutes les AUDIO_STATS_PERIOD_MS pendant la lecture).
+ */
+void audio_manager_get_pipeline_stats(audio_pipeline_stats_t *out);
+
+/**
+ * @brief Copie l'état du lien A2DP (niveau, pertes, signal, débit envoyé).
+ */
+void audio_manager_get_link_stats(link_q_stats_t *out);
+
+/**
+ * @brief Mémoire tenue par le pipeline : anneaux, piles des tâches, tampons
+ *        des éléments et de la lecture (hors état interne du décodeur).
+ */
+size_t audio_manager_get_memory_usage(void);
+
 #ifdef __cplusplus
 }
 #endif
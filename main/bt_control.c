@@ -8,23 +8,135 @@
 #include "esp_gap_bt_api.h"
 #include "esp_a2dp_api.h"
 #include "esp_avrc_api.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "nvs.h"
 #include "audio_manager.h"
+#include "status_push.h"
+#include "sdkconfig.h"
 
 static const char *TAG = "bt_control";
 
+#ifndef CONFIG_BT_KNOWN_SINKS
+#define CONFIG_BT_KNOWN_SINKS 4
+#endif
+#ifndef CONFIG_BT_RECONNECT_BACKOFF_MAX_SEC
+#define CONFIG_BT_RECONNECT_BACKOFF_MAX_SEC 60
+#endif
+
+#define SEEK_STEP_MS 10000  // avance/retour rapide AVRCP par appui
+#define SINKS_NAMESPACE "bt"
+#define SINKS_KEY "registry"
+#define SEEN_MAX 8                  // appareils audio inconnus gardés par recherche
+#define MAX_SINKS (CONFIG_BT_KNOWN_SINKS + SEEN_MAX)
+#define PAGE_TIMEOUT_SLOTS 0x1400   // 3,2 s par adresse connue (unités de 0,625 ms)
+#define INQUIRY_LEN 5               // x 1,28 s
+#define RANK_INQUIRY_LEN 3          // mesure du signal avant de choisir l'enceinte
+#define BACKOFF_BASE_MS 2000
+#define RSSI_POLL_US 1000000        // une mesure du lien par seconde au plus
+#define EVT_QUEUE_LEN 16
+#define CTL_TASK_STACK 4096
+
+// Enregistrement NVS d'une enceinte connue
+typedef struct {
+    esp_bd_addr_t addr;
+    uint16_t reserved;
+    char name[BT_SINK_NAME_LEN];
+} stored_sink_t;
+
+/*
+ * Table des enceintes : d'abord les connues (la plus récente en tête,
+ * gardées en NVS), puis les appareils audio vus à la dernière recherche.
+ */
+typedef struct {
+    esp_bd_addr_t addr;
+    char name[BT_SINK_NAME_LEN];
+    int8_t rssi;        // BT_SINK_RSSI_UNKNOWN si absente de la dernière recherche
+    bool target;        // candidate à la connexion automatique
+    bool tried;         // déjà appelée pendant le cycle en cours
+} sink_t;
+
+typedef enum {
+    LINK_IDLE,
+    LINK_PAGING,        // connexion directe en cours
+    LINK_INQUIRY,       // recherche en cours
+    LINK_BACKOFF,       // attente avant le cycle suivant
+    LINK_CONNECTED,
+    LINK_SWITCHING,     // déconnexion demandée pour passer à une autre enceinte
+} link_state_t;
+
+/*
+ * Toutes les transitions de l'automate passent par une file : callbacks
+ * Bluedroid, minuterie d'attente et requêtes HTTP y déposent un événement
+ * que seule la tâche bt_ctl traite.
+ */
+typedef enum {
+    BT_EVT_START,           // premier cycle de connexion
+    BT_EVT_BACKOFF,         // fin de l'attente entre deux cycles
+    BT_EVT_SELECT,          // enceinte choisie (select_addr)
+    BT_EVT_SCAN,            // recherche sans couper le lien
+    BT_EVT_DISCOVER,        // recherche par nom
+    BT_EVT_DISC_RES,        // appareil vu pendant une recherche
+    BT_EVT_DISC_STOPPED,
+    BT_EVT_CONNECTED,
+    BT_EVT_DISCONNECTED,
+} bt_evt_type_t;
+
+typedef struct {
+    bt_evt_type_t type;
+    esp_bd_addr_t addr;             // DISC_RES, CONNECTED
+    char name[BT_SINK_NAME_LEN];    // DISC_RES
+    int8_t rssi;
+    bool audio;                     // DISC_RES : appareil audio/vidéo
+    bool match;                     // DISC_RES : porte le nom recherché
+} bt_evt_t;
+
+static QueueHandle_t evt_queue = NULL;
+
 static uint8_t remote_bt_device_name[ESP_BT_GAP_MAX_BDNAME_LEN + 1] = {0};
 static esp_bd_addr_t remote_bd_addr = {0};
 static bool a2dp_connected = false;
-static bool device_found = false;
+
+static sink_t sinks[MAX_SINKS];
+static size_t known_count = 0;
+static size_t sink_count = 0;
+static bool paging_known = false;       // la connexion en cours vise une adresse connue
+static bool cycle_inquired = false;     // le cycle en cours a déjà fait sa recherche
+static bool rank_on_failure = false;    // mesure du signal si la dernière enceinte ne répond pas
+static esp_bd_addr_t select_addr;       // enceinte choisie par l'utilisateur
+static bool select_pending = false;
+static link_state_t link_state = LINK_IDLE;
+static uint32_t failed_cycles = 0;
+static int64_t reconnect_start_us = 0;
+static esp_timer_handle_t backoff_timer = NULL;
+static portMUX_TYPE link_lock = portMUX_INITIALIZER_UNLOCKED;
+static bt_connect_stats_t stats;
+static int8_t rssi_delta = BT_SINK_RSSI_UNKNOWN;
+static int64_t rssi_request_us = 0;
+
+static void page_or_inquire(void);
 
 bool bt_control_is_connected(void) {
     return a2dp_connected;
 }
 
-void bt_control_start_discovery(void) {
-    device_found = false;
-    ESP_LOGI(TAG, "Starting device discovery...");
-    esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, 5, 0);
+void bt_control_get_stats(bt_connect_stats_t *out) {
+    taskENTER_CRITICAL(&link_lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&link_lock);
+}
+
+int8_t bt_control_poll_rssi_delta(void) {
+    int64_t now = esp_timer_get_time();
+    if (!a2dp_connected) {
+        rssi_delta = BT_SINK_RSSI_UNKNOWN;
+    } else if (now - rssi_request_us >= RSSI_POLL_US) {
+        rssi_request_us = now;
+        esp_bt_gap_read_rssi_delta(remote_bd_addr);
+    }
+    return rssi_delta;
 }
 
 static char *bda2str(const esp_bd_addr_t bda, char *str, size_t size) {
@@ -34,6 +146,353 @@ static char *bda2str(const esp_bd_addr_t bda, char *str, size_t size) {
     return str;
 }
 
+static int find_sink(const esp_bd_addr_t addr) {
+    for (size_t i = 0; i < sink_count; i++) {
+        if (memcmp(sinks[i].addr, addr, ESP_BD_ADDR_LEN) == 0) return (int)i;
+    }
+    return -1;
+}
+
+// Ajoute ou met à jour un appareil vu ; la table pleine, les nouveaux sont ignorés
+static int note_sink(const esp_bd_addr_t addr, const char *name, int8_t rssi, bool target) {
+    taskENTER_CRITICAL(&link_lock);
+    int i = find_sink(addr);
+    if (i < 0 && sink_count < MAX_SINKS) {
+        i = (int)sink_count++;
+        memset(&sinks[i], 0, sizeof(sinks[i]));
+        memcpy(sinks[i].addr, addr, ESP_BD_ADDR_LEN);
+        sinks[i].rssi = BT_SINK_RSSI_UNKNOWN;
+    }
+    if (i >= 0) {
+        if (name[0]) strlcpy(sinks[i].name, name, sizeof(sinks[i].name));
+        if (rssi != BT_SINK_RSSI_UNKNOWN) sinks[i].rssi = rssi;
+        if (target) sinks[i].target = true;
+    }
+    taskEXIT_CRITICAL(&link_lock);
+    return i;
+}
+
+static void load_known_sinks(void) {
+    stored_sink_t stored[CONFIG_BT_KNOWN_SINKS];
+    size_t len = sizeof(stored);
+    nvs_handle_t nvs;
+    if (nvs_open(SINKS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return;
+    if (nvs_get_blob(nvs, SINKS_KEY, stored, &len) == ESP_OK) {
+        for (size_t i = 0; i < len / sizeof(stored[0]); i++) {
+            sink_t *s = &sinks[i];
+            memcpy(s->addr, stored[i].addr, ESP_BD_ADDR_LEN);
+            memcpy(s->name, stored[i].name, sizeof(s->name));
+            s->name[sizeof(s->name) - 1] = '\0';
+            s->rssi = BT_SINK_RSSI_UNKNOWN;
+            s->target = true;
+        }
+        known_count = sink_count = len / sizeof(stored[0]);
+    }
+    nvs_close(nvs);
+    ESP_LOGI(TAG, "%u known sink(s)", (unsigned)known_count);
+}
+
+static void save_known_sinks(void) {
+    stored_sink_t stored[CONFIG_BT_KNOWN_SINKS] = {0};
+    taskENTER_CRITICAL(&link_lock);
+    size_t n = known_count;
+    for (size_t i = 0; i < n; i++) {
+        memcpy(stored[i].addr, sinks[i].addr, ESP_BD_ADDR_LEN);
+        memcpy(stored[i].name, sinks[i].name, sizeof(stored[i].name));
+    }
+    taskEXIT_CRITICAL(&link_lock);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SINKS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, SINKS_KEY, stored, n * sizeof(stored[0]));
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) ESP_LOGW(TAG, "Saving known sinks failed: %s", esp_err_to_name(err));
+}
+
+// Place l'enceinte connectée en tête des connues et les enregistre si l'ordre a changé
+static void remember_sink(const esp_bd_addr_t addr) {
+    int i = find_sink(addr);
+    if (i == 0 && known_count > 0) return;
+    sink_t sink = { .rssi = BT_SINK_RSSI_UNKNOWN };
+    if (i >= 0) {
+        sink = sinks[i];
+    } else {
+        memcpy(sink.addr, addr, ESP_BD_ADDR_LEN);
+    }
+    sink.target = true;
+
+    taskENTER_CRITICAL(&link_lock);
+    if (i >= 0) {
+        memmove(&sinks[i], &sinks[i + 1], (sink_count - i - 1) * sizeof(sinks[0]));
+        sink_count--;
+        if ((size_t)i < known_count) known_count--;
+    }
+    if (known_count == CONFIG_BT_KNOWN_SINKS) {
+        // liste pleine : la plus ancienne est oubliée
+        known_count--;
+        memmove(&sinks[known_count], &sinks[known_count + 1],
+                (sink_count - known_count - 1) * sizeof(sinks[0]));
+        sink_count--;
+    }
+    if (sink_count == MAX_SINKS) sink_count--;
+    memmove(&sinks[1], &sinks[0], sink_count * sizeof(sinks[0]));
+    sinks[0] = sink;
+    known_count++;
+    sink_count++;
+    taskEXIT_CRITICAL(&link_lock);
+    save_known_sinks();
+}
+
+// Les appareils vus à la recherche précédente sont oubliés, le signal des connus aussi
+static void start_inquiry(uint8_t len) {
+    taskENTER_CRITICAL(&link_lock);
+    sink_count = known_count;
+    for (size_t i = 0; i < known_count; i++) sinks[i].rssi = BT_SINK_RSSI_UNKNOWN;
+    stats.inquiries++;
+    taskEXIT_CRITICAL(&link_lock);
+    ESP_LOGI(TAG, "Starting device discovery...");
+    esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, len, 0);
+}
+
+static void start_discovery(void) {
+    link_state = LINK_INQUIRY;
+    start_inquiry(INQUIRY_LEN);
+}
+
+// Les événements d'état ne sont jamais perdus ; un appareil vu peut l'être si la file est pleine
+static bool post(const bt_evt_t *evt, TickType_t wait) {
+    return evt_queue && xQueueSend(evt_queue, evt, wait) == pdTRUE;
+}
+
+static void post_type(bt_evt_type_t type) {
+    bt_evt_t evt = { .type = type };
+    post(&evt, portMAX_DELAY);
+}
+
+void bt_control_start_discovery(void) {
+    post_type(BT_EVT_DISCOVER);
+}
+
+static bool selection_is_pending(void) {
+    taskENTER_CRITICAL(&link_lock);
+    bool pending = select_pending;
+    taskEXIT_CRITICAL(&link_lock);
+    return pending;
+}
+
+// Enceinte choisie par l'utilisateur, ajoutée à la table si elle n'y est pas
+static int take_selection(void) {
+    esp_bd_addr_t addr;
+    taskENTER_CRITICAL(&link_lock);
+    bool pending = select_pending;
+    select_pending = false;
+    memcpy(addr, select_addr, ESP_BD_ADDR_LEN);
+    taskEXIT_CRITICAL(&link_lock);
+    return pending ? note_sink(addr, "", BT_SINK_RSSI_UNKNOWN, false) : -1;
+}
+
+/*
+ * Prochaine enceinte à appeler : la plus forte à la dernière recherche,
+ * à égalité (ou sans mesure) la plus récemment connectée.
+ */
+static int next_candidate(void) {
+    int best = -1;
+    for (size_t i = 0; i < sink_count; i++) {
+        const sink_t *s = &sinks[i];
+        if (s->tried || !s->target) continue;
+#if CONFIG_BT_SINK_RANK_RSSI
+        if (best < 0 || s->rssi > sinks[best].rssi) best = (int)i;
+#else
+        return (int)i;
+#endif
+    }
+    return best;
+}
+
+static void page_sink(int i) {
+    char bda_str[18];
+    sinks[i].tried = true;
+    memcpy(remote_bd_addr, sinks[i].addr, ESP_BD_ADDR_LEN);
+    paging_known = (size_t)i < known_count;
+    link_state = LINK_PAGING;
+    ESP_LOGI(TAG, "Paging %s %s (rssi %d)", bda2str(remote_bd_addr, bda_str, sizeof(bda_str)),
+             sinks[i].name, sinks[i].rssi);
+    esp_a2d_source_connect(remote_bd_addr);
+}
+
+// Aucun appareil joignable : nouveau cycle après 2, 4, 8... s
+static void schedule_backoff(void) {
+    uint32_t shift = failed_cycles < 8 ? failed_cycles : 8;
+    uint64_t delay_ms = (uint64_t)BACKOFF_BASE_MS << shift;
+    if (delay_ms > CONFIG_BT_RECONNECT_BACKOFF_MAX_SEC * 1000ULL) {
+        delay_ms = CONFIG_BT_RECONNECT_BACKOFF_MAX_SEC * 1000ULL;
+    }
+    failed_cycles++;
+    link_state = LINK_BACKOFF;
+    ESP_LOGI(TAG, "No sink reachable, retrying in %u s", (unsigned)(delay_ms / 1000));
+    esp_timer_start_once(backoff_timer, delay_ms * 1000);
+}
+
+/*
+ * Appelle l'enceinte choisie, sinon les candidates une à une (une
+ * connexion directe aboutit en moins d'une seconde si l'enceinte est
+ * allumée) ; la liste épuisée, lance une recherche par nom.
+ */
+static void page_or_inquire(void) {
+    int i = take_selection();
+    if (i < 0) i = next_candidate();
+    if (i >= 0) {
+        page_sink(i);
+    } else if (!cycle_inquired) {
+        cycle_inquired = true;
+        start_discovery();
+    } else {
+        schedule_backoff();
+    }
+}
+
+// Courte recherche pour appeler d'abord l'enceinte connue la plus proche
+static void start_rank_inquiry(void) {
+    cycle_inquired = true;
+    link_state = LINK_INQUIRY;
+    start_inquiry(RANK_INQUIRY_LEN);
+}
+
+/*
+ * Nouveau cycle de connexion. Avec plusieurs enceintes connues, le signal
+ * n'est mesuré d'emblée qu'avec rank (démarrage) : après une coupure ou une
+ * attente, la dernière enceinte connectée est appelée directement, et la
+ * recherche n'a lieu que si elle ne répond pas.
+ */
+static void start_cycle(bool rank) {
+    for (size_t i = 0; i < sink_count; i++) sinks[i].tried = false;
+    cycle_inquired = false;
+    rank_on_failure = false;
+#if CONFIG_BT_SINK_RANK_RSSI
+    if (known_count > 1 && !selection_is_pending()) {
+        if (rank) {
+            start_rank_inquiry();
+        } else {
+            rank_on_failure = true;
+            page_sink(0);
+        }
+        return;
+    }
+#endif
+    page_or_inquire();
+}
+
+// Tâche esp_timer : le cycle suivant est lancé par la tâche bt_ctl
+static void backoff_expired(void *arg) {
+    post_type(BT_EVT_BACKOFF);
+}
+
+// L'enceinte a pu se reconnecter d'elle-même pendant l'attente
+static void retry_after_backoff(void) {
+    if (link_state != LINK_BACKOFF || a2dp_connected) return;
+    esp_timer_stop(backoff_timer);
+    taskENTER_CRITICAL(&link_lock);
+    link_state = LINK_IDLE;
+    taskEXIT_CRITICAL(&link_lock);
+    start_cycle(false);
+}
+
+// Déconnexion volontaire : la suite est décidée à l'événement DISCONNECTED
+static void begin_switch(void) {
+    taskENTER_CRITICAL(&link_lock);
+    link_state = LINK_SWITCHING;
+    stats.switches++;
+    taskEXIT_CRITICAL(&link_lock);
+    reconnect_start_us = esp_timer_get_time();
+    esp_a2d_source_disconnect(remote_bd_addr);
+}
+
+static void link_up(const esp_bd_addr_t addr) {
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - reconnect_start_us) / 1000);
+    esp_timer_stop(backoff_timer);
+    taskENTER_CRITICAL(&link_lock);
+    a2dp_connected = true;
+    bool direct = link_state == LINK_PAGING && paging_known;
+    link_state = LINK_CONNECTED;
+    stats.connects++;
+    if (direct) stats.page_connects++;
+    stats.last_connect_ms = ms;
+    stats.total_connect_ms += ms;
+    if (ms > stats.max_connect_ms) stats.max_connect_ms = ms;
+    memcpy(remote_bd_addr, addr, ESP_BD_ADDR_LEN);
+    // l'enceinte choisie est celle qui vient de se connecter
+    bool switch_again = select_pending && memcmp(select_addr, addr, ESP_BD_ADDR_LEN) != 0;
+    if (!switch_again) select_pending = false;
+    taskEXIT_CRITICAL(&link_lock);
+    failed_cycles = 0;
+    remember_sink(addr);
+    ESP_LOGI(TAG, "A2DP CONNECTED to %s in %u ms (%s)", sinks[0].name, (unsigned)ms,
+             direct ? "known address" : "inquiry");
+    // choisie pendant la connexion : on passe tout de suite à la nouvelle
+    if (switch_again) begin_switch();
+}
+
+bool bt_control_get_sink(size_t index, bt_sink_info_t *out) {
+    bool ok = false;
+    taskENTER_CRITICAL(&link_lock);
+    if (index < sink_count) {
+        const sink_t *s = &sinks[index];
+        memcpy(out->addr, s->addr, ESP_BD_ADDR_LEN);
+        memcpy(out->name, s->name, sizeof(out->name));
+        out->rssi = s->rssi;
+        out->known = index < known_count;
+        out->active = a2dp_connected && memcmp(remote_bd_addr, s->addr, ESP_BD_ADDR_LEN) == 0;
+        ok = true;
+    }
+    taskEXIT_CRITICAL(&link_lock);
+    return ok;
+}
+
+esp_err_t bt_control_select_sink(const uint8_t addr[ESP_BD_ADDR_LEN]) {
+    if (!evt_queue) return ESP_ERR_INVALID_STATE;
+    taskENTER_CRITICAL(&link_lock);
+    bool current = a2dp_connected && memcmp(remote_bd_addr, addr, ESP_BD_ADDR_LEN) == 0;
+    if (!current) {
+        memcpy(select_addr, addr, ESP_BD_ADDR_LEN);
+        select_pending = true;
+    }
+    taskEXIT_CRITICAL(&link_lock);
+    if (!current) post_type(BT_EVT_SELECT);
+    return ESP_OK;
+}
+
+static void handle_select(void) {
+    if (!selection_is_pending()) return;
+    char bda_str[18];
+    ESP_LOGI(TAG, "Switching to %s", bda2str(select_addr, bda_str, sizeof(bda_str)));
+    switch (link_state) {
+        case LINK_CONNECTED:
+            begin_switch();
+            break;
+        case LINK_INQUIRY:
+            esp_bt_gap_cancel_discovery();
+            break;
+        case LINK_BACKOFF:
+            retry_after_backoff();
+            break;
+        default:
+            // connexion en cours : la sélection est prise à son issue
+            break;
+    }
+}
+
+esp_err_t bt_control_scan_sinks(void) {
+    taskENTER_CRITICAL(&link_lock);
+    bool connected = link_state == LINK_CONNECTED;
+    taskEXIT_CRITICAL(&link_lock);
+    if (!connected) return ESP_ERR_INVALID_STATE;
+    post_type(BT_EVT_SCAN);
+    return ESP_OK;
+}
+
 static bool get_name_from_eir(uint8_t *eir, uint8_t *bdname) {
     uint8_t *rmt_bdname = NULL;
     uint8_t rmt_bdname_len = 0;
@@ -50,29 +509,73 @@ static bool get_name_from_eir(uint8_t *eir, uint8_t *bdname) {
     return false;
 }
 
-static void filter_inquiry_scan_result(esp_bt_gap_cb_param_t *param) {
-    char bda_str[18];
-    uint8_t *eir = NULL;
+// Classement définitif dès que toutes les enceintes connues ont répondu
+static bool ranking_complete(void) {
+#if CONFIG_BT_SINK_RANK_RSSI
+    if (known_count > 1) {
+        for (size_t i = 0; i < known_count; i++) {
+            if (sinks[i].rssi == BT_SINK_RSSI_UNKNOWN) return false;
+        }
+    }
+#endif
+    return true;
+}
+
+// Tâche Bluedroid : extrait du résultat ce que la tâche bt_ctl doit savoir
+static void post_inquiry_scan_result(esp_bt_gap_cb_param_t *param) {
     uint8_t peer_bdname[ESP_BT_GAP_MAX_BDNAME_LEN + 1] = {0};
+    int8_t rssi = BT_SINK_RSSI_UNKNOWN;
+    uint32_t cod = 0;
     esp_bt_gap_dev_prop_t *p;
-    ESP_LOGI(TAG, "Scanned device: %s", bda2str(param->disc_res.bda, bda_str, sizeof(bda_str)));
     for (int i = 0; i < param->disc_res.num_prop; i++) {
         p = param->disc_res.prop + i;
-        if (p->type == ESP_BT_GAP_DEV_PROP_EIR) {
-            eir = (uint8_t *)(p->val);
-            get_name_from_eir(eir, peer_bdname);
-            ESP_LOGI(TAG, "--Name: %s", peer_bdname);
+        switch (p->type) {
+            case ESP_BT_GAP_DEV_PROP_EIR:
+                get_name_from_eir((uint8_t *)p->val, peer_bdname);
+                break;
+            case ESP_BT_GAP_DEV_PROP_BDNAME:
+                if (!peer_bdname[0] && p->len > 0) {
+                    int len = p->len < ESP_BT_GAP_MAX_BDNAME_LEN ? p->len : ESP_BT_GAP_MAX_BDNAME_LEN;
+                    memcpy(peer_bdname, p->val, len);
+                    peer_bdname[len] = '\0';
+                }
+                break;
+            case ESP_BT_GAP_DEV_PROP_RSSI:
+                rssi = *(int8_t *)p->val;
+                break;
+            case ESP_BT_GAP_DEV_PROP_COD:
+                cod = *(uint32_t *)p->val;
+                break;
+            default:
+                break;
         }
     }
-    ESP_LOGI(TAG, "Looking for: %s", remote_bt_device_name);
-    if (eir) {
-        get_name_from_eir(eir, peer_bdname);
-        if (strcmp((char *)peer_bdname, (char *)remote_bt_device_name) != 0)
-            return;
-        ESP_LOGI(TAG, "Found target! address %s, name %s", bda_str, peer_bdname);
-        device_found = true;
-        memcpy(remote_bd_addr, param->disc_res.bda, ESP_BD_ADDR_LEN);
-        ESP_LOGI(TAG, "Cancel device discovery ...");
+    bt_evt_t evt = {
+        .type = BT_EVT_DISC_RES,
+        .rssi = rssi,
+        .audio = esp_bt_gap_get_cod_major_dev(cod) == ESP_BT_COD_MAJOR_DEV_AV,
+        .match = peer_bdname[0] && strcmp((char *)peer_bdname, (char *)remote_bt_device_name) == 0,
+    };
+    memcpy(evt.addr, param->disc_res.bda, ESP_BD_ADDR_LEN);
+    strlcpy(evt.name, (char *)peer_bdname, sizeof(evt.name));
+    if (!post(&evt, 0)) ESP_LOGW(TAG, "Event queue full, scan result dropped");
+}
+
+/*
+ * Les appareils audio sont gardés pour un choix manuel ; seuls les connus
+ * et ceux qui portent le nom recherché sont candidats à la connexion.
+ */
+static void filter_inquiry_scan_result(const bt_evt_t *evt) {
+    char bda_str[18];
+    ESP_LOGI(TAG, "Scanned device: %s %s (rssi %d)",
+             bda2str(evt->addr, bda_str, sizeof(bda_str)), evt->name, evt->rssi);
+
+    int i = find_sink(evt->addr);
+    bool known = i >= 0 && (size_t)i < known_count;
+    if (!known && !evt->match && !evt->audio) return;
+    note_sink(evt->addr, evt->name, evt->rssi, evt->match);
+    if (link_state == LINK_INQUIRY && (known || evt->match) && ranking_complete()) {
+        ESP_LOGI(TAG, "Found target %s, cancel device discovery ...", bda_str);
         esp_bt_gap_cancel_discovery();
     }
 }
@@ -80,17 +583,16 @@ static void filter_inquiry_scan_result(esp_bt_gap_cb_param_t *param) {
 static void bt_app_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param) {
     switch (event) {
         case ESP_BT_GAP_DISC_RES_EVT:
-            filter_inquiry_scan_result(param);
+            post_inquiry_scan_result(param);
+            break;
+        case ESP_BT_GAP_READ_RSSI_DELTA_EVT:
+            if (param->read_rssi_delta.stat == ESP_BT_STATUS_SUCCESS && a2dp_connected) {
+                rssi_delta = param->read_rssi_delta.rssi_delta;
+            }
             break;
         case ESP_BT_GAP_DISC_STATE_CHANGED_EVT:
             if (param->disc_st_chg.state == ESP_BT_GAP_DISCOVERY_STOPPED) {
-                if (device_found && !a2dp_connected) {
-                    ESP_LOGI(TAG, "Discovery stopped, connecting A2DP...");
-                    esp_a2d_source_connect(remote_bd_addr);
-                } else if (!a2dp_connected) {
-                    ESP_LOGI(TAG, "Discovery failed, retrying...");
-                    esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, 5, 0);
-                }
+                post_type(BT_EVT_DISC_STOPPED);
             }
             break;
         default:
@@ -98,22 +600,93 @@ static void bt_app_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *pa
     }
 }
 
-static void bt_app_a2dp_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param) {
-    switch (event) {
-        case ESP_A2D_CONNECTION_STATE_EVT:
-            if (param->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED) {
-                ESP_LOGI(TAG, "A2DP CONNECTED to %s", remote_bt_device_name);
-                a2dp_connected = true;
-            } else if (param->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
-                ESP_LOGW(TAG, "A2DP DISCONNECTED from %s", remote_bt_device_name);
-                a2dp_connected = false;
-                device_found = false;
-                ESP_LOGI(TAG, "Re-launching device discovery...");
-                esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, 5, 0);
-            }
-            break;
-        default:
-            break;
+// Tâche Bluedroid, ou celle du flux a2dp qui fait suivre ses événements
+void bt_control_a2dp_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param) {
+    if (event != ESP_A2D_CONNECTION_STATE_EVT) return;
+    bt_evt_t evt = {0};
+    if (param->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED) {
+        evt.type = BT_EVT_CONNECTED;
+        memcpy(evt.addr, param->conn_stat.remote_bda, ESP_BD_ADDR_LEN);
+    } else if (param->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
+        evt.type = BT_EVT_DISCONNECTED;
+    } else {
+        return;
+    }
+    post(&evt, portMAX_DELAY);
+}
+
+static void handle_connected(const esp_bd_addr_t addr) {
+    if (link_state == LINK_INQUIRY) esp_bt_gap_cancel_discovery();
+    link_up(addr);
+    audio_manager_set_sink_connected(true);
+    status_push_notify();
+}
+
+static void handle_disconnected(void) {
+    if (link_state == LINK_CONNECTED || link_state == LINK_SWITCHING) {
+        // la lecture n'est pas arrêtée : le pipeline garde sa position et attend le lien
+        audio_manager_set_sink_connected(false);
+        if (link_state == LINK_SWITCHING) {
+            ESP_LOGI(TAG, "A2DP released, handing over");
+        } else {
+            ESP_LOGW(TAG, "A2DP DISCONNECTED");
+            reconnect_start_us = esp_timer_get_time();
+        }
+        a2dp_connected = false;
+        status_push_notify();
+        start_cycle(false);
+    } else if (link_state == LINK_PAGING) {
+        if (paging_known) {
+            taskENTER_CRITICAL(&link_lock);
+            stats.page_failures++;
+            taskEXIT_CRITICAL(&link_lock);
+        }
+        if (rank_on_failure && !selection_is_pending()) {
+            rank_on_failure = false;
+            start_rank_inquiry();
+            return;
+        }
+        page_or_inquire();
+    }
+}
+
+static void bt_control_task(void *arg) {
+    bt_evt_t evt;
+    while (1) {
+        if (xQueueReceive(evt_queue, &evt, portMAX_DELAY) != pdTRUE) continue;
+        switch (evt.type) {
+            case BT_EVT_START:
+                start_cycle(true);
+                break;
+            case BT_EVT_BACKOFF:
+                retry_after_backoff();
+                break;
+            case BT_EVT_SELECT:
+                handle_select();
+                break;
+            case BT_EVT_SCAN:
+                if (link_state == LINK_CONNECTED) start_inquiry(INQUIRY_LEN);
+                break;
+            case BT_EVT_DISCOVER:
+                if (link_state != LINK_CONNECTED && link_state != LINK_INQUIRY) start_discovery();
+                break;
+            case BT_EVT_DISC_RES:
+                filter_inquiry_scan_result(&evt);
+                break;
+            case BT_EVT_DISC_STOPPED:
+                status_push_notify();
+                if (link_state == LINK_INQUIRY && !a2dp_connected) {
+                    ESP_LOGI(TAG, "Discovery stopped, %u sink(s) listed", (unsigned)sink_count);
+                    page_or_inquire();
+                }
+                break;
+            case BT_EVT_CONNECTED:
+                handle_connected(evt.addr);
+                break;
+            case BT_EVT_DISCONNECTED:
+                handle_disconnected();
+                break;
+        }
     }
 }
 
@@ -127,8 +700,10 @@ void bt_app_avrc_ct_cb(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *par
                 case ESP_AVRC_PT_CMD_PLAY:
                     audio_manager_start();
                     break;
-                case ESP_AVRC_PT_CMD_STOP:
                 case ESP_AVRC_PT_CMD_PAUSE:
+                    audio_manager_pause();
+                    break;
+                case ESP_AVRC_PT_CMD_STOP:
                     audio_manager_stop();
                     break;
                 case ESP_AVRC_PT_CMD_FORWARD:
@@ -152,16 +727,24 @@ static void bt_app_avrc_tg_cb(esp_avrc_tg_cb_event_t event, esp_avrc_tg_cb_param
             case ESP_AVRC_PT_CMD_PLAY:
                 audio_manager_resume();
                 break;
-            case ESP_AVRC_PT_CMD_STOP:
             case ESP_AVRC_PT_CMD_PAUSE:
                 audio_manager_pause();
                 break;
+            case ESP_AVRC_PT_CMD_STOP:
+                audio_manager_stop();
+                break;
             case ESP_AVRC_PT_CMD_FORWARD:
                 audio_manager_next();
                 break;
             case ESP_AVRC_PT_CMD_BACKWARD:
                 audio_manager_prev();
                 break;
+            case ESP_AVRC_PT_CMD_FAST_FORWARD:
+                audio_manager_seek_relative(SEEK_STEP_MS);
+                break;
+            case ESP_AVRC_PT_CMD_REWIND:
+                audio_manager_seek_relative(-SEEK_STEP_MS);
+                break;
             default:
                 break;
         }
@@ -178,6 +761,27 @@ esp_err_t bt_control_init(void) {
   ESP_ERROR_CHECK(esp_bluedroid_init());
   ESP_ERROR_CHECK(esp_bluedroid_enable());
 
+  // nom recherché, table, minuterie et file prêts avant le premier callback
+  const char *remote_name = NULL;
+  remote_name = CONFIG_BT_REMOTE_NAME;
+  if (remote_name) {
+    memcpy(&remote_bt_device_name, remote_name, strlen(remote_name) + 1);
+  } else {
+    memcpy(&remote_bt_device_name, "ESP_SINK_STREAM_DEMO", ESP_BT_GAP_MAX_BDNAME_LEN);
+  }
+
+  load_known_sinks();
+  const esp_timer_create_args_t timer_args = {
+    .callback = backoff_expired,
+    .name = "bt_backoff",
+  };
+  ESP_ERROR_CHECK(esp_timer_create(&timer_args, &backoff_timer));
+  evt_queue = xQueueCreate(EVT_QUEUE_LEN, sizeof(bt_evt_t));
+  if (!evt_queue) return ESP_ERR_NO_MEM;
+  if (xTaskCreatePinnedToCore(bt_control_task, "bt_ctl", CTL_TASK_STACK, NULL, 5, NULL, 0) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+
   ESP_ERROR_CHECK(esp_avrc_tg_init());
   esp_avrc_tg_register_callback(bt_app_avrc_tg_cb);
   ESP_ERROR_CHECK(esp_avrc_ct_init());
@@ -186,20 +790,15 @@ esp_err_t bt_control_init(void) {
   esp_bt_gap_set_device_name("ESP_SOURCE_STREAM_DEMO");
   esp_bt_gap_set_pin(pin_type, 1, pin_code);
   esp_bt_gap_register_callback(bt_app_gap_cb);
-  esp_a2d_register_callback(bt_app_a2dp_cb);
+  esp_a2d_register_callback(bt_control_a2dp_cb);
   esp_a2d_source_register_data_callback(NULL);
   ESP_ERROR_CHECK(esp_a2d_source_init());
   esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE);
-
-  const char *remote_name = NULL;
-  remote_name = CONFIG_BT_REMOTE_NAME;
-  if (remote_name) {
-    memcpy(&remote_bt_device_name, remote_name, strlen(remote_name) + 1);
-  } else {
-    memcpy(&remote_bt_device_name, "ESP_SINK_STREAM_DEMO", ESP_BT_GAP_MAX_BDNAME_LEN);
+  if (esp_bt_gap_set_page_timeout(PAGE_TIMEOUT_SLOTS) != ESP_OK) {
+    ESP_LOGW(TAG, "Page timeout not set");
   }
-
-  bt_control_start_discovery();
+  reconnect_start_us = esp_timer_get_time();
+  post_type(BT_EVT_START);
 
     ESP_LOGI(TAG, "Bluetooth A2DP source initialized");
     return ESP_OK;
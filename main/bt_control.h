@@ -2,10 +2,90 @@
 #define BT_CONTROL_H
 
 #include "esp_err.h"
+#include "esp_a2dp_api.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#define BT_SINK_NAME_LEN 32
+#define BT_SINK_RSSI_UNKNOWN INT8_MIN
+
+/**
+ * Connexions à l'enceinte : la durée est mesurée depuis le démarrage ou la
+ * perte du lien.
+ */
+typedef struct {
+    uint32_t connects;
+    uint32_t page_connects;     // dont directement sur une adresse connue
+    uint32_t page_failures;     // adresses connues qui n'ont pas répondu
+    uint32_t inquiries;         // recherches lancées
+    uint32_t switches;          // changements d'enceinte demandés
+    uint32_t last_connect_ms;
+    uint32_t max_connect_ms;
+    uint64_t total_connect_ms;
+} bt_connect_stats_t;
+
+/**
+ * Enceinte connue ou appareil audio vu à la dernière recherche.
+ */
+typedef struct {
+    uint8_t addr[6];
+    char name[BT_SINK_NAME_LEN];
+    int8_t rssi;                // dBm, BT_SINK_RSSI_UNKNOWN si absente de la dernière recherche
+    bool known;                 // déjà connectée, gardée en NVS
+    bool active;                // enceinte connectée
+} bt_sink_info_t;
+
+/**
+ * @brief Initialise Bluetooth et se connecte à l'enceinte : d'abord aux
+ *        adresses déjà connues (NVS), la plus proche en premier, sinon par
+ *        recherche de son nom.
+ */
 esp_err_t bt_control_init(void);
+
+/**
+ * @brief Lance une recherche de l'enceinte par son nom.
+ */
 void bt_control_start_discovery(void);
 bool bt_control_is_connected(void);
 
+/**
+ * @brief Copie les statistiques de connexion.
+ */
+void bt_control_get_stats(bt_connect_stats_t *out);
+
+/**
+ * @brief Demande une nouvelle mesure du lien (au plus une par seconde) et
+ *        renvoie la dernière reçue : écart en dB à la plage de réception
+ *        idéale du contrôleur, négatif en dessous. BT_SINK_RSSI_UNKNOWN
+ *        sans lien.
+ */
+int8_t bt_control_poll_rssi_delta(void);
+
+/**
+ * @brief Copie l'enceinte d'indice index (les connues d'abord).
+ * @return false au-delà de la dernière.
+ */
+bool bt_control_get_sink(size_t index, bt_sink_info_t *out);
+
+/**
+ * @brief Passe sur une autre enceinte. Le lien courant est rendu puis la
+ *        nouvelle est appelée ; la lecture continue là où elle en était.
+ *        La demande est traitée par la tâche bt_ctl, au retour elle est
+ *        seulement en file.
+ */
+esp_err_t bt_control_select_sink(const uint8_t addr[6]);
+
+/**
+ * @brief Recherche les appareils audio à portée sans couper le lien
+ *        (environ 6 s) pour mettre à jour la liste et le signal.
+ */
+esp_err_t bt_control_scan_sinks(void);
+
+/**
+ * @brief Événements A2DP, à faire suivre par le flux a2dp qui remplace
+ *        le callback enregistré à l'initialisation.
+ */
+void bt_control_a2dp_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param);
+
 #endif
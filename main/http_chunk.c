@@ -0,0 +1,162 @@
+// http_chunk.c
+#include "http_chunk.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static uint32_t pace_ms = 0;
+static uint32_t paced = 0;
+
+void http_chunk_set_pace(uint32_t ms)
+{
+    __atomic_store_n(&pace_ms, ms, __ATOMIC_RELAXED);
+}
+
+void http_chunk_pace(void)
+{
+    uint32_t ms = __atomic_load_n(&pace_ms, __ATOMIC_RELAXED);
+    if (!ms) return;
+    __atomic_add_fetch(&paced, 1, __ATOMIC_RELAXED);
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+uint32_t http_chunk_paced_count(void)
+{
+    return __atomic_load_n(&paced, __ATOMIC_RELAXED);
+}
+
+static void flush(http_chunk_t *c)
+{
+    if (c->len > 0 && c->err == ESP_OK) {
+        http_chunk_pace();
+        c->err = httpd_resp_send_chunk(c->req, c->buf, c->len);
+    }
+    c->total += c->len;
+    c->len = 0;
+}
+
+http_chunk_t *http_chunk_begin(httpd_req_t *req)
+{
+    http_chunk_t *c = malloc(sizeof(*c));
+    if (!c) return NULL;
+    c->req = req;
+    c->err = ESP_OK;
+    c->len = 0;
+    c->total = 0;
+    return c;
+}
+
+void http_chunk_write(http_chunk_t *c, const char *data, size_t len)
+{
+    while (len > 0) {
+        size_t n = sizeof(c->buf) - c->len;
+        if (n > len) n = len;
+        memcpy(c->buf + c->len, data, n);
+        c->len += n;
+        data += n;
+        len -= n;
+        if (c->len == sizeof(c->buf)) flush(c);
+    }
+}
+
+void http_chunk_puts(http_chunk_t *c, const char *s)
+{
+    http_chunk_write(c, s, strlen(s));
+}
+
+/*
+ * Formate directement dans le tampon d'envoi ; si la place restante ne
+ * suffit pas, on envoie le tampon et on recommence au début. Un texte plus
+ * long qu'un envoi entier passe par un tampon alloué : rien n'est tronqué.
+ */
+void http_chunk_printf(http_chunk_t *c, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(c->buf + c->len, sizeof(c->buf) - c->len, fmt, ap);
+    va_end(ap);
+    if (n <= 0) return;
+    if ((size_t)n < sizeof(c->buf) - c->len) {
+        c->len += n;
+        return;
+    }
+    flush(c);
+    if ((size_t)n < sizeof(c->buf)) {
+        va_start(ap, fmt);
+        vsnprintf(c->buf, sizeof(c->buf), fmt, ap);
+        va_end(ap);
+        c->len = n;
+        return;
+    }
+    char *tmp = malloc((size_t)n + 1);
+    if (!tmp) {
+        if (c->err == ESP_OK) c->err = ESP_ERR_NO_MEM;
+        return;
+    }
+    va_start(ap, fmt);
+    vsnprintf(tmp, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    http_chunk_write(c, tmp, n);
+    free(tmp);
+}
+
+// Séquence d'échappement JSON de ch, ou 0 si ch peut être copié tel quel
+static size_t json_escape_char(unsigned char ch, char esc[7])
+{
+    if (ch == '"' || ch == '\\') {
+        esc[0] = '\\';
+        esc[1] = ch;
+        return 2;
+    }
+    if (ch < 0x20) {
+        snprintf(esc, 7, "\\u%04x", ch);
+        return 6;
+    }
+    return 0;
+}
+
+void http_chunk_json_string(http_chunk_t *c, const char *s)
+{
+    http_chunk_write(c, "\"", 1);
+    const char *run = s;
+    for (; *s; s++) {
+        char esc[7];
+        size_t n = json_escape_char((unsigned char)*s, esc);
+        if (n == 0) continue;
+        http_chunk_write(c, run, s - run);
+        http_chunk_write(c, esc, n);
+        run = s + 1;
+    }
+    http_chunk_write(c, run, s - run);
+    http_chunk_write(c, "\"", 1);
+}
+
+size_t http_json_escape(char *dst, size_t size, const char *src)
+{
+    size_t len = 0;
+    if (size == 0) return 0;
+    for (; *src; src++) {
+        char esc[7];
+        size_t n = json_escape_char((unsigned char)*src, esc);
+        const char *p = n ? esc : src;
+        if (n == 0) n = 1;
+        if (len + n >= size) break;
+        memcpy(dst + len, p, n);
+        len += n;
+    }
+    dst[len] = '\0';
+    return len;
+}
+
+esp_err_t http_chunk_end(http_chunk_t *c, size_t *total)
+{
+    flush(c);
+    esp_err_t err = c->err;
+    if (err == ESP_OK) err = httpd_resp_send_chunk(c->req, NULL, 0);
+    if (total) *total = c->total;
+    free(c);
+    return err;
+}
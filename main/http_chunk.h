@@ -0,0 +1,89 @@
+// http_chunk.h
+#ifndef HTTP_CHUNK_H
+#define HTTP_CHUNK_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Taille d'un envoi : un segment TCP (MSS 1460) moins l'en-tête de chunk HTTP
+#define HTTP_CHUNK_LEN 1436
+
+/**
+ * Regroupe les petites écritures d'une réponse HTTP chunked en envois
+ * de la taille d'un segment TCP.
+ */
+typedef struct {
+    httpd_req_t *req;
+    esp_err_t err;
+    size_t len;
+    size_t total;
+    char buf[HTTP_CHUNK_LEN];
+} http_chunk_t;
+
+/**
+ * @brief Alloue un tampon d'envoi pour la requête.
+ */
+http_chunk_t *http_chunk_begin(httpd_req_t *req);
+
+/**
+ * @brief Ajoute des octets à la réponse.
+ */
+void http_chunk_write(http_chunk_t *c, const char *data, size_t len);
+
+/**
+ * @brief Ajoute une chaîne à la réponse.
+ */
+void http_chunk_puts(http_chunk_t *c, const char *s);
+
+/**
+ * @brief Ajoute une chaîne formatée (printf) à la réponse, sans limite de
+ *        longueur.
+ */
+void http_chunk_printf(http_chunk_t *c, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Ajoute une chaîne JSON entre guillemets, échappée.
+ */
+void http_chunk_json_string(http_chunk_t *c, const char *s);
+
+/**
+ * @brief Copie src dans dst en échappant les caractères spéciaux JSON
+ *        (sans guillemets autour). Tronque si dst est trop petit.
+ * @return Longueur écrite (hors '\0').
+ */
+size_t http_json_escape(char *dst, size_t size, const char *src);
+
+/**
+ * @brief Fixe une pause avant chaque envoi (0 : aucune). Sert à laisser
+ *        l'antenne, partagée avec le Wi-Fi, au lien Bluetooth encombré.
+ */
+void http_chunk_set_pace(uint32_t ms);
+
+/**
+ * @brief Observe la pause en cours ; à appeler avant chaque envoi de
+ *        réponse volumineuse.
+ */
+void http_chunk_pace(void);
+
+/**
+ * @brief Nombre d'envois retardés depuis le démarrage.
+ */
+uint32_t http_chunk_paced_count(void);
+
+/**
+ * @brief Envoie le reste du tampon, termine la réponse et libère le tampon.
+ * @return ESP_OK, ou la première erreur d'envoi rencontrée.
+ */
+esp_err_t http_chunk_end(http_chunk_t *c, size_t *total);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_CHUNK_H
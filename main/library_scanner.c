@@ -0,0 +1,176 @@
+// library_scanner.c
+#include "library_scanner.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "path_config.h"
+#include "track_index.h"
+#include "sdkconfig.h"
+
+#ifndef CONFIG_LIBRARY_SCAN_MAX_DEPTH
+#define CONFIG_LIBRARY_SCAN_MAX_DEPTH 8
+#endif
+
+#define SCAN_TASK_STACK 4096
+#define SCAN_TASK_PRIO (tskIDLE_PRIORITY + 1)
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+#define PRESENT_BYTES ((TRACK_INDEX_MAX_TRACKS + 7) / 8)
+
+#define SCAN_BIT_TRACK BIT0
+#define SCAN_BIT_DONE BIT1
+
+static const char *TAG = "lib_scan";
+static EventGroupHandle_t scan_events = NULL;
+static library_scanner_track_cb_t track_cb = NULL;
+static library_scan_status_t status;
+static int64_t scan_start_us;
+static uint8_t *present = NULL;         // bitmap des pistes vues pendant ce scan
+static uint32_t scan_generation;
+static char scan_path[TRACK_PATH_MAX];
+
+static bool is_mp3(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    return dot && strcasecmp(dot, ".mp3") == 0;
+}
+
+static uint32_t fnv1a(uint32_t h, const char *s)
+{
+    do {
+        h ^= (uint8_t)*s;
+        h *= FNV_PRIME;
+    } while (*s++);
+    return h;
+}
+
+static void found_track(const char *rel)
+{
+    status.tracks++;
+    scan_generation = fnv1a(scan_generation, rel);
+
+    int id = track_index_find(rel);
+    if (id < 0) {
+        struct stat st;
+        if (stat(scan_path, &st) != 0) return;
+        id = track_index_append(rel, st.st_size, st.st_mtime);
+        if (id < 0) return;
+        status.added++;
+        if (track_cb) track_cb(id);
+        xEventGroupSetBits(scan_events, SCAN_BIT_TRACK);
+    }
+    present[id >> 3] |= 1 << (id & 7);
+}
+
+// scan_path contient le répertoire courant, de longueur len
+static void scan_dir(size_t len, int depth)
+{
+    DIR *dir = opendir(scan_path);
+    if (!dir) {
+        ESP_LOGW(TAG, "Failed to open dir: %s", scan_path);
+        return;
+    }
+    status.dirs++;
+    struct dirent *de;
+    while ((de = readdir(dir))) {
+        if (de->d_name[0] == '.') continue; // fichiers cachés, "._*" macOS
+        bool is_dir = de->d_type == DT_DIR;
+        if (!is_dir && (de->d_type != DT_REG || !is_mp3(de->d_name))) continue;
+        if (is_dir && depth >= CONFIG_LIBRARY_SCAN_MAX_DEPTH) continue;
+
+        int n = snprintf(scan_path + len, sizeof(scan_path) - len, "/%s", de->d_name);
+        if (n < 0 || len + n >= sizeof(scan_path)) {
+            ESP_LOGW(TAG, "Path too long, skipped: %s", de->d_name);
+        } else if (is_dir) {
+            scan_dir(len + n, depth + 1);
+        } else {
+            found_track(scan_path + strlen(MP3_DIR) + 1);
+        }
+        scan_path[len] = '\0';
+    }
+    closedir(dir);
+}
+
+static void scan_task(void *arg)
+{
+    size_t loaded = track_index_count();
+
+    scan_generation = FNV_OFFSET;
+    strlcpy(scan_path, MP3_DIR, sizeof(scan_path));
+    scan_dir(strlen(scan_path), 0);
+
+    // les pistes absentes sortent de l'ordre de lecture et de /list sans attendre le redémarrage
+    for (size_t id = 0; id < loaded; id++) {
+        if ((present[id >> 3] & (1 << (id & 7))) || track_index_is_removed(id)) continue;
+        if (track_index_remove(id) == ESP_OK) status.removed++;
+    }
+    if (status.added || status.removed || scan_generation != track_index_generation()) {
+        if (track_index_save(present, scan_generation) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to write %s", TRACK_INDEX_PATH);
+        }
+    }
+
+    size_t count = track_index_count();
+    status.elapsed_ms = (esp_timer_get_time() - scan_start_us) / 1000;
+    ESP_LOGI(TAG, "Scan done: %u dirs, %u tracks (+%u -%u) in %u ms, %u bytes/track",
+             (unsigned)status.dirs, (unsigned)status.tracks, (unsigned)status.added,
+             (unsigned)status.removed, (unsigned)status.elapsed_ms,
+             (unsigned)(count ? track_index_memory_usage() / count : 0));
+
+    free(present);
+    present = NULL;
+    status.running = false;
+    status.done = true;
+    xEventGroupSetBits(scan_events, SCAN_BIT_DONE);
+    vTaskDelete(NULL);
+}
+
+esp_err_t library_scanner_start(library_scanner_track_cb_t on_track)
+{
+    if (status.running) return ESP_ERR_INVALID_STATE;
+    if (!scan_events && !(scan_events = xEventGroupCreate())) return ESP_ERR_NO_MEM;
+
+    present = heap_caps_calloc(PRESENT_BYTES, 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!present) present = calloc(PRESENT_BYTES, 1);
+    if (!present) return ESP_ERR_NO_MEM;
+
+    track_cb = on_track;
+    memset(&status, 0, sizeof(status));
+    status.running = true;
+    scan_start_us = esp_timer_get_time();
+    xEventGroupClearBits(scan_events, SCAN_BIT_TRACK | SCAN_BIT_DONE);
+    if (track_index_count() > 0) xEventGroupSetBits(scan_events, SCAN_BIT_TRACK);
+
+    if (xTaskCreate(scan_task, "lib_scan", SCAN_TASK_STACK, NULL, SCAN_TASK_PRIO, NULL) != pdPASS) {
+        status.running = false;
+        free(present);
+        present = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool library_scanner_wait_for_tracks(TickType_t timeout)
+{
+    if (scan_events) {
+        xEventGroupWaitBits(scan_events, SCAN_BIT_TRACK | SCAN_BIT_DONE, pdFALSE, pdFALSE, timeout);
+    }
+    return track_index_count() > 0;
+}
+
+void library_scanner_get_status(library_scan_status_t *out)
+{
+    *out = status;
+    if (out->running) {
+        out->elapsed_ms = (esp_timer_get_time() - scan_start_us) / 1000;
+    }
+}
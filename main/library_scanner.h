@@ -0,0 +1,52 @@
+// library_scanner.h
+#ifndef LIBRARY_SCANNER_H
+#define LIBRARY_SCANNER_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    bool running;
+    bool done;
+    uint32_t dirs;          // répertoires parcourus
+    uint32_t tracks;        // fichiers MP3 trouvés
+    uint32_t added;         // pistes absentes de l'index
+    uint32_t removed;       // pistes de l'index disparues du disque
+    uint32_t elapsed_ms;
+} library_scan_status_t;
+
+/**
+ * @brief Appelé pour chaque nouvelle piste ajoutée à l'index.
+ */
+typedef void (*library_scanner_track_cb_t)(size_t id);
+
+/**
+ * @brief Lance le parcours récursif de MP3_DIR dans une tâche de basse priorité.
+ *        Les nouvelles pistes sont ajoutées à l'index au fur et à mesure,
+ *        puis l'index est réécrit si le contenu a changé.
+ */
+esp_err_t library_scanner_start(library_scanner_track_cb_t on_track);
+
+/**
+ * @brief Attend qu'au moins une piste soit disponible ou que le scan soit terminé.
+ * @return true si l'index contient au moins une piste.
+ */
+bool library_scanner_wait_for_tracks(TickType_t timeout);
+
+/**
+ * @brief Retourne l'avancement du scan en cours ou du dernier scan.
+ */
+void library_scanner_get_status(library_scan_status_t *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBRARY_SCANNER_H
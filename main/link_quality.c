@@ -0,0 +1,124 @@
+// link_quality.c
+#include "link_quality.h"
+#include <string.h>
+
+#define RSSI_WEAK_DB -6             // sous la plage idéale : peu de marge avant les pertes
+#define SEND_PCT_DEGRADED 97        // la pile prend moins que le temps réel
+#define SEND_PCT_CONGESTED 90
+#define QUEUE_BACKLOG_PCT 50        // file assez pleine pour que le retard vienne du lien
+#define SEND_PCT_CAP 999
+#define RAISE_WINDOWS 2             // fenêtres mauvaises avant de monter
+#define RELAX_WINDOWS 5             // fenêtres bonnes avant de redescendre d'un niveau
+
+static const char *const level_names[LINK_Q_LEVELS] = {"good", "degraded", "congested"};
+
+const char *link_quality_level_name(link_q_level_t level)
+{
+    return level < LINK_Q_LEVELS ? level_names[level] : "?";
+}
+
+void link_quality_init(link_quality_t *q, uint32_t byte_rate)
+{
+    memset(q, 0, sizeof(*q));
+    q->byte_rate = byte_rate;
+    q->stats.rssi_delta = LINK_Q_RSSI_UNKNOWN;
+    q->stats.rssi_delta_min = LINK_Q_RSSI_UNKNOWN;
+    q->window_rssi = LINK_Q_RSSI_UNKNOWN;
+}
+
+static bool set_level(link_quality_t *q, link_q_level_t level)
+{
+    if (level == q->stats.level) return false;
+    q->stats.level = level;
+    q->stats.transitions++;
+    return true;
+}
+
+static void start_window(link_quality_t *q, const link_q_sample_t *s)
+{
+    q->primed = true;
+    q->window_start_ms = s->now_ms;
+    q->window_sent = s->sent_bytes;
+    q->window_underruns = s->underruns;
+    q->window_rssi = LINK_Q_RSSI_UNKNOWN;
+}
+
+/*
+ * Niveau justifié par une seule fenêtre. Un débit faible ne compte que si
+ * la file d'émission a de quoi envoyer : vide, c'est la source (carte SD,
+ * décodeur) qui est en retard, pas le lien.
+ */
+static link_q_level_t judge(const link_quality_t *q, uint16_t send_pct, uint16_t queue_pct)
+{
+    if (queue_pct >= QUEUE_BACKLOG_PCT) {
+        if (send_pct < SEND_PCT_CONGESTED) return LINK_Q_CONGESTED;
+        if (send_pct < SEND_PCT_DEGRADED) return LINK_Q_DEGRADED;
+    }
+    if (q->window_rssi != LINK_Q_RSSI_UNKNOWN && q->window_rssi <= RSSI_WEAK_DB) return LINK_Q_DEGRADED;
+    return LINK_Q_GOOD;
+}
+
+bool link_quality_update(link_quality_t *q, const link_q_sample_t *s)
+{
+    link_q_stats_t *st = &q->stats;
+    if (s->rssi_delta != LINK_Q_RSSI_UNKNOWN) {
+        st->rssi_delta = s->rssi_delta;
+        if (st->rssi_delta_min == LINK_Q_RSSI_UNKNOWN || s->rssi_delta < st->rssi_delta_min) {
+            st->rssi_delta_min = s->rssi_delta;
+        }
+        if (q->window_rssi == LINK_Q_RSSI_UNKNOWN || s->rssi_delta < q->window_rssi) {
+            q->window_rssi = s->rssi_delta;
+        }
+    }
+    st->queue_pct = s->queue_size ? (uint16_t)((uint64_t)s->queue_fill * 100 / s->queue_size) : 0;
+
+    // lien coupé : plus rien à protéger, l'enceinte suivante repart d'un état neutre
+    if (!s->connected) {
+        q->primed = false;
+        q->bad_windows = q->good_windows = 0;
+        return set_level(q, LINK_Q_GOOD);
+    }
+    // en pause la pile ne prend rien : la fenêtre repart à la reprise
+    if (!s->playing) {
+        q->primed = false;
+        return false;
+    }
+    // compteurs remis à zéro par un nouveau pipeline
+    if (!q->primed || s->sent_bytes < q->window_sent || s->underruns < q->window_underruns) {
+        start_window(q, s);
+        return false;
+    }
+    uint32_t elapsed = s->now_ms - q->window_start_ms;
+    if (elapsed < LINK_Q_WINDOW_MS) return false;
+
+    uint64_t expected = (uint64_t)q->byte_rate * elapsed / 1000;
+    uint64_t pct = expected ? (s->sent_bytes - q->window_sent) * 100 / expected : 100;
+    uint16_t send_pct = pct > SEND_PCT_CAP ? SEND_PCT_CAP : (uint16_t)pct;
+    bool dropout = s->underruns != q->window_underruns;
+    link_q_level_t target = judge(q, send_pct, st->queue_pct);
+    start_window(q, s);
+
+    st->windows++;
+    st->send_pct = send_pct;
+    if (st->windows == 1 || send_pct < st->send_pct_min) st->send_pct_min = send_pct;
+    if (dropout) st->dropouts++;
+
+    link_q_level_t level = st->level;
+    if (target > level) {
+        q->good_windows = 0;
+        if (++q->bad_windows >= RAISE_WINDOWS) {
+            level = target;
+            q->bad_windows = 0;
+        }
+    } else if (target < level) {
+        q->bad_windows = 0;
+        if (++q->good_windows >= RELAX_WINDOWS) {
+            level = (link_q_level_t)(level - 1);
+            q->good_windows = 0;
+        }
+    } else {
+        q->bad_windows = q->good_windows = 0;
+    }
+    st->level_windows[level]++;
+    return set_level(q, level);
+}
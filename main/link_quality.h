@@ -0,0 +1,86 @@
+// link_quality.h
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Estimation de l'état du lien A2DP, sans dépendance à ESP-IDF : le
+ * simulateur tools/link_sim la rejoue sur des traces enregistrées.
+ */
+
+#define LINK_Q_RSSI_UNKNOWN INT8_MIN
+#define LINK_Q_WINDOW_MS 1000       // durée d'une fenêtre d'évaluation
+
+typedef enum {
+    LINK_Q_GOOD,
+    LINK_Q_DEGRADED,        // signal faible ou débit irrégulier : priorité radio au Bluetooth
+    LINK_Q_CONGESTED,       // pertes ou débit insuffisant : le HTTP est en plus ralenti
+    LINK_Q_LEVELS,
+} link_q_level_t;
+
+/**
+ * Relevé cumulé, fourni à chaque mesure du pipeline.
+ */
+typedef struct {
+    uint32_t now_ms;
+    bool connected;
+    bool playing;
+    int8_t rssi_delta;      // dB par rapport à la plage de réception idéale, LINK_Q_RSSI_UNKNOWN
+    uint64_t sent_bytes;    // octets pris par la pile A2DP depuis le démarrage du pipeline
+    uint32_t underruns;     // passages à vide de l'anneau devant l'émetteur
+    uint32_t queue_fill;    // octets en attente devant l'émetteur
+    uint32_t queue_size;
+} link_q_sample_t;
+
+typedef struct {
+    link_q_level_t level;
+    uint32_t windows;           // fenêtres évaluées (lecture en cours)
+    uint32_t dropouts;          // fenêtres avec au moins un passage à vide
+    uint32_t level_windows[LINK_Q_LEVELS];
+    uint32_t transitions;
+    int8_t rssi_delta;          // dernière mesure
+    int8_t rssi_delta_min;
+    uint16_t send_pct;          // débit pris par la pile sur la dernière fenêtre, % du nominal
+    uint16_t send_pct_min;
+    uint16_t queue_pct;         // remplissage de la file d'émission
+} link_q_stats_t;
+
+typedef struct {
+    link_q_stats_t stats;
+    uint32_t byte_rate;         // débit nominal du flux (octets/s)
+    bool primed;
+    uint32_t window_start_ms;
+    uint64_t window_sent;
+    uint32_t window_underruns;
+    int8_t window_rssi;         // plus faible mesure de la fenêtre
+    uint8_t bad_windows;
+    uint8_t good_windows;
+} link_quality_t;
+
+/**
+ * @brief Remet l'estimation à zéro pour un flux de byte_rate octets/s.
+ */
+void link_quality_init(link_quality_t *q, uint32_t byte_rate);
+
+/**
+ * @brief Intègre un relevé ; la fenêtre close, réévalue le niveau.
+ * @return true si le niveau a changé.
+ */
+bool link_quality_update(link_quality_t *q, const link_q_sample_t *s);
+
+/**
+ * @brief Nom du niveau, pour les journaux et les métriques.
+ */
+const char *link_quality_level_name(link_q_level_t level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LINK_QUALITY_H
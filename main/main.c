@@ -4,27 +4,38 @@
 #include "audio_pipeline.h"
 #include "bt_control.h"
 #include "esp_event.h"
-#include <fcntl.h>
-#include <unistd.h>
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "esp_peripherals.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_heap_caps.h"
 #include "nvs_flash.h"
 #include "path_config.h"
+#include "playback_state.h"
 #include "playlist_manager.h"
+#include "replaygain.h"
+#include "track_index.h"
+#include "library_scanner.h"
+#include "http_chunk.h"
+#include "mem_budget.h"
+#include "metrics.h"
+#include "status_push.h"
+#include "track_list.h"
+#include "track_reader.h"
+#include "web_static.h"
 #include "sdkconfig.h"
-#include <dirent.h>
+#include <ctype.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define WIFI_AP_SSID "mp3-player"
 #define WIFI_AP_PASS "12345678"
-#define MOUNT_POINT MP3_DIR
-#define HTTP_MOUNT_POINT "/sdcard/www"
 
 static const char *TAG = "main";
 static httpd_handle_t http_server = NULL;
@@ -50,61 +61,33 @@ void init_wifi_ap() {
   ESP_LOGI(TAG, "WiFi AP démarré SSID:%s", WIFI_AP_SSID);
 }
 
-esp_err_t index_handler(httpd_req_t *req) {
-    char path[128];
-    snprintf(path, sizeof(path), "%s/index.html", HTTP_MOUNT_POINT);
-    int fd = open(path, O_RDONLY);
-    if (fd < 0) {
-        httpd_resp_send_404(req);
-        return ESP_FAIL;
-    }
-    httpd_resp_set_type(req, "text/html");
-    char buf[1024];
-    ssize_t r;
-    while ((r = read(fd, buf, sizeof(buf))) > 0) {
-        httpd_resp_send_chunk(req, buf, r);
-    }
-    close(fd);
-    httpd_resp_send_chunk(req, NULL, 0); // signal de fin
-    return ESP_OK;
-}
-
-esp_err_t list_handler(httpd_req_t *req) {
-  DIR *dir = opendir(MOUNT_POINT);
-  if (!dir)
-    return ESP_FAIL;
-  struct dirent *de;
-  httpd_resp_set_type(req, "application/json");
-  httpd_resp_sendstr_chunk(req, "[");
-  bool first = true;
-  while ((de = readdir(dir))) {
-    if (de->d_type == DT_REG) {
-      if (!first)
-        httpd_resp_sendstr_chunk(req, ",");
-      httpd_resp_sendstr_chunk(req, "\"");
-      httpd_resp_sendstr_chunk(req, de->d_name);
-      httpd_resp_sendstr_chunk(req, "\"");
-      first = false;
+// Decode %XX et '+' sur place (httpd_query_key_value ne le fait pas)
+static void url_decode(char *s) {
+  char *out = s;
+  for (; *s; s++) {
+    if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2])) {
+      char hex[3] = {s[1], s[2], '\0'};
+      *out++ = (char)strtol(hex, NULL, 16);
+      s += 2;
+    } else {
+      *out++ = *s == '+' ? ' ' : *s;
     }
   }
-  closedir(dir);
-  httpd_resp_sendstr_chunk(req, "]");
-  httpd_resp_sendstr_chunk(req, NULL);
-  return ESP_OK;
+  *out = '\0';
 }
 
 esp_err_t play_handler(httpd_req_t *req) {
-  char buf[128];
+  char buf[CONFIG_HTTPD_MAX_URI_LEN];
   size_t len = httpd_req_get_url_query_len(req) + 1;
   if (len > sizeof(buf))
     return ESP_FAIL;
   if (httpd_req_get_url_query_str(req, buf, len) == ESP_OK) {
-    char file[64];
+    char file[TRACK_PATH_MAX];
     if (httpd_query_key_value(buf, "file", file, sizeof(file)) == ESP_OK) {
-      char path[128];
+      url_decode(file);
+      char path[TRACK_PATH_MAX + sizeof(MP3_DIR)];
       snprintf(path, sizeof(path), "%s/%s", MP3_DIR, file);
-      playlist_manager_set_current_by_name(file);
-      audio_manager_play(path);
+          audio_manager_play(path);
       httpd_resp_sendstr(req, "OK");
       return ESP_OK;
     }
@@ -127,42 +110,276 @@ esp_err_t ctl_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
+esp_err_t volume_handler(httpd_req_t *req) {
+  char buf[32], val[8];
+  size_t len = httpd_req_get_url_query_len(req) + 1;
+  if (len > 1 && len <= sizeof(buf) &&
+      httpd_req_get_url_query_str(req, buf, len) == ESP_OK &&
+      httpd_query_key_value(buf, "level", val, sizeof(val)) == ESP_OK &&
+      audio_manager_set_volume(atoi(val)) == ESP_OK) {
+    httpd_resp_sendstr(req, "OK");
+    return ESP_OK;
+  }
+  httpd_resp_sendstr(req, "BAD REQUEST");
+  return ESP_FAIL;
+}
+
+// /seek?ms=N va à N ms du début de la piste, /seek?delta=N avance (ou recule si N < 0)
+esp_err_t seek_handler(httpd_req_t *req) {
+  char buf[32], val[12];
+  esp_err_t err = ESP_ERR_INVALID_ARG;
+  size_t len = httpd_req_get_url_query_len(req) + 1;
+  if (len > 1 && len <= sizeof(buf) &&
+      httpd_req_get_url_query_str(req, buf, len) == ESP_OK) {
+    if (httpd_query_key_value(buf, "ms", val, sizeof(val)) == ESP_OK && val[0] != '-') {
+      err = audio_manager_seek(strtoul(val, NULL, 10));
+    } else if (httpd_query_key_value(buf, "delta", val, sizeof(val)) == ESP_OK) {
+      err = audio_manager_seek_relative(strtol(val, NULL, 10));
+    }
+  }
+  if (err == ESP_OK) {
+    httpd_resp_sendstr(req, "OK");
+    return ESP_OK;
+  }
+  httpd_resp_sendstr(req, "BAD REQUEST");
+  return ESP_FAIL;
+}
+
+// Nombre décimal complet et fini : "nan", "inf" ou "3dB" sont refusés
+static bool parse_finite(const char *s, float *out) {
+  char *end;
+  float v = strtof(s, &end);
+  if (end == s || *end != '\0' || !isfinite(v))
+    return false;
+  *out = v;
+  return true;
+}
+
+static const char *const eq_type_names[] = {"off", "peaking", "lowshelf", "highshelf"};
+
+/*
+ * /eq sans parametre renvoie le reglage ; /eq?preamp=dB et
+ * /eq?band=N&type=peaking|lowshelf|highshelf|off&freq=Hz&gain=dB&q=
+ * le modifient.
+ */
+esp_err_t eq_handler(httpd_req_t *req) {
+  audio_eq_settings_t eq;
+  audio_manager_get_eq(&eq);
+
+  char query[160], val[16];
+  size_t len = httpd_req_get_url_query_len(req) + 1;
+  if (len > sizeof(query)) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+    return ESP_OK;
+  }
+  if (len > 1 && httpd_req_get_url_query_str(req, query, len) == ESP_OK) {
+    bool bad = false;
+    if (httpd_query_key_value(query, "preamp", val, sizeof(val)) == ESP_OK)
+      bad |= !parse_finite(val, &eq.preamp_db);
+    if (httpd_query_key_value(query, "band", val, sizeof(val)) == ESP_OK) {
+      int band = atoi(val);
+      if (band < 0 || band >= AUDIO_EQ_MAX_BANDS) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "band out of range");
+        return ESP_OK;
+      }
+      audio_eq_band_t *b = &eq.bands[band];
+      if (httpd_query_key_value(query, "type", val, sizeof(val)) == ESP_OK) {
+        for (int t = 0; t < sizeof(eq_type_names) / sizeof(eq_type_names[0]); t++) {
+          if (strcmp(val, eq_type_names[t]) == 0)
+            b->type = (audio_eq_type_t)t;
+        }
+      }
+      if (httpd_query_key_value(query, "freq", val, sizeof(val)) == ESP_OK)
+        bad |= !parse_finite(val, &b->freq);
+      if (httpd_query_key_value(query, "gain", val, sizeof(val)) == ESP_OK)
+        bad |= !parse_finite(val, &b->gain_db);
+      if (httpd_query_key_value(query, "q", val, sizeof(val)) == ESP_OK)
+        bad |= !parse_finite(val, &b->q);
+      if (b->type != AUDIO_EQ_OFF && b->q == 0)
+        b->q = 0.707f;
+    }
+    if (bad || audio_manager_set_eq(&eq) != ESP_OK) {
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "invalid EQ setting");
+      return ESP_OK;
+    }
+  }
+
+  http_chunk_t *c = http_chunk_begin(req);
+  if (!c) {
+    httpd_resp_send_500(req);
+    return ESP_ERR_NO_MEM;
+  }
+  httpd_resp_set_type(req, "application/json");
+  http_chunk_printf(c, "{\"preamp\":%.1f,\"cycles_per_sample_band\":%u,\"bands\":[",
+                    eq.preamp_db, (unsigned)audio_manager_get_eq_cycles());
+  for (int i = 0; i < AUDIO_EQ_MAX_BANDS; i++) {
+    const audio_eq_band_t *b = &eq.bands[i];
+    http_chunk_printf(c, "%s{\"type\":\"%s\",\"freq\":%.0f,\"gain\":%.1f,\"q\":%.2f}",
+                      i ? "," : "", eq_type_names[b->type], b->freq, b->gain_db, b->q);
+  }
+  http_chunk_puts(c, "]}");
+  return http_chunk_end(c, NULL);
+}
+
 esp_err_t current_handler(httpd_req_t *req) {
-  const char *path = playlist_manager_get_current_track();
-  if (!path) {
+  if (!track_reader_get_current_uri()) {
     httpd_resp_send_404(req);
     return ESP_OK;
   }
-  const char *name = strrchr(path, '/');
-  name = name ? name + 1 : path;
-  char resp[128];
-  snprintf(resp, sizeof(resp), "{\"track\":\"%s\",\"index\":%d,\"total\":%d}",
-           name, (int)playlist_manager_get_current_index(),
-           (int)playlist_manager_get_track_count());
+  char resp[448];
+  status_push_format(resp, sizeof(resp));
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_sendstr(req, resp);
+  return ESP_OK;
+}
+
+esp_err_t memory_handler(httpd_req_t *req) {
+  http_chunk_t *c = http_chunk_begin(req);
+  if (!c) {
+    httpd_resp_send_500(req);
+    return ESP_ERR_NO_MEM;
+  }
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  http_chunk_puts(c, "{\"subsystems\":[");
+  for (int s = 0; s < MEM_SUBSYS_MAX; s++) {
+    mem_budget_entry_t e;
+    bool over = mem_budget_get(s, &e);
+    http_chunk_printf(c, "%s{\"name\":\"%s\",\"bytes\":%u,\"peak\":%u,\"internal\":%u,"
+                      "\"psram\":%u,\"budget\":%u,\"over\":%s}",
+                      s ? "," : "", e.name, (unsigned)e.bytes, (unsigned)e.peak,
+                      (unsigned)e.internal, (unsigned)e.spiram, (unsigned)e.budget,
+                      over ? "true" : "false");
+  }
+  http_chunk_puts(c, "],\"heaps\":{");
+  const uint32_t caps[] = {MALLOC_CAP_INTERNAL, MALLOC_CAP_SPIRAM};
+  const char *names[] = {"internal", "psram"};
+  for (int i = 0; i < 2; i++) {
+    mem_heap_stats_t h;
+    mem_budget_heap(caps[i], &h);
+    http_chunk_printf(c, "%s\"%s\":{\"total\":%u,\"free\":%u,\"min_free\":%u,"
+                      "\"largest_block\":%u,\"frag_pct\":%u}",
+                      i ? "," : "", names[i], (unsigned)h.total, (unsigned)h.free,
+                      (unsigned)h.min_free, (unsigned)h.largest_block, (unsigned)h.frag_pct);
+  }
+  http_chunk_puts(c, "}}");
+  return http_chunk_end(c, NULL);
+}
+
+esp_err_t scan_status_handler(httpd_req_t *req) {
+  library_scan_status_t st;
+  library_scanner_get_status(&st);
+  char resp[192];
+  snprintf(resp, sizeof(resp),
+           "{\"state\":\"%s\",\"dirs\":%u,\"tracks\":%u,\"added\":%u,"
+           "\"removed\":%u,\"elapsed_ms\":%u,\"total\":%u}",
+           st.running ? "scanning" : (st.done ? "done" : "idle"),
+           (unsigned)st.dirs, (unsigned)st.tracks, (unsigned)st.added,
+           (unsigned)st.removed, (unsigned)st.elapsed_ms,
+           (unsigned)track_index_count());
   httpd_resp_set_type(req, "application/json");
   httpd_resp_sendstr(req, resp);
   return ESP_OK;
 }
 
+static esp_err_t sinks_list(httpd_req_t *req) {
+  http_chunk_t *c = http_chunk_begin(req);
+  if (!c) {
+    httpd_resp_send_500(req);
+    return ESP_ERR_NO_MEM;
+  }
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  http_chunk_puts(c, "[");
+  bt_sink_info_t s;
+  for (size_t i = 0; bt_control_get_sink(i, &s); i++) {
+    char rssi[8] = "null";
+    if (s.rssi != BT_SINK_RSSI_UNKNOWN) snprintf(rssi, sizeof(rssi), "%d", s.rssi);
+    // le nom est écrit à part : échappé, il peut dépasser toute taille fixe
+    http_chunk_printf(c, "%s{\"addr\":\"%02x:%02x:%02x:%02x:%02x:%02x\",\"name\":", i ? "," : "",
+                      s.addr[0], s.addr[1], s.addr[2], s.addr[3], s.addr[4], s.addr[5]);
+    http_chunk_json_string(c, s.name);
+    http_chunk_printf(c, ",\"rssi\":%s,\"known\":%s,\"active\":%s}", rssi,
+                      s.known ? "true" : "false", s.active ? "true" : "false");
+  }
+  http_chunk_puts(c, "]");
+  return http_chunk_end(c, NULL);
+}
+
+/*
+ * /sinks liste les enceintes, /sinks/select?addr=aa:bb:cc:dd:ee:ff passe
+ * sur l'une d'elles et /sinks/scan relance une recherche.
+ */
+esp_err_t sinks_handler(httpd_req_t *req) {
+  esp_err_t err = ESP_ERR_INVALID_ARG;
+  if (strncmp(req->uri, "/sinks/select", 13) == 0) {
+    char buf[48], val[24];
+    uint8_t a[6];
+    size_t len = httpd_req_get_url_query_len(req) + 1;
+    if (len > 1 && len <= sizeof(buf) &&
+        httpd_req_get_url_query_str(req, buf, len) == ESP_OK &&
+        httpd_query_key_value(buf, "addr", val, sizeof(val)) == ESP_OK &&
+        sscanf(val, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+               &a[0], &a[1], &a[2], &a[3], &a[4], &a[5]) == 6) {
+      err = bt_control_select_sink(a);
+    }
+  } else if (strncmp(req->uri, "/sinks/scan", 11) == 0) {
+    err = bt_control_scan_sinks();
+  } else {
+    return sinks_list(req);
+  }
+  if (err == ESP_OK) {
+    httpd_resp_sendstr(req, "OK");
+    return ESP_OK;
+  }
+  httpd_resp_sendstr(req, err == ESP_ERR_INVALID_STATE ? "BUSY" : "BAD REQUEST");
+  return ESP_FAIL;
+}
+
+static size_t playlist_memory(void) {
+  return playlist_manager_get_memory_usage() + replaygain_memory_usage();
+}
+
 void start_httpd() {
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.max_uri_handlers = 20;
+  config.uri_match_fn = httpd_uri_match_wildcard;
   httpd_start(&http_server, &config);
-  httpd_uri_t list_uri = {"/list", HTTP_GET, list_handler, NULL, NULL, 0};
   httpd_uri_t play_uri = {"/play", HTTP_GET, play_handler, NULL, NULL, 0};
   httpd_uri_t pause_uri = {"/pause", HTTP_GET, ctl_handler, NULL, NULL, 0};
   httpd_uri_t resume_uri = {"/resume", HTTP_GET, ctl_handler, NULL, NULL, 0};
   httpd_uri_t next_uri = {"/next", HTTP_GET, ctl_handler, NULL, NULL, 0};
   httpd_uri_t prev_uri = {"/previous", HTTP_GET, ctl_handler, NULL, NULL, 0};
   httpd_uri_t current_uri = {"/current", HTTP_GET, current_handler, NULL, NULL, 0};
-  httpd_uri_t index_uri = {"/", HTTP_GET, index_handler, NULL, NULL, 0};
-  httpd_register_uri_handler(http_server, &index_uri);
-  httpd_register_uri_handler(http_server, &list_uri);
+  httpd_uri_t volume_uri = {"/volume", HTTP_GET, volume_handler, NULL, NULL, 0};
+  httpd_uri_t seek_uri = {"/seek", HTTP_GET, seek_handler, NULL, NULL, 0};
+  httpd_uri_t eq_uri = {"/eq", HTTP_GET, eq_handler, NULL, NULL, 0};
+  httpd_uri_t scan_uri = {"/scan/status", HTTP_GET, scan_status_handler, NULL, NULL, 0};
+  httpd_uri_t memory_uri = {"/memory", HTTP_GET, memory_handler, NULL, NULL, 0};
+  httpd_uri_t sinks_uri = {"/sinks*", HTTP_GET, sinks_handler, NULL, NULL, 0};
+  if (track_list_register(http_server) != ESP_OK) {
+    ESP_LOGW(TAG, "Track list endpoint unavailable");
+  }
   httpd_register_uri_handler(http_server, &play_uri);
   httpd_register_uri_handler(http_server, &pause_uri);
   httpd_register_uri_handler(http_server, &resume_uri);
   httpd_register_uri_handler(http_server, &next_uri);
   httpd_register_uri_handler(http_server, &prev_uri);
   httpd_register_uri_handler(http_server, &current_uri);
+  httpd_register_uri_handler(http_server, &scan_uri);
+  httpd_register_uri_handler(http_server, &volume_uri);
+  httpd_register_uri_handler(http_server, &seek_uri);
+  httpd_register_uri_handler(http_server, &eq_uri);
+  httpd_register_uri_handler(http_server, &memory_uri);
+  httpd_register_uri_handler(http_server, &sinks_uri);
+  if (metrics_register(http_server) != ESP_OK) {
+    ESP_LOGW(TAG, "Metrics endpoint unavailable");
+  }
+  if (status_push_start(http_server) != ESP_OK) {
+    ESP_LOGW(TAG, "Status push channel unavailable");
+  }
+  // en dernier : la route générique ne doit pas masquer les précédentes
+  web_static_register(http_server);
 }
 
 void app_main(void) {
@@ -182,14 +399,39 @@ void app_main(void) {
     ESP_LOGE(TAG, "Playlist manager failed");
     return;
   }
+#if CONFIG_PLAYBACK_RESUME
+  // même permutation et même piste qu'avant le redémarrage
+  static playback_state_t saved;
+  if (playback_state_load(&saved) == ESP_OK && playlist_manager_restore(&saved) == ESP_OK) {
+    audio_manager_set_resume(saved.offset);
+  }
+#endif
+#if CONFIG_AUDIO_REPLAYGAIN
+  if (replaygain_init() != ESP_OK) {
+    ESP_LOGW(TAG, "Track gain cache unavailable");
+  }
+#endif
 
+  mem_budget_set_source(MEM_SUBSYS_PLAYLIST, playlist_memory);
+  mem_budget_set_source(MEM_SUBSYS_AUDIO, audio_manager_get_memory_usage);
+  // différence du tas : approximatif, le Wi-Fi peut allouer en même temps
+  mem_budget_begin(MEM_SUBSYS_HTTP);
   start_httpd();
+  mem_budget_end(MEM_SUBSYS_HTTP);
 
+  mem_budget_begin(MEM_SUBSYS_BT);
   ESP_ERROR_CHECK(bt_control_init());
+  mem_budget_end(MEM_SUBSYS_BT);
 
   ESP_LOGI(TAG, "Start audio playback");
   if (audio_manager_start() != ESP_OK) {
     ESP_LOGE(TAG, "Audio pipeline failed to start");
     return;
   }
+
+  // bilan une fois les éléments du pipeline ouverts
+  vTaskDelay(pdMS_TO_TICKS(2000));
+  if (mem_budget_report() > 0) {
+    ESP_LOGW(TAG, "Memory budget exceeded, see /memory");
+  }
 }
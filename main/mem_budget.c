@@ -0,0 +1,128 @@
+// mem_budget.c
+#include "mem_budget.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#ifndef CONFIG_MEM_BUDGET_PLAYLIST_KB
+#define CONFIG_MEM_BUDGET_PLAYLIST_KB 0
+#define CONFIG_MEM_BUDGET_AUDIO_KB 0
+#define CONFIG_MEM_BUDGET_HTTP_KB 0
+#define CONFIG_MEM_BUDGET_BT_KB 0
+#endif
+
+static const char *TAG = "mem_budget";
+
+typedef struct {
+    mem_budget_entry_t e;
+    size_t (*source)(void);
+    size_t start_internal;      // tas libre au mem_budget_begin()
+    size_t start_spiram;
+} subsys_t;
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static subsys_t subsys[MEM_SUBSYS_MAX] = {
+    [MEM_SUBSYS_PLAYLIST] = { .e = { .name = "playlist", .budget = CONFIG_MEM_BUDGET_PLAYLIST_KB * 1024 } },
+    [MEM_SUBSYS_AUDIO]    = { .e = { .name = "audio",    .budget = CONFIG_MEM_BUDGET_AUDIO_KB * 1024 } },
+    [MEM_SUBSYS_HTTP]     = { .e = { .name = "http",     .budget = CONFIG_MEM_BUDGET_HTTP_KB * 1024 } },
+    [MEM_SUBSYS_BT]       = { .e = { .name = "bt",       .budget = CONFIG_MEM_BUDGET_BT_KB * 1024 } },
+};
+
+static size_t used_since(size_t start, size_t now)
+{
+    return start > now ? start - now : 0;
+}
+
+void mem_budget_begin(mem_subsys_t s)
+{
+    if (s >= MEM_SUBSYS_MAX) return;
+    size_t internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t spiram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    taskENTER_CRITICAL(&lock);
+    subsys[s].start_internal = internal;
+    subsys[s].start_spiram = spiram;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void mem_budget_end(mem_subsys_t s)
+{
+    if (s >= MEM_SUBSYS_MAX) return;
+    size_t internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t spiram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    taskENTER_CRITICAL(&lock);
+    mem_budget_entry_t *e = &subsys[s].e;
+    e->internal = used_since(subsys[s].start_internal, internal);
+    e->spiram = used_since(subsys[s].start_spiram, spiram);
+    e->bytes = e->internal + e->spiram;
+    if (e->bytes > e->peak) e->peak = e->bytes;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void mem_budget_release(mem_subsys_t s)
+{
+    if (s >= MEM_SUBSYS_MAX) return;
+    taskENTER_CRITICAL(&lock);
+    subsys[s].e.bytes = subsys[s].e.internal = subsys[s].e.spiram = 0;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void mem_budget_set_source(mem_subsys_t s, size_t (*source)(void))
+{
+    if (s < MEM_SUBSYS_MAX) subsys[s].source = source;
+}
+
+bool mem_budget_get(mem_subsys_t s, mem_budget_entry_t *out)
+{
+    if (s >= MEM_SUBSYS_MAX) return false;
+    // la source peut prendre un verrou : appelée hors section critique
+    size_t bytes = subsys[s].source ? subsys[s].source() : 0;
+    taskENTER_CRITICAL(&lock);
+    mem_budget_entry_t *e = &subsys[s].e;
+    if (subsys[s].source) {
+        e->bytes = bytes;
+        if (bytes > e->peak) e->peak = bytes;
+    }
+    *out = *e;
+    taskEXIT_CRITICAL(&lock);
+    return out->budget && out->bytes > out->budget;
+}
+
+void mem_budget_heap(uint32_t caps, mem_heap_stats_t *out)
+{
+    out->total = heap_caps_get_total_size(caps);
+    out->free = heap_caps_get_free_size(caps);
+    out->min_free = heap_caps_get_minimum_free_size(caps);
+    out->largest_block = heap_caps_get_largest_free_block(caps);
+    out->frag_pct = out->free ? 100 - (uint32_t)((uint64_t)out->largest_block * 100 / out->free) : 0;
+}
+
+int mem_budget_report(void)
+{
+    int over = 0;
+    for (int s = 0; s < MEM_SUBSYS_MAX; s++) {
+        mem_budget_entry_t e;
+        if (mem_budget_get(s, &e)) {
+            over++;
+            ESP_LOGE(TAG, "%-8s %7u B (peak %u) over budget %u B", e.name, (unsigned)e.bytes,
+                     (unsigned)e.peak, (unsigned)e.budget);
+        } else {
+            ESP_LOGI(TAG, "%-8s %7u B (peak %u, internal %u, psram %u) budget %u B", e.name,
+                     (unsigned)e.bytes, (unsigned)e.peak, (unsigned)e.internal,
+                     (unsigned)e.spiram, (unsigned)e.budget);
+        }
+    }
+    static const struct { uint32_t caps; const char *name; } heaps[] = {
+        { MALLOC_CAP_INTERNAL, "internal" },
+        { MALLOC_CAP_SPIRAM, "psram" },
+    };
+    for (size_t i = 0; i < sizeof(heaps) / sizeof(heaps[0]); i++) {
+        mem_heap_stats_t h;
+        mem_budget_heap(heaps[i].caps, &h);
+        if (h.total == 0) continue;
+        ESP_LOGI(TAG, "heap %-8s free %u / %u B, min %u, largest block %u (%u%% fragmented)",
+                 heaps[i].name, (unsigned)h.free, (unsigned)h.total, (unsigned)h.min_free,
+                 (unsigned)h.largest_block, (unsigned)h.frag_pct);
+    }
+    return over;
+}
@@ -0,0 +1,94 @@
+// mem_budget.h
+#ifndef MEM_BUDGET_H
+#define MEM_BUDGET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MEM_SUBSYS_PLAYLIST,
+    MEM_SUBSYS_AUDIO,
+    MEM_SUBSYS_HTTP,
+    MEM_SUBSYS_BT,
+    MEM_SUBSYS_MAX,
+} mem_subsys_t;
+
+/**
+ * Occupation mémoire d'un sous-système. Les sous-systèmes mesurés par
+ * différence du tas (begin/end) ont le détail interne/PSRAM ; ceux qui
+ * tiennent leur propre compte (source) n'ont que le total.
+ */
+typedef struct {
+    const char *name;
+    size_t bytes;               // occupation courante
+    size_t peak;                // plus haute occupation constatée
+    size_t internal;            // dont RAM interne (mesure par différence)
+    size_t spiram;              // dont PSRAM (mesure par différence)
+    size_t budget;              // 0 : pas de budget
+} mem_budget_entry_t;
+
+/**
+ * État d'un type de tas (MALLOC_CAP_INTERNAL ou MALLOC_CAP_SPIRAM).
+ */
+typedef struct {
+    size_t total;
+    size_t free;
+    size_t min_free;
+    size_t largest_block;
+    uint32_t frag_pct;          // 100 - plus grand bloc / libre, en %
+} mem_heap_stats_t;
+
+/**
+ * @brief Mémorise l'état du tas avant l'initialisation d'un sous-système.
+ */
+void mem_budget_begin(mem_subsys_t s);
+
+/**
+ * @brief Attribue au sous-système la mémoire consommée depuis
+ *        mem_budget_begin(). Approximatif : la différence du tas compte
+ *        tout ce qui est alloué entre-temps, par toutes les tâches. À
+ *        réserver à une initialisation courte et séquentielle ; un
+ *        sous-système qui alloue dans ses propres tâches déclare plutôt
+ *        une source (mem_budget_set_source()).
+ */
+void mem_budget_end(mem_subsys_t s);
+
+/**
+ * @brief Remet à zéro l'occupation courante (sous-système arrêté) ;
+ *        le pic est conservé.
+ */
+void mem_budget_release(mem_subsys_t s);
+
+/**
+ * @brief Déclare une fonction qui donne l'occupation exacte du sous-système,
+ *        relue à chaque consultation.
+ */
+void mem_budget_set_source(mem_subsys_t s, size_t (*source)(void));
+
+/**
+ * @brief Copie l'occupation d'un sous-système (sources relues).
+ * @return true si le budget est dépassé.
+ */
+bool mem_budget_get(mem_subsys_t s, mem_budget_entry_t *out);
+
+/**
+ * @brief Relève l'état d'un type de tas.
+ */
+void mem_budget_heap(uint32_t caps, mem_heap_stats_t *out);
+
+/**
+ * @brief Journalise le bilan par sous-système et par tas.
+ * @return nombre de sous-systèmes au-delà de leur budget.
+ */
+int mem_budget_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_BUDGET_H
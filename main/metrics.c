@@ -0,0 +1,252 @@
+// metrics.c
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "audio_manager.h"
+#include "bt_control.h"
+#include "http_chunk.h"
+#include "mem_budget.h"
+#include "sd_readahead.h"
+
+static const char *TAG = "metrics";
+
+// Tâches dont la marge de pile est publiée (absentes : ignorées)
+static const char *const watched_tasks[] = {
+    "audio_ctl_task", "audio_evt_task", "mp3", "filter", "bt",
+    "sd_readahead", "rg_writer", "status_push", "httpd", "BTC_TASK",
+};
+
+// Quantiles en pour mille : rang calculé en entiers, sans arrondi flottant
+static const uint16_t switch_quantiles[] = { 500, 900, 990 };
+
+static void help(http_chunk_t *c, const char *name, const char *type, const char *text)
+{
+    http_chunk_printf(c, "# HELP %s %s\n# TYPE %s %s\n", name, text, name, type);
+}
+
+static void put_pipeline(http_chunk_t *c, const audio_pipeline_stats_t *p)
+{
+    help(c, "audio_ringbuffer_size_bytes", "gauge", "Ring buffer size at the output of each element.");
+    for (int i = 0; i < AUDIO_LINK_COUNT; i++) {
+        http_chunk_printf(c, "audio_ringbuffer_size_bytes{element=\"%s\"} %u\n",
+                          p->links[i].name, (unsigned)p->links[i].size);
+    }
+    help(c, "audio_ringbuffer_fill_bytes", "gauge", "Ring buffer fill level at the last sample.");
+    for (int i = 0; i < AUDIO_LINK_COUNT; i++) {
+        http_chunk_printf(c, "audio_ringbuffer_fill_bytes{element=\"%s\"} %u\n",
+                          p->links[i].name, (unsigned)p->links[i].fill);
+    }
+    help(c, "audio_ringbuffer_empty_total", "counter", "Times a ring buffer was found drained while playing.");
+    for (int i = 0; i < AUDIO_LINK_COUNT; i++) {
+        http_chunk_printf(c, "audio_ringbuffer_empty_total{element=\"%s\"} %u\n",
+                          p->links[i].name, (unsigned)p->links[i].empty_events);
+    }
+    help(c, "audio_a2dp_underruns_total", "counter", "Times the A2DP input ring buffer ran dry while playing.");
+    http_chunk_printf(c, "audio_a2dp_underruns_total %u\n",
+                      (unsigned)p->links[AUDIO_LINK_COUNT - 1].empty_events);
+
+    help(c, "audio_element_errors_total", "counter", "Error statuses reported by pipeline elements.");
+    http_chunk_printf(c, "audio_element_errors_total{element=\"mp3\"} %u\n", (unsigned)p->decoder_errors);
+    http_chunk_printf(c, "audio_element_errors_total{element=\"other\"} %u\n", (unsigned)p->element_errors);
+
+    help(c, "audio_element_busy_seconds_total", "counter", "Processing time of each element, ring buffer waits excluded.");
+    http_chunk_printf(c, "audio_element_busy_seconds_total{element=\"filter\"} %.3f\n", p->dsp_busy_us / 1e6);
+    help(c, "audio_source_read_seconds_total", "counter", "Time the decoder spent reading the track.");
+    http_chunk_printf(c, "audio_source_read_seconds_total %.3f\n", p->source_read_us / 1e6);
+
+    // quantiles sur les derniers changements de piste, somme et nombre depuis le démarrage
+    uint32_t recent[AUDIO_SWITCH_WINDOW];
+    uint32_t n = p->switch_recent_len;
+    memcpy(recent, p->switch_recent_us, n * sizeof(recent[0]));
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t v = recent[i];
+        uint32_t j = i;
+        for (; j > 0 && recent[j - 1] > v; j--) recent[j] = recent[j - 1];
+        recent[j] = v;
+    }
+    help(c, "audio_track_switch_seconds", "summary", "Pipeline restart latency on track changes.");
+    for (size_t q = 0; n > 0 && q < sizeof(switch_quantiles) / sizeof(switch_quantiles[0]); q++) {
+        // rang le plus proche : plus petit r tel que r / n >= q
+        uint32_t rank = (switch_quantiles[q] * n + 999) / 1000;
+        http_chunk_printf(c, "audio_track_switch_seconds{quantile=\"%g\"} %.4f\n",
+                          switch_quantiles[q] / 1000.0, recent[rank > 0 ? rank - 1 : 0] / 1e6);
+    }
+    http_chunk_printf(c, "audio_track_switch_seconds_sum %.4f\naudio_track_switch_seconds_count %u\n",
+                      p->switch_total_us / 1e6, (unsigned)p->switch_count);
+}
+
+static void put_commands(http_chunk_t *c)
+{
+    audio_cmd_stats_t st[AUDIO_CMD_MAX];
+    for (int t = 0; t < AUDIO_CMD_MAX; t++) audio_manager_get_cmd_stats(t, &st[t]);
+
+    help(c, "audio_commands_total", "counter", "Transport commands handled by the control task.");
+    for (int t = 0; t < AUDIO_CMD_MAX; t++) {
+        http_chunk_printf(c, "audio_commands_total{cmd=\"%s\"} %u\n",
+                          audio_manager_cmd_name(t), (unsigned)st[t].count);
+    }
+    help(c, "audio_commands_coalesced_total", "counter", "Queued next/previous commands merged into a single skip.");
+    for (int t = 0; t < AUDIO_CMD_MAX; t++) {
+        if (st[t].coalesced == 0) continue;
+        http_chunk_printf(c, "audio_commands_coalesced_total{cmd=\"%s\"} %u\n",
+                          audio_manager_cmd_name(t), (unsigned)st[t].coalesced);
+    }
+    help(c, "audio_command_latency_max_seconds", "gauge", "Worst queue-to-done latency per command.");
+    for (int t = 0; t < AUDIO_CMD_MAX; t++) {
+        http_chunk_printf(c, "audio_command_latency_max_seconds{cmd=\"%s\"} %.6f\n",
+                          audio_manager_cmd_name(t), st[t].max_us / 1e6);
+    }
+
+    audio_rsp_stats_t rsp;
+    audio_manager_get_rsp_stats(&rsp);
+    help(c, "audio_tracks_total", "counter", "Tracks opened, by resampler path.");
+    http_chunk_printf(c, "audio_tracks_total{path=\"bypassed\"} %u\naudio_tracks_total{path=\"resampled\"} %u\n",
+                      (unsigned)rsp.bypassed_tracks, (unsigned)rsp.resampled_tracks);
+    help(c, "audio_played_seconds_total", "counter", "Playback time, by resampler path.");
+    http_chunk_printf(c, "audio_played_seconds_total{path=\"bypassed\"} %.3f\n"
+                      "audio_played_seconds_total{path=\"resampled\"} %.3f\n",
+                      rsp.bypassed_ms / 1e3, rsp.resampled_ms / 1e3);
+    help(c, "audio_eq_cycles_per_sample_band", "gauge", "Measured equaliser cost.");
+    http_chunk_printf(c, "audio_eq_cycles_per_sample_band %u\n", (unsigned)audio_manager_get_eq_cycles());
+}
+
+static void put_sd(http_chunk_t *c)
+{
+    sd_readahead_stats_t st;
+    sd_readahead_get_stats(&st);
+    help(c, "sd_readahead_ring_bytes", "gauge", "Read-ahead ring size.");
+    http_chunk_printf(c, "sd_readahead_ring_bytes %u\n", (unsigned)st.ring_size);
+    help(c, "sd_readahead_fill_bytes", "gauge", "Bytes buffered ahead of the decoder.");
+    http_chunk_printf(c, "sd_readahead_fill_bytes %u\n", (unsigned)st.fill);
+    help(c, "sd_readahead_stalls_total", "counter", "Decoder reads that had to wait for the card.");
+    http_chunk_printf(c, "sd_readahead_stalls_total %u\n", (unsigned)st.stalls);
+    help(c, "sd_readahead_stall_seconds_total", "counter", "Time the decoder waited for the card.");
+    http_chunk_printf(c, "sd_readahead_stall_seconds_total %.3f\n", st.stall_us / 1e6);
+    help(c, "sd_readahead_refill_bytes_total", "counter", "Bytes read from the card by the read-ahead task.");
+    http_chunk_printf(c, "sd_readahead_refill_bytes_total %llu\n", (unsigned long long)st.refill_bytes);
+    help(c, "sd_readahead_refill_seconds_total", "counter", "Time spent in card reads.");
+    http_chunk_printf(c, "sd_readahead_refill_seconds_total %.3f\n", st.refill_us / 1e6);
+}
+
+static void put_bt(http_chunk_t *c)
+{
+    bt_connect_stats_t st;
+    bt_control_get_stats(&st);
+    help(c, "bt_connected", "gauge", "1 while the A2DP link to the sink is up.");
+    http_chunk_printf(c, "bt_connected %d\n", bt_control_is_connected() ? 1 : 0);
+    help(c, "bt_connects_total", "counter", "A2DP connections, by how the sink was reached.");
+    http_chunk_printf(c, "bt_connects_total{method=\"known\"} %u\nbt_connects_total{method=\"inquiry\"} %u\n",
+                      (unsigned)st.page_connects, (unsigned)(st.connects - st.page_connects));
+    help(c, "bt_page_failures_total", "counter", "Known sink addresses that did not answer a page.");
+    http_chunk_printf(c, "bt_page_failures_total %u\n", (unsigned)st.page_failures);
+    help(c, "bt_inquiries_total", "counter", "Inquiries started.");
+    http_chunk_printf(c, "bt_inquiries_total %u\n", (unsigned)st.inquiries);
+    help(c, "bt_sink_switches_total", "counter", "Hand-overs to another sink requested by the user.");
+    http_chunk_printf(c, "bt_sink_switches_total %u\n", (unsigned)st.switches);
+    help(c, "bt_connect_seconds", "summary", "Time from boot or link loss to the A2DP connection.");
+    http_chunk_printf(c, "bt_connect_seconds_sum %.3f\nbt_connect_seconds_count %u\n",
+                      st.total_connect_ms / 1e3, (unsigned)st.connects);
+    help(c, "bt_connect_last_seconds", "gauge", "Duration of the last (re)connection.");
+    http_chunk_printf(c, "bt_connect_last_seconds %.3f\n", st.last_connect_ms / 1e3);
+    help(c, "bt_connect_max_seconds", "gauge", "Longest (re)connection since boot.");
+    http_chunk_printf(c, "bt_connect_max_seconds %.3f\n", st.max_connect_ms / 1e3);
+}
+
+static void put_link(http_chunk_t *c)
+{
+    link_q_stats_t st;
+    audio_manager_get_link_stats(&st);
+    help(c, "bt_link_level", "gauge", "A2DP link state: 0 good, 1 degraded, 2 congested.");
+    http_chunk_printf(c, "bt_link_level %d\n", (int)st.level);
+    help(c, "bt_link_windows_total", "counter", "One-second evaluation windows while streaming, by link state.");
+    for (int i = 0; i < LINK_Q_LEVELS; i++) {
+        http_chunk_printf(c, "bt_link_windows_total{level=\"%s\"} %u\n",
+                          link_quality_level_name(i), (unsigned)st.level_windows[i]);
+    }
+    help(c, "bt_link_transitions_total", "counter", "Link state changes.");
+    http_chunk_printf(c, "bt_link_transitions_total %u\n", (unsigned)st.transitions);
+    help(c, "bt_link_dropouts_total", "counter", "Windows where the A2DP writer ran dry.");
+    http_chunk_printf(c, "bt_link_dropouts_total %u\n", (unsigned)st.dropouts);
+    help(c, "bt_link_send_ratio", "gauge", "Bytes taken by the A2DP stack over the last window, relative to real time.");
+    http_chunk_printf(c, "bt_link_send_ratio %.2f\n", st.send_pct / 100.0);
+    help(c, "bt_link_send_ratio_min", "gauge", "Lowest send ratio since boot.");
+    http_chunk_printf(c, "bt_link_send_ratio_min %.2f\n", st.send_pct_min / 100.0);
+    help(c, "bt_link_queue_ratio", "gauge", "Fill of the ring in front of the A2DP writer.");
+    http_chunk_printf(c, "bt_link_queue_ratio %.2f\n", st.queue_pct / 100.0);
+    if (st.rssi_delta != LINK_Q_RSSI_UNKNOWN) {
+        help(c, "bt_link_rssi_delta_db", "gauge", "Signal relative to the controller's golden receive range.");
+        http_chunk_printf(c, "bt_link_rssi_delta_db %d\n", st.rssi_delta);
+        help(c, "bt_link_rssi_delta_min_db", "gauge", "Weakest signal since boot, relative to the golden range.");
+        http_chunk_printf(c, "bt_link_rssi_delta_min_db %d\n", st.rssi_delta_min);
+    }
+    help(c, "http_paced_sends_total", "counter", "HTTP sends delayed to leave airtime to the A2DP link.");
+    http_chunk_printf(c, "http_paced_sends_total %u\n", (unsigned)http_chunk_paced_count());
+}
+
+static void put_system(http_chunk_t *c)
+{
+    help(c, "task_stack_free_min_bytes", "gauge", "Stack high-water mark (smallest free stack seen).");
+    for (size_t i = 0; i < sizeof(watched_tasks) / sizeof(watched_tasks[0]); i++) {
+        TaskHandle_t t = xTaskGetHandle(watched_tasks[i]);
+        if (!t) continue;
+        http_chunk_printf(c, "task_stack_free_min_bytes{task=\"%s\"} %u\n", watched_tasks[i],
+                          (unsigned)uxTaskGetStackHighWaterMark(t));
+    }
+    help(c, "heap_free_bytes", "gauge", "Free heap by memory type.");
+    http_chunk_printf(c, "heap_free_bytes{type=\"internal\"} %u\nheap_free_bytes{type=\"spiram\"} %u\n",
+                      (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                      (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    help(c, "heap_free_min_bytes", "gauge", "Lowest free heap since boot by memory type.");
+    http_chunk_printf(c, "heap_free_min_bytes{type=\"internal\"} %u\nheap_free_min_bytes{type=\"spiram\"} %u\n",
+                      (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+                      (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+    help(c, "memory_subsystem_bytes", "gauge", "Heap attributed to each subsystem.");
+    for (int s = 0; s < MEM_SUBSYS_MAX; s++) {
+        mem_budget_entry_t e;
+        mem_budget_get(s, &e);
+        http_chunk_printf(c, "memory_subsystem_bytes{subsystem=\"%s\"} %u\n", e.name, (unsigned)e.bytes);
+    }
+    help(c, "heap_largest_free_block_bytes", "gauge", "Largest allocatable block by memory type.");
+    http_chunk_printf(c, "heap_largest_free_block_bytes{type=\"internal\"} %u\n"
+                      "heap_largest_free_block_bytes{type=\"spiram\"} %u\n",
+                      (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+                      (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+    help(c, "uptime_seconds", "counter", "Time since boot.");
+    http_chunk_printf(c, "uptime_seconds %.1f\n", esp_timer_get_time() / 1e6);
+}
+
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    audio_pipeline_stats_t pipe;
+    audio_manager_get_pipeline_stats(&pipe);
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    http_chunk_t *c = http_chunk_begin(req);
+    if (!c) return httpd_resp_send_500(req);
+    put_pipeline(c, &pipe);
+    put_commands(c);
+    put_sd(c);
+    put_bt(c);
+    put_link(c);
+    put_system(c);
+    size_t sent;
+    esp_err_t err = http_chunk_end(c, &sent);
+    if (err != ESP_OK) ESP_LOGW(TAG, "/metrics aborted after %u bytes", (unsigned)sent);
+    return err;
+}
+
+esp_err_t metrics_register(httpd_handle_t server)
+{
+    httpd_uri_t uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_handler,
+    };
+    return httpd_register_uri_handler(server, &uri);
+}
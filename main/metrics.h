@@ -0,0 +1,22 @@
+// metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enregistre le point d'accès /metrics (format texte Prometheus) :
+ *        pipeline audio, commandes, carte SD, tâches et mémoire.
+ */
+esp_err_t metrics_register(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,269 @@
+// mp3_frame.c
+#include "mp3_frame.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const uint16_t bitrate_v1[16] = {
+    0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0
+};
+static const uint16_t bitrate_v2[16] = {
+    0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0
+};
+static const uint32_t sample_rate_v1[3] = { 44100, 48000, 32000 };
+
+bool mp3_frame_parse_header(const uint8_t *hdr, mp3_frame_info_t *info)
+{
+    if (hdr[0] != 0xFF || (hdr[1] & 0xE0) != 0xE0) return false;
+
+    int version_bits = (hdr[1] >> 3) & 0x03;
+    int layer_bits = (hdr[1] >> 1) & 0x03;
+    int bitrate_idx = (hdr[2] >> 4) & 0x0F;
+    int rate_idx = (hdr[2] >> 2) & 0x03;
+    int padding = (hdr[2] >> 1) & 0x01;
+    int mode = (hdr[3] >> 6) & 0x03;
+
+    // Layer III uniquement, version reservee, bitrate libre/invalide exclus
+    if (version_bits == 1 || layer_bits != 1) return false;
+    if (bitrate_idx == 0 || bitrate_idx == 15 || rate_idx == 3) return false;
+
+    mp3_frame_info_t fi;
+    fi.version = version_bits == 3 ? 1 : (version_bits == 2 ? 2 : 25);
+    fi.sample_rate = sample_rate_v1[rate_idx];
+    if (fi.version == 2) fi.sample_rate /= 2;
+    if (fi.version == 25) fi.sample_rate /= 4;
+    fi.bitrate_kbps = fi.version == 1 ? bitrate_v1[bitrate_idx] : bitrate_v2[bitrate_idx];
+    fi.channels = mode == 3 ? 1 : 2;
+    fi.samples_per_frame = fi.version == 1 ? 1152 : 576;
+    fi.frame_bytes = (fi.samples_per_frame / 8) * fi.bitrate_kbps * 1000 / fi.sample_rate + padding;
+    if (info) *info = fi;
+    return true;
+}
+
+size_t mp3_frame_id3v2_size(const uint8_t *buf, size_t len)
+{
+    if (len < 10 || memcmp(buf, "ID3", 3) != 0) return 0;
+    if ((buf[6] | buf[7] | buf[8] | buf[9]) & 0x80) return 0;
+    size_t size = ((size_t)buf[6] << 21) | ((size_t)buf[7] << 14) |
+                  ((size_t)buf[8] << 7) | (size_t)buf[9];
+    size += 10;
+    if (buf[5] & 0x10) size += 10; // footer present
+    return size;
+}
+
+// Copie un texte ID3 en ASCII : les octets nuls de l'UTF-16 sont ignorés
+static size_t id3_text(const uint8_t *p, size_t len, char *out, size_t size)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len && n + 1 < size; i++) {
+        if (p[i] >= 0x20 && p[i] < 0x7F) out[n++] = (char)p[i];
+    }
+    out[n] = '\0';
+    return n;
+}
+
+size_t mp3_frame_id3v2_frame_size(const uint8_t *hdr, uint8_t version)
+{
+    if (version == 4) {
+        return ((size_t)hdr[4] << 21) | ((size_t)hdr[5] << 14) | ((size_t)hdr[6] << 7) | hdr[7];
+    }
+    return ((size_t)hdr[4] << 24) | ((size_t)hdr[5] << 16) | ((size_t)hdr[6] << 8) | hdr[7];
+}
+
+bool mp3_frame_id3v2_frame_gain(const uint8_t *f, size_t size, float *gain_db)
+{
+    if (memcmp(f, "TXXX", 4) != 0 || size < 2) return false;
+    // encodage, description terminée par un nul, puis la valeur
+    const uint8_t *p = f + 11;
+    size_t rest = size - 1;
+    size_t unit = (f[10] == 1 || f[10] == 2) ? 2 : 1;
+    size_t d = 0;
+    while (d + unit <= rest && (p[d] != 0 || (unit == 2 && p[d + 1] != 0))) d += unit;
+    char desc[32], value[24];
+    id3_text(p, d, desc, sizeof(desc));
+    if (strcasecmp(desc, "REPLAYGAIN_TRACK_GAIN") != 0 || d + unit > rest) return false;
+    id3_text(p + d + unit, rest - d - unit, value, sizeof(value));
+    char *end;
+    float g = strtof(value, &end);
+    if (end == value) return false;
+    *gain_db = g;
+    return true;
+}
+
+bool mp3_frame_id3v2_replaygain(const uint8_t *buf, size_t len, float *gain_db, size_t *resume)
+{
+    *resume = 0;
+    size_t tag = mp3_frame_id3v2_size(buf, len);
+    if (tag == 0 || (buf[3] != 3 && buf[3] != 4)) return false;
+    if (buf[5] & 0x10) tag -= 10;   // le pied de tag ne contient pas de trame
+    bool syncsafe = buf[3] == 4;
+
+    size_t pos = 10;
+    if (buf[5] & 0x40) { // en-tête étendu
+        if (pos + 4 > len) return false;
+        size_t ext = ((size_t)buf[pos] << 24) | ((size_t)buf[pos + 1] << 16) |
+                     ((size_t)buf[pos + 2] << 8) | buf[pos + 3];
+        if (syncsafe) {
+            ext = ((size_t)buf[pos] << 21) | ((size_t)buf[pos + 1] << 14) |
+                  ((size_t)buf[pos + 2] << 7) | buf[pos + 3];
+        } else {
+            ext += 4;
+        }
+        pos += ext;
+    }
+
+    while (pos + 10 <= tag) {
+        if (pos + 10 > len) {
+            *resume = pos;  // en-tête suivant hors du buffer
+            return false;
+        }
+        const uint8_t *f = buf + pos;
+        if (f[0] == 0) return false;    // remplissage : plus de trame
+        size_t size = mp3_frame_id3v2_frame_size(f, buf[3]);
+        if (size == 0 || pos + 10 + size > tag) return false;
+        if (pos + 10 + size > len) {
+            // trame coupée par la fin du buffer (une pochette, souvent) :
+            // le TXXX peut venir après
+            *resume = pos;
+            return false;
+        }
+        if (mp3_frame_id3v2_frame_gain(f, size, gain_db)) return true;
+        pos += 10 + size;
+    }
+    return false;
+}
+
+int mp3_frame_find(const uint8_t *buf, size_t len, mp3_frame_info_t *info)
+{
+    mp3_frame_info_t fi, next;
+    for (size_t i = 0; i + MP3_FRAME_HEADER_LEN <= len; i++) {
+        if (buf[i] != 0xFF || !mp3_frame_parse_header(buf + i, &fi)) continue;
+        size_t n = i + fi.frame_bytes;
+        if (n + MP3_FRAME_HEADER_LEN <= len) {
+            if (!mp3_frame_parse_header(buf + n, &next) ||
+                next.sample_rate != fi.sample_rate) {
+                continue;
+            }
+        }
+        if (info) *info = fi;
+        return (int)i;
+    }
+    return -1;
+}
+
+static size_t xing_offset(const mp3_frame_info_t *info)
+{
+    size_t side_info;
+    if (info->version == 1) {
+        side_info = info->channels == 1 ? 17 : 32;
+    } else {
+        side_info = info->channels == 1 ? 9 : 17;
+    }
+    return MP3_FRAME_HEADER_LEN + side_info;
+}
+
+bool mp3_frame_is_vbr_header(const uint8_t *frame, size_t len, const mp3_frame_info_t *info)
+{
+    size_t off = xing_offset(info);
+    if (off + 4 <= len &&
+        (memcmp(frame + off, "Xing", 4) == 0 || memcmp(frame + off, "Info", 4) == 0)) {
+        return true;
+    }
+    off = MP3_FRAME_HEADER_LEN + 32;
+    return off + 4 <= len && memcmp(frame + off, "VBRI", 4) == 0;
+}
+
+static uint32_t be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint32_t be_n(const uint8_t *p, int n)
+{
+    uint32_t v = 0;
+    while (n-- > 0) v = v << 8 | *p++;
+    return v;
+}
+
+/*
+ * VBRI : entries tailles (octets) de groupes de frames_per_entry trames.
+ * Conversion en table Xing par interpolation dans chaque groupe.
+ */
+static bool parse_vbri(const uint8_t *v, size_t len, mp3_vbr_info_t *out)
+{
+    if (len < 26) return false;
+    out->bytes = be32(v + 10);
+    out->frames = be32(v + 14);
+    int entries = (v[18] << 8) | v[19];
+    int scale = (v[20] << 8) | v[21];
+    int entry_size = (v[22] << 8) | v[23];
+    int frames_per_entry = (v[24] << 8) | v[25];
+    if (entries == 0 || entry_size < 1 || entry_size > 4 || frames_per_entry == 0 ||
+        out->frames == 0 || out->bytes == 0 || 26 + (size_t)entries * entry_size > len) {
+        return true;
+    }
+
+    const uint8_t *table = v + 26;
+    uint64_t done_bytes = 0;
+    uint32_t done_frames = 0;
+    int e = 0;
+    for (int pct = 0; pct < 100; pct++) {
+        uint32_t target = (uint32_t)((uint64_t)out->frames * pct / 100);
+        uint32_t size = 0;
+        while (e < entries) {
+            size = be_n(table + e * entry_size, entry_size) * scale;
+            if (done_frames + frames_per_entry > target) break;
+            done_frames += frames_per_entry;
+            done_bytes += size;
+            e++;
+        }
+        uint64_t pos = done_bytes;
+        if (e < entries) pos += (uint64_t)size * (target - done_frames) / frames_per_entry;
+        uint32_t t = (uint32_t)(pos * 256 / out->bytes);
+        out->toc[pct] = t > 255 ? 255 : t;
+    }
+    out->has_toc = true;
+    return true;
+}
+
+bool mp3_frame_parse_vbr(const uint8_t *frame, size_t len, const mp3_frame_info_t *info,
+                         mp3_vbr_info_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    size_t off = MP3_FRAME_HEADER_LEN + 32;
+    if (off + 4 <= len && memcmp(frame + off, "VBRI", 4) == 0) {
+        return parse_vbri(frame + off, len - off, out);
+    }
+
+    off = xing_offset(info);
+    if (off + 8 > len ||
+        (memcmp(frame + off, "Xing", 4) != 0 && memcmp(frame + off, "Info", 4) != 0)) {
+        return false;
+    }
+    uint32_t flags = be32(frame + off + 4);
+    off += 8;
+    if ((flags & 0x1) && off + 4 <= len) {
+        out->frames = be32(frame + off);
+        off += 4;
+    }
+    if ((flags & 0x2) && off + 4 <= len) {
+        out->bytes = be32(frame + off);
+        off += 4;
+    }
+    if ((flags & 0x4) && off + 100 <= len) {
+        memcpy(out->toc, frame + off, 100);
+        out->has_toc = true;
+    }
+    if (flags & 0x4) off += 100;
+    if (flags & 0x8) off += 4;  // indicateur de qualite
+
+    // extension LAME (aussi ecrite par ffmpeg) : delai et remplissage sur 2 x 12 bits
+    const uint8_t *lame = frame + off;
+    if (off + 24 <= len && (memcmp(lame, "LAME", 4) == 0 || memcmp(lame, "Lavf", 4) == 0 ||
+                            memcmp(lame, "Lavc", 4) == 0)) {
+        out->enc_delay = (uint16_t)(lame[21] << 4 | lame[22] >> 4);
+        out->enc_padding = (uint16_t)((lame[22] & 0x0F) << 8 | lame[23]);
+        out->has_lame = true;
+    }
+    return true;
+}
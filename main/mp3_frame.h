@@ -0,0 +1,98 @@
+// mp3_frame.h
+#ifndef MP3_FRAME_H
+#define MP3_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MP3_FRAME_HEADER_LEN 4
+#define MP3_DECODER_DELAY 529       // retard propre au décodeur (banc de filtres), en échantillons
+
+typedef struct {
+    int version;            // 1 = MPEG1, 2 = MPEG2, 25 = MPEG2.5
+    int sample_rate;
+    int channels;
+    int bitrate_kbps;
+    int samples_per_frame;
+    int frame_bytes;
+} mp3_frame_info_t;
+
+/**
+ * Contenu d'un en-tête VBR : nombre de trames, octets et table de
+ * recherche. toc[i] est la position, en 1/256 de bytes, du début de la
+ * trame à i % de la durée (format Xing ; la table VBRI y est convertie).
+ */
+typedef struct {
+    uint32_t frames;        // 0 si absent
+    uint32_t bytes;         // 0 si absent
+    bool has_toc;
+    uint8_t toc[100];
+    bool has_lame;          // extension LAME : délai et remplissage de l'encodeur
+    uint16_t enc_delay;     // échantillons ajoutés en tête par l'encodeur
+    uint16_t enc_padding;   // échantillons ajoutés en fin de la dernière trame
+} mp3_vbr_info_t;
+
+/**
+ * @brief Décode un en-tête de trame MPEG Layer III (4 octets).
+ * @return true si l'en-tête est valide.
+ */
+bool mp3_frame_parse_header(const uint8_t *hdr, mp3_frame_info_t *info);
+
+/**
+ * @brief Taille totale du tag ID3v2 en début de buffer (0 si absent).
+ */
+size_t mp3_frame_id3v2_size(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Lit le gain ReplayGain de la piste (TXXX REPLAYGAIN_TRACK_GAIN)
+ *        dans le tag ID3v2.3/2.4 en début de buffer.
+ * @param resume reçoit, si le tag continue au-delà du buffer sans que le
+ *        gain ait été trouvé, la position depuis le début du tag de la
+ *        première trame qui ne tient pas ; 0 sinon.
+ * @return true si le gain a été trouvé dans la partie du tag présente.
+ */
+bool mp3_frame_id3v2_replaygain(const uint8_t *buf, size_t len, float *gain_db, size_t *resume);
+
+/**
+ * @brief Taille du corps d'une trame ID3v2 d'après son en-tête (10 octets)
+ *        et la version majeure du tag (3 ou 4).
+ */
+size_t mp3_frame_id3v2_frame_size(const uint8_t *hdr, uint8_t version);
+
+/**
+ * @brief Gain d'une trame ID3v2 entière (en-tête puis size octets de
+ *        corps), si c'est un TXXX REPLAYGAIN_TRACK_GAIN.
+ */
+bool mp3_frame_id3v2_frame_gain(const uint8_t *frame, size_t size, float *gain_db);
+
+/**
+ * @brief Cherche la première trame valide dans le buffer.
+ *        Si la place le permet, la trame suivante doit aussi être valide.
+ * @return décalage de la trame, ou -1 si aucune trame trouvée.
+ */
+int mp3_frame_find(const uint8_t *buf, size_t len, mp3_frame_info_t *info);
+
+/**
+ * @brief Indique si la trame est un en-tête VBR (Xing, Info ou VBRI)
+ *        qui ne contient pas d'audio.
+ */
+bool mp3_frame_is_vbr_header(const uint8_t *frame, size_t len, const mp3_frame_info_t *info);
+
+/**
+ * @brief Lit l'en-tête VBR (Xing, Info ou VBRI) de la trame, et l'extension
+ *        LAME qui suit un en-tête Xing/Info si elle est présente.
+ * @return false si la trame n'en contient pas.
+ */
+bool mp3_frame_parse_vbr(const uint8_t *frame, size_t len, const mp3_frame_info_t *info,
+                         mp3_vbr_info_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MP3_FRAME_H
@@ -1,7 +1,17 @@
 #ifndef PATH_CONFIG_H
 #define PATH_CONFIG_H
 
+// Remplaçable à la compilation (build hôte : répertoire de test)
+#ifndef SD_MOUNT_POINT
 #define SD_MOUNT_POINT "/sdcard"
+#endif
 #define MP3_DIR SD_MOUNT_POINT "/mp3"
+#define TRACK_INDEX_PATH SD_MOUNT_POINT "/mp3.idx"
+#define REPLAYGAIN_CACHE_PATH SD_MOUNT_POINT "/mp3.rg"
+#define SEEK_INDEX_DIR SD_MOUNT_POINT "/mp3.seek"
+#define HTTP_WWW_DIR SD_MOUNT_POINT "/www"
+
+// MP3_DIR + '/' + nom long FAT (255) + '\0', arrondi
+#define TRACK_PATH_MAX 320
 
 #endif // PATH_CONFIG_H
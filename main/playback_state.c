@@ -0,0 +1,145 @@
+// playback_state.c
+#include "playback_state.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+
+#ifndef CONFIG_PLAYBACK_STATE_SAVE_SEC
+#define CONFIG_PLAYBACK_STATE_SAVE_SEC 30
+#endif
+
+#define STATE_NAMESPACE "player"
+#define STATE_KEY_POS "pos"
+#define STATE_KEY_TRACK "track"
+#define STATE_VERSION 2
+
+// Partie écrite à chaque sauvegarde, le nom n'est réécrit qu'au changement de piste
+typedef struct {
+    uint32_t version;
+    uint32_t seed;
+    uint32_t prev_seed;
+    uint32_t track_count;
+    uint32_t generation;
+    uint32_t offset;
+} state_blob_t;
+
+static const char *TAG = "playback_state";
+static SemaphoreHandle_t lock = NULL;
+static playback_state_t state;          // état courant
+static state_blob_t saved_blob;         // dernier état écrit
+static char saved_track[TRACK_PATH_MAX];
+static int64_t last_write_us = 0;
+
+static bool take(void)
+{
+    if (!lock && !(lock = xSemaphoreCreateMutex())) return false;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    return true;
+}
+
+esp_err_t playback_state_load(playback_state_t *out)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(STATE_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+
+    state_blob_t blob;
+    size_t len = sizeof(blob);
+    size_t name_len = sizeof(out->track);
+    err = nvs_get_blob(nvs, STATE_KEY_POS, &blob, &len);
+    if (err == ESP_OK) err = nvs_get_str(nvs, STATE_KEY_TRACK, out->track, &name_len);
+    nvs_close(nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND) return ESP_ERR_NOT_FOUND;
+    if (err != ESP_OK) return err;
+    if (len != sizeof(blob) || blob.version != STATE_VERSION) return ESP_ERR_INVALID_VERSION;
+
+    out->seed = blob.seed;
+    out->prev_seed = blob.prev_seed;
+    out->track_count = blob.track_count;
+    out->generation = blob.generation;
+    out->offset = blob.offset;
+    if (take()) {
+        // l'ordre courant est celui de la playlist, déjà tirée : seule la
+        // piste est reprise, l'ordre le sera par playlist_manager_restore()
+        strlcpy(state.track, out->track, sizeof(state.track));
+        state.offset = out->offset;
+        saved_blob = blob;
+        strlcpy(saved_track, out->track, sizeof(saved_track));
+        xSemaphoreGive(lock);
+    }
+    return ESP_OK;
+}
+
+void playback_state_set_order(uint32_t seed, uint32_t prev_seed, uint32_t track_count,
+                              uint32_t generation)
+{
+    if (!take()) return;
+    state.seed = seed;
+    state.prev_seed = prev_seed;
+    state.track_count = track_count;
+    state.generation = generation;
+    xSemaphoreGive(lock);
+}
+
+void playback_state_set_track(const char *path, uint32_t offset)
+{
+    if (!path) return;
+    size_t dir_len = strlen(MP3_DIR);
+    if (strncmp(path, MP3_DIR "/", dir_len + 1) == 0) path += dir_len + 1;
+    if (!take()) return;
+    strlcpy(state.track, path, sizeof(state.track));
+    state.offset = offset;
+    xSemaphoreGive(lock);
+}
+
+void playback_state_set_offset(uint32_t offset)
+{
+    if (!take()) return;
+    state.offset = offset;
+    xSemaphoreGive(lock);
+}
+
+void playback_state_flush(bool force)
+{
+#if !CONFIG_PLAYBACK_RESUME
+    return;
+#endif
+    int64_t now = esp_timer_get_time();
+    if (!force && now - last_write_us < CONFIG_PLAYBACK_STATE_SAVE_SEC * 1000000LL) return;
+    if (!take()) return;
+    state_blob_t blob = {
+        .version = STATE_VERSION,
+        .seed = state.seed,
+        .prev_seed = state.prev_seed,
+        .track_count = state.track_count,
+        .generation = state.generation,
+        .offset = state.offset,
+    };
+    bool blob_changed = memcmp(&blob, &saved_blob, sizeof(blob)) != 0;
+    bool track_changed = strcmp(state.track, saved_track) != 0;
+    char track[TRACK_PATH_MAX];
+    strlcpy(track, state.track, sizeof(track));
+    xSemaphoreGive(lock);
+    if ((!blob_changed && !track_changed) || track[0] == '\0') return;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(STATE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        if (track_changed) err = nvs_set_str(nvs, STATE_KEY_TRACK, track);
+        if (err == ESP_OK && blob_changed) err = nvs_set_blob(nvs, STATE_KEY_POS, &blob, sizeof(blob));
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    last_write_us = now;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Saving playback state failed: %s", esp_err_to_name(err));
+        return;
+    }
+    saved_blob = blob;
+    strlcpy(saved_track, track, sizeof(saved_track));
+    ESP_LOGD(TAG, "Saved %s @%u", track, (unsigned)blob.offset);
+}
@@ -0,0 +1,60 @@
+// playback_state.h
+#ifndef PLAYBACK_STATE_H
+#define PLAYBACK_STATE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "path_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * État de lecture conservé en NVS pour reprendre après un redémarrage.
+ */
+typedef struct {
+    uint32_t seed;              // graine de la permutation aléatoire
+    uint32_t prev_seed;         // graine du cycle précédent (jointure sans répétition)
+    uint32_t track_count;       // nombre de pistes permutées
+    uint32_t generation;        // empreinte de l'index des pistes
+    uint32_t offset;            // octet de la piste où reprendre
+    char track[TRACK_PATH_MAX]; // piste courante, relative à MP3_DIR
+} playback_state_t;
+
+/**
+ * @brief Lit l'état enregistré.
+ * @return ESP_ERR_NOT_FOUND s'il n'y en a pas.
+ */
+esp_err_t playback_state_load(playback_state_t *out);
+
+/**
+ * @brief Mémorise la permutation courante (écrite au prochain flush).
+ */
+void playback_state_set_order(uint32_t seed, uint32_t prev_seed, uint32_t track_count,
+                              uint32_t generation);
+
+/**
+ * @brief Mémorise la piste qui démarre (chemin complet ou relatif à MP3_DIR).
+ */
+void playback_state_set_track(const char *path, uint32_t offset);
+
+/**
+ * @brief Mémorise la position dans la piste courante.
+ */
+void playback_state_set_offset(uint32_t offset);
+
+/**
+ * @brief Écrit l'état en NVS s'il a changé : au plus une écriture toutes les
+ *        CONFIG_PLAYBACK_STATE_SAVE_SEC secondes, sauf si force.
+ *        La piste et la position sont dans deux clés distinctes : une simple
+ *        avance de la position ne réécrit pas le nom.
+ */
+void playback_state_flush(bool force);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLAYBACK_STATE_H
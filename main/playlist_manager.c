@@ -2,145 +2,451 @@
 #include "playlist_manager.h"
 #include <stdio.h>
 #include <string.h>
-#include <dirent.h>
 #include <stdlib.h>
 #include "esp_log.h"
 #include "driver/sdmmc_host.h"
 #include "sdmmc_cmd.h"
 #include "esp_vfs_fat.h"
 #include "esp_random.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "path_config.h"
+#include "track_index.h"
+#include "library_scanner.h"
+#include "playback_state.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
 
-#define MAX_TRACKS 512
+#define ORDER_MIN_CAPACITY 64
+#define SPREAD_LOOKAHEAD 16
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+// Fichiers ouverts en meme temps au pire : piste courante et piste suivante
+// (track_reader), index de seek, cache ReplayGain, track_index.tmp et un
+// fichier du site web, plus une marge. ~550 octets chacun, pris au montage.
+#define SD_MAX_OPEN_FILES 8
+
+#ifndef CONFIG_PLAYLIST_HISTORY_LEN
+#define CONFIG_PLAYLIST_HISTORY_LEN 50
+#endif
+#ifndef CONFIG_PLAYLIST_NO_REPEAT
+#define CONFIG_PLAYLIST_NO_REPEAT 8
+#endif
 
 static const char *TAG = "playlist_mgr";
-static char *track_list[MAX_TRACKS];
-static size_t shuffle_order[MAX_TRACKS];
+static SemaphoreHandle_t playlist_lock = NULL;
+static track_id_t *shuffle_order = NULL;    // position -> piste
+static track_id_t *order_pos = NULL;        // piste -> position (permutation inverse)
+static size_t order_capacity = 0;
 static size_t track_count = 0;
 static size_t current_index = 0;
+static char next_path[TRACK_PATH_MAX];
+static char prev_path[TRACK_PATH_MAX];
+static char current_path[TRACK_PATH_MAX];
+static uint32_t shuffle_seed = 0;
+static uint32_t prev_seed = 0;              // graine du cycle precedent, 0 au premier
+static uint32_t rng_state = 0;
 
-static esp_err_t scan_directory(void) {
-    DIR *dir = opendir(MP3_DIR);
-    if (!dir) {
-        ESP_LOGE(TAG, "Failed to open dir: %s", MP3_DIR);
-        return ESP_FAIL;
-    }
-    struct dirent *entry;
-    while ((entry = readdir(dir)) && track_count < MAX_TRACKS) {
-        if (strstr(entry->d_name, ".mp3")) {
-            size_t len = strlen(entry->d_name) + strlen(MP3_DIR) + 2;
-            track_list[track_count] = malloc(len);
-            snprintf(track_list[track_count], len, "%s/%s", MP3_DIR, entry->d_name);
-            track_count++;
+// Pistes rendues par get_next(), la plus ancienne en premier (anneau)
+static track_id_t history[CONFIG_PLAYLIST_HISTORY_LEN];
+static size_t history_start = 0;
+static size_t history_len = 0;
+static size_t history_cur = 0;              // piste courante dans l'historique
+
+static inline void lock(void) {
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+}
+
+static inline void unlock(void) {
+    xSemaphoreGive(playlist_lock);
+}
+
+static const char *track_path(size_t id, char *buf, size_t size) {
+    snprintf(buf, size, "%s/%s", MP3_DIR, track_index_name(id));
+    return buf;
+}
+
+static track_id_t *grow_ids(track_id_t *ids, size_t cap) {
+    track_id_t *p = heap_caps_realloc(ids, cap * sizeof(track_id_t),
+                                      MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    return p ? p : realloc(ids, cap * sizeof(track_id_t));
+}
+
+// Les identifiants restent en RAM interne, les noms (index) en PSRAM si possible
+static esp_err_t reserve_order(size_t capacity) {
+    if (capacity <= order_capacity) return ESP_OK;
+    size_t cap = order_capacity ? order_capacity : ORDER_MIN_CAPACITY;
+    while (cap < capacity) cap *= 2;
+    track_id_t *order = grow_ids(shuffle_order, cap);
+    if (!order) return ESP_ERR_NO_MEM;
+    shuffle_order = order;
+    track_id_t *pos = grow_ids(order_pos, cap);
+    if (!pos) return ESP_ERR_NO_MEM;
+    order_pos = pos;
+    order_capacity = cap;
+    return ESP_OK;
+}
+
+static inline void set_order(size_t pos, track_id_t id) {
+    shuffle_order[pos] = id;
+    order_pos[id] = pos;
+}
+
+static inline void swap_order(size_t a, size_t b) {
+    track_id_t tmp = shuffle_order[a];
+    shuffle_order[a] = shuffle_order[b];
+    shuffle_order[b] = tmp;
+}
+
+// Tirage uniforme dans [0, n) sans biais de modulo (methode de Lemire)
+static uint32_t bounded(uint32_t n, uint32_t (*next)(void)) {
+    uint64_t m = (uint64_t)next() * n;
+    uint32_t low = (uint32_t)m;
+    if (low < n) {
+        uint32_t threshold = -n % n;
+        while (low < threshold) {
+            m = (uint64_t)next() * n;
+            low = (uint32_t)m;
         }
     }
-    closedir(dir);
-    ESP_LOGI(TAG, "Found %d tracks", track_count);
+    return (uint32_t)(m >> 32);
+}
+
+/*
+ * Nouvelle piste trouvee par le scanner : inseree a une position aleatoire
+ * parmi les pistes pas encore jouees de la permutation courante.
+ */
+static void add_track(size_t id) {
+    lock();
+    if (reserve_order(track_count + 1) == ESP_OK) {
+        size_t pos = current_index + bounded(track_count - current_index + 1, esp_random);
+        if (pos < track_count) set_order(track_count, shuffle_order[pos]);
+        set_order(pos, id);
+        track_count++;
+    }
+    unlock();
+}
+
+static esp_err_t scan_directory(void) {
+    esp_err_t err = track_index_load();
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Index unusable, full scan");
+    }
+    size_t count = track_index_count();
+    if ((err = reserve_order(count)) != ESP_OK) return err;
+    track_count = count;
+    for (size_t i = 0; i < count; i++) {
+        set_order(i, i);
+    }
+
+    // La lecture demarre sur l'index charge, le scanner complete en arriere-plan
+    if ((err = library_scanner_start(add_track)) != ESP_OK) return err;
+    if (!library_scanner_wait_for_tracks(portMAX_DELAY)) return ESP_OK;
+
+    size_t mem = playlist_manager_get_memory_usage();
+    ESP_LOGI(TAG, "Found %d tracks, %u bytes (%u bytes/track)", (int)track_count,
+             (unsigned)mem, (unsigned)(track_count ? mem / track_count : 0));
     return ESP_OK;
 }
 
-static void shuffle_tracks(void) {
-    if (track_count == 0) {
-        current_index = 0;
-        return;
+// xorshift32 : une graine donnée reproduit la même permutation
+static uint32_t rng_next(void) {
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return rng_state = x;
+}
+
+#if CONFIG_PLAYLIST_SHUFFLE_ARTIST_SPREAD
+// Artiste d'une piste : son premier sous-repertoire de MP3_DIR (0 : aucun)
+static uint32_t artist_key(size_t id) {
+    const char *name = track_index_name(id);
+    const char *slash = strchr(name, '/');
+    if (!slash) return 0;
+    uint32_t h = FNV_OFFSET;
+    for (const char *p = name; p < slash; p++) {
+        h ^= (uint8_t)*p;
+        h *= FNV_PRIME;
+    }
+    return h | 1;
+}
+
+/*
+ * Evite deux pistes consecutives du meme artiste : la piste fautive est
+ * echangee avec la premiere des SPREAD_LOOKAHEAD suivantes qui convient.
+ */
+static void spread_artists(void) {
+    uint32_t prev = artist_key(shuffle_order[0]);
+    for (size_t i = 1; i < track_count; i++) {
+        uint32_t cur = artist_key(shuffle_order[i]);
+        size_t end = i + SPREAD_LOOKAHEAD < track_count ? i + SPREAD_LOOKAHEAD : track_count;
+        for (size_t j = i + 1; cur != 0 && cur == prev && j < end; j++) {
+            uint32_t other = artist_key(shuffle_order[j]);
+            if (other != prev) {
+                swap_order(i, j);
+                cur = other;
+            }
+        }
+        prev = cur;
     }
+}
+#endif
+
+// Permutation entierement determinee par la graine (Fisher-Yates sans biais)
+static void build_order(uint32_t seed) {
+    rng_state = seed ? seed : 1;
     for (size_t i = 0; i < track_count; i++) {
         shuffle_order[i] = i;
     }
     for (size_t i = track_count - 1; i > 0; i--) {
-        size_t j = esp_random() % (i + 1);
-        size_t tmp = shuffle_order[i];
-        shuffle_order[i] = shuffle_order[j];
-        shuffle_order[j] = tmp;
+        swap_order(i, bounded(i + 1, rng_next));
     }
+#if CONFIG_PLAYLIST_SHUFFLE_ARTIST_SPREAD
+    spread_artists();
+#endif
+}
+
+/*
+ * Les no_repeat dernieres pistes du cycle precedent ne sont pas rejouees
+ * parmi les no_repeat premieres du nouveau : elles sont echangees avec une
+ * piste du milieu. La fin d'un cycle ne dependant que de sa graine, la
+ * permutation se reconstruit a partir des deux graines.
+ */
+static bool is_recent(track_id_t id, const track_id_t *tail, size_t k) {
+    for (size_t t = 0; t < k; t++) {
+        if (tail[t] == id) return true;
+    }
+    return false;
+}
+
+static void avoid_repeats(uint32_t seed, uint32_t previous) {
+    size_t k = CONFIG_PLAYLIST_NO_REPEAT;
+    if (k > track_count / 4) k = track_count / 4;
+    if (!previous || k == 0) {
+        build_order(seed);
+        return;
+    }
+    track_id_t tail[CONFIG_PLAYLIST_NO_REPEAT > 0 ? CONFIG_PLAYLIST_NO_REPEAT : 1];
+    build_order(previous);
+    memcpy(tail, &shuffle_order[track_count - k], k * sizeof(tail[0]));
+    build_order(seed);
+
+    for (size_t i = 0; i < k; i++) {
+        bool recent = is_recent(shuffle_order[i], tail, k);
+        // quelques tirages dans le milieu, qui contient au plus k pistes recentes
+        for (int tries = 0; recent && tries < 8; tries++) {
+            size_t j = k + bounded(track_count - 2 * k, rng_next);
+            if (!is_recent(shuffle_order[j], tail, k)) {
+                swap_order(i, j);
+                recent = false;
+            }
+        }
+        // rare (petite bibliotheque) : le milieu a toujours une piste qui convient
+        for (size_t j = k; recent && j < track_count - k; j++) {
+            if (!is_recent(shuffle_order[j], tail, k)) {
+                swap_order(i, j);
+                recent = false;
+            }
+        }
+    }
+}
+
+static void shuffle_with_seed(uint32_t seed, uint32_t previous) {
+    shuffle_seed = seed ? seed : 1;
+    prev_seed = previous;
     current_index = 0;
+    if (track_count == 0) return;
+    int64_t t0 = esp_timer_get_time();
+    avoid_repeats(shuffle_seed, prev_seed);
+    for (size_t i = 0; i < track_count; i++) {
+        order_pos[shuffle_order[i]] = i;
+    }
+    ESP_LOGI(TAG, "Shuffled %d tracks in %lld us", (int)track_count,
+             (long long)(esp_timer_get_time() - t0));
+    playback_state_set_order(shuffle_seed, prev_seed, track_count, track_index_generation());
 }
 
+// Nouveau cycle : enchaine sur le precedent sans repetition a la jointure
+static void shuffle_tracks(void) {
+    shuffle_with_seed(esp_random(), shuffle_seed);
+}
+
+static inline track_id_t history_at(size_t i) {
+    return history[(history_start + i) % CONFIG_PLAYLIST_HISTORY_LEN];
+}
+
+// Ajoute une piste apres la courante ; les pistes suivantes de l'historique sont oubliees
+static void history_push(track_id_t id) {
+    if (history_len > 0) history_len = history_cur + 1;
+    if (history_len == CONFIG_PLAYLIST_HISTORY_LEN) {
+        history_start = (history_start + 1) % CONFIG_PLAYLIST_HISTORY_LEN;
+        history_len--;
+    }
+    history[(history_start + history_len) % CONFIG_PLAYLIST_HISTORY_LEN] = id;
+    history_cur = history_len++;
+}
 
 esp_err_t playlist_manager_init(void) {
 esp_err_t err;
     sdmmc_host_t host = SDMMC_HOST_DEFAULT();
     sdmmc_slot_config_t slot = SDMMC_SLOT_CONFIG_DEFAULT();
+#if CONFIG_SD_BUS_4BIT
+    slot.width = 4;
+#else
+    slot.width = 1;
+#endif
+#if CONFIG_SD_BUS_HIGH_SPEED
+    host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+#endif
     esp_vfs_fat_mount_config_t mount_cfg = {
         .format_if_mount_failed = false,
-        .max_files = 5
+        .max_files = SD_MAX_OPEN_FILES
     };
     sdmmc_card_t* card;
     if ((err = esp_vfs_fat_sdmmc_mount(SD_MOUNT_POINT, &host, &slot, &mount_cfg, &card)) != ESP_OK) {
         ESP_LOGE(TAG, "SD mount failed: %s", esp_err_to_name(err));
         return err;
     } else {
-        ESP_LOGI(TAG, "Carte montée");
+        ESP_LOGI(TAG, "Carte montée (%d bit, %d kHz)", slot.width, card->real_freq_khz);
     }
     ESP_LOGI(TAG, "Initializing playlist manager");
+    if (!playlist_lock && !(playlist_lock = xSemaphoreCreateMutex())) return ESP_ERR_NO_MEM;
     esp_err_t scan_err = scan_directory();
     if (scan_err != ESP_OK) return scan_err;
 
+    lock();
     if (track_count == 0) {
+        unlock();
         ESP_LOGW(TAG, "No MP3 files found");
         return ESP_ERR_NOT_FOUND;
     }
-
-    shuffle_tracks();
+    shuffle_with_seed(esp_random(), 0);
+    unlock();
     return ESP_OK;
 }
 
 const char *playlist_manager_get_next(void) {
-    if (track_count == 0) {
-        return NULL;
+    const char *path = NULL;
+    lock();
+    while (history_cur + 1 < history_len && track_index_is_removed(history_at(history_cur + 1))) {
+        history_cur++;
+    }
+    if (history_cur + 1 < history_len) {
+        // revenu en arriere par get_prev() : on rejoue l'historique
+        path = track_path(history_at(++history_cur), next_path, sizeof(next_path));
     }
-    if (current_index >= track_count) {
-        shuffle_tracks();
+    // les pistes retirees par le scanner restent dans l'ordre et sont sautees,
+    // un tour complet au plus si toutes l'ont ete
+    for (size_t tries = 0; !path && tries <= track_count; tries++) {
+        if (current_index >= track_count) {
+            shuffle_tracks();
+        }
+        size_t id = shuffle_order[current_index++];
+        if (track_index_is_removed(id)) continue;
+        history_push(id);
+        path = track_path(id, next_path, sizeof(next_path));
     }
-    return track_list[shuffle_order[current_index++]];
+    unlock();
+    return path;
 }
 
 void playlist_manager_reset(void) {
+    lock();
     current_index = 0;
+    history_len = history_cur = 0;
+    unlock();
 }
 
 size_t playlist_manager_get_track_count(void) {
-    return track_count;
+    size_t removed = track_index_removed_count();
+    return track_count > removed ? track_count - removed : 0;
+}
+
+size_t playlist_manager_get_memory_usage(void) {
+    return track_index_memory_usage() + 2 * order_capacity * sizeof(track_id_t);
 }
 
 size_t playlist_manager_get_current_index(void) {
-    return current_index;
+    size_t back = history_len > 0 ? history_len - 1 - history_cur : 0;
+    return current_index > back ? current_index - back : 0;
 }
 
 const char *playlist_manager_get_current_track(void) {
-    if (track_count == 0) {
-        return NULL;
+    const char *path = NULL;
+    lock();
+    if (history_len > 0) {
+        path = track_path(history_at(history_cur), current_path, sizeof(current_path));
+    } else if (track_count > 0) {
+        path = track_path(shuffle_order[current_index], current_path, sizeof(current_path));
     }
-    size_t idx = current_index > 0 ? current_index - 1 : 0;
-    return track_list[shuffle_order[idx]];
+    unlock();
+    return path;
 }
 
+/*
+ * Remonte l'historique des pistes jouees, y compris au-dela d'un nouveau
+ * tirage ; arrive a son debut, la piste la plus ancienne est redonnee.
+ */
 const char *playlist_manager_get_prev(void) {
-    if (track_count == 0) {
-        return NULL;
-    }
-    if (current_index == 0) {
-        current_index = track_count;
+    const char *path = NULL;
+    lock();
+    if (history_len > 0) {
+        if (history_cur > 0) history_cur--;
+        while (history_cur > 0 && track_index_is_removed(history_at(history_cur))) history_cur--;
+        path = track_path(history_at(history_cur), prev_path, sizeof(prev_path));
     }
-    current_index--;
-    return track_list[shuffle_order[current_index]];
+    unlock();
+    return path;
 }
 
 esp_err_t playlist_manager_set_current_by_name(const char *filename) {
     if (!filename) return ESP_ERR_INVALID_ARG;
-    for (size_t i = 0; i < track_count; i++) {
-        const char *path = track_list[i];
-        const char *name = strrchr(path, '/');
-        name = name ? name + 1 : path;
-        if (strcmp(name, filename) == 0) {
-            for (size_t j = 0; j < track_count; j++) {
-                if (shuffle_order[j] == i) {
-                    current_index = j + 1;
-                    return ESP_OK;
-                }
-            }
-        }
+    int id = track_index_find(filename);
+    if (id < 0) return ESP_ERR_NOT_FOUND;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    lock();
+    size_t pos = (size_t)id < order_capacity ? order_pos[id] : track_count;
+    if (pos < track_count && shuffle_order[pos] == (track_id_t)id) {
+        current_index = pos + 1;
+        history_push(id);
+        err = ESP_OK;
     }
-    return ESP_ERR_NOT_FOUND;
+    unlock();
+    return err;
 }
 
+esp_err_t playlist_manager_restore(const playback_state_t *st) {
+    if (!st || !playlist_lock) return ESP_ERR_INVALID_ARG;
+    int id = track_index_find(st->track);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    bool same_order = false;
+    lock();
+    // même liste de pistes : la graine redonne la même permutation
+    if (id >= 0 && st->track_count == track_count && st->generation == track_index_generation()) {
+        shuffle_with_seed(st->seed, st->prev_seed);
+        current_index = order_pos[id];   // get_next() rendra cette piste
+        history_len = history_cur = 0;
+        same_order = true;
+        err = ESP_OK;
+    } else if (id >= 0 && (size_t)id < order_capacity && order_pos[id] < track_count &&
+               shuffle_order[order_pos[id]] == (track_id_t)id) {
+        // liste changee (ou tiree pendant un parcours complet) : l'ordre est
+        // perdu, la piste est reprise en tete du tirage courant
+        size_t pos = order_pos[id];
+        swap_order(current_index, pos);
+        order_pos[shuffle_order[pos]] = pos;
+        order_pos[id] = current_index;
+        history_len = history_cur = 0;
+        err = ESP_OK;
+    }
+    unlock();
+    if (same_order) {
+        ESP_LOGI(TAG, "Resuming order %08x at %u/%u", (unsigned)st->seed,
+                 (unsigned)current_index + 1, (unsigned)track_count);
+    } else if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Track list changed, resuming %s in a new order", st->track);
+    }
+    return err;
+}
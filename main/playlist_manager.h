@@ -4,6 +4,7 @@
 
 #include "esp_err.h"
 #include <stddef.h>
+#include "playback_state.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,7 +22,9 @@ esp_err_t playlist_manager_init(void);
 const char *playlist_manager_get_next(void);
 
 /**
- * @brief Recupere le chemin du fichier precedent dans l'ordre shuffle.
+ * @brief Recupere le chemin du fichier precedent dans l'historique de lecture
+ *        (CONFIG_PLAYLIST_HISTORY_LEN pistes, y compris celles d'un tirage
+ *        precedent). L'appel suivant a get_next() revient vers la plus recente.
  */
 const char *playlist_manager_get_prev(void);
 
@@ -35,6 +38,11 @@ void playlist_manager_reset(void);
  */
 size_t playlist_manager_get_track_count(void);
 
+/**
+ * @brief Retourne la mémoire occupée par la playlist (noms et ordre de lecture).
+ */
+size_t playlist_manager_get_memory_usage(void);
+
 /**
  * @brief Retourne l'index courant dans la playlist.
  */
@@ -50,6 +58,14 @@ const char *playlist_manager_get_current_track(void);
  */
 esp_err_t playlist_manager_set_current_by_name(const char *filename);
 
+/**
+ * @brief Reprend la lecture enregistrée : la prochaine piste rendue sera
+ *        st->track. Si la liste des pistes n'a pas changé, l'ordre qui suit
+ *        est aussi celui d'avant ; sinon la piste ouvre le tirage courant.
+ * @return ESP_ERR_INVALID_STATE si la piste n'est plus dans la liste.
+ */
+esp_err_t playlist_manager_restore(const playback_state_t *st);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,298 @@
+// replaygain.c
+#include "replaygain.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "path_config.h"
+
+#define RG_MAGIC 0x31434752     // "RGC1"
+#define RG_VERSION 1
+#define RG_QUEUE_LEN 4
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+/*
+ * Mesure inspirée de ReplayGain : RMS par fenêtres de 50 ms, histogramme
+ * par pas de 0,25 dB, niveau retenu au 95e centile. Sans le filtre
+ * d'isosonie, une piste riche en graves est jugée un peu trop forte.
+ */
+#define RG_WINDOW_FRAMES 2205   // 50 ms à 44,1 kHz
+#define RG_BINS_PER_DB 4
+#define RG_FLOOR_DB 100
+#define RG_BINS (RG_FLOOR_DB * RG_BINS_PER_DB)
+#define RG_TARGET_DB (-14.0f)   // 89 dB SPL de la référence ReplayGain
+#define RG_MIN_WINDOWS (30 * 20) // 30 s d'écoute au minimum
+#define RG_MIN_GAIN_DB (-24.0f)
+#define RG_MAX_GAIN_DB 12.0f
+
+/*
+ * Format du fichier (little endian) : rg_header_t | rg_record_t...
+ * Les enregistrements sont ajoutés en fin de fichier au fil des analyses ;
+ * la clé est l'empreinte du nom relatif à MP3_DIR et la taille du fichier.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+} rg_header_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    int16_t gain_cdb;       // centièmes de dB
+    uint16_t reserved;
+} rg_record_t;
+
+static const char *TAG = "replaygain";
+static SemaphoreHandle_t lock = NULL;
+static rg_record_t *records = NULL;     // triés par (hash, size)
+static size_t record_count = 0;
+static size_t record_cap = 0;
+static QueueHandle_t write_queue = NULL;
+
+// Mesure en cours, alimentée depuis la tâche de l'élément DSP
+static portMUX_TYPE meter_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool meter_active = false;
+static int64_t window_sum;
+static int window_frames;
+static uint32_t histogram[RG_BINS];
+static uint32_t windows;
+static rg_record_t measured;
+
+static uint32_t hash_name(const char *s)
+{
+    uint32_t h = FNV_OFFSET;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static int cmp_record(const void *a, const void *b)
+{
+    const rg_record_t *ra = a, *rb = b;
+    if (ra->hash != rb->hash) return ra->hash < rb->hash ? -1 : 1;
+    if (ra->size != rb->size) return ra->size < rb->size ? -1 : 1;
+    return 0;
+}
+
+static esp_err_t reserve_records(size_t n)
+{
+    if (n <= record_cap) return ESP_OK;
+    size_t cap = record_cap ? record_cap * 2 : 256;
+    while (cap < n) cap *= 2;
+    rg_record_t *p = heap_caps_realloc(records, cap * sizeof(*p), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!p) p = realloc(records, cap * sizeof(*p));
+    if (!p) return ESP_ERR_NO_MEM;
+    records = p;
+    record_cap = cap;
+    return ESP_OK;
+}
+
+// Insère ou remplace un enregistrement (verrou pris)
+static esp_err_t insert_record(const rg_record_t *r)
+{
+    size_t lo = 0, hi = record_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (cmp_record(&records[mid], r) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < record_count && cmp_record(&records[lo], r) == 0) {
+        records[lo] = *r;
+        return ESP_OK;
+    }
+    if (reserve_records(record_count + 1) != ESP_OK) return ESP_ERR_NO_MEM;
+    memmove(&records[lo + 1], &records[lo], (record_count - lo) * sizeof(*r));
+    records[lo] = *r;
+    record_count++;
+    return ESP_OK;
+}
+
+static esp_err_t load_cache(void)
+{
+    struct stat st;
+    if (stat(REPLAYGAIN_CACHE_PATH, &st) != 0) return ESP_ERR_NOT_FOUND;
+    if (st.st_size < (off_t)sizeof(rg_header_t)) return ESP_ERR_INVALID_SIZE;
+    size_t n = (st.st_size - sizeof(rg_header_t)) / sizeof(rg_record_t);
+
+    FILE *fp = fopen(REPLAYGAIN_CACHE_PATH, "rb");
+    if (!fp) return ESP_FAIL;
+    rg_header_t h;
+    esp_err_t err = ESP_OK;
+    if (fread(&h, sizeof(h), 1, fp) != 1 || h.magic != RG_MAGIC || h.version != RG_VERSION ||
+        h.record_size != sizeof(rg_record_t)) {
+        err = ESP_ERR_INVALID_VERSION;
+    } else if ((err = reserve_records(n)) == ESP_OK) {
+        // un enregistrement tronqué (coupure pendant l'écriture) est ignoré
+        record_count = fread(records, sizeof(rg_record_t), n, fp);
+    }
+    fclose(fp);
+    if (err != ESP_OK) return err;
+
+    qsort(records, record_count, sizeof(rg_record_t), cmp_record);
+    // une piste réanalysée a deux entrées : on n'en garde qu'une
+    size_t out = 0;
+    for (size_t i = 0; i < record_count; i++) {
+        if (out > 0 && cmp_record(&records[out - 1], &records[i]) == 0) {
+            records[out - 1] = records[i];
+        } else {
+            records[out++] = records[i];
+        }
+    }
+    record_count = out;
+    return ESP_OK;
+}
+
+static void append_record(const rg_record_t *r)
+{
+    FILE *fp = fopen(REPLAYGAIN_CACHE_PATH, "ab");
+    if (!fp) {
+        ESP_LOGW(TAG, "Cannot open %s", REPLAYGAIN_CACHE_PATH);
+        return;
+    }
+    bool ok = true;
+    if (ftell(fp) == 0) {
+        rg_header_t h = { .magic = RG_MAGIC, .version = RG_VERSION, .record_size = sizeof(rg_record_t) };
+        ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    }
+    ok = ok && fwrite(r, sizeof(*r), 1, fp) == 1;
+    if (fclose(fp) != 0 || !ok) ESP_LOGW(TAG, "Failed to append to %s", REPLAYGAIN_CACHE_PATH);
+}
+
+// Les écritures sur la carte SD sont faites hors des tâches audio
+static void replaygain_writer_task(void *param)
+{
+    rg_record_t r;
+    while (1) {
+        if (xQueueReceive(write_queue, &r, portMAX_DELAY) == pdTRUE) append_record(&r);
+    }
+}
+
+esp_err_t replaygain_init(void)
+{
+    if (lock) return ESP_OK;
+    lock = xSemaphoreCreateMutex();
+    write_queue = xQueueCreate(RG_QUEUE_LEN, sizeof(rg_record_t));
+    if (!lock || !write_queue) return ESP_ERR_NO_MEM;
+    if (xTaskCreate(replaygain_writer_task, "rg_writer", 3072, NULL, tskIDLE_PRIORITY + 1,
+                    NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = load_cache();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "%u track gains loaded", (unsigned)record_count);
+    } else if (err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Ignoring gain cache: %s", esp_err_to_name(err));
+        record_count = 0;
+        remove(REPLAYGAIN_CACHE_PATH);
+    }
+    return ESP_OK;
+}
+
+bool replaygain_lookup(const char *name, uint32_t size, float *gain_db)
+{
+    if (!lock || !name) return false;
+    rg_record_t key = { .hash = hash_name(name), .size = size };
+    xSemaphoreTake(lock, portMAX_DELAY);
+    const rg_record_t *r = record_count ?
+        bsearch(&key, records, record_count, sizeof(*records), cmp_record) : NULL;
+    if (r) *gain_db = r->gain_cdb / 100.0f;
+    xSemaphoreGive(lock);
+    return r != NULL;
+}
+
+void replaygain_analysis_begin(const char *name, uint32_t size)
+{
+    taskENTER_CRITICAL(&meter_lock);
+    meter_active = false;
+    taskEXIT_CRITICAL(&meter_lock);
+
+    // la mesure est inactive : la tâche DSP ne touche plus l'histogramme
+    memset(histogram, 0, sizeof(histogram));
+    windows = 0;
+    window_sum = 0;
+    window_frames = 0;
+    measured = (rg_record_t) { .hash = hash_name(name), .size = size };
+
+    taskENTER_CRITICAL(&meter_lock);
+    meter_active = true;
+    taskEXIT_CRITICAL(&meter_lock);
+}
+
+void replaygain_analysis_feed(int64_t sum_squares, int frames, void *ctx)
+{
+    if (!meter_active) return;
+    taskENTER_CRITICAL(&meter_lock);
+    if (meter_active) {
+        window_sum += sum_squares;
+        window_frames += frames;
+    }
+    bool full = meter_active && window_frames >= RG_WINDOW_FRAMES;
+    int64_t sum = window_sum;
+    int n = window_frames;
+    if (full) window_sum = window_frames = 0;
+    taskEXIT_CRITICAL(&meter_lock);
+    if (!full) return;
+
+    // moyenne des carrés des deux voies, en dB relatifs à la pleine échelle
+    float ms = (float)sum / (2.0f * n * 32768.0f * 32768.0f);
+    float db = ms > 0 ? 10 * log10f(ms) : -RG_FLOOR_DB;
+    int bin = (int)((db + RG_FLOOR_DB) * RG_BINS_PER_DB);
+    if (bin < 0) bin = 0;
+    if (bin >= RG_BINS) bin = RG_BINS - 1;
+
+    taskENTER_CRITICAL(&meter_lock);
+    if (meter_active) {
+        histogram[bin]++;
+        windows++;
+    }
+    taskEXIT_CRITICAL(&meter_lock);
+}
+
+void replaygain_analysis_end(bool complete)
+{
+    taskENTER_CRITICAL(&meter_lock);
+    bool was_active = meter_active;
+    meter_active = false;
+    taskEXIT_CRITICAL(&meter_lock);
+    if (!was_active || !complete || windows < RG_MIN_WINDOWS || !lock) return;
+
+    // 95e centile : 5 % des fenêtres sont plus fortes
+    uint32_t louder = 0;
+    int bin = RG_BINS - 1;
+    for (; bin > 0; bin--) {
+        louder += histogram[bin];
+        if (louder * 20 >= windows) break;
+    }
+    float level = (float)bin / RG_BINS_PER_DB - RG_FLOOR_DB;
+    float gain = RG_TARGET_DB - level;
+    if (gain < RG_MIN_GAIN_DB) gain = RG_MIN_GAIN_DB;
+    if (gain > RG_MAX_GAIN_DB) gain = RG_MAX_GAIN_DB;
+    measured.gain_cdb = (int16_t)lrintf(gain * 100);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    esp_err_t err = insert_record(&measured);
+    xSemaphoreGive(lock);
+    if (err != ESP_OK) return;
+    if (xQueueSend(write_queue, &measured, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Write queue full, gain kept in memory only");
+    }
+    ESP_LOGI(TAG, "Track level %.2f dBFS over %u windows: gain %.2f dB", level,
+             (unsigned)windows, gain);
+}
+
+size_t replaygain_memory_usage(void)
+{
+    return record_cap * sizeof(rg_record_t) + sizeof(histogram);
+}
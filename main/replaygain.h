@@ -0,0 +1,54 @@
+// replaygain.h
+#ifndef REPLAYGAIN_H
+#define REPLAYGAIN_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Charge le cache des gains par piste depuis la carte SD et démarre
+ *        la tâche qui y ajoute les nouveaux résultats.
+ */
+esp_err_t replaygain_init(void);
+
+/**
+ * @brief Cherche le gain mémorisé d'une piste.
+ * @param name chemin relatif à MP3_DIR
+ * @param size taille du fichier : une piste modifiée est réanalysée
+ */
+bool replaygain_lookup(const char *name, uint32_t size, float *gain_db);
+
+/**
+ * @brief Commence la mesure de niveau de la piste qui démarre.
+ *        Une mesure en cours est abandonnée.
+ */
+void replaygain_analysis_begin(const char *name, uint32_t size);
+
+/**
+ * @brief Accumule un bloc de la piste mesurée (fonction de mesure de
+ *        l'élément DSP, cf. audio_dsp_set_meter_cb).
+ */
+void replaygain_analysis_feed(int64_t sum_squares, int frames, void *ctx);
+
+/**
+ * @brief Termine la mesure en cours. Le gain n'est calculé et mémorisé que
+ *        si la piste a été écoutée jusqu'au bout (complete) assez longtemps.
+ */
+void replaygain_analysis_end(bool complete);
+
+/**
+ * @brief Retourne la mémoire occupée par le cache des gains.
+ */
+size_t replaygain_memory_usage(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REPLAYGAIN_H
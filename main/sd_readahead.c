@@ -0,0 +1,218 @@
+// sd_readahead.c
+#include "sd_readahead.h"
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#ifndef CONFIG_SD_READAHEAD_SEC
+#define CONFIG_SD_READAHEAD_SEC 3
+#endif
+#ifndef CONFIG_SD_READAHEAD_BLOCK_KB
+#define CONFIG_SD_READAHEAD_BLOCK_KB 16
+#endif
+
+#define RA_BLOCK (CONFIG_SD_READAHEAD_BLOCK_KB * 1024)
+#define RA_MAX_BYTES_PER_SEC (320 * 1000 / 8)  // MP3 à 320 kb/s
+#define RA_RING_BLOCKS ((CONFIG_SD_READAHEAD_SEC * RA_MAX_BYTES_PER_SEC + RA_BLOCK - 1) / RA_BLOCK)
+#define RA_MIN_BLOCKS 2
+
+static const char *TAG = "sd_readahead";
+
+/*
+ * Anneau à un producteur (la tâche de lecture) et un consommateur (le
+ * décodeur). La carte n'est lue que par blocs entiers alignés sur les
+ * offsets du fichier, dans un tampon interne compatible DMA : le pilote
+ * SDMMC transfère alors plusieurs secteurs d'un coup, puis le bloc est
+ * recopié dans l'anneau en PSRAM.
+ */
+static SemaphoreHandle_t lock = NULL;
+static SemaphoreHandle_t data_ready = NULL;
+static SemaphoreHandle_t idle = NULL;
+static TaskHandle_t reader_task = NULL;
+static uint8_t *ring = NULL;
+static uint8_t *bounce = NULL;
+static size_t ring_size = 0;
+static uint32_t wr = 0;             // octets écrits depuis le start
+static uint32_t rd = 0;             // octets consommés depuis le start
+static FILE *fp = NULL;
+static long file_pos = 0;           // prochain offset lu par la tâche
+static long file_end = 0;
+static bool eof = true;
+static bool seek_needed = false;
+static bool busy = false;           // lecture de la carte en cours, verrou relâché
+static bool stop_waiting = false;
+static uint32_t generation = 0;
+static sd_readahead_stats_t stats;
+
+static void ring_put(const uint8_t *src, size_t n)
+{
+    size_t at = wr % ring_size;
+    size_t first = ring_size - at < n ? ring_size - at : n;
+    memcpy(ring + at, src, first);
+    memcpy(ring, src + first, n - first);
+}
+
+static void ring_get(uint8_t *dst, size_t n)
+{
+    size_t at = rd % ring_size;
+    size_t first = ring_size - at < n ? ring_size - at : n;
+    memcpy(dst, ring + at, first);
+    memcpy(dst + first, ring, n - first);
+}
+
+static void sd_readahead_task(void *param)
+{
+    while (1) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        // premier bloc raccourci jusqu'à la frontière suivante, les autres alignés
+        size_t want = RA_BLOCK - (size_t)(file_pos % RA_BLOCK);
+        if (fp && !eof && (long)want > file_end - file_pos) want = (size_t)(file_end - file_pos);
+        if (!fp || eof || ring_size - (wr - rd) < want) {
+            xSemaphoreGive(lock);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        FILE *f = fp;
+        long pos = file_pos;
+        bool seek = seek_needed;
+        uint32_t gen = generation;
+        busy = true;
+        seek_needed = false;
+        xSemaphoreGive(lock);
+
+        int64_t t0 = esp_timer_get_time();
+        size_t n = 0;
+        if (!seek || fseek(f, pos, SEEK_SET) == 0) n = fread(bounce, 1, want, f);
+        int64_t dt = esp_timer_get_time() - t0;
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        busy = false;
+        if (gen == generation) {
+            ring_put(bounce, n);
+            wr += n;
+            file_pos += (long)n;
+            if (n < want) {
+                ESP_LOGW(TAG, "Short read at %ld (%u/%u)", pos, (unsigned)n, (unsigned)want);
+                eof = true;
+            } else if (file_pos >= file_end) {
+                eof = true;
+            }
+            stats.refill_bytes += n;
+            stats.refill_us += dt;
+        }
+        if (stop_waiting) {
+            stop_waiting = false;
+            xSemaphoreGive(idle);
+        }
+        xSemaphoreGive(lock);
+        xSemaphoreGive(data_ready);
+    }
+}
+
+esp_err_t sd_readahead_init(void)
+{
+    if (reader_task) return ESP_OK;
+    size_t blocks = RA_RING_BLOCKS < RA_MIN_BLOCKS ? RA_MIN_BLOCKS : RA_RING_BLOCKS;
+    ring = heap_caps_malloc(blocks * RA_BLOCK, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ring) {
+        blocks = RA_MIN_BLOCKS;
+        ring = malloc(blocks * RA_BLOCK);
+    }
+    bounce = heap_caps_malloc(RA_BLOCK, MALLOC_CAP_DMA);
+    lock = xSemaphoreCreateMutex();
+    data_ready = xSemaphoreCreateBinary();
+    idle = xSemaphoreCreateBinary();
+    if (!ring || !bounce || !lock || !data_ready || !idle) return ESP_ERR_NO_MEM;
+    ring_size = blocks * RA_BLOCK;
+    stats.ring_size = ring_size;
+
+    if (xTaskCreatePinnedToCore(sd_readahead_task, "sd_readahead", 3072, NULL, 6,
+                                &reader_task, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Read-ahead ring %u KB, %u KB blocks", (unsigned)(ring_size / 1024),
+             (unsigned)(RA_BLOCK / 1024));
+    return ESP_OK;
+}
+
+esp_err_t sd_readahead_start(FILE *f, long pos, long end)
+{
+    if (!reader_task) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    generation++;
+    fp = f;
+    file_pos = pos;
+    file_end = end;
+    eof = pos >= end;
+    seek_needed = true;
+    wr = rd = 0;
+    xSemaphoreGive(lock);
+    xTaskNotifyGive(reader_task);
+    return ESP_OK;
+}
+
+void sd_readahead_stop(void)
+{
+    if (!reader_task) return;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    generation++;
+    fp = NULL;
+    eof = true;
+    wr = rd = 0;
+    bool wait = busy;
+    if (wait) stop_waiting = true;
+    xSemaphoreGive(lock);
+    if (wait) xSemaphoreTake(idle, portMAX_DELAY);
+}
+
+int sd_readahead_read(void *buf, size_t len, TickType_t wait)
+{
+    int64_t stall_start = 0;
+    int ret;
+    while (1) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        size_t avail = wr - rd;
+        if (avail > 0 || eof) {
+            size_t n = avail < len ? avail : len;
+            ring_get(buf, n);
+            bool wake = ring_size - avail < RA_BLOCK && ring_size - (avail - n) >= RA_BLOCK;
+            rd += n;
+            if (stall_start) stats.stall_us += esp_timer_get_time() - stall_start;
+            xSemaphoreGive(lock);
+            if (wake) xTaskNotifyGive(reader_task);
+            ret = (int)n;
+            break;
+        }
+        if (!stall_start) {
+            stall_start = esp_timer_get_time();
+            stats.stalls++;
+        }
+        xSemaphoreGive(lock);
+        if (xSemaphoreTake(data_ready, wait) != pdTRUE) {
+            xSemaphoreTake(lock, portMAX_DELAY);
+            stats.stall_us += esp_timer_get_time() - stall_start;
+            xSemaphoreGive(lock);
+            ret = -1;
+            break;
+        }
+    }
+    return ret;
+}
+
+void sd_readahead_get_stats(sd_readahead_stats_t *out)
+{
+    if (!lock) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    *out = stats;
+    out->fill = wr - rd;
+    xSemaphoreGive(lock);
+}
@@ -0,0 +1,61 @@
+// sd_readahead.h
+#ifndef SD_READAHEAD_H
+#define SD_READAHEAD_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Compteurs de la lecture anticipée, cumulés depuis le démarrage.
+ */
+typedef struct {
+    uint32_t ring_size;         // taille de l'anneau en octets
+    uint32_t fill;              // octets disponibles dans l'anneau
+    uint32_t stalls;            // lectures qui ont dû attendre la carte
+    uint64_t stall_us;          // temps passé à attendre
+    uint64_t refill_bytes;      // octets lus sur la carte
+    uint64_t refill_us;         // temps passé dans les lectures de la carte
+} sd_readahead_stats_t;
+
+/**
+ * @brief Alloue l'anneau (PSRAM si disponible) et démarre la tâche de lecture.
+ */
+esp_err_t sd_readahead_init(void);
+
+/**
+ * @brief Lit le fichier par blocs alignés de pos à end dans l'anneau.
+ *        Le fichier reste à l'appelant, qui appelle sd_readahead_stop()
+ *        avant de le fermer.
+ */
+esp_err_t sd_readahead_start(FILE *fp, long pos, long end);
+
+/**
+ * @brief Arrête la lecture en cours et vide l'anneau ; au retour la tâche
+ *        n'utilise plus le fichier.
+ */
+void sd_readahead_stop(void);
+
+/**
+ * @brief Copie jusqu'à len octets de l'anneau, en attendant au plus wait
+ *        s'il est vide.
+ * @return octets copiés, 0 à la fin des données (ou sur erreur de lecture)
+ *         ou -1 si rien n'est arrivé pendant wait
+ */
+int sd_readahead_read(void *buf, size_t len, TickType_t wait);
+
+/**
+ * @brief Copie les compteurs courants.
+ */
+void sd_readahead_get_stats(sd_readahead_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_READAHEAD_H
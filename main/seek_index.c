@@ -0,0 +1,257 @@
+// seek_index.c
+#include "seek_index.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "mp3_frame.h"
+#include "path_config.h"
+
+#define SEEK_MAGIC 0x314b4553   // "SEK1"
+#define SEEK_VERSION 1
+#define SEEK_STEP 32            // une entrée toutes les 32 trames (~0,8 s)
+#define SCAN_BUF_LEN 8192
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+/*
+ * Format d'un fichier de table (little endian) : seek_header_t | uint32_t...
+ * L'entrée k est l'octet de début de la trame k * SEEK_STEP. La table
+ * n'est construite que jusqu'à la trame la plus loin demandée ; frames
+ * n'est renseigné qu'une fois la fin de la piste atteinte.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t step;
+    uint32_t audio_start;
+    uint32_t data_end;
+    uint32_t count;         // entrées valides
+    uint32_t frames;        // nombre total de trames, 0 si inconnu
+} seek_header_t;
+
+typedef struct {
+    FILE *fp;
+    uint8_t *buf;
+    long buf_off;           // octet du fichier en buf[0]
+    size_t len;
+} scan_t;
+
+static const char *TAG = "seek_index";
+static char table_path[TRACK_PATH_MAX]; // piste de la table en mémoire
+static seek_header_t hdr;
+static uint32_t *entries = NULL;
+static size_t entry_cap = 0;
+
+static uint32_t hash_name(const char *s)
+{
+    uint32_t h = FNV_OFFSET;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static void cache_path(const char *path, char *out, size_t size)
+{
+    size_t dir_len = strlen(MP3_DIR);
+    if (strncmp(path, MP3_DIR "/", dir_len + 1) == 0) path += dir_len + 1;
+    snprintf(out, size, SEEK_INDEX_DIR "/%08" PRIx32 ".idx", hash_name(path));
+}
+
+static esp_err_t reserve_entries(size_t n)
+{
+    if (n <= entry_cap) return ESP_OK;
+    size_t cap = entry_cap ? entry_cap * 2 : 256;
+    while (cap < n) cap *= 2;
+    uint32_t *p = heap_caps_realloc(entries, cap * sizeof(*p), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!p) p = realloc(entries, cap * sizeof(*p));
+    if (!p) return ESP_ERR_NO_MEM;
+    entries = p;
+    entry_cap = cap;
+    return ESP_OK;
+}
+
+// Relit la table de la piste si elle correspond toujours au fichier
+static void load_table(const char *path, long audio_start, long data_end)
+{
+    hdr = (seek_header_t) {
+        .magic = SEEK_MAGIC,
+        .version = SEEK_VERSION,
+        .step = SEEK_STEP,
+        .audio_start = (uint32_t)audio_start,
+        .data_end = (uint32_t)data_end,
+    };
+    strlcpy(table_path, path, sizeof(table_path));
+
+    char file[64];
+    cache_path(path, file, sizeof(file));
+    FILE *fp = fopen(file, "rb");
+    if (!fp) return;
+    seek_header_t h;
+    if (fread(&h, sizeof(h), 1, fp) == 1 && h.magic == SEEK_MAGIC && h.version == SEEK_VERSION &&
+        h.step == SEEK_STEP && h.audio_start == hdr.audio_start && h.data_end == hdr.data_end &&
+        reserve_entries(h.count) == ESP_OK) {
+        // une table tronquée (coupure pendant l'écriture) est gardée jusqu'où elle est lisible
+        size_t n = fread(entries, sizeof(entries[0]), h.count, fp);
+        hdr.count = (uint32_t)n;
+        hdr.frames = n == h.count ? h.frames : 0;
+    }
+    fclose(fp);
+    ESP_LOGD(TAG, "Loaded %s: %u entries", file, (unsigned)hdr.count);
+}
+
+static void save_table(void)
+{
+    char file[64];
+    cache_path(table_path, file, sizeof(file));
+    if (mkdir(SEEK_INDEX_DIR, 0775) != 0 && errno != EEXIST) {
+        ESP_LOGW(TAG, "Cannot create %s", SEEK_INDEX_DIR);
+        return;
+    }
+    FILE *fp = fopen(file, "wb");
+    if (!fp) {
+        ESP_LOGW(TAG, "Cannot write %s", file);
+        return;
+    }
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+              fwrite(entries, sizeof(entries[0]), hdr.count, fp) == hdr.count;
+    if (fclose(fp) != 0 || !ok) {
+        ESP_LOGW(TAG, "Writing %s failed", file);
+        remove(file);
+    }
+}
+
+// Octets du fichier à partir de off, relus si le buffer ne couvre pas un en-tête
+static const uint8_t *bytes_at(scan_t *s, long off, long end, size_t *avail)
+{
+    if (off < s->buf_off || off + MP3_FRAME_HEADER_LEN > s->buf_off + (long)s->len) {
+        size_t want = SCAN_BUF_LEN;
+        if ((long)want > end - off) want = (size_t)(end - off);
+        if (fseek(s->fp, off, SEEK_SET) != 0) return NULL;
+        s->len = fread(s->buf, 1, want, s->fp);
+        s->buf_off = off;
+        if (s->len < MP3_FRAME_HEADER_LEN) return NULL;
+    }
+    *avail = s->len - (size_t)(off - s->buf_off);
+    return s->buf + (off - s->buf_off);
+}
+
+/*
+ * Première trame valide à partir de off. Une trame n'est retenue que si
+ * la suivante a aussi un en-tête valide (sauf la dernière des données) :
+ * un motif de synchro dans une zone invalide (tag APE, données
+ * corrompues) est ainsi sauté.
+ * @return octet de la trame, -1 en fin de données.
+ */
+static long frame_at(scan_t *s, long off, long end, int *frame_bytes)
+{
+    while (off + MP3_FRAME_HEADER_LEN <= end) {
+        size_t avail;
+        const uint8_t *p = bytes_at(s, off, end, &avail);
+        if (!p) return -1;
+        mp3_frame_info_t info, next;
+        if (mp3_frame_parse_header(p, &info)) {
+            long n = off + info.frame_bytes;
+            if (n + MP3_FRAME_HEADER_LEN > end) {
+                *frame_bytes = info.frame_bytes;
+                return off;
+            }
+            const uint8_t *q = bytes_at(s, n, end, &avail);
+            if (q && mp3_frame_parse_header(q, &next) && next.sample_rate == info.sample_rate) {
+                *frame_bytes = info.frame_bytes;
+                return off;
+            }
+            // faux en-tête : on cherche plus loin
+            off++;
+            continue;
+        }
+        int found = mp3_frame_find(p, avail, &info);
+        if (found > 0) {
+            off += found;   // confirmé au tour suivant, même à cheval sur deux lectures
+        } else {
+            // rien dans le reste du buffer : on relit à partir de ses derniers octets
+            off += avail > MP3_FRAME_HEADER_LEN ? (long)(avail - MP3_FRAME_HEADER_LEN + 1) : 1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Parcourt les trames depuis l'entrée la plus proche avant la cible,
+ * en ajoutant à la table les entrées rencontrées au-delà de sa fin.
+ */
+static esp_err_t scan_to(FILE *fp, uint32_t target, long *offset)
+{
+    scan_t s = { .fp = fp, .buf_off = -1 };
+    s.buf = heap_caps_malloc(SCAN_BUF_LEN, MALLOC_CAP_DMA);
+    if (!s.buf) s.buf = malloc(SCAN_BUF_LEN);
+    if (!s.buf) return ESP_ERR_NO_MEM;
+
+    uint32_t k = target / SEEK_STEP;
+    if (k >= hdr.count) k = hdr.count ? hdr.count - 1 : 0;
+    uint32_t frame = k * SEEK_STEP;
+    long off = hdr.count ? (long)entries[k] : (long)hdr.audio_start;
+    uint32_t added = 0;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = ESP_ERR_INVALID_SIZE;
+
+    for (;;) {
+        int frame_bytes = 0;
+        long pos = frame_at(&s, off, hdr.data_end, &frame_bytes);
+        if (pos < 0) {
+            hdr.frames = frame;
+            break;
+        }
+        if (frame % SEEK_STEP == 0 && frame / SEEK_STEP == hdr.count) {
+            if (reserve_entries(hdr.count + 1) != ESP_OK) {
+                err = ESP_ERR_NO_MEM;
+                break;
+            }
+            entries[hdr.count++] = (uint32_t)pos;
+            added++;
+        }
+        if (frame == target) {
+            *offset = pos;
+            err = ESP_OK;
+            break;
+        }
+        off = pos + frame_bytes;
+        frame++;
+    }
+    free(s.buf);
+
+    if (added > 0 || (err == ESP_ERR_INVALID_SIZE && hdr.frames)) {
+        ESP_LOGI(TAG, "Indexed up to frame %u (+%u entries) in %lld ms", (unsigned)frame,
+                 (unsigned)added, (long long)((esp_timer_get_time() - start_us) / 1000));
+        save_table();
+    }
+    return err;
+}
+
+esp_err_t seek_index_lookup(const char *path, FILE *fp, long audio_start, long data_end,
+                            uint32_t frame, long *offset)
+{
+    if (!path || !fp || !offset) return ESP_ERR_INVALID_ARG;
+    if (strcmp(path, table_path) != 0 || hdr.audio_start != (uint32_t)audio_start ||
+        hdr.data_end != (uint32_t)data_end) {
+        load_table(path, audio_start, data_end);
+    }
+    if (hdr.frames && frame >= hdr.frames) return ESP_ERR_INVALID_SIZE;
+    return scan_to(fp, frame, offset);
+}
+
+void seek_index_release(void)
+{
+    free(entries);
+    entries = NULL;
+    entry_cap = 0;
+    table_path[0] = '\0';
+    memset(&hdr, 0, sizeof(hdr));
+}
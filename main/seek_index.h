@@ -0,0 +1,34 @@
+// seek_index.h
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Donne l'octet du fichier où commence la trame numéro frame
+ *        (0 = première trame audio) de la piste ouverte dans fp.
+ *        La table des trames de la piste est relue depuis la carte SD, ou
+ *        complétée en parcourant les en-têtes jusqu'à la trame demandée.
+ *        Déplace la position de fp.
+ * @param path chemin de la piste, clé de la table
+ * @return ESP_ERR_INVALID_SIZE si la piste a moins de trames.
+ */
+esp_err_t seek_index_lookup(const char *path, FILE *fp, long audio_start, long data_end,
+                            uint32_t frame, long *offset);
+
+/**
+ * @brief Libère la table de la piste en mémoire.
+ */
+void seek_index_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SEEK_INDEX_H
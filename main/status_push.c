@@ -0,0 +1,139 @@
+// status_push.c
+#include "status_push.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "audio_manager.h"
+#include "bt_control.h"
+#include "playlist_manager.h"
+#include "track_reader.h"
+#include "http_chunk.h"
+#include "path_config.h"
+#include "sdkconfig.h"
+
+#define STATUS_CHANGED_BIT BIT0
+#define STATUS_MAX_LEN 448
+#define POSITION_PERIOD_MS 1000
+
+static const char *TAG = "status_push";
+static httpd_handle_t server = NULL;
+static EventGroupHandle_t status_events = NULL;
+static volatile int ws_clients = 0;
+
+void status_push_notify(void)
+{
+    if (status_events) xEventGroupSetBits(status_events, STATUS_CHANGED_BIT);
+}
+
+size_t status_push_format(char *buf, size_t size)
+{
+    // copie unique : la tache du decodeur peut enchainer pendant le formatage
+    track_reader_status_t st;
+    track_reader_get_status(&st);
+    const char *name = strrchr(st.uri, '/');
+    name = name ? name + 1 : st.uri;
+    char escaped[TRACK_PATH_MAX * 2];
+    http_json_escape(escaped, sizeof(escaped), name);
+
+    size_t index = playlist_manager_get_current_index();
+    if (st.pending && index > 0) {
+        index--; // la playlist a déjà avancé sur la piste préparée
+    }
+    int n = snprintf(buf, size,
+                     "{\"track\":\"%s\",\"index\":%u,\"total\":%u,\"gap\":%u,"
+                     "\"state\":\"%s\",\"pos_ms\":%u,\"duration_ms\":%u,\"volume\":%d,\"bt\":%s}",
+                     escaped, (unsigned)index,
+                     (unsigned)playlist_manager_get_track_count(),
+                     (unsigned)audio_manager_get_last_gap_samples(),
+                     audio_manager_get_state_name(),
+                     (unsigned)st.position_ms,
+                     (unsigned)st.duration_ms,
+                     audio_manager_get_volume(),
+                     bt_control_is_connected() ? "true" : "false");
+    if (n < 0) n = 0;
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+// Exécuté sur la tâche httpd : seul endroit où les sockets WebSocket sont écrites
+static void broadcast_work(void *arg)
+{
+    char *msg = arg;
+    int fds[CONFIG_LWIP_MAX_SOCKETS];
+    size_t nfds = sizeof(fds) / sizeof(fds[0]);
+    int clients = 0;
+    if (httpd_get_client_list(server, &nfds, fds) == ESP_OK) {
+        httpd_ws_frame_t frame = {
+            .type = HTTPD_WS_TYPE_TEXT,
+            .payload = (uint8_t *)msg,
+            .len = strlen(msg),
+        };
+        for (size_t i = 0; i < nfds; i++) {
+            if (httpd_ws_get_fd_info(server, fds[i]) != HTTPD_WS_CLIENT_WEBSOCKET) continue;
+            if (httpd_ws_send_frame_async(server, fds[i], &frame) == ESP_OK) clients++;
+        }
+    }
+    ws_clients = clients;
+    free(msg);
+}
+
+static void status_push_task(void *param)
+{
+    while (1) {
+        // Sans client ou à l'arrêt, rien n'est envoyé tant que l'état ne change pas
+        TickType_t wait = ws_clients > 0 && audio_manager_is_playing()
+                              ? pdMS_TO_TICKS(POSITION_PERIOD_MS)
+                              : portMAX_DELAY;
+        xEventGroupWaitBits(status_events, STATUS_CHANGED_BIT, pdTRUE, pdFALSE, wait);
+
+        char *msg = malloc(STATUS_MAX_LEN);
+        if (!msg) continue;
+        status_push_format(msg, STATUS_MAX_LEN);
+        if (httpd_queue_work(server, broadcast_work, msg) != ESP_OK) {
+            free(msg);
+        }
+    }
+}
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        // poignée de main : le nouveau client reçoit l'état immédiatement
+        ESP_LOGI(TAG, "WebSocket client connected (fd %d)", httpd_req_to_sockfd(req));
+        status_push_notify();
+        return ESP_OK;
+    }
+    // Les messages des clients sont ignorés, on vide simplement la trame
+    uint8_t buf[64];
+    httpd_ws_frame_t frame = { .payload = buf };
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) return err;
+    if (frame.len > sizeof(buf)) return ESP_ERR_INVALID_SIZE; // ferme la connexion
+    if (frame.len > 0) err = httpd_ws_recv_frame(req, &frame, sizeof(buf));
+    return err;
+}
+
+esp_err_t status_push_start(httpd_handle_t http_server)
+{
+    if (!http_server) return ESP_ERR_INVALID_ARG;
+    server = http_server;
+    status_events = xEventGroupCreate();
+    if (!status_events) return ESP_ERR_NO_MEM;
+
+    httpd_uri_t ws_uri = {
+        .uri = "/ws",
+        .method = HTTP_GET,
+        .handler = ws_handler,
+        .is_websocket = true,
+    };
+    esp_err_t err = httpd_register_uri_handler(server, &ws_uri);
+    if (err != ESP_OK) return err;
+
+    if (xTaskCreate(status_push_task, "status_push", 4096, NULL, tskIDLE_PRIORITY + 2, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
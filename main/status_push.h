@@ -0,0 +1,36 @@
+// status_push.h
+#ifndef STATUS_PUSH_H
+#define STATUS_PUSH_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enregistre la route WebSocket /ws et démarre la tâche d'envoi.
+ *        Les clients reçoivent l'état de lecture à chaque changement,
+ *        et la position chaque seconde pendant la lecture.
+ */
+esp_err_t status_push_start(httpd_handle_t server);
+
+/**
+ * @brief Signale un changement d'état (piste, pause, liaison BT).
+ *        Appelable depuis n'importe quelle tâche, ne bloque pas.
+ */
+void status_push_notify(void);
+
+/**
+ * @brief Écrit l'état de lecture courant en JSON dans buf.
+ * @return Longueur écrite (hors '\0').
+ */
+size_t status_push_format(char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STATUS_PUSH_H
@@ -0,0 +1,415 @@
+// track_index.c
+#include "track_index.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "path_config.h"
+
+#define INDEX_MAGIC 0x58444954 // "TIDX"
+#define INDEX_VERSION 2
+#define ENTRY_CHUNK_SHIFT 10
+#define ENTRY_CHUNK_LEN (1 << ENTRY_CHUNK_SHIFT)
+#define ENTRY_CHUNK_MAX ((TRACK_INDEX_MAX_TRACKS + ENTRY_CHUNK_LEN - 1) / ENTRY_CHUNK_LEN)
+#define NAME_BLOCK_LEN (32 * 1024)
+#define NAME_BLOCK_MAX 256
+#define HASH_MIN_SLOTS 256
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+#define REMOVED_BYTES ((TRACK_INDEX_MAX_TRACKS + 7) / 8)
+
+/*
+ * Format du fichier (little endian) :
+ *   index_header_t | noms terminés par '\0' | index_file_entry_t[count]
+ * Les entrées sont triées par nom ; les noms sont relatifs à MP3_DIR.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_size;
+    uint32_t generation;
+    uint32_t count;
+    uint32_t names_len;
+    uint32_t crc;           // crc32 de tout ce qui suit l'en-tête
+} index_header_t;
+
+typedef struct {
+    uint32_t name_off;
+    uint32_t size;
+    uint32_t mtime;
+} index_file_entry_t;
+
+typedef struct {
+    const char *name;
+    uint32_t size;
+    uint32_t mtime;
+} track_entry_t;
+
+/*
+ * Les entrées et les noms sont stockés par blocs qui ne sont jamais déplacés :
+ * un seul écrivain (le scanner) ajoute des pistes et publie le compteur,
+ * les lecteurs n'ont besoin d'aucun verrou. Une piste supprimée de la carte
+ * garde son identifiant jusqu'au prochain chargement, marquée dans removed.
+ */
+static const char *TAG = "track_index";
+static track_entry_t *entry_chunks[ENTRY_CHUNK_MAX];
+static char *name_blocks[NAME_BLOCK_MAX];
+static size_t name_block_count = 0;
+static size_t name_block_used = 0;      // octets utilisés dans le dernier bloc
+static size_t name_block_size = 0;      // taille du dernier bloc
+static size_t names_alloc = 0;           // octets alloués pour les noms
+static size_t count = 0;
+static uint32_t generation = 0;
+static uint8_t *removed = NULL;         // bitmap, alloué à la première suppression
+static size_t removed_count = 0;
+
+/* Table de hachage nom -> id (adressage ouvert), protégée par hash_lock */
+static SemaphoreHandle_t hash_lock = NULL;
+static track_id_t *hash_slots = NULL;
+static size_t hash_mask = 0;
+
+static void *alloc_large(size_t size)
+{
+    void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : malloc(size);
+}
+
+static inline track_entry_t *entry_at(size_t id)
+{
+    return &entry_chunks[id >> ENTRY_CHUNK_SHIFT][id & (ENTRY_CHUNK_LEN - 1)];
+}
+
+static inline bool is_removed(size_t id)
+{
+    const uint8_t *bits = __atomic_load_n(&removed, __ATOMIC_ACQUIRE);
+    return bits && (__atomic_load_n(&bits[id >> 3], __ATOMIC_RELAXED) & (1 << (id & 7)));
+}
+
+static inline size_t published_count(void)
+{
+    return __atomic_load_n(&count, __ATOMIC_ACQUIRE);
+}
+
+static track_entry_t *reserve_entry(size_t id)
+{
+    size_t chunk = id >> ENTRY_CHUNK_SHIFT;
+    if (chunk >= ENTRY_CHUNK_MAX) return NULL;
+    if (!entry_chunks[chunk]) {
+        entry_chunks[chunk] = alloc_large(ENTRY_CHUNK_LEN * sizeof(track_entry_t));
+        if (!entry_chunks[chunk]) return NULL;
+    }
+    return entry_at(id);
+}
+
+static const char *store_name(const char *name)
+{
+    size_t n = strlen(name) + 1;
+    if (name_block_count == 0 || name_block_used + n > name_block_size) {
+        if (name_block_count >= NAME_BLOCK_MAX || n > NAME_BLOCK_LEN) return NULL;
+        char *block = alloc_large(NAME_BLOCK_LEN);
+        if (!block) return NULL;
+        name_blocks[name_block_count++] = block;
+        name_block_size = NAME_BLOCK_LEN;
+        name_block_used = 0;
+        names_alloc += NAME_BLOCK_LEN;
+    }
+    char *dst = name_blocks[name_block_count - 1] + name_block_used;
+    memcpy(dst, name, n);
+    name_block_used += n;
+    return dst;
+}
+
+static uint32_t hash_name(const char *s)
+{
+    uint32_t h = FNV_OFFSET;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static void hash_put(track_id_t *slots, size_t mask, track_id_t id)
+{
+    size_t i = hash_name(entry_at(id)->name) & mask;
+    while (slots[i] != TRACK_ID_NONE) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = id;
+}
+
+/*
+ * Garde un taux de remplissage <= 1/2 ; rebuild force la reconstruction
+ * (pistes publiées sans passer par hash_put). Appelé avec hash_lock pris.
+ */
+static esp_err_t hash_reserve(size_t n, bool rebuild)
+{
+    if (!rebuild && hash_slots && n * 2 <= hash_mask + 1) return ESP_OK;
+    size_t slots = HASH_MIN_SLOTS;
+    while (slots < n * 2) slots *= 2;
+    track_id_t *table = alloc_large(slots * sizeof(track_id_t));
+    if (!table) return ESP_ERR_NO_MEM;
+    memset(table, 0xFF, slots * sizeof(track_id_t));
+    for (size_t id = 0; id < count; id++) {
+        hash_put(table, slots - 1, id);
+    }
+    free(hash_slots);
+    hash_slots = table;
+    hash_mask = slots - 1;
+    return ESP_OK;
+}
+
+static esp_err_t hash_init(bool rebuild)
+{
+    if (!hash_lock && !(hash_lock = xSemaphoreCreateMutex())) return ESP_ERR_NO_MEM;
+    xSemaphoreTake(hash_lock, portMAX_DELAY);
+    esp_err_t err = hash_reserve(count, rebuild);
+    xSemaphoreGive(hash_lock);
+    return err;
+}
+
+esp_err_t track_index_load(void)
+{
+    if (count > 0) return ESP_ERR_INVALID_STATE;
+    int64_t t0 = esp_timer_get_time();
+
+    esp_err_t err = hash_init(false);
+    if (err != ESP_OK) return err;
+
+    struct stat st;
+    if (stat(TRACK_INDEX_PATH, &st) != 0 || st.st_size <= (off_t)sizeof(index_header_t)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint8_t *data = alloc_large(st.st_size);
+    if (!data) return ESP_ERR_NO_MEM;
+    FILE *fp = fopen(TRACK_INDEX_PATH, "rb");
+    size_t len = fp ? fread(data, 1, st.st_size, fp) : 0;
+    if (fp) fclose(fp);
+
+    const index_header_t *h = (const index_header_t *)data;
+    size_t entries_at = sizeof(*h) + (len >= sizeof(*h) ? h->names_len : 0);
+    if (len != (size_t)st.st_size || h->magic != INDEX_MAGIC || h->version != INDEX_VERSION ||
+        h->entry_size != sizeof(index_file_entry_t)) {
+        err = ESP_ERR_INVALID_VERSION;
+    } else if (h->count > TRACK_INDEX_MAX_TRACKS || h->names_len == 0 || (h->names_len & 3) ||
+               entries_at + (size_t)h->count * sizeof(index_file_entry_t) != len ||
+               data[entries_at - 1] != '\0') {
+        err = ESP_ERR_INVALID_SIZE;
+    } else if (esp_rom_crc32_le(0, data + sizeof(*h), len - sizeof(*h)) != h->crc) {
+        err = ESP_ERR_INVALID_CRC;
+    }
+
+    const index_file_entry_t *fe = (const index_file_entry_t *)(data + entries_at);
+    for (uint32_t i = 0; err == ESP_OK && i < h->count; i++) {
+        track_entry_t *e = fe[i].name_off < h->names_len ? reserve_entry(i) : NULL;
+        if (!e) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        e->name = (const char *)(uintptr_t)fe[i].name_off;
+        e->size = fe[i].size;
+        e->mtime = fe[i].mtime;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Ignoring index file: %s", esp_err_to_name(err));
+        free(data);
+        return err;
+    }
+    uint32_t n = h->count;
+    generation = h->generation;
+
+    // Les entrées du fichier ont été copiées : on ne garde que l'en-tête et les noms
+    uint8_t *names_blob = heap_caps_realloc(data, entries_at, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (names_blob) data = names_blob;
+    for (uint32_t i = 0; i < n; i++) {
+        track_entry_t *e = entry_at(i);
+        e->name = (const char *)data + sizeof(index_header_t) + (uintptr_t)e->name;
+    }
+
+    // Le premier bloc de noms est celui du fichier ; les nouveaux noms iront dans un autre bloc
+    name_blocks[0] = (char *)data;
+    name_block_count = 1;
+    name_block_size = name_block_used = entries_at;
+    names_alloc = entries_at;
+    __atomic_store_n(&count, n, __ATOMIC_RELEASE);
+    // la table créée plus haut est vide, même si elle est assez grande
+    if ((err = hash_init(true)) != ESP_OK) return err;
+
+    ESP_LOGI(TAG, "%u tracks loaded in %lld ms", (unsigned)count,
+             (long long)(esp_timer_get_time() - t0) / 1000);
+    return ESP_OK;
+}
+
+int track_index_append(const char *name, uint32_t size, uint32_t mtime)
+{
+    size_t id = count;
+    if (id >= TRACK_INDEX_MAX_TRACKS || hash_init(false) != ESP_OK) return -1;
+    track_entry_t *e = reserve_entry(id);
+    const char *stored = e ? store_name(name) : NULL;
+    if (!stored) {
+        ESP_LOGE(TAG, "Index full, %s ignored", name);
+        return -1;
+    }
+    e->name = stored;
+    e->size = size;
+    e->mtime = mtime;
+
+    xSemaphoreTake(hash_lock, portMAX_DELAY);
+    esp_err_t err = hash_reserve(id + 1, false);
+    if (err == ESP_OK) {
+        hash_put(hash_slots, hash_mask, id);
+        __atomic_store_n(&count, id + 1, __ATOMIC_RELEASE);
+    }
+    xSemaphoreGive(hash_lock);
+    return err == ESP_OK ? (int)id : -1;
+}
+
+esp_err_t track_index_remove(size_t id)
+{
+    if (id >= count) return ESP_ERR_INVALID_ARG;
+    if (is_removed(id)) return ESP_OK;
+    if (!removed) {
+        uint8_t *bits = alloc_large(REMOVED_BYTES);
+        if (!bits) return ESP_ERR_NO_MEM;
+        memset(bits, 0, REMOVED_BYTES);
+        __atomic_store_n(&removed, bits, __ATOMIC_RELEASE);
+    }
+    __atomic_fetch_or(&removed[id >> 3], 1 << (id & 7), __ATOMIC_RELEASE);
+    __atomic_store_n(&removed_count, removed_count + 1, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+static int cmp_id_name(const void *a, const void *b)
+{
+    return strcmp(entry_at(*(const uint32_t *)a)->name, entry_at(*(const uint32_t *)b)->name);
+}
+
+esp_err_t track_index_save(const uint8_t *present, uint32_t new_generation)
+{
+    size_t n = 0, total = count;
+    uint32_t *ids = alloc_large((total ? total : 1) * sizeof(uint32_t));
+    if (!ids) return ESP_ERR_NO_MEM;
+    for (size_t id = 0; id < total; id++) {
+        if (is_removed(id)) continue;
+        if (!present || (present[id >> 3] & (1 << (id & 7)))) ids[n++] = id;
+    }
+    qsort(ids, n, sizeof(*ids), cmp_id_name);
+
+    FILE *fp = fopen(TRACK_INDEX_PATH ".tmp", "wb");
+    if (!fp) {
+        free(ids);
+        return ESP_FAIL;
+    }
+    index_header_t h = {
+        .magic = INDEX_MAGIC,
+        .version = INDEX_VERSION,
+        .entry_size = sizeof(index_file_entry_t),
+        .generation = new_generation,
+        .count = n,
+    };
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    uint32_t crc = 0;
+    for (size_t i = 0; ok && i < n; i++) {
+        const char *name = entry_at(ids[i])->name;
+        size_t len = strlen(name) + 1;
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)name, len);
+        ok = fwrite(name, 1, len, fp) == len;
+        h.names_len += len;
+    }
+    // au moins un '\0' (bibliothèque vide), puis alignement des entrées sur 4 octets
+    static const uint8_t pad[4] = { 0 };
+    size_t pad_len = h.names_len ? (4 - (h.names_len & 3)) & 3 : 4;
+    if (ok && pad_len) {
+        crc = esp_rom_crc32_le(crc, pad, pad_len);
+        ok = fwrite(pad, 1, pad_len, fp) == pad_len;
+        h.names_len += pad_len;
+    }
+    uint32_t off = 0;
+    for (size_t i = 0; ok && i < n; i++) {
+        const track_entry_t *e = entry_at(ids[i]);
+        index_file_entry_t fe = { .name_off = off, .size = e->size, .mtime = e->mtime };
+        off += strlen(e->name) + 1;
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)&fe, sizeof(fe));
+        ok = fwrite(&fe, sizeof(fe), 1, fp) == 1;
+    }
+    h.crc = crc;
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+    free(ids);
+
+    if (!ok) {
+        unlink(TRACK_INDEX_PATH ".tmp");
+        return ESP_FAIL;
+    }
+    unlink(TRACK_INDEX_PATH);
+    if (rename(TRACK_INDEX_PATH ".tmp", TRACK_INDEX_PATH) != 0) return ESP_FAIL;
+    generation = new_generation;
+    ESP_LOGI(TAG, "Index saved: %u tracks", (unsigned)n);
+    return ESP_OK;
+}
+
+size_t track_index_count(void)
+{
+    return published_count();
+}
+
+size_t track_index_removed_count(void)
+{
+    return __atomic_load_n(&removed_count, __ATOMIC_ACQUIRE);
+}
+
+bool track_index_is_removed(size_t id)
+{
+    return is_removed(id);
+}
+
+const char *track_index_name(size_t id)
+{
+    return entry_at(id)->name;
+}
+
+uint32_t track_index_size(size_t id)
+{
+    return entry_at(id)->size;
+}
+
+uint32_t track_index_mtime(size_t id)
+{
+    return entry_at(id)->mtime;
+}
+
+size_t track_index_memory_usage(void)
+{
+    size_t n = published_count();
+    size_t chunks = (n + ENTRY_CHUNK_LEN - 1) >> ENTRY_CHUNK_SHIFT;
+    return names_alloc + chunks * ENTRY_CHUNK_LEN * sizeof(track_entry_t) +
+           (hash_slots ? (hash_mask + 1) * sizeof(track_id_t) : 0) + (removed ? REMOVED_BYTES : 0);
+}
+
+uint32_t track_index_generation(void)
+{
+    return generation;
+}
+
+int track_index_find(const char *name)
+{
+    if (!name || !hash_lock) return -1;
+    int id = -1;
+    xSemaphoreTake(hash_lock, portMAX_DELAY);
+    for (size_t i = hash_name(name) & hash_mask; hash_slots[i] != TRACK_ID_NONE; i = (i + 1) & hash_mask) {
+        // une piste supprimée puis recopiée a un nouvel identifiant plus loin
+        if (!is_removed(hash_slots[i]) && strcmp(name, entry_at(hash_slots[i])->name) == 0) {
+            id = hash_slots[i];
+            break;
+        }
+    }
+    xSemaphoreGive(hash_lock);
+    return id;
+}
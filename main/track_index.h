@@ -0,0 +1,104 @@
+// track_index.h
+#ifndef TRACK_INDEX_H
+#define TRACK_INDEX_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_PLAYLIST_WIDE_TRACK_IDS
+typedef uint32_t track_id_t;
+#define TRACK_ID_NONE UINT32_MAX
+#define TRACK_INDEX_MAX_TRACKS (256 * 1024)
+#else
+typedef uint16_t track_id_t;
+#define TRACK_ID_NONE UINT16_MAX
+#define TRACK_INDEX_MAX_TRACKS TRACK_ID_NONE
+#endif
+
+/**
+ * @brief Charge l'index des pistes depuis la carte SD (une seule lecture).
+ *        Les pistes chargées sont triées par nom.
+ */
+esp_err_t track_index_load(void);
+
+/**
+ * @brief Ajoute une piste à l'index (nom relatif à MP3_DIR).
+ *        Réservé à un seul écrivain ; les lecteurs voient la piste dès le retour.
+ * @return l'identifiant de la piste, ou -1 si l'index est plein.
+ */
+int track_index_append(const char *name, uint32_t size, uint32_t mtime);
+
+/**
+ * @brief Retire une piste absente de la carte. Son identifiant reste
+ *        réservé jusqu'au prochain chargement ; track_index_find() ne la
+ *        trouve plus et track_index_save() ne l'écrit pas.
+ *        Réservé à l'écrivain de track_index_append().
+ */
+esp_err_t track_index_remove(size_t id);
+
+/**
+ * @brief Réécrit le fichier d'index, trié par nom.
+ * @param present bitmap des pistes à conserver (NULL : toutes)
+ * @param generation empreinte du répertoire à enregistrer
+ */
+esp_err_t track_index_save(const uint8_t *present, uint32_t generation);
+
+/**
+ * @brief Retourne le nombre d'identifiants attribués, pistes retirées comprises.
+ */
+size_t track_index_count(void);
+
+/**
+ * @brief Retourne le nombre de pistes retirées, toujours inférieur ou égal
+ *        à track_index_count() lu ensuite.
+ */
+size_t track_index_removed_count(void);
+
+/**
+ * @brief Indique si la piste a été retirée par track_index_remove().
+ */
+bool track_index_is_removed(size_t id);
+
+/**
+ * @brief Retourne le chemin de la piste, relatif à MP3_DIR.
+ */
+const char *track_index_name(size_t id);
+
+/**
+ * @brief Retourne la taille du fichier en octets.
+ */
+uint32_t track_index_size(size_t id);
+
+/**
+ * @brief Retourne la date de modification du fichier (secondes epoch).
+ */
+uint32_t track_index_mtime(size_t id);
+
+/**
+ * @brief Retourne l'empreinte du répertoire enregistrée dans l'index.
+ */
+uint32_t track_index_generation(void);
+
+/**
+ * @brief Retourne la mémoire allouée par l'index (entrées et noms).
+ */
+size_t track_index_memory_usage(void);
+
+/**
+ * @brief Cherche une piste par nom (table de hachage, temps constant).
+ * @return l'identifiant de la piste, ou -1 si absente.
+ */
+int track_index_find(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACK_INDEX_H
@@ -0,0 +1,96 @@
+// track_list.c
+#include "track_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "http_chunk.h"
+#include "track_index.h"
+
+static const char *TAG = "track_list";
+
+static size_t query_size_t(httpd_req_t *req, const char *key, size_t def)
+{
+    char query[64], val[16];
+    size_t len = httpd_req_get_url_query_len(req) + 1;
+    if (len > 1 && len <= sizeof(query) &&
+        httpd_req_get_url_query_str(req, query, len) == ESP_OK &&
+        httpd_query_key_value(query, key, val, sizeof(val)) == ESP_OK) {
+        return strtoul(val, NULL, 10);
+    }
+    return def;
+}
+
+// Identifiant de la piste qui suit n pistes presentes a partir de id
+static size_t skip_tracks(size_t id, size_t n, size_t ids)
+{
+    if (track_index_removed_count() == 0) return id + n < ids ? id + n : ids;
+    for (; id < ids; id++) {
+        if (track_index_is_removed(id)) continue;
+        if (n-- == 0) break;
+    }
+    return id;
+}
+
+/*
+ * Liste des pistes, servie depuis l'index en memoire ; offset et limit
+ * comptent les pistes presentes, les pistes retirees par le scanner sont
+ * sautees. L'ETag suit le contenu de la bibliotheque (empreinte + nombre
+ * de pistes).
+ */
+static esp_err_t list_handler(httpd_req_t *req)
+{
+    int64_t t0 = esp_timer_get_time();
+    size_t removed = track_index_removed_count();
+    size_t ids = track_index_count();
+    size_t count = ids - removed;
+    size_t offset = query_size_t(req, "offset", 0);
+    size_t limit = query_size_t(req, "limit", count);
+    if (offset > count) offset = count;
+    if (limit > count - offset) limit = count - offset;
+
+    char etag[32], total[12];
+    snprintf(etag, sizeof(etag), "\"%08x-%u\"", (unsigned)track_index_generation(),
+             (unsigned)count);
+    char inm[32];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+        strcmp(inm, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", etag);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    http_chunk_t *c = http_chunk_begin(req);
+    if (!c) {
+        httpd_resp_send_500(req);
+        return ESP_ERR_NO_MEM;
+    }
+    snprintf(total, sizeof(total), "%u", (unsigned)count);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "X-Total-Count", total);
+    http_chunk_write(c, "[", 1);
+    size_t id = skip_tracks(0, offset, ids);
+    for (size_t i = 0; i < limit && id < ids; i++, id = skip_tracks(id + 1, 0, ids)) {
+        if (i > 0) http_chunk_write(c, ",", 1);
+        http_chunk_json_string(c, track_index_name(id));
+    }
+    http_chunk_write(c, "]", 1);
+    size_t sent;
+    esp_err_t err = http_chunk_end(c, &sent);
+    ESP_LOGI(TAG, "/list: %u bytes in %lld ms", (unsigned)sent,
+             (long long)(esp_timer_get_time() - t0) / 1000);
+    return err;
+}
+
+esp_err_t track_list_register(httpd_handle_t server)
+{
+    httpd_uri_t uri = {
+        .uri = "/list",
+        .method = HTTP_GET,
+        .handler = list_handler,
+    };
+    return httpd_register_uri_handler(server, &uri);
+}
@@ -0,0 +1,22 @@
+// track_list.h
+#ifndef TRACK_LIST_H
+#define TRACK_LIST_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enregistre le point d'accès /list : noms des pistes de l'index,
+ *        paginés par /list?offset=&limit=, total dans X-Total-Count.
+ */
+esp_err_t track_list_register(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACK_LIST_H
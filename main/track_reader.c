@@ -0,0 +1,590 @@
+// track_reader.c
+#include "track_reader.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mp3_frame.h"
+#include "sd_readahead.h"
+#include "seek_index.h"
+#include "sdkconfig.h"
+#include "path_config.h"
+
+#ifndef CONFIG_AUDIO_GAPLESS_PREFETCH_KB
+#define CONFIG_AUDIO_GAPLESS_PREFETCH_KB 16
+#endif
+
+#define PREFETCH_LEN (CONFIG_AUDIO_GAPLESS_PREFETCH_KB * 1024)
+#define ID3V1_LEN 128
+#define CUT_QUEUE_LEN 4
+#define ID3_FRAME_HDR 10
+#define TXXX_MAX 128            // un TXXX ReplayGain tient largement
+
+typedef struct {
+    FILE *fp;
+    long pos;               // prochain offset lu dans le fichier
+    long data_end;          // fin des données audio (tag ID3v1 exclu)
+    long audio_start;       // offset de la premiere trame audio
+    uint8_t *head;          // début de la piste déjà chargé en mémoire
+    size_t head_len;
+    size_t head_pos;
+    long vbr_start;         // offset de la trame d'en-tete VBR (origine de la TOC)
+    long pos_base_off;      // derniere position connue exactement...
+    uint32_t pos_base_ms;   // ...et son instant dans la piste
+    long next_frame;        // offset du prochain en-tete de trame a compter
+    mp3_frame_info_t fmt;
+    mp3_vbr_info_t vbr;
+    bool fmt_valid;
+    bool rg_valid;          // gain ReplayGain lu dans le tag
+    float rg_db;
+    char uri[TRACK_PATH_MAX];
+} track_file_t;
+
+static const char *TAG = "track_reader";
+static SemaphoreHandle_t lock = NULL;   // cur et pending : decodeur, controle et statut
+static track_file_t cur;
+static track_file_t pending;
+static bool pending_tried = false;
+static bool readahead = false;          // la piste courante est lue par sd_readahead
+
+/*
+ * Les coupes sont reperees en echantillons decodes depuis le lancement du
+ * pipeline : chaque trame remise au decodeur en produit samples_per_frame.
+ */
+static uint64_t stream_samples = 0;
+static uint8_t walk_tail[MP3_FRAME_HEADER_LEN - 1];    // fin de la lecture precedente
+static track_cut_t cuts[CUT_QUEUE_LEN];
+static int cut_count = 0;
+
+static bool take(void)
+{
+    if (!lock && !(lock = xSemaphoreCreateMutex())) return false;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    return true;
+}
+
+static uint8_t *alloc_head_buffer(void)
+{
+    uint8_t *buf = heap_caps_malloc(PREFETCH_LEN, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) buf = malloc(PREFETCH_LEN);
+    return buf;
+}
+
+static void close_file(track_file_t *t)
+{
+    if (t == &cur && readahead) sd_readahead_stop();
+    if (t->fp) {
+        fclose(t->fp);
+        t->fp = NULL;
+    }
+    t->pos = t->data_end = t->audio_start = t->vbr_start = t->pos_base_off = t->next_frame = 0;
+    t->pos_base_ms = 0;
+    t->vbr.frames = t->vbr.bytes = 0;
+    t->vbr.has_toc = t->vbr.has_lame = false;
+    t->head_len = t->head_pos = 0;
+    t->fmt_valid = false;
+    t->rg_valid = false;
+    t->uri[0] = '\0';
+}
+
+static size_t remaining(const track_file_t *t)
+{
+    return (t->head_len - t->head_pos) + (size_t)(t->data_end - t->pos);
+}
+
+/*
+ * Suite du tag ID3v2 au-dela de la tete chargee, a partir de la trame pos :
+ * seuls les en-tetes de trames sont lus, les corps (pochette...) sont
+ * sautes, sauf celui d'un TXXX de taille raisonnable.
+ */
+static bool tag_gain_from_file(FILE *fp, uint8_t version, size_t pos, size_t end, float *gain_db)
+{
+    uint8_t frame[ID3_FRAME_HDR + TXXX_MAX];
+    while (pos + ID3_FRAME_HDR <= end) {
+        if (fseek(fp, (long)pos, SEEK_SET) != 0 || fread(frame, 1, ID3_FRAME_HDR, fp) != ID3_FRAME_HDR ||
+            frame[0] == 0) {
+            return false;
+        }
+        size_t size = mp3_frame_id3v2_frame_size(frame, version);
+        if (size == 0 || pos + ID3_FRAME_HDR + size > end) return false;
+        if (memcmp(frame, "TXXX", 4) == 0 && size <= TXXX_MAX &&
+            fread(frame + ID3_FRAME_HDR, 1, size, fp) == size &&
+            mp3_frame_id3v2_frame_gain(frame, size, gain_db)) {
+            return true;
+        }
+        pos += ID3_FRAME_HDR + size;
+    }
+    return false;
+}
+
+// Ouvre le fichier, saute le tag ID3v2 et l'en-tete VBR, puis charge le debut de l'audio
+static esp_err_t open_file(track_file_t *t, const char *uri)
+{
+    close_file(t);
+    if (!uri) return ESP_ERR_INVALID_ARG;
+    if (!t->head && !(t->head = alloc_head_buffer())) return ESP_ERR_NO_MEM;
+
+    FILE *fp = fopen(uri, "rb");
+    if (!fp) {
+        ESP_LOGE(TAG, "Failed to open %s", uri);
+        return ESP_FAIL;
+    }
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    long data_end = size;
+    char tag[3];
+    if (size >= ID3V1_LEN && fseek(fp, size - ID3V1_LEN, SEEK_SET) == 0 &&
+        fread(tag, 1, sizeof(tag), fp) == sizeof(tag) && memcmp(tag, "TAG", 3) == 0) {
+        data_end -= ID3V1_LEN;
+    }
+
+    long base = 0;
+    fseek(fp, 0, SEEK_SET);
+    size_t len = fread(t->head, 1, PREFETCH_LEN, fp);
+    size_t id3 = mp3_frame_id3v2_size(t->head, len);
+    size_t resume;
+    t->rg_valid = mp3_frame_id3v2_replaygain(t->head, len, &t->rg_db, &resume);
+    if (!t->rg_valid && resume > 0) {
+        // le gain peut suivre une trame plus grande que la tete
+        size_t frames_end = id3 - ((t->head[5] & 0x10) ? 10 : 0);
+        t->rg_valid = tag_gain_from_file(fp, t->head[3], resume, frames_end, &t->rg_db);
+        fseek(fp, (long)len, SEEK_SET);
+    }
+    if (id3 > 0 && id3 >= len) {
+        base = (long)id3;
+        fseek(fp, base, SEEK_SET);
+        len = fread(t->head, 1, PREFETCH_LEN, fp);
+        id3 = 0;
+    }
+    if ((long)len > data_end - base) len = data_end > base ? (size_t)(data_end - base) : 0;
+
+    // tag annonce plus long que le fichier : pas d'audio
+    size_t off = id3 < len ? id3 : len;
+    int frame = mp3_frame_find(t->head + off, len - off, &t->fmt);
+    if (frame >= 0) {
+        off += frame;
+        t->fmt_valid = true;
+        if (mp3_frame_parse_vbr(t->head + off, len - off, &t->fmt, &t->vbr) &&
+            off + t->fmt.frame_bytes <= len) {
+            t->vbr_start = base + (long)off;
+            off += t->fmt.frame_bytes;
+        }
+    }
+
+    t->fp = fp;
+    t->head_pos = off;
+    t->head_len = len;
+    t->pos = base + (long)len;
+    t->audio_start = base + (long)off;
+    t->pos_base_off = t->next_frame = t->audio_start;
+    t->data_end = data_end;
+    strlcpy(t->uri, uri, sizeof(t->uri));
+    return ESP_OK;
+}
+
+static void push_cut(uint64_t from, uint64_t to, bool junction)
+{
+    if (cut_count == CUT_QUEUE_LEN) {
+        ESP_LOGW(TAG, "Cut queue full");
+        return;
+    }
+    cuts[cut_count++] = (track_cut_t) { .from = from, .to = to, .junction = junction };
+}
+
+static bool can_splice(void)
+{
+    return pending.fp && cur.fmt_valid && pending.fmt_valid &&
+           cur.fmt.sample_rate == pending.fmt.sample_rate &&
+           cur.fmt.channels == pending.fmt.channels;
+}
+
+/*
+ * Compte les trames des octets remis au decodeur, at etant l'offset du
+ * fichier du premier octet. Un en-tete a cheval sur deux lectures est
+ * complete par la fin de la precedente.
+ */
+static void walk_frames(const uint8_t *buf, size_t n, long at)
+{
+    long end = at + (long)n;
+    while (cur.fmt_valid && cur.next_frame + MP3_FRAME_HEADER_LEN <= end) {
+        uint8_t hdr[MP3_FRAME_HEADER_LEN];
+        for (int k = 0; k < MP3_FRAME_HEADER_LEN; k++) {
+            long o = cur.next_frame + k;
+            hdr[k] = o >= at ? buf[o - at] : walk_tail[o - (at - (long)sizeof(walk_tail))];
+        }
+        mp3_frame_info_t fi;
+        if (mp3_frame_parse_header(hdr, &fi) && fi.sample_rate == cur.fmt.sample_rate) {
+            stream_samples += fi.samples_per_frame;
+            cur.next_frame += fi.frame_bytes;
+        } else {
+            cur.next_frame++;   // donnees parasites : resynchronisation
+        }
+    }
+    for (size_t i = n > sizeof(walk_tail) ? n - sizeof(walk_tail) : 0; i < n; i++) {
+        memmove(walk_tail, walk_tail + 1, sizeof(walk_tail) - 1);
+        walk_tail[sizeof(walk_tail) - 1] = buf[i];
+    }
+}
+
+/*
+ * Derniers octets de la piste remis au decodeur : son contenu finit
+ * MP3_DECODER_DELAY echantillons apres sa derniere trame, moins le
+ * remplissage de l'encodeur. Enchainee, la piste suivante commence apres
+ * son propre delai d'encodeur ; les deux sont retires d'une seule coupe.
+ * Le decodeur n'a pas encore rendu ces trames, la coupe arrive a temps.
+ */
+static void queue_end_cuts(void)
+{
+    uint64_t end = stream_samples + MP3_DECODER_DELAY;
+    uint16_t pad = cur.vbr.has_lame ? cur.vbr.enc_padding : 0;
+    uint64_t from = end > pad ? end - pad : 0;
+    if (can_splice()) {
+        push_cut(from, end + (pending.vbr.has_lame ? pending.vbr.enc_delay : 0), true);
+    } else if (pad) {
+        push_cut(from, UINT64_MAX, false);
+    }
+}
+
+static bool splice_pending(void)
+{
+    if (!pending.fp) return false;
+    if (!can_splice()) {
+        ESP_LOGI(TAG, "Format change, no gapless splice");
+        return false;
+    }
+    uint8_t *spare = cur.head;
+    close_file(&cur);
+    cur = pending;
+    memset(&pending, 0, sizeof(pending));
+    pending.head = spare;
+    pending_tried = false;
+    if (readahead) sd_readahead_start(cur.fp, cur.pos, cur.data_end);
+    ESP_LOGI(TAG, "Gapless splice: %s", cur.uri);
+    return true;
+}
+
+static long offset_of(const track_file_t *t)
+{
+    return t->fp ? t->pos - (long)(t->head_len - t->head_pos) : 0;
+}
+
+static uint32_t frames_to_ms(uint32_t frames)
+{
+    return (uint32_t)((uint64_t)frames * cur.fmt.samples_per_frame * 1000 / cur.fmt.sample_rate);
+}
+
+static uint32_t duration_ms(void)
+{
+    if (!cur.fp || !cur.fmt_valid) return 0;
+    if (cur.vbr.frames) return frames_to_ms(cur.vbr.frames);
+    if (cur.fmt.bitrate_kbps == 0) return 0;
+    return (uint32_t)((int64_t)(cur.data_end - cur.audio_start) * 8 / cur.fmt.bitrate_kbps);
+}
+
+static uint32_t position_ms(void)
+{
+    if (!cur.fp || !cur.fmt_valid || cur.fmt.bitrate_kbps == 0) return 0;
+    long consumed = offset_of(&cur) - cur.pos_base_off;
+    if (consumed < 0) consumed = 0;
+    return cur.pos_base_ms + (uint32_t)((int64_t)consumed * 8 / cur.fmt.bitrate_kbps);
+}
+
+esp_err_t track_reader_open(const char *uri)
+{
+    if (!take()) return ESP_ERR_NO_MEM;
+    close_file(&pending);
+    pending_tried = false;
+    if (!readahead) readahead = sd_readahead_init() == ESP_OK;
+    esp_err_t err = open_file(&cur, uri);
+    if (err == ESP_OK && !cur.fmt_valid) {
+        ESP_LOGW(TAG, "No MPEG frame found in %s", uri);
+    }
+    // nouveau flux : retard du decodeur et delai de l'encodeur en tete
+    stream_samples = 0;
+    cut_count = 0;
+    push_cut(0, MP3_DECODER_DELAY + (cur.vbr.has_lame ? cur.vbr.enc_delay : 0), true);
+    if (cur.vbr.has_lame) {
+        ESP_LOGD(TAG, "Encoder delay %u, padding %u", cur.vbr.enc_delay, cur.vbr.enc_padding);
+    }
+    if (err == ESP_OK && readahead) {
+        sd_readahead_stats_t st;
+        sd_readahead_get_stats(&st);
+        ESP_LOGI(TAG, "SD read-ahead: %u stalls (%llu ms), refill %llu KB/s",
+                 (unsigned)st.stalls, (unsigned long long)(st.stall_us / 1000),
+                 (unsigned long long)(st.refill_us ? st.refill_bytes * 1000000 / 1024 / st.refill_us : 0));
+        sd_readahead_start(cur.fp, cur.pos, cur.data_end);
+    }
+    xSemaphoreGive(lock);
+    return err;
+}
+
+esp_err_t track_reader_prepare_next(const char *uri)
+{
+    if (!take()) return ESP_ERR_NO_MEM;
+    pending_tried = true;
+    esp_err_t err = open_file(&pending, uri);
+    if (err != ESP_OK) {
+        close_file(&pending);
+    }
+    xSemaphoreGive(lock);
+    return err;
+}
+
+bool track_reader_wants_next(void)
+{
+    if (!take()) return false;
+    bool wants = cur.fp && !pending.fp && !pending_tried && remaining(&cur) <= PREFETCH_LEN;
+    xSemaphoreGive(lock);
+    return wants;
+}
+
+const char *track_reader_get_pending_uri(void)
+{
+    if (!take()) return NULL;
+    const char *uri = pending.fp ? pending.uri : NULL;
+    xSemaphoreGive(lock);
+    return uri;
+}
+
+/*
+ * Appele par la seule tache du decodeur. La lecture SD se fait hors verrou :
+ * les autres taches ne modifient cur que pipeline arrete, donc jamais
+ * pendant cet appel.
+ */
+int track_reader_read(char *buf, size_t len)
+{
+    if (!take()) return 0;
+    if (!cur.fp || (remaining(&cur) == 0 && !splice_pending())) {
+        xSemaphoreGive(lock);
+        return 0;
+    }
+
+    long at = offset_of(&cur);
+    size_t n = 0;
+    if (cur.head_pos < cur.head_len) {
+        n = cur.head_len - cur.head_pos;
+        if (n > len) n = len;
+        memcpy(buf, cur.head + cur.head_pos, n);
+        cur.head_pos += n;
+    }
+    size_t want = 0;
+    if (n < len && cur.pos < cur.data_end) {
+        want = len - n;
+        if ((long)want > cur.data_end - cur.pos) want = (size_t)(cur.data_end - cur.pos);
+    }
+    FILE *fp = cur.fp;
+    xSemaphoreGive(lock);
+
+    int r = 0;
+    if (want) {
+        r = readahead ? sd_readahead_read(buf + n, want, portMAX_DELAY) : (int)fread(buf + n, 1, want, fp);
+        if (r < 0) r = 0;
+    }
+
+    take();
+    if (want) {
+        cur.pos += r;
+        n += r;
+        if (r == 0) cur.data_end = cur.pos; // fichier tronque ou erreur de lecture
+    }
+    walk_frames((const uint8_t *)buf, n, at);
+    if (n > 0 && remaining(&cur) == 0) queue_end_cuts();
+    xSemaphoreGive(lock);
+    return (int)n;
+}
+
+bool track_reader_take_cut(track_cut_t *out)
+{
+    if (!take()) return false;
+    bool have = cut_count > 0;
+    if (have) {
+        *out = cuts[0];
+        memmove(cuts, cuts + 1, --cut_count * sizeof(cuts[0]));
+    }
+    xSemaphoreGive(lock);
+    return have;
+}
+
+const char *track_reader_get_current_uri(void)
+{
+    if (!take()) return NULL;
+    const char *uri = cur.fp ? cur.uri : NULL;
+    xSemaphoreGive(lock);
+    return uri;
+}
+
+bool track_reader_get_status(track_reader_status_t *out)
+{
+    if (!take()) return false;
+    bool open = cur.fp != NULL;
+    strlcpy(out->uri, open ? cur.uri : "", sizeof(out->uri));
+    out->pending = pending.fp != NULL;
+    out->position_ms = position_ms();
+    out->duration_ms = duration_ms();
+    xSemaphoreGive(lock);
+    return open;
+}
+
+bool track_reader_get_format(int *sample_rate, int *channels)
+{
+    if (!take()) return false;
+    bool valid = cur.fp && cur.fmt_valid;
+    if (valid) {
+        *sample_rate = cur.fmt.sample_rate;
+        *channels = cur.fmt.channels;
+    }
+    xSemaphoreGive(lock);
+    return valid;
+}
+
+bool track_reader_get_tag_gain(float *gain_db)
+{
+    if (!take()) return false;
+    bool valid = cur.fp && cur.rg_valid;
+    if (valid) *gain_db = cur.rg_db;
+    xSemaphoreGive(lock);
+    return valid;
+}
+
+/*
+ * Repositionne la piste courante sur la premiere trame trouvee a partir
+ * de offset (pipeline arrete). La piste en attente est abandonnee.
+ */
+static esp_err_t seek_offset(long offset)
+{
+    if (!cur.fp) return ESP_ERR_INVALID_STATE;
+    if (offset < cur.audio_start || offset >= cur.data_end) return ESP_ERR_INVALID_ARG;
+    close_file(&pending);
+    pending_tried = false;
+    if (readahead) sd_readahead_stop();
+
+    size_t len = 0;
+    if (fseek(cur.fp, offset, SEEK_SET) == 0) len = fread(cur.head, 1, PREFETCH_LEN, cur.fp);
+    if ((long)len > cur.data_end - offset) len = (size_t)(cur.data_end - offset);
+    mp3_frame_info_t info;
+    int frame = mp3_frame_find(cur.head, len, &info);
+    if (frame < 0) {
+        ESP_LOGW(TAG, "No frame at offset %ld", offset);
+        frame = 0;
+    }
+    cur.head_pos = (size_t)frame;
+    cur.head_len = len;
+    cur.pos = offset + (long)len;
+    cur.pos_base_off = cur.audio_start;
+    cur.pos_base_ms = 0;
+    cur.next_frame = offset + frame;
+    // le decodeur repart a zero : seul son propre retard est a retirer
+    stream_samples = 0;
+    cut_count = 0;
+    push_cut(0, MP3_DECODER_DELAY, false);
+    if (readahead) sd_readahead_start(cur.fp, cur.pos, cur.data_end);
+    return ESP_OK;
+}
+
+esp_err_t track_reader_seek_offset(long offset)
+{
+    if (!take()) return ESP_ERR_NO_MEM;
+    esp_err_t err = seek_offset(offset);
+    xSemaphoreGive(lock);
+    return err;
+}
+
+/*
+ * Avec une TOC Xing/VBRI, la position est interpolee au centieme de la
+ * duree (precision de l'ordre de la seconde, sans lecture). Sinon la trame
+ * exacte est trouvee par la table des trames de seek_index.
+ */
+static esp_err_t seek_ms(uint32_t ms)
+{
+    if (!cur.fp || !cur.fmt_valid) return ESP_ERR_INVALID_STATE;
+
+    long offset;
+    uint32_t base_ms = ms;
+    if (cur.vbr.has_toc && cur.vbr.frames) {
+        uint32_t duration = frames_to_ms(cur.vbr.frames);
+        if (ms >= duration) return ESP_ERR_INVALID_ARG;
+        float pct = ms * 100.0f / duration;
+        int i = (int)pct;
+        float a = cur.vbr.toc[i];
+        float b = i < 99 ? cur.vbr.toc[i + 1] : 256.0f;
+        long bytes = cur.vbr.bytes ? (long)cur.vbr.bytes : cur.data_end - cur.vbr_start;
+        offset = cur.vbr_start + (long)((a + (b - a) * (pct - i)) * bytes / 256.0f);
+        if (offset < cur.audio_start) offset = cur.audio_start;
+    } else {
+        uint32_t frame = (uint32_t)((uint64_t)ms * cur.fmt.sample_rate / 1000 / cur.fmt.samples_per_frame);
+        if (readahead) sd_readahead_stop(); // seek_index lit le meme FILE
+        esp_err_t err = seek_index_lookup(cur.uri, cur.fp, cur.audio_start, cur.data_end, frame, &offset);
+        if (err != ESP_OK) {
+            if (readahead) sd_readahead_start(cur.fp, cur.pos, cur.data_end);
+            return err == ESP_ERR_INVALID_SIZE ? ESP_ERR_INVALID_ARG : err;
+        }
+        base_ms = frames_to_ms(frame);
+    }
+    esp_err_t err = seek_offset(offset);
+    if (err == ESP_OK) {
+        cur.pos_base_off = offset_of(&cur);
+        cur.pos_base_ms = base_ms;
+    }
+    return err;
+}
+
+esp_err_t track_reader_seek_ms(uint32_t ms)
+{
+    if (!take()) return ESP_ERR_NO_MEM;
+    esp_err_t err = seek_ms(ms);
+    xSemaphoreGive(lock);
+    return err;
+}
+
+uint32_t track_reader_get_duration_ms(void)
+{
+    if (!take()) return 0;
+    uint32_t ms = duration_ms();
+    xSemaphoreGive(lock);
+    return ms;
+}
+
+long track_reader_get_offset(void)
+{
+    if (!take()) return 0;
+    long offset = offset_of(&cur);
+    xSemaphoreGive(lock);
+    return offset;
+}
+
+uint32_t track_reader_get_position_ms(void)
+{
+    if (!take()) return 0;
+    uint32_t ms = position_ms();
+    xSemaphoreGive(lock);
+    return ms;
+}
+
+void track_reader_close(void)
+{
+    if (!take()) return;
+    close_file(&cur);
+    close_file(&pending);
+    pending_tried = false;
+    cut_count = 0;
+    seek_index_release();
+    xSemaphoreGive(lock);
+}
+
+size_t track_reader_get_memory_usage(void)
+{
+    if (!take()) return 0;
+    size_t n = ((cur.head ? 1 : 0) + (pending.head ? 1 : 0)) * (size_t)PREFETCH_LEN;
+    xSemaphoreGive(lock);
+    if (readahead) {
+        sd_readahead_stats_t ra;
+        sd_readahead_get_stats(&ra);
+        n += ra.ring_size;
+    }
+    return n;
+}
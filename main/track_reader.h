@@ -0,0 +1,151 @@
+// track_reader.h
+#ifndef TRACK_READER_H
+#define TRACK_READER_H
+
+#include "esp_err.h"
+#include "path_config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Ouvre le fichier donné comme piste courante.
+ *        Ferme la piste courante et la piste en attente éventuelle.
+ */
+esp_err_t track_reader_open(const char *uri);
+
+/**
+ * @brief Pré-ouvre la piste suivante et charge son début en mémoire,
+ *        pour l'enchaîner sans arrêter le pipeline (mode gapless).
+ */
+esp_err_t track_reader_prepare_next(const char *uri);
+
+/**
+ * @brief Indique que la fin de la piste courante approche et
+ *        qu'aucune piste suivante n'a encore été préparée.
+ */
+bool track_reader_wants_next(void);
+
+/**
+ * @brief Retourne le chemin de la piste en attente, ou NULL.
+ *        Pointeur valable pour la tâche du décodeur ou pipeline arrêté ;
+ *        les autres tâches passent par track_reader_get_status().
+ */
+const char *track_reader_get_pending_uri(void);
+
+/**
+ * @brief Lit les données MP3 de la piste courante.
+ *        En fin de piste, enchaîne sur la piste en attente si son format
+ *        est identique.
+ * @return nombre d'octets lus, 0 en fin de flux.
+ */
+int track_reader_read(char *buf, size_t len);
+
+/**
+ * Échantillons à retirer de la sortie du décodeur : retard du décodeur,
+ * délai et remplissage de l'encodeur (tag LAME). Positions en échantillons
+ * par canal décodés depuis l'ouverture ou le repositionnement de la piste,
+ * to exclu (UINT64_MAX : jusqu'à la fin du flux). junction marque la
+ * jonction entre deux pistes, où le gap est mesuré.
+ */
+typedef struct {
+    uint64_t from;
+    uint64_t to;
+    bool junction;
+} track_cut_t;
+
+/**
+ * @brief Retire la plus ancienne coupe en attente, à transmettre à
+ *        l'élément qui reçoit la sortie du décodeur.
+ * @return false s'il n'y en a pas.
+ */
+bool track_reader_take_cut(track_cut_t *out);
+
+/**
+ * @brief Retourne le chemin de la piste en cours de lecture (NULL si aucune).
+ *        Mêmes restrictions que track_reader_get_pending_uri().
+ */
+const char *track_reader_get_current_uri(void);
+
+/**
+ * État de la lecture copié d'un seul tenant, lisible depuis n'importe
+ * quelle tâche pendant un enchaînement.
+ */
+typedef struct {
+    char uri[TRACK_PATH_MAX];   // vide si aucune piste
+    bool pending;               // piste suivante préparée : la playlist a déjà avancé
+    uint32_t position_ms;
+    uint32_t duration_ms;
+} track_reader_status_t;
+
+/**
+ * @brief Copie l'état de la piste courante.
+ * @return false si aucune piste n'est ouverte.
+ */
+bool track_reader_get_status(track_reader_status_t *out);
+
+/**
+ * @brief Donne la fréquence et le nombre de canaux de la piste courante,
+ *        lus dans l'en-tête de la première trame.
+ * @return false si aucune trame valide n'a été trouvée.
+ */
+bool track_reader_get_format(int *sample_rate, int *channels);
+
+/**
+ * @brief Donne le gain ReplayGain de la piste courante lu dans son tag ID3.
+ * @return false si la piste n'a pas de tag REPLAYGAIN_TRACK_GAIN.
+ */
+bool track_reader_get_tag_gain(float *gain_db);
+
+/**
+ * @brief Retourne la position de lecture dans la piste courante, en ms.
+ *        Estimée à partir des octets lus et du débit de la première trame.
+ */
+uint32_t track_reader_get_position_ms(void);
+
+/**
+ * @brief Reprend la lecture de la piste courante à la première trame qui
+ *        suit l'octet offset du fichier. Pipeline arrêté uniquement.
+ */
+esp_err_t track_reader_seek_offset(long offset);
+
+/**
+ * @brief Reprend la lecture de la piste courante à l'instant ms.
+ *        Interpolé dans la TOC Xing/VBRI si la piste en a une, sinon à la
+ *        trame exacte grâce à la table des trames (seek_index).
+ *        Pipeline arrêté uniquement.
+ * @return ESP_ERR_INVALID_ARG si ms dépasse la fin de la piste.
+ */
+esp_err_t track_reader_seek_ms(uint32_t ms);
+
+/**
+ * @brief Retourne la durée de la piste courante, en ms : exacte avec un
+ *        en-tête Xing/VBRI, estimée d'après le débit de la première trame sinon.
+ */
+uint32_t track_reader_get_duration_ms(void);
+
+/**
+ * @brief Retourne l'octet du fichier où en est la lecture de la piste courante.
+ */
+long track_reader_get_offset(void);
+
+/**
+ * @brief Ferme la piste courante et la piste en attente.
+ */
+void track_reader_close(void);
+
+/**
+ * @brief Mémoire des tampons de lecture : débuts de piste préchargés et
+ *        anneau de lecture anticipée.
+ */
+size_t track_reader_get_memory_usage(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACK_READER_H
@@ -0,0 +1,202 @@
+// web_static.c
+#include "web_static.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "http_chunk.h"
+#include "path_config.h"
+#include "sdkconfig.h"
+
+#define WEB_READ_BUF_LEN (8 * 1024)
+#define WEB_PATH_MAX 96
+
+static const char *TAG = "web_static";
+
+typedef struct {
+    const char *ext;
+    const char *type;
+    const char *cache;
+} mime_type_t;
+
+// Les URL ne sont pas versionnées : HTML, script et feuille de style sont
+// revalidés à chaque chargement (ETag, 304 sans corps), sinon une mise à
+// jour de la carte SD laisserait un app.js périmé face au nouveau HTML.
+// Seules les images restent en cache une semaine.
+static const mime_type_t mime_types[] = {
+    {".html", "text/html",                "no-cache"},
+    {".js",   "application/javascript",   "no-cache"},
+    {".css",  "text/css",                 "no-cache"},
+    {".json", "application/json",         "no-cache"},
+    {".svg",  "image/svg+xml",            "public, max-age=604800"},
+    {".png",  "image/png",                "public, max-age=604800"},
+    {".ico",  "image/x-icon",             "public, max-age=604800"},
+};
+
+static const mime_type_t *mime_for(const char *path)
+{
+    static const mime_type_t fallback = {"", "application/octet-stream", "no-cache"};
+    const char *ext = strrchr(path, '.');
+    if (ext) {
+        for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+            if (strcasecmp(ext, mime_types[i].ext) == 0) return &mime_types[i];
+        }
+    }
+    return &fallback;
+}
+
+static bool accepts_gzip(httpd_req_t *req)
+{
+    char enc[64];
+    return httpd_req_get_hdr_value_str(req, "Accept-Encoding", enc, sizeof(enc)) == ESP_OK &&
+           strstr(enc, "gzip") != NULL;
+}
+
+// Répond 304 si le client a déjà cette version ; sinon pose l'en-tête ETag
+static bool not_modified(httpd_req_t *req, const char *etag)
+{
+    char inm[32];
+    httpd_resp_set_hdr(req, "ETag", etag);
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+        strcmp(inm, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        return true;
+    }
+    return false;
+}
+
+// Chemin de la ressource dans www/, sans la query string ; "/" -> "/index.html"
+static bool resource_path(const httpd_req_t *req, char *out, size_t size)
+{
+    const char *uri = req->uri;
+    size_t len = strcspn(uri, "?#");
+    if (len == 0 || uri[0] != '/' || len >= size) return false;
+    memcpy(out, uri, len);
+    out[len] = '\0';
+    if (strstr(out, "..")) return false;
+    if (out[len - 1] == '/') strlcat(out, "index.html", size);
+    return true;
+}
+
+#if CONFIG_WEB_ASSETS_EMBED
+extern const uint8_t index_html_start[] asm("_binary_index_html_start");
+extern const uint8_t index_html_end[]   asm("_binary_index_html_end");
+extern const uint8_t app_js_start[]     asm("_binary_app_js_start");
+extern const uint8_t app_js_end[]       asm("_binary_app_js_end");
+extern const uint8_t style_css_start[]  asm("_binary_style_css_start");
+extern const uint8_t style_css_end[]    asm("_binary_style_css_end");
+
+typedef struct {
+    const char *path;
+    const uint8_t *start;
+    const uint8_t *end;
+    uint32_t crc;       // calculé à la première requête
+} embedded_asset_t;
+
+static embedded_asset_t embedded_assets[] = {
+    {"/index.html", index_html_start, index_html_end, 0},
+    {"/app.js",     app_js_start,     app_js_end,     0},
+    {"/style.css",  style_css_start,  style_css_end,  0},
+};
+
+static esp_err_t send_embedded(httpd_req_t *req, const char *path)
+{
+    for (size_t i = 0; i < sizeof(embedded_assets) / sizeof(embedded_assets[0]); i++) {
+        embedded_asset_t *a = &embedded_assets[i];
+        if (strcmp(path, a->path) != 0) continue;
+        size_t len = a->end - a->start;
+        if (a->crc == 0) a->crc = esp_rom_crc32_le(0, a->start, len) | 1;
+        char etag[24];
+        snprintf(etag, sizeof(etag), "\"e%08x\"", (unsigned)a->crc);
+        const mime_type_t *mime = mime_for(path);
+        httpd_resp_set_hdr(req, "Cache-Control", mime->cache);
+        if (not_modified(req, etag)) return ESP_OK;
+        httpd_resp_set_type(req, mime->type);
+        return httpd_resp_send(req, (const char *)a->start, len);
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+#endif
+
+static esp_err_t send_file(httpd_req_t *req, const char *path)
+{
+    char file[WEB_PATH_MAX + 8];
+    struct stat st;
+    bool gzip = false;
+
+    if (accepts_gzip(req)) {
+        snprintf(file, sizeof(file), "%s%s.gz", HTTP_WWW_DIR, path);
+        gzip = stat(file, &st) == 0;
+    }
+    if (!gzip) {
+        snprintf(file, sizeof(file), "%s%s", HTTP_WWW_DIR, path);
+        if (stat(file, &st) != 0 || !S_ISREG(st.st_mode)) return ESP_ERR_NOT_FOUND;
+    }
+
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%lx-%lx%s\"", (unsigned long)st.st_mtime,
+             (unsigned long)st.st_size, gzip ? "-gz" : "");
+    const mime_type_t *mime = mime_for(path);
+    httpd_resp_set_hdr(req, "Cache-Control", mime->cache);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    if (not_modified(req, etag)) return ESP_OK;
+
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) return ESP_ERR_NOT_FOUND;
+    // Tampon DMA : le pilote SD lit directement dedans sans copie intermédiaire
+    char *buf = heap_caps_malloc(WEB_READ_BUF_LEN, MALLOC_CAP_DMA);
+    if (!buf) {
+        close(fd);
+        httpd_resp_send_500(req);
+        return ESP_ERR_NO_MEM;
+    }
+
+    httpd_resp_set_type(req, mime->type);
+    if (gzip) httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    esp_err_t err = ESP_OK;
+    ssize_t r;
+    while (err == ESP_OK && (r = read(fd, buf, WEB_READ_BUF_LEN)) > 0) {
+        http_chunk_pace();
+        err = httpd_resp_send_chunk(req, buf, r);
+    }
+    if (err == ESP_OK) err = httpd_resp_send_chunk(req, NULL, 0);
+    free(buf);
+    close(fd);
+    return err;
+}
+
+static esp_err_t static_handler(httpd_req_t *req)
+{
+    char path[WEB_PATH_MAX];
+    if (!resource_path(req, path, sizeof(path))) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+        return ESP_OK;
+    }
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+#if CONFIG_WEB_ASSETS_EMBED
+    err = send_embedded(req, path);
+#endif
+    if (err == ESP_ERR_NOT_FOUND) err = send_file(req, path);
+    if (err == ESP_ERR_NOT_FOUND) {
+        ESP_LOGD(TAG, "Not found: %s", path);
+        httpd_resp_send_404(req);
+        return ESP_OK;
+    }
+    return err;
+}
+
+esp_err_t web_static_register(httpd_handle_t server)
+{
+    httpd_uri_t uri = {
+        .uri = "/*",
+        .method = HTTP_GET,
+        .handler = static_handler,
+    };
+    return httpd_register_uri_handler(server, &uri);
+}
@@ -0,0 +1,23 @@
+// web_static.h
+#ifndef WEB_STATIC_H
+#define WEB_STATIC_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enregistre la route générique qui sert l'interface web (www/).
+ *        Doit être enregistrée après les autres routes, et le serveur
+ *        configuré avec httpd_uri_match_wildcard.
+ */
+esp_err_t web_static_register(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WEB_STATIC_H
@@ -0,0 +1,358 @@
+// bench.c
+/*
+ * Mesure, sur la machine hôte, le parcours de la bibliothèque, le tirage
+ * aléatoire, la réponse de /list et le passage à la piste suivante pour
+ * des bibliothèques de 100 à 100 000 fichiers (voir Makefile) :
+ *
+ *   make -C tools/host bench
+ *   tools/host/build/ids32/bench [-d répertoire] [nombre de pistes...]
+ *
+ * Chaque bibliothèque est générée dans un répertoire temporaire, sous la
+ * forme artiste/album/piste.mp3 (fichiers vides : seul le nom compte).
+ * Les modules gardant leur état dans des variables statiques, chaque mesure
+ * tourne dans un processus fils : un démarrage sans index (parcours
+ * complet), puis un démarrage avec l'index écrit par le premier.
+ * /list est servi par le vrai gestionnaire (main/track_list.c). Le passage
+ * à la piste suivante est mesuré de audio_manager_next() à la reprise de
+ * la lecture, à travers le pipeline persistant de main/audio_manager.c sur
+ * l'ADF factice de shim/adf.c, comme dans test_pipeline ; seul le lecteur
+ * de piste est remplacé, par du PCM sans fichier.
+ * Les temps sont ceux de l'hôte : ils servent à comparer les tailles et
+ * les versions entre elles, pas à prédire ceux de la carte.
+ */
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "audio_manager.h"
+#include "esp_a2dp_api.h"
+#include "esp_http_server.h"
+#include "esp_random.h"
+#include "freertos/task.h"
+#include "track_list.h"
+#include "track_reader.h"
+
+// Pour appeler shuffle_with_seed() et prendre le verrou de la playlist
+#include "playlist_manager.c"
+
+#define TRACKS_PER_ALBUM 12
+#define ALBUMS_PER_ARTIST 4
+#define SHUFFLE_RUNS 5
+#define NEXT_RUNS 200
+#define STATE_TIMEOUT_US 2000000
+#define PAGE_LEN 50
+#define BENCH_SEED 0x5eed1234u
+
+typedef struct {
+    // démarrage sans index
+    double cold_first_ms;       // première piste jouable
+    double cold_scan_ms;        // parcours complet et écriture de l'index
+    // démarrage avec l'index
+    double warm_first_ms;
+    double warm_scan_ms;        // parcours de vérification
+    size_t tracks;
+    size_t memory;
+    double shuffle_ms;
+    double list_ms;
+    size_t list_bytes;
+    double page_us;
+    double next_us;             // audio_manager_next() jusqu'à la lecture de la suivante
+    double next_max_us;
+    int ok;
+} bench_result_t;
+
+static double ms_since(int64_t t0)
+{
+    return (esp_timer_get_time() - t0) / 1000.0;
+}
+
+static int make_dir(const char *path)
+{
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+static int generate(size_t tracks)
+{
+    char path[TRACK_PATH_MAX];
+    if (make_dir(SD_MOUNT_POINT) || make_dir(MP3_DIR)) return -1;
+    for (size_t i = 0; i < tracks; i++) {
+        size_t album = i / TRACKS_PER_ALBUM;
+        size_t artist = album / ALBUMS_PER_ARTIST;
+        int n = snprintf(path, sizeof(path), "%s/Artist %04zu", MP3_DIR, artist);
+        if (i % (TRACKS_PER_ALBUM * ALBUMS_PER_ARTIST) == 0 && make_dir(path)) return -1;
+        n += snprintf(path + n, sizeof(path) - n, "/Album Title %02zu", album % ALBUMS_PER_ARTIST);
+        if (i % TRACKS_PER_ALBUM == 0 && make_dir(path)) return -1;
+        snprintf(path + n, sizeof(path) - n, "/%02zu - Track Title %zu.mp3",
+                 i % TRACKS_PER_ALBUM + 1, i);
+        FILE *fp = fopen(path, "wb");
+        if (!fp) return -1;
+        fclose(fp);
+    }
+    return 0;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+/* ---------- lecteur de piste : PCM 44,1 kHz stéréo, sans fichier ---------- */
+
+#define TRACK_MS 600000
+#define BYTE_RATE (44100 * 2 * 2)
+
+static char cur_uri[TRACK_PATH_MAX];
+static long track_pos;
+
+esp_err_t track_reader_open(const char *uri)
+{
+    strlcpy(cur_uri, uri, sizeof(cur_uri));
+    __atomic_store_n(&track_pos, 0, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+int track_reader_read(char *buf, size_t len)
+{
+    long pos = __atomic_load_n(&track_pos, __ATOMIC_RELAXED);
+    long left = (long)TRACK_MS * (BYTE_RATE / 1000) - pos;
+    size_t n = left < (long)len ? (size_t)left : len;
+    for (size_t i = 0; i < n; i++) buf[i] = (char)((pos + i) * 7 + 1);
+    __atomic_store_n(&track_pos, pos + (long)n, __ATOMIC_RELAXED);
+    return (int)n;
+}
+
+esp_err_t track_reader_prepare_next(const char *uri) { return ESP_ERR_NOT_SUPPORTED; }
+bool track_reader_wants_next(void) { return false; }
+const char *track_reader_get_pending_uri(void) { return NULL; }
+bool track_reader_take_cut(track_cut_t *out) { return false; }
+const char *track_reader_get_current_uri(void) { return cur_uri[0] ? cur_uri : NULL; }
+bool track_reader_get_tag_gain(float *gain_db) { *gain_db = 0; return true; }
+uint32_t track_reader_get_duration_ms(void) { return TRACK_MS; }
+long track_reader_get_offset(void) { return __atomic_load_n(&track_pos, __ATOMIC_RELAXED); }
+size_t track_reader_get_memory_usage(void) { return 0; }
+uint32_t track_reader_get_position_ms(void) { return (uint32_t)(track_reader_get_offset() / (BYTE_RATE / 1000)); }
+
+bool track_reader_get_format(int *sample_rate, int *channels)
+{
+    *sample_rate = 44100;
+    *channels = 2;
+    return true;
+}
+
+esp_err_t track_reader_seek_offset(long offset)
+{
+    __atomic_store_n(&track_pos, offset & ~3L, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t track_reader_seek_ms(uint32_t ms)
+{
+    return track_reader_seek_offset((long)ms * (BYTE_RATE / 1000));
+}
+
+bool replaygain_lookup(const char *name, uint32_t size, float *gain_db) { return false; }
+void replaygain_analysis_begin(const char *name, uint32_t size) {}
+void replaygain_analysis_feed(int64_t sum_squares, int frames, void *ctx) {}
+void replaygain_analysis_end(bool complete) {}
+
+bool bt_control_is_connected(void) { return true; }
+int8_t bt_control_poll_rssi_delta(void) { return 0; }
+void bt_control_a2dp_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param) {}
+
+void status_push_notify(void) {}
+
+/* ---------- mesures ---------- */
+
+// Réponse du gestionnaire /list, comptée sans être gardée
+static size_t list_body(const httpd_uri_t *list, size_t offset, size_t limit)
+{
+    char query[48];
+    snprintf(query, sizeof(query), "offset=%zu&limit=%zu", offset, limit);
+    httpd_req_t req = { .query = query };
+    return list->handler(&req) == ESP_OK && req.status == 0 ? req.sent : 0;
+}
+
+static uint32_t switch_count(void)
+{
+    audio_pipeline_stats_t st;
+    audio_manager_get_pipeline_stats(&st);
+    return st.switch_count;
+}
+
+// Attend un changement de piste après before et la lecture ; -1 si aucun
+static int64_t wait_switch(int64_t t0, uint32_t before)
+{
+    while (switch_count() == before || !audio_manager_is_playing()) {
+        if (esp_timer_get_time() - t0 > STATE_TIMEOUT_US) return -1;
+        usleep(50);
+    }
+    return esp_timer_get_time() - t0;
+}
+
+// Passages à la piste suivante, pipeline en lecture ; false si l'un n'aboutit pas
+static bool measure_next(bench_result_t *r)
+{
+    int64_t t0 = esp_timer_get_time();
+    if (audio_manager_start() != ESP_OK) return false;
+    while (!audio_manager_is_playing()) {
+        if (esp_timer_get_time() - t0 > STATE_TIMEOUT_US) return false;
+        usleep(50);
+    }
+    int64_t total = 0;
+    for (int i = 0; i < NEXT_RUNS; i++) {
+        uint32_t before = switch_count();
+        t0 = esp_timer_get_time();
+        int64_t us = audio_manager_next() == ESP_OK ? wait_switch(t0, before) : -1;
+        if (us < 0) return false;
+        total += us;
+        if (us > r->next_max_us) r->next_max_us = us;
+    }
+    r->next_us = (double)total / NEXT_RUNS;
+    audio_manager_stop();
+    return true;
+}
+
+static void wait_scan(void)
+{
+    library_scan_status_t st;
+    for (library_scanner_get_status(&st); !st.done; library_scanner_get_status(&st)) {
+        vTaskDelay(1);
+    }
+}
+
+static void run_cold(bench_result_t *r)
+{
+    int64_t t0 = esp_timer_get_time();
+    if (playlist_manager_init() != ESP_OK) return;
+    r->cold_first_ms = ms_since(t0);
+    wait_scan();
+    r->cold_scan_ms = ms_since(t0);
+    r->ok = 1;
+}
+
+static void run_warm(bench_result_t *r)
+{
+    int64_t t0 = esp_timer_get_time();
+    if (playlist_manager_init() != ESP_OK) return;
+    r->warm_first_ms = ms_since(t0);
+    wait_scan();
+    r->warm_scan_ms = ms_since(t0);
+
+    r->tracks = playlist_manager_get_track_count();
+    r->memory = playlist_manager_get_memory_usage();
+
+    lock();
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < SHUFFLE_RUNS; i++) {
+        shuffle_with_seed(BENCH_SEED + i + 1, BENCH_SEED + i);
+    }
+    r->shuffle_ms = ms_since(t0) / SHUFFLE_RUNS;
+    unlock();
+
+    if (track_list_register(NULL) != ESP_OK) return;
+    const httpd_uri_t *list = host_httpd_find("/list", HTTP_GET);
+    t0 = esp_timer_get_time();
+    r->list_bytes = list_body(list, 0, r->tracks);
+    r->list_ms = ms_since(t0);
+
+    size_t page = r->tracks < PAGE_LEN ? r->tracks : PAGE_LEN;
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < 100; i++) {
+        list_body(list, (r->tracks - page) / 2, page);
+    }
+    r->page_us = ms_since(t0) * 1000.0 / 100;
+
+    if (!measure_next(r)) return;
+    r->ok = 2;
+}
+
+// Lance fn dans un processus fils ; le résultat revient par une page partagée
+static int run_child(void (*fn)(bench_result_t *), bench_result_t *shared)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        host_random_seed(BENCH_SEED);
+        fn(shared);
+        _exit(0);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return 0;
+}
+
+static int bench_size(size_t tracks, bench_result_t *shared)
+{
+    memset(shared, 0, sizeof(*shared));
+    int64_t t0 = esp_timer_get_time();
+    if (generate(tracks) != 0) {
+        perror("generate");
+        return -1;
+    }
+    double gen_ms = ms_since(t0);
+    if (run_child(run_cold, shared) || shared->ok != 1 || run_child(run_warm, shared) ||
+        shared->ok != 2) {
+        fprintf(stderr, "%zu tracks: run failed\n", tracks);
+        return -1;
+    }
+    const bench_result_t *r = shared;
+    printf("%7zu %8.1f %9.1f %9.1f %9.1f %9.1f %9.3f %9.2f %9zu %8.1f %7.0f %7.0f %8zu %6zu\n",
+           r->tracks, gen_ms, r->cold_first_ms, r->cold_scan_ms, r->warm_first_ms,
+           r->warm_scan_ms, r->shuffle_ms, r->list_ms, r->list_bytes, r->page_us, r->next_us,
+           r->next_max_us, r->memory, r->tracks ? r->memory / r->tracks : 0);
+    nftw(SD_MOUNT_POINT, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t default_sizes[] = { 100, 1000, 10000, 100000 };
+    char tmpl[] = "/tmp/lecteur_bench.XXXXXX";
+    const char *dir = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:")) != -1) {
+        if (opt != 'd') {
+            fprintf(stderr, "usage: %s [-d dir] [tracks...]\n", argv[0]);
+            return 2;
+        }
+        dir = optarg;
+    }
+    if (!dir && !(dir = mkdtemp(tmpl))) {
+        perror("mkdtemp");
+        return 1;
+    }
+    if (chdir(dir) != 0) {
+        perror(dir);
+        return 1;
+    }
+    bench_result_t *shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    printf("# %s, track ids %u bits, times in ms unless noted\n", dir,
+           (unsigned)sizeof(track_id_t) * 8);
+    printf("# tracks   gen   cold1st  coldscan   warm1st  warmscan   shuffle   list_ms"
+           "  list_B  page_us next_us nextmax   mem_B  B/trk\n");
+    int failed = 0;
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) failed |= bench_size(strtoul(argv[i], NULL, 10), shared);
+    } else {
+        for (size_t i = 0; i < sizeof(default_sizes) / sizeof(default_sizes[0]); i++) {
+            failed |= bench_size(default_sizes[i], shared);
+        }
+    }
+    if (dir == tmpl) rmdir(tmpl);
+    return failed ? 1 : 0;
+}
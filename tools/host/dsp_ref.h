@@ -0,0 +1,29 @@
+// dsp_ref.h
+/*
+ * Inclus (-include) dans la seconde compilation de audio_dsp.c et
+ * audio_eq.c, celle de la voie C (CONFIG_AUDIO_DSP_USE_ESP_DSP=0) : l'API
+ * publique y prend le préfixe ref_ pour cohabiter dans test_dsp avec la
+ * voie esp-dsp.
+ */
+#define audio_dsp_init ref_audio_dsp_init
+#define audio_dsp_set_src_info ref_audio_dsp_set_src_info
+#define audio_dsp_set_volume ref_audio_dsp_set_volume
+#define audio_dsp_set_track_gain ref_audio_dsp_set_track_gain
+#define audio_dsp_set_meter_cb ref_audio_dsp_set_meter_cb
+#define audio_dsp_cut ref_audio_dsp_cut
+#define audio_dsp_clear_cuts ref_audio_dsp_clear_cuts
+#define audio_dsp_get_last_gap ref_audio_dsp_get_last_gap
+#define audio_dsp_get_volume ref_audio_dsp_get_volume
+#define audio_dsp_get_busy_us ref_audio_dsp_get_busy_us
+#define audio_dsp_get_out_bytes ref_audio_dsp_get_out_bytes
+#define audio_dsp_get_memory ref_audio_dsp_get_memory
+
+#define audio_eq_create ref_audio_eq_create
+#define audio_eq_destroy ref_audio_eq_destroy
+#define audio_eq_set ref_audio_eq_set
+#define audio_eq_begin ref_audio_eq_begin
+#define audio_eq_process ref_audio_eq_process
+#define audio_eq_reset ref_audio_eq_reset
+#define audio_eq_get_cycles_per_sample_band ref_audio_eq_get_cycles_per_sample_band
+#define audio_eq_get_memory ref_audio_eq_get_memory
+#define audio_eq_band_is_valid ref_audio_eq_band_is_valid
@@ -0,0 +1,24 @@
+// a2dp_stream.h (hôte)
+#ifndef A2DP_STREAM_H
+#define A2DP_STREAM_H
+
+/*
+ * Émetteur A2DP de l'hôte : consomme son anneau d'entrée au rythme du PCM
+ * 44,1 kHz stéréo 16 bits, comme la pile Bluetooth, sans rien émettre.
+ */
+#include "audio_common.h"
+#include "audio_element.h"
+#include "esp_a2dp_api.h"
+
+typedef struct {
+    esp_a2d_cb_t user_a2d_cb;
+} a2dp_stream_user_callback_t;
+
+typedef struct {
+    audio_stream_type_t type;
+    a2dp_stream_user_callback_t user_callback;
+} a2dp_stream_config_t;
+
+audio_element_handle_t a2dp_stream_init(a2dp_stream_config_t *config);
+
+#endif // A2DP_STREAM_H
@@ -0,0 +1,775 @@
+// adf.c
+/*
+ * Sous-ensemble d'ESP-ADF sur l'hôte : anneaux, éléments à tâche
+ * persistante, pipeline, interface d'événements, décodeur MP3 et émetteur
+ * A2DP factices. De quoi faire tourner audio_manager.c avec ses vraies
+ * tâches et mesurer ses transitions ; ni le format ni le rythme de
+ * l'ordonnanceur ne sont ceux de la carte.
+ *
+ * Tout l'état (anneaux et éléments) est sous un seul mutex, et chaque
+ * changement réveille tous les threads en attente : grossier, mais les
+ * attentes ne peuvent pas manquer un réveil.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "a2dp_stream.h"
+#include "audio_element.h"
+#include "audio_event_iface.h"
+#include "audio_pipeline.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "mp3_decoder.h"
+#include "ringbuf.h"
+
+#define PIPELINE_MAX_ELEMENTS 8
+#define ELEMENT_TAG_LEN 16
+#define PAUSE_WAIT_US 2000000
+#define EVENT_SEND_TICKS 100
+#define SINK_BYTE_RATE (44100 * 2 * 2)
+#define SINK_CHUNK 1024             // ~6 ms de PCM par process() de l'émetteur
+
+static const char *TAG = "adf";
+
+static pthread_mutex_t adf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t adf_cond;
+static host_adf_stats_t adf_stats;
+
+__attribute__((constructor)) static void adf_init(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&adf_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void changed(void)
+{
+    pthread_cond_broadcast(&adf_cond);
+}
+
+// Attend un changement sous adf_lock ; false une fois l'échéance (µs) passée
+static bool wait_until(int64_t deadline_us)
+{
+    if (deadline_us == INT64_MAX) return pthread_cond_wait(&adf_cond, &adf_lock) == 0;
+    int64_t now = esp_timer_get_time();
+    if (deadline_us <= now) return false;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t ns = ts.tv_nsec + (deadline_us - now) * 1000;
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    return pthread_cond_timedwait(&adf_cond, &adf_lock, &ts) != ETIMEDOUT ||
+           esp_timer_get_time() < deadline_us;
+}
+
+static int64_t deadline_for(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? INT64_MAX : esp_timer_get_time() + (int64_t)ticks * 1000;
+}
+
+/* ---------- anneaux ---------- */
+
+struct ringbuf {
+    char *data;
+    int size;
+    int head;       // prochain octet lu
+    int fill;
+    bool done;      // plus d'écriture : la lecture rend RB_DONE une fois vide
+    bool aborted;
+};
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks)
+{
+    struct ringbuf *rb = calloc(1, sizeof(*rb));
+    if (!rb) return NULL;
+    rb->size = block_size * n_blocks;
+    if (!(rb->data = malloc(rb->size))) {
+        free(rb);
+        return NULL;
+    }
+    pthread_mutex_lock(&adf_lock);
+    adf_stats.ringbufs++;
+    pthread_mutex_unlock(&adf_lock);
+    return rb;
+}
+
+esp_err_t rb_destroy(ringbuf_handle_t rb)
+{
+    if (!rb) return ESP_ERR_INVALID_ARG;
+    free(rb->data);
+    free(rb);
+    return ESP_OK;
+}
+
+esp_err_t rb_abort(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock(&adf_lock);
+    rb->aborted = true;
+    changed();
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+esp_err_t rb_reset(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock(&adf_lock);
+    rb->head = rb->fill = 0;
+    rb->done = rb->aborted = false;
+    changed();
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+esp_err_t rb_done_write(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock(&adf_lock);
+    rb->done = true;
+    changed();
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+int rb_bytes_filled(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock(&adf_lock);
+    int n = rb->fill;
+    pthread_mutex_unlock(&adf_lock);
+    return n;
+}
+
+int rb_bytes_available(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock(&adf_lock);
+    int n = rb->size - rb->fill;
+    pthread_mutex_unlock(&adf_lock);
+    return n;
+}
+
+int rb_get_size(ringbuf_handle_t rb)
+{
+    return rb->size;
+}
+
+// Sous adf_lock, anneau non vide
+static int ring_take(struct ringbuf *rb, char *buf, int len)
+{
+    int n = len < rb->fill ? len : rb->fill;
+    int first = rb->size - rb->head < n ? rb->size - rb->head : n;
+    memcpy(buf, rb->data + rb->head, first);
+    memcpy(buf + first, rb->data, n - first);
+    rb->head = (rb->head + n) % rb->size;
+    rb->fill -= n;
+    changed();
+    return n;
+}
+
+// Sous adf_lock, place libre
+static int ring_put(struct ringbuf *rb, const char *buf, int len)
+{
+    int free_bytes = rb->size - rb->fill;
+    int n = len < free_bytes ? len : free_bytes;
+    int tail = (rb->head + rb->fill) % rb->size;
+    int first = rb->size - tail < n ? rb->size - tail : n;
+    memcpy(rb->data + tail, buf, first);
+    memcpy(rb->data, buf + first, n - first);
+    rb->fill += n;
+    changed();
+    return n;
+}
+
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait)
+{
+    int64_t deadline = deadline_for(ticks_to_wait);
+    int r;
+    pthread_mutex_lock(&adf_lock);
+    for (;;) {
+        if (rb->aborted) r = RB_ABORT;
+        else if (rb->fill > 0) r = ring_take(rb, buf, len);
+        else if (rb->done) r = RB_DONE;
+        else if (!wait_until(deadline)) r = RB_TIMEOUT;
+        else continue;
+        break;
+    }
+    pthread_mutex_unlock(&adf_lock);
+    return r;
+}
+
+int rb_write(ringbuf_handle_t rb, const char *buf, int len, TickType_t ticks_to_wait)
+{
+    int64_t deadline = deadline_for(ticks_to_wait);
+    int done = 0;
+    pthread_mutex_lock(&adf_lock);
+    while (done < len) {
+        if (rb->aborted) break;
+        if (rb->fill < rb->size) {
+            done += ring_put(rb, buf + done, len - done);
+        } else if (!wait_until(deadline)) {
+            break;
+        }
+    }
+    bool aborted = rb->aborted;
+    pthread_mutex_unlock(&adf_lock);
+    if (done == 0) return aborted ? RB_ABORT : RB_TIMEOUT;
+    return done;
+}
+
+/* ---------- interface d'événements ---------- */
+
+struct audio_event_iface {
+    QueueHandle_t queue;
+};
+
+audio_event_iface_handle_t audio_event_iface_init(audio_event_iface_cfg_t *config)
+{
+    struct audio_event_iface *evt = calloc(1, sizeof(*evt));
+    if (!evt) return NULL;
+    evt->queue = xQueueCreate(config->internal_queue_size + config->external_queue_size,
+                              sizeof(audio_event_iface_msg_t));
+    if (!evt->queue) {
+        free(evt);
+        return NULL;
+    }
+    return evt;
+}
+
+esp_err_t audio_event_iface_destroy(audio_event_iface_handle_t evt)
+{
+    if (!evt) return ESP_ERR_INVALID_ARG;
+    vQueueDelete(evt->queue);
+    free(evt);
+    return ESP_OK;
+}
+
+esp_err_t audio_event_iface_listen(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg,
+                                   TickType_t wait_time)
+{
+    return xQueueReceive(evt->queue, msg, wait_time) == pdTRUE ? ESP_OK : ESP_FAIL;
+}
+
+/* ---------- éléments ---------- */
+
+struct audio_element {
+    audio_element_cfg_t cfg;
+    char tag[ELEMENT_TAG_LEN];
+    audio_element_info_t info;
+    stream_func read_cb;
+    void *read_ctx;
+    stream_func write_cb;
+    void *write_ctx;
+    ringbuf_handle_t in;
+    ringbuf_handle_t out;
+    audio_event_iface_handle_t listener;
+    TaskHandle_t task;
+    // sous adf_lock
+    audio_element_state_t state;
+    bool is_open;
+    bool pause_req;
+    bool holding;       // tâche suspendue sur pause_req
+    bool stop_req;      // tâche pas encore revenue au repos
+};
+
+audio_element_handle_t audio_element_init(audio_element_cfg_t *config)
+{
+    struct audio_element *el = calloc(1, sizeof(*el));
+    if (!el) return NULL;
+    el->cfg = *config;
+    if (el->cfg.buffer_len <= 0) el->cfg.buffer_len = 1024;
+    strlcpy(el->tag, config->tag ? config->tag : "element", sizeof(el->tag));
+    el->state = AEL_STATE_INIT;
+    pthread_mutex_lock(&adf_lock);
+    adf_stats.elements++;
+    pthread_mutex_unlock(&adf_lock);
+    return el;
+}
+
+esp_err_t audio_element_deinit(audio_element_handle_t el)
+{
+    // la tâche ne s'arrête pas ici : main/ ne détruit jamais ses éléments
+    ESP_LOGE(TAG, "audio_element_deinit(%s) is not supported on the host", el->tag);
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void *audio_element_getdata(audio_element_handle_t el)
+{
+    return el->cfg.data;
+}
+
+esp_err_t audio_element_setdata(audio_element_handle_t el, void *data)
+{
+    el->cfg.data = data;
+    return ESP_OK;
+}
+
+static void report(audio_element_handle_t el, int cmd, intptr_t data)
+{
+    if (!el->listener) return;
+    audio_event_iface_msg_t msg = {
+        .cmd = cmd,
+        .data = (void *)data,
+        .source = el,
+        .source_type = AUDIO_ELEMENT_TYPE_ELEMENT,
+    };
+    if (xQueueSend(el->listener->queue, &msg, EVENT_SEND_TICKS) != pdTRUE) {
+        ESP_LOGW(TAG, "%s: event %d dropped", el->tag, cmd);
+    }
+}
+
+// Sous adf_lock : reste suspendu tant que la pause est demandée
+static void hold(audio_element_handle_t el)
+{
+    el->holding = true;
+    changed();
+    while (el->pause_req && !el->stop_req) wait_until(INT64_MAX);
+    el->holding = false;
+}
+
+audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size)
+{
+    if (el->read_cb) return el->read_cb(el, buffer, wanted_size, portMAX_DELAY, el->read_ctx);
+    if (!el->in) return AEL_IO_FAIL;
+    struct ringbuf *rb = el->in;
+    int r;
+    pthread_mutex_lock(&adf_lock);
+    for (;;) {
+        if (rb->aborted) r = AEL_IO_ABORT;
+        else if (rb->fill > 0) r = ring_take(rb, buffer, wanted_size);
+        else if (rb->done) r = AEL_IO_DONE;
+        // rien de lu : la pause ou l'arrêt est pris par la boucle de la tâche
+        else if (el->pause_req || el->stop_req) r = AEL_IO_TIMEOUT;
+        else {
+            wait_until(INT64_MAX);
+            continue;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&adf_lock);
+    return r;
+}
+
+audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size)
+{
+    if (el->write_cb) return el->write_cb(el, buffer, write_size, portMAX_DELAY, el->write_ctx);
+    if (!el->out) return write_size;
+    struct ringbuf *rb = el->out;
+    int done = 0;
+    pthread_mutex_lock(&adf_lock);
+    while (done < write_size && !rb->aborted) {
+        if (rb->fill < rb->size) {
+            done += ring_put(rb, buffer + done, write_size - done);
+        } else if (el->pause_req && !el->stop_req) {
+            // anneau plein : la pause est prise ici, le reste est écrit à la reprise
+            hold(el);
+        } else {
+            wait_until(INT64_MAX);
+        }
+    }
+    bool aborted = rb->aborted;
+    pthread_mutex_unlock(&adf_lock);
+    return aborted ? AEL_IO_ABORT : done;
+}
+
+esp_err_t audio_element_set_read_cb(audio_element_handle_t el, stream_func fn, void *context)
+{
+    el->read_cb = fn;
+    el->read_ctx = context;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_write_cb(audio_element_handle_t el, stream_func fn, void *context)
+{
+    el->write_cb = fn;
+    el->write_ctx = context;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_music_info(audio_element_handle_t el, int sample_rates, int channels,
+                                       int bits)
+{
+    pthread_mutex_lock(&adf_lock);
+    el->info.sample_rates = sample_rates;
+    el->info.channels = channels;
+    el->info.bits = bits;
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_getinfo(audio_element_handle_t el, audio_element_info_t *info)
+{
+    pthread_mutex_lock(&adf_lock);
+    *info = el->info;
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_element_report_info(audio_element_handle_t el)
+{
+    report(el, AEL_MSG_CMD_REPORT_MUSIC_INFO, 0);
+    return ESP_OK;
+}
+
+audio_element_state_t audio_element_get_state(audio_element_handle_t el)
+{
+    pthread_mutex_lock(&adf_lock);
+    audio_element_state_t st = el->state == AEL_STATE_RUNNING && el->holding ? AEL_STATE_PAUSED : el->state;
+    pthread_mutex_unlock(&adf_lock);
+    return st;
+}
+
+ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el)
+{
+    return el->out;
+}
+
+esp_err_t audio_element_pause(audio_element_handle_t el)
+{
+    esp_err_t err = ESP_OK;
+    int64_t deadline = esp_timer_get_time() + PAUSE_WAIT_US;
+    pthread_mutex_lock(&adf_lock);
+    if (el->task && el->state == AEL_STATE_RUNNING) {
+        el->pause_req = true;
+        changed();
+        while (!el->holding && el->state == AEL_STATE_RUNNING && !el->stop_req) {
+            if (!wait_until(deadline)) {
+                err = ESP_FAIL;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&adf_lock);
+    if (err != ESP_OK) ESP_LOGE(TAG, "%s: not paused", el->tag);
+    return err;
+}
+
+esp_err_t audio_element_resume(audio_element_handle_t el, float wait_for_rb_threshold,
+                               TickType_t timeout)
+{
+    pthread_mutex_lock(&adf_lock);
+    el->pause_req = false;
+    changed();
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+// Sous adf_lock, rendu dans le même état
+static void close_element(audio_element_handle_t el)
+{
+    if (!el->is_open) return;
+    el->is_open = false;
+    pthread_mutex_unlock(&adf_lock);
+    if (el->cfg.close) el->cfg.close(el);
+    pthread_mutex_lock(&adf_lock);
+}
+
+/*
+ * Tâche de l'élément, jamais terminée : au repos hors de RUNNING, elle
+ * ouvre l'élément au démarrage et le ferme à l'arrêt ou en fin de flux.
+ */
+static void element_task(void *arg)
+{
+    audio_element_handle_t el = arg;
+    char *buf = malloc(el->cfg.buffer_len);
+    if (!buf) {
+        ESP_LOGE(TAG, "%s: no memory for the buffer", el->tag);
+        vTaskDelete(NULL);
+    }
+    pthread_mutex_lock(&adf_lock);
+    for (;;) {
+        if (el->stop_req) {
+            close_element(el);
+            el->state = AEL_STATE_STOPPED;
+            el->stop_req = false;
+            changed();
+            continue;
+        }
+        if (el->state != AEL_STATE_RUNNING) {
+            wait_until(INT64_MAX);
+            continue;
+        }
+        if (el->pause_req) {
+            hold(el);
+            continue;
+        }
+        if (!el->is_open) {
+            pthread_mutex_unlock(&adf_lock);
+            esp_err_t err = el->cfg.open ? el->cfg.open(el) : ESP_OK;
+            pthread_mutex_lock(&adf_lock);
+            if (err != ESP_OK) {
+                el->state = AEL_STATE_ERROR;
+                pthread_mutex_unlock(&adf_lock);
+                if (el->cfg.close) el->cfg.close(el);
+                report(el, AEL_MSG_CMD_REPORT_STATUS, AEL_STATUS_ERROR_OPEN);
+                pthread_mutex_lock(&adf_lock);
+                continue;
+            }
+            el->is_open = true;
+        }
+        pthread_mutex_unlock(&adf_lock);
+        int r = el->cfg.process(el, buf, el->cfg.buffer_len);
+        pthread_mutex_lock(&adf_lock);
+        if (r >= 0 || r == AEL_IO_TIMEOUT || r == AEL_IO_ABORT) continue;
+
+        // fin du flux ou erreur : l'aval est prévenu, l'élément est fermé
+        if (el->out) {
+            el->out->done = true;
+            changed();
+        }
+        close_element(el);
+        if (el->stop_req) continue;
+        int status = r == AEL_IO_DONE ? AEL_STATUS_STATE_FINISHED : AEL_STATUS_ERROR_PROCESS;
+        el->state = r == AEL_IO_DONE ? AEL_STATE_FINISHED : AEL_STATE_ERROR;
+        pthread_mutex_unlock(&adf_lock);
+        report(el, AEL_MSG_CMD_REPORT_STATUS, status);
+        pthread_mutex_lock(&adf_lock);
+    }
+}
+
+/* ---------- pipeline ---------- */
+
+struct audio_pipeline {
+    audio_element_handle_t els[PIPELINE_MAX_ELEMENTS];
+    char names[PIPELINE_MAX_ELEMENTS][ELEMENT_TAG_LEN];
+    int count;
+    audio_element_handle_t linked[PIPELINE_MAX_ELEMENTS];
+    int linked_count;
+};
+
+audio_pipeline_handle_t audio_pipeline_init(audio_pipeline_cfg_t *config)
+{
+    struct audio_pipeline *p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    pthread_mutex_lock(&adf_lock);
+    adf_stats.pipelines++;
+    pthread_mutex_unlock(&adf_lock);
+    return p;
+}
+
+esp_err_t audio_pipeline_deinit(audio_pipeline_handle_t pipeline)
+{
+    ESP_LOGE(TAG, "audio_pipeline_deinit is not supported on the host");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t audio_pipeline_register(audio_pipeline_handle_t pipeline, audio_element_handle_t el,
+                                  const char *name)
+{
+    if (!el || pipeline->count == PIPELINE_MAX_ELEMENTS) return ESP_FAIL;
+    strlcpy(pipeline->names[pipeline->count], name, ELEMENT_TAG_LEN);
+    pipeline->els[pipeline->count++] = el;
+    return ESP_OK;
+}
+
+static audio_element_handle_t find_element(audio_pipeline_handle_t pipeline, const char *name)
+{
+    for (int i = 0; i < pipeline->count; i++) {
+        if (strcmp(pipeline->names[i], name) == 0) return pipeline->els[i];
+    }
+    return NULL;
+}
+
+esp_err_t audio_pipeline_link(audio_pipeline_handle_t pipeline, const char *link_tag[],
+                              int link_num)
+{
+    if (pipeline->linked_count || link_num > PIPELINE_MAX_ELEMENTS) return ESP_FAIL;
+    for (int i = 0; i < link_num; i++) {
+        audio_element_handle_t el = find_element(pipeline, link_tag[i]);
+        if (!el) return ESP_FAIL;
+        if (i > 0) {
+            audio_element_handle_t up = pipeline->linked[i - 1];
+            ringbuf_handle_t rb = rb_create(up->cfg.out_rb_size, 1);
+            if (!rb) return ESP_ERR_NO_MEM;
+            up->out = el->in = rb;
+        }
+        pipeline->linked[pipeline->linked_count++] = el;
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_set_listener(audio_pipeline_handle_t pipeline,
+                                      audio_event_iface_handle_t evt)
+{
+    for (int i = 0; i < pipeline->linked_count; i++) pipeline->linked[i]->listener = evt;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_run(audio_pipeline_handle_t pipeline)
+{
+    for (int i = 0; i < pipeline->linked_count; i++) {
+        audio_element_handle_t el = pipeline->linked[i];
+        if (el->task) continue;
+        if (xTaskCreatePinnedToCore(element_task, el->tag, el->cfg.task_stack, el,
+                                    el->cfg.task_prio, &el->task, el->cfg.task_core) != pdPASS) {
+            return ESP_FAIL;
+        }
+        pthread_mutex_lock(&adf_lock);
+        adf_stats.element_tasks++;
+        pthread_mutex_unlock(&adf_lock);
+    }
+    pthread_mutex_lock(&adf_lock);
+    for (int i = 0; i < pipeline->linked_count; i++) {
+        audio_element_handle_t el = pipeline->linked[i];
+        el->state = AEL_STATE_RUNNING;
+        el->pause_req = false;
+    }
+    changed();
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_stop(audio_pipeline_handle_t pipeline)
+{
+    pthread_mutex_lock(&adf_lock);
+    for (int i = 0; i < pipeline->linked_count; i++) {
+        audio_element_handle_t el = pipeline->linked[i];
+        if (el->task) el->stop_req = true;
+        if (el->out) el->out->aborted = true;
+    }
+    changed();
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_wait_for_stop(audio_pipeline_handle_t pipeline)
+{
+    esp_err_t err = ESP_OK;
+    int64_t deadline = esp_timer_get_time() + PAUSE_WAIT_US;
+    pthread_mutex_lock(&adf_lock);
+    for (int i = 0; i < pipeline->linked_count && err == ESP_OK; i++) {
+        while (pipeline->linked[i]->stop_req) {
+            if (!wait_until(deadline)) {
+                ESP_LOGE(TAG, "%s: not stopped", pipeline->linked[i]->tag);
+                err = ESP_FAIL;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&adf_lock);
+    return err;
+}
+
+esp_err_t audio_pipeline_pause(audio_pipeline_handle_t pipeline)
+{
+    esp_err_t err = ESP_OK;
+    for (int i = 0; i < pipeline->linked_count; i++) {
+        if (audio_element_pause(pipeline->linked[i]) != ESP_OK) err = ESP_FAIL;
+    }
+    return err;
+}
+
+esp_err_t audio_pipeline_resume(audio_pipeline_handle_t pipeline)
+{
+    for (int i = 0; i < pipeline->linked_count; i++) {
+        audio_element_resume(pipeline->linked[i], 0, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_reset_ringbuffer(audio_pipeline_handle_t pipeline)
+{
+    for (int i = 0; i < pipeline->linked_count; i++) {
+        if (pipeline->linked[i]->out) rb_reset(pipeline->linked[i]->out);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_change_state(audio_pipeline_handle_t pipeline,
+                                      audio_element_state_t new_state)
+{
+    pthread_mutex_lock(&adf_lock);
+    for (int i = 0; i < pipeline->linked_count; i++) pipeline->linked[i]->state = new_state;
+    changed();
+    pthread_mutex_unlock(&adf_lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_reset_elements(audio_pipeline_handle_t pipeline)
+{
+    return audio_pipeline_change_state(pipeline, AEL_STATE_INIT);
+}
+
+void host_adf_get_stats(host_adf_stats_t *out)
+{
+    pthread_mutex_lock(&adf_lock);
+    *out = adf_stats;
+    pthread_mutex_unlock(&adf_lock);
+}
+
+/* ---------- décodeur et émetteur factices ---------- */
+
+// Recopie le PCM lu et annonce son format au premier bloc
+static audio_element_err_t mp3_process(audio_element_handle_t self, char *buf, int len)
+{
+    bool *reported = audio_element_getdata(self);
+    int r = audio_element_input(self, buf, len);
+    if (r <= 0) return r;
+    if (!*reported) {
+        *reported = true;
+        audio_element_set_music_info(self, 44100, 2, 16);
+        audio_element_report_info(self);
+    }
+    return audio_element_output(self, buf, r);
+}
+
+static esp_err_t mp3_open(audio_element_handle_t self)
+{
+    *(bool *)audio_element_getdata(self) = false;
+    return ESP_OK;
+}
+
+audio_element_handle_t mp3_decoder_init(mp3_decoder_cfg_t *config)
+{
+    static bool reported;
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = mp3_open;
+    cfg.process = mp3_process;
+    cfg.buffer_len = 2 * 1024;
+    cfg.task_stack = config->task_stack;
+    cfg.task_prio = config->task_prio;
+    cfg.task_core = config->task_core;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.data = &reported;
+    cfg.tag = "mp3";
+    return audio_element_init(&cfg);
+}
+
+static int64_t sink_due_us;     // fin de lecture de ce qui a été consommé
+
+static esp_err_t a2dp_open(audio_element_handle_t self)
+{
+    sink_due_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+/*
+ * Consomme au rythme de la lecture ; l'attente est écourtée par une pause
+ * ou un arrêt, comme le serait le retour du callback de la pile.
+ */
+static audio_element_err_t a2dp_process(audio_element_handle_t self, char *buf, int len)
+{
+    int r = audio_element_input(self, buf, len);
+    if (r <= 0) return r;
+    int64_t now = esp_timer_get_time();
+    if (sink_due_us < now) sink_due_us = now;     // après une pause, pas de rattrapage
+    sink_due_us += (int64_t)r * 1000000 / SINK_BYTE_RATE;
+    pthread_mutex_lock(&adf_lock);
+    adf_stats.sink_bytes += r;
+    while (!self->pause_req && !self->stop_req && wait_until(sink_due_us)) {
+    }
+    pthread_mutex_unlock(&adf_lock);
+    return r;
+}
+
+audio_element_handle_t a2dp_stream_init(a2dp_stream_config_t *config)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = a2dp_open;
+    cfg.process = a2dp_process;
+    cfg.buffer_len = SINK_CHUNK;
+    cfg.tag = "bt";
+    return audio_element_init(&cfg);
+}
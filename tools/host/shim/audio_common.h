@@ -0,0 +1,20 @@
+// audio_common.h (hôte)
+#ifndef AUDIO_COMMON_H
+#define AUDIO_COMMON_H
+
+// Sous-ensemble d'ESP-ADF, mêmes valeurs que l'original
+typedef enum {
+    AUDIO_STREAM_NONE = 0,
+    AUDIO_STREAM_READER,
+    AUDIO_STREAM_WRITER,
+} audio_stream_type_t;
+
+typedef enum {
+    AUDIO_ELEMENT_TYPE_UNKNOW = 0x01 << 24,
+    AUDIO_ELEMENT_TYPE_ELEMENT = 0x01 << 25,
+    AUDIO_ELEMENT_TYPE_PLAYER = 0x01 << 26,
+    AUDIO_ELEMENT_TYPE_SERVICE = 0x01 << 27,
+    AUDIO_ELEMENT_TYPE_PERIPH = 0x01 << 28,
+} audio_element_type_t;
+
+#endif // AUDIO_COMMON_H
@@ -0,0 +1,141 @@
+// audio_element.h (hôte)
+#ifndef AUDIO_ELEMENT_H
+#define AUDIO_ELEMENT_H
+
+/*
+ * Sous-ensemble d'ESP-ADF (shim/adf.c). Comme sur la carte, chaque élément
+ * a sa tâche, créée au premier audio_pipeline_run() et gardée ensuite :
+ * open() au démarrage, process() en boucle, close() à l'arrêt ou en fin de
+ * flux. Une pause est prise entre deux process() ou pendant une attente
+ * sur un anneau, sans perdre de données.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio_common.h"
+#include "audio_event_iface.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "ringbuf.h"
+
+typedef enum {
+    AEL_IO_OK = ESP_OK,
+    AEL_IO_FAIL = ESP_FAIL,
+    AEL_IO_DONE = -2,
+    AEL_IO_ABORT = -3,
+    AEL_IO_TIMEOUT = -4,
+    AEL_PROCESS_FAIL = -5,
+} audio_element_err_t;
+
+typedef enum {
+    AEL_STATE_NONE = 0,
+    AEL_STATE_INIT,
+    AEL_STATE_INITIALIZING,
+    AEL_STATE_RUNNING,
+    AEL_STATE_PAUSED,
+    AEL_STATE_STOPPED,
+    AEL_STATE_FINISHED,
+    AEL_STATE_ERROR,
+} audio_element_state_t;
+
+typedef enum {
+    AEL_MSG_CMD_NONE = 0,
+    AEL_MSG_CMD_ERROR = 1,
+    AEL_MSG_CMD_FINISH = 2,
+    AEL_MSG_CMD_STOP = 3,
+    AEL_MSG_CMD_PAUSE = 4,
+    AEL_MSG_CMD_RESUME = 5,
+    AEL_MSG_CMD_DESTROY = 6,
+    AEL_MSG_CMD_REPORT_STATUS = 8,
+    AEL_MSG_CMD_REPORT_MUSIC_INFO = 9,
+    AEL_MSG_CMD_REPORT_CODEC_FMT = 10,
+    AEL_MSG_CMD_REPORT_POSITION = 11,
+} audio_element_msg_cmd_t;
+
+typedef enum {
+    AEL_STATUS_NONE = 0,
+    AEL_STATUS_ERROR_OPEN = 1,
+    AEL_STATUS_ERROR_INPUT = 2,
+    AEL_STATUS_ERROR_PROCESS = 3,
+    AEL_STATUS_ERROR_OUTPUT = 4,
+    AEL_STATUS_ERROR_CLOSE = 5,
+    AEL_STATUS_ERROR_TIMEOUT = 6,
+    AEL_STATUS_ERROR_UNKNOWN = 7,
+    AEL_STATUS_INPUT_DONE = 8,
+    AEL_STATUS_INPUT_BUFFERING = 9,
+    AEL_STATUS_OUTPUT_DONE = 10,
+    AEL_STATUS_OUTPUT_BUFFERING = 11,
+    AEL_STATUS_STATE_RUNNING = 12,
+    AEL_STATUS_STATE_PAUSED = 13,
+    AEL_STATUS_STATE_STOPPED = 14,
+    AEL_STATUS_STATE_FINISHED = 15,
+} audio_element_status_t;
+
+typedef struct {
+    int sample_rates;
+    int channels;
+    int bits;
+    int bps;
+    int64_t byte_pos;
+    int64_t total_bytes;
+    int duration;
+} audio_element_info_t;
+
+typedef struct audio_element *audio_element_handle_t;
+
+typedef esp_err_t (*el_io_func)(audio_element_handle_t self);
+typedef audio_element_err_t (*process_func)(audio_element_handle_t self, char *el_buffer,
+                                            int el_buf_len);
+typedef audio_element_err_t (*stream_func)(audio_element_handle_t self, char *buffer, int len,
+                                           TickType_t ticks_to_wait, void *context);
+
+typedef struct {
+    el_io_func open;
+    el_io_func seek;
+    process_func process;
+    el_io_func close;
+    el_io_func destroy;
+    stream_func read;
+    stream_func write;
+    int buffer_len;
+    int task_stack;
+    int task_prio;
+    int task_core;
+    int out_rb_size;
+    void *data;
+    const char *tag;
+    bool stack_in_ext;
+} audio_element_cfg_t;
+
+#define DEFAULT_AUDIO_ELEMENT_CONFIG() { \
+    .buffer_len = 1024,                  \
+    .task_stack = 4 * 1024,              \
+    .task_prio = 5,                      \
+    .task_core = 0,                      \
+    .out_rb_size = 8 * 1024,             \
+}
+
+audio_element_handle_t audio_element_init(audio_element_cfg_t *config);
+esp_err_t audio_element_deinit(audio_element_handle_t el);
+void *audio_element_getdata(audio_element_handle_t el);
+esp_err_t audio_element_setdata(audio_element_handle_t el, void *data);
+
+// Lit l'anneau d'entrée, ou le callback de lecture s'il y en a un ;
+// de même en sortie avec le callback d'écriture
+audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size);
+audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size);
+
+esp_err_t audio_element_set_read_cb(audio_element_handle_t el, stream_func fn, void *context);
+esp_err_t audio_element_set_write_cb(audio_element_handle_t el, stream_func fn, void *context);
+esp_err_t audio_element_set_music_info(audio_element_handle_t el, int sample_rates, int channels,
+                                       int bits);
+esp_err_t audio_element_getinfo(audio_element_handle_t el, audio_element_info_t *info);
+esp_err_t audio_element_report_info(audio_element_handle_t el);
+audio_element_state_t audio_element_get_state(audio_element_handle_t el);
+ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el);
+
+// Attend que la tâche de l'élément soit suspendue (2 s au plus)
+esp_err_t audio_element_pause(audio_element_handle_t el);
+esp_err_t audio_element_resume(audio_element_handle_t el, float wait_for_rb_threshold,
+                               TickType_t timeout);
+
+#endif // AUDIO_ELEMENT_H
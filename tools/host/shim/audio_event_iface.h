@@ -0,0 +1,43 @@
+// audio_event_iface.h (hôte)
+#ifndef AUDIO_EVENT_IFACE_H
+#define AUDIO_EVENT_IFACE_H
+
+/*
+ * Interface d'événements d'ESP-ADF réduite à une file : les éléments du
+ * pipeline y postent leurs messages, l'écouteur les reçoit.
+ */
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    int cmd;
+    void *data;
+    int data_len;
+    void *source;
+    int source_type;
+    bool need_free_data;
+} audio_event_iface_msg_t;
+
+typedef struct {
+    int internal_queue_size;
+    int external_queue_size;
+    int queue_set_size;
+    TickType_t wait_time;
+} audio_event_iface_cfg_t;
+
+#define AUDIO_EVENT_IFACE_DEFAULT_CFG() { \
+    .internal_queue_size = 5,             \
+    .external_queue_size = 5,             \
+    .queue_set_size = 5,                  \
+    .wait_time = portMAX_DELAY,           \
+}
+
+typedef struct audio_event_iface *audio_event_iface_handle_t;
+
+audio_event_iface_handle_t audio_event_iface_init(audio_event_iface_cfg_t *config);
+esp_err_t audio_event_iface_destroy(audio_event_iface_handle_t evt);
+esp_err_t audio_event_iface_listen(audio_event_iface_handle_t evt, audio_event_iface_msg_t *msg,
+                                   TickType_t wait_time);
+
+#endif // AUDIO_EVENT_IFACE_H
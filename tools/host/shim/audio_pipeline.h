@@ -0,0 +1,53 @@
+// audio_pipeline.h (hôte)
+#ifndef AUDIO_PIPELINE_H
+#define AUDIO_PIPELINE_H
+
+/*
+ * Pipeline d'ESP-ADF (shim/adf.c) : éléments enregistrés par nom, reliés
+ * en chaîne par un anneau de la taille out_rb_size de l'élément amont.
+ */
+#include <stdint.h>
+#include "audio_element.h"
+#include "audio_event_iface.h"
+#include "esp_err.h"
+
+typedef struct {
+    int rb_size;
+} audio_pipeline_cfg_t;
+
+#define DEFAULT_AUDIO_PIPELINE_CONFIG() { \
+    .rb_size = 8 * 1024,                  \
+}
+
+typedef struct audio_pipeline *audio_pipeline_handle_t;
+
+audio_pipeline_handle_t audio_pipeline_init(audio_pipeline_cfg_t *config);
+esp_err_t audio_pipeline_deinit(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_register(audio_pipeline_handle_t pipeline, audio_element_handle_t el,
+                                  const char *name);
+esp_err_t audio_pipeline_link(audio_pipeline_handle_t pipeline, const char *link_tag[],
+                              int link_num);
+esp_err_t audio_pipeline_set_listener(audio_pipeline_handle_t pipeline,
+                                      audio_event_iface_handle_t evt);
+esp_err_t audio_pipeline_run(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_stop(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_wait_for_stop(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_pause(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_resume(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_reset_ringbuffer(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_reset_elements(audio_pipeline_handle_t pipeline);
+esp_err_t audio_pipeline_change_state(audio_pipeline_handle_t pipeline,
+                                      audio_element_state_t new_state);
+
+// Compteurs de l'hôte : ce que le pipeline a créé depuis le début du programme
+typedef struct {
+    unsigned pipelines;
+    unsigned elements;
+    unsigned ringbufs;
+    unsigned element_tasks;
+    uint64_t sink_bytes;        // octets consommés par l'émetteur A2DP
+} host_adf_stats_t;
+
+void host_adf_get_stats(host_adf_stats_t *out);
+
+#endif // AUDIO_PIPELINE_H
@@ -0,0 +1,25 @@
+// driver/sdmmc_host.h (hôte)
+#ifndef DRIVER_SDMMC_HOST_H
+#define DRIVER_SDMMC_HOST_H
+
+#include <stdint.h>
+
+#define SDMMC_FREQ_DEFAULT 20000
+#define SDMMC_FREQ_HIGHSPEED 40000
+
+typedef struct {
+    int max_freq_khz;
+} sdmmc_host_t;
+
+typedef struct {
+    int width;
+} sdmmc_slot_config_t;
+
+typedef struct {
+    int real_freq_khz;
+} sdmmc_card_t;
+
+#define SDMMC_HOST_DEFAULT() { .max_freq_khz = SDMMC_FREQ_DEFAULT }
+#define SDMMC_SLOT_CONFIG_DEFAULT() { .width = 1 }
+
+#endif // DRIVER_SDMMC_HOST_H
@@ -0,0 +1,25 @@
+// dsps_biquad.h (hôte)
+#ifndef DSPS_BIQUAD_H
+#define DSPS_BIQUAD_H
+
+/*
+ * esp-dsp sur l'hôte : version de référence (ANSI) de la bibliothèque,
+ * recopiée. Forme directe II, coefficients {b0, b1, b2, a1, a2}.
+ */
+#include "esp_err.h"
+
+static inline esp_err_t dsps_biquad_f32_ansi(const float *input, float *output, int len,
+                                             float *coef, float *w)
+{
+    for (int i = 0; i < len; i++) {
+        float d0 = input[i] - coef[3] * w[0] - coef[4] * w[1];
+        output[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+        w[1] = w[0];
+        w[0] = d0;
+    }
+    return ESP_OK;
+}
+
+#define dsps_biquad_f32 dsps_biquad_f32_ansi
+
+#endif // DSPS_BIQUAD_H
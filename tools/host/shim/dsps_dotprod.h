@@ -0,0 +1,30 @@
+// dsps_dotprod.h (hôte)
+#ifndef DSPS_DOTPROD_H
+#define DSPS_DOTPROD_H
+
+/*
+ * esp-dsp sur l'hôte : la version de référence (ANSI) de la bibliothèque,
+ * recopiée, celle contre laquelle esp-dsp teste ses versions optimisées.
+ */
+#include <stdint.h>
+#include "esp_err.h"
+
+static inline esp_err_t dsps_dotprod_s16_ansi(const int16_t *src1, const int16_t *src2,
+                                              int16_t *dest, int len, int8_t shift)
+{
+    long long acc = 0x7fff >> shift;
+    for (int i = 0; i < len; i++) {
+        acc += (int32_t)src1[i] * (int32_t)src2[i];
+    }
+    int final_shift = shift - 15;
+    if (final_shift > 0) {
+        *dest = (int16_t)(acc << final_shift);
+    } else {
+        *dest = (int16_t)(acc >> (-final_shift));
+    }
+    return ESP_OK;
+}
+
+#define dsps_dotprod_s16 dsps_dotprod_s16_ansi
+
+#endif // DSPS_DOTPROD_H
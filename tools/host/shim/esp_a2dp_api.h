@@ -0,0 +1,20 @@
+// esp_a2dp_api.h (hôte)
+#ifndef ESP_A2DP_API_H
+#define ESP_A2DP_API_H
+
+/*
+ * Pas de pile Bluetooth sur l'hôte : juste de quoi déclarer le callback
+ * A2DP de bt_control.h.
+ */
+typedef enum {
+    ESP_A2D_CONNECTION_STATE_EVT = 0,
+    ESP_A2D_AUDIO_STATE_EVT,
+    ESP_A2D_AUDIO_CFG_EVT,
+    ESP_A2D_MEDIA_CTRL_ACK_EVT,
+} esp_a2d_cb_event_t;
+
+typedef union esp_a2d_cb_param esp_a2d_cb_param_t;
+
+typedef void (*esp_a2d_cb_t)(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param);
+
+#endif // ESP_A2DP_API_H
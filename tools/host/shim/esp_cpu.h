@@ -0,0 +1,16 @@
+// esp_cpu.h (hôte)
+#ifndef ESP_CPU_H
+#define ESP_CPU_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Compteur de cycles d'un cœur à 240 MHz, déduit de l'horloge monotone à la ns
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec) * 240 / 1000);
+}
+
+#endif // ESP_CPU_H
@@ -0,0 +1,62 @@
+// esp_http_server.h (hôte)
+#ifndef ESP_HTTP_SERVER_H
+#define ESP_HTTP_SERVER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+#define ESP_ERR_HTTPD_BASE 0xb000
+#define ESP_ERR_HTTPD_HANDLERS_FULL (ESP_ERR_HTTPD_BASE + 1)
+#define ESP_ERR_HTTPD_HANDLER_EXISTS (ESP_ERR_HTTPD_BASE + 2)
+#define ESP_ERR_HTTPD_RESULT_TRUNC (ESP_ERR_HTTPD_BASE + 4)
+
+/*
+ * Une requête qui ne va nulle part : le corps envoyé est compté et, si
+ * body est fourni, recopié tant qu'il y a de la place. query et headers
+ * sont posés par le test avant l'appel du gestionnaire.
+ */
+typedef struct httpd_req {
+    const char *query;      // partie de l'URL après '?', ou NULL
+    const char *headers;    // lignes "Nom: valeur\n", ou NULL
+    size_t sent;            // octets du corps
+    size_t chunks;          // appels à httpd_resp_send_chunk (hors fin)
+    char *body;
+    size_t body_size;
+    const char *type;       // dernier httpd_resp_set_type
+    int status;             // code de httpd_resp_set_status ou 500, 0 sinon
+} httpd_req_t;
+
+typedef void *httpd_handle_t;
+
+typedef enum {
+    HTTP_GET = 1,
+    HTTP_POST = 3,
+} httpd_method_t;
+
+typedef struct httpd_uri {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+} httpd_uri_t;
+
+size_t httpd_req_get_url_query_len(httpd_req_t *req);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *req, char *buf, size_t buf_len);
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size);
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status);
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t len);
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value);
+esp_err_t httpd_resp_send_500(httpd_req_t *req);
+
+/*
+ * Le serveur n'existe pas : les gestionnaires enregistrés sont gardés pour
+ * que les tests les retrouvent par host_httpd_find().
+ */
+esp_err_t httpd_register_uri_handler(httpd_handle_t server, const httpd_uri_t *uri);
+const httpd_uri_t *host_httpd_find(const char *uri, httpd_method_t method);
+
+#endif // ESP_HTTP_SERVER_H
@@ -0,0 +1,7 @@
+// esp_peripherals.h (hôte)
+#ifndef ESP_PERIPHERALS_H
+#define ESP_PERIPHERALS_H
+
+// Inclus par audio_manager.c ; aucun périphérique ADF n'est utilisé sur l'hôte
+
+#endif // ESP_PERIPHERALS_H
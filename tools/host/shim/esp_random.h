@@ -0,0 +1,11 @@
+// esp_random.h (hôte)
+#ifndef ESP_RANDOM_H
+#define ESP_RANDOM_H
+
+#include <stdint.h>
+
+// xorshift32 : reproductible d'une exécution à l'autre pour une même graine
+uint32_t esp_random(void);
+void host_random_seed(uint32_t seed);
+
+#endif // ESP_RANDOM_H
@@ -0,0 +1,10 @@
+// esp_rom_crc.h (hôte)
+#ifndef ESP_ROM_CRC_H
+#define ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC-32 IEEE 802.3 chaîné comme celui de la ROM (et de zlib)
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // ESP_ROM_CRC_H
@@ -0,0 +1,23 @@
+// esp_vfs_fat.h (hôte)
+#ifndef ESP_VFS_FAT_H
+#define ESP_VFS_FAT_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/sdmmc_host.h"
+
+typedef struct {
+    bool format_if_mount_failed;
+    int max_files;
+    size_t allocation_unit_size;
+} esp_vfs_fat_mount_config_t;
+
+/*
+ * Pas de carte : le point de montage est un répertoire de l'hôte, qui doit
+ * exister (ESP_ERR_NOT_FOUND sinon).
+ */
+esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path, const sdmmc_host_t *host,
+                                  const void *slot, const esp_vfs_fat_mount_config_t *cfg,
+                                  sdmmc_card_t **out_card);
+
+#endif // ESP_VFS_FAT_H
@@ -0,0 +1,57 @@
+// freertos/FreeRTOS.h (hôte)
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+/*
+ * Sous-ensemble de l'API FreeRTOS d'ESP-IDF utilisé par main/, au-dessus des
+ * threads POSIX (shim.c). Un tick vaut une milliseconde.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#ifndef BIT0
+#define BIT0 (1u << 0)
+#define BIT1 (1u << 1)
+#define BIT2 (1u << 2)
+#define BIT3 (1u << 3)
+#define BIT4 (1u << 4)
+#define BIT5 (1u << 5)
+#define BIT6 (1u << 6)
+#define BIT7 (1u << 7)
+#endif
+
+/*
+ * Toutes les sections critiques partagent un seul mutex récursif : plus
+ * grossier que les spinlocks du port ESP32, mais la sémantique est la même.
+ */
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portMUX_INITIALIZE(mux) ((void)(mux))
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+
+#define taskENTER_CRITICAL(mux) ((void)(mux), host_critical_enter())
+#define taskEXIT_CRITICAL(mux) ((void)(mux), host_critical_exit())
+#define portENTER_CRITICAL taskENTER_CRITICAL
+#define portEXIT_CRITICAL taskEXIT_CRITICAL
+
+#endif // FREERTOS_H
@@ -0,0 +1,17 @@
+// freertos/semphr.h (hôte)
+#ifndef FREERTOS_SEMPHR_H
+#define FREERTOS_SEMPHR_H
+
+#include "freertos/queue.h"
+
+// Un sémaphore est une file d'éléments vides, comme dans FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+#define xSemaphoreTake(s, timeout) xQueueReceive(s, NULL, timeout)
+#define xSemaphoreGive(s) xQueueSend(s, NULL, 0)
+#define vSemaphoreDelete(s) vQueueDelete(s)
+
+#endif // FREERTOS_SEMPHR_H
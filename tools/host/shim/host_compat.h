@@ -0,0 +1,26 @@
+// host_compat.h
+#ifndef HOST_COMPAT_H
+#define HOST_COMPAT_H
+
+/*
+ * Inclus avant chaque fichier (-include) : ce que la newlib d'ESP-IDF
+ * fournit et que la libc de l'hôte n'a pas forcément.
+ */
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+static inline size_t host_strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#define strlcpy host_strlcpy
+#endif
+
+#endif // HOST_COMPAT_H
@@ -0,0 +1,30 @@
+// mp3_decoder.h (hôte)
+#ifndef MP3_DECODER_H
+#define MP3_DECODER_H
+
+/*
+ * Pas de décodeur sur l'hôte : l'élément recopie son entrée, déjà en PCM
+ * 44,1 kHz stéréo 16 bits, et annonce ce format à l'ouverture.
+ */
+#include <stdbool.h>
+#include "audio_element.h"
+
+typedef struct {
+    int out_rb_size;
+    int task_stack;
+    int task_core;
+    int task_prio;
+    bool stack_in_ext;
+} mp3_decoder_cfg_t;
+
+#define DEFAULT_MP3_DECODER_CONFIG() { \
+    .out_rb_size = 8 * 1024,           \
+    .task_stack = 5 * 1024,            \
+    .task_core = 0,                    \
+    .task_prio = 5,                    \
+    .stack_in_ext = true,              \
+}
+
+audio_element_handle_t mp3_decoder_init(mp3_decoder_cfg_t *config);
+
+#endif // MP3_DECODER_H
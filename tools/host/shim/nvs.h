@@ -0,0 +1,53 @@
+// nvs.h (hôte)
+#ifndef NVS_H
+#define NVS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+/*
+ * Stockage en mémoire, perdu à la fin du processus sauf s'il est adossé
+ * à un fichier (host_nvs_set_file()). Comme sur la cible,
+ * ouvrir en lecture seule un espace de noms jamais écrit échoue avec
+ * ESP_ERR_NVS_NOT_FOUND ; les écritures sont visibles sans nvs_commit().
+ */
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out);
+void nvs_close(nvs_handle_t h);
+esp_err_t nvs_commit(nvs_handle_t h);
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key);
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len);
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len);
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value);
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len);
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t value);
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out);
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t value);
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out);
+
+// Vide le stockage (simule une partition effacée)
+void host_nvs_erase_all(void);
+
+/*
+ * Adosse le stockage au fichier path : son contenu est chargé (s'il existe)
+ * et chaque nvs_commit() le réécrit, pour retrouver l'état au redémarrage
+ * suivant, dans un autre processus.
+ */
+esp_err_t host_nvs_set_file(const char *path);
+
+// Écritures (nvs_set_*) acceptées depuis le démarrage, pour mesurer l'usure
+unsigned host_nvs_write_count(void);
+
+#endif // NVS_H
@@ -0,0 +1,32 @@
+// ringbuf.h (hôte)
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+/*
+ * Anneau d'ESP-ADF entre deux éléments (shim/adf.c). Une lecture rend ce
+ * qui est disponible, au plus len octets ; une écriture attend la place
+ * pour tout écrire. rb_abort() débloque les deux côtés jusqu'à rb_reset().
+ */
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define RB_OK 0
+#define RB_FAIL -1
+#define RB_DONE -2
+#define RB_ABORT -3
+#define RB_TIMEOUT -4
+
+typedef struct ringbuf *ringbuf_handle_t;
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks);
+esp_err_t rb_destroy(ringbuf_handle_t rb);
+esp_err_t rb_abort(ringbuf_handle_t rb);
+esp_err_t rb_reset(ringbuf_handle_t rb);
+esp_err_t rb_done_write(ringbuf_handle_t rb);
+int rb_bytes_filled(ringbuf_handle_t rb);
+int rb_bytes_available(ringbuf_handle_t rb);
+int rb_get_size(ringbuf_handle_t rb);
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait);
+int rb_write(ringbuf_handle_t rb, const char *buf, int len, TickType_t ticks_to_wait);
+
+#endif // RINGBUF_H
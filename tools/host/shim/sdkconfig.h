@@ -0,0 +1,39 @@
+// sdkconfig.h (hôte)
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+/*
+ * Valeurs par défaut de main/Kconfig.projbuild utiles aux modules compilés
+ * sur l'hôte ; les autres gardent le repli #ifndef de leur fichier. Chaque
+ * valeur peut être remplacée par -D.
+ */
+#ifndef CONFIG_PLAYBACK_RESUME
+#define CONFIG_PLAYBACK_RESUME 1
+#endif
+#ifndef CONFIG_PLAYBACK_STATE_SAVE_SEC
+#define CONFIG_PLAYBACK_STATE_SAVE_SEC 30
+#endif
+#ifndef CONFIG_PLAYLIST_WIDE_TRACK_IDS
+#define CONFIG_PLAYLIST_WIDE_TRACK_IDS 0
+#endif
+#ifndef CONFIG_AUDIO_GAPLESS
+#define CONFIG_AUDIO_GAPLESS 1
+#endif
+#ifndef CONFIG_AUDIO_REPLAYGAIN
+#define CONFIG_AUDIO_REPLAYGAIN 1
+#endif
+#ifndef CONFIG_AUDIO_DSP_USE_ESP_DSP
+#define CONFIG_AUDIO_DSP_USE_ESP_DSP 1
+#endif
+#ifndef CONFIG_BT_LINK_ADAPT
+#define CONFIG_BT_LINK_ADAPT 1
+#define CONFIG_BT_LINK_HTTP_PACE_MS 20
+#endif
+#ifndef CONFIG_MEM_BUDGET_PLAYLIST_KB
+#define CONFIG_MEM_BUDGET_PLAYLIST_KB 2048
+#define CONFIG_MEM_BUDGET_AUDIO_KB 320
+#define CONFIG_MEM_BUDGET_HTTP_KB 64
+#define CONFIG_MEM_BUDGET_BT_KB 192
+#endif
+
+#endif // SDKCONFIG_H
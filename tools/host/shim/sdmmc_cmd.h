@@ -0,0 +1,7 @@
+// sdmmc_cmd.h (hôte)
+#ifndef SDMMC_CMD_H
+#define SDMMC_CMD_H
+
+#include "driver/sdmmc_host.h"
+
+#endif // SDMMC_CMD_H
@@ -0,0 +1,1079 @@
+// shim.c
+/*
+ * Implémentation sur l'hôte (POSIX) du sous-ensemble d'ESP-IDF et de
+ * FreeRTOS déclaré dans tools/host/shim. Le but est de compiler et de
+ * mesurer les modules portables de main/ sans la cible : la sémantique
+ * suit celle d'ESP-IDF, pas ses performances ni son ordonnancement.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define TASK_NAME_LEN 16
+#define NVS_KEY_LEN 16
+#define NVS_MAX_HANDLES 16
+
+/* ---------- horloge ---------- */
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t boot_us;
+
+__attribute__((constructor)) static void host_boot(void)
+{
+    boot_us = now_us();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us() - boot_us;
+}
+
+// Échéance absolue (CLOCK_MONOTONIC) dans `ticks` millisecondes
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+static void cond_init(pthread_cond_t *c)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/*
+ * Attend un signal sur c jusqu'à l'échéance ; portMAX_DELAY attend sans fin.
+ * @return false si le délai est écoulé.
+ */
+static bool cond_wait(pthread_cond_t *c, pthread_mutex_t *m, TickType_t timeout,
+                      const struct timespec *deadline)
+{
+    if (timeout == 0) return false;
+    if (timeout == portMAX_DELAY) return pthread_cond_wait(c, m) == 0;
+    return pthread_cond_timedwait(c, m, deadline) != ETIMEDOUT;
+}
+
+/* ---------- journal et erreurs ---------- */
+
+static int log_level = -1;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    log_level = level;
+}
+
+void host_log(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    if (log_level < 0) {
+        const char *env = getenv("HOST_LOG");
+        log_level = env ? atoi(env) : ESP_LOG_WARN;
+    }
+    if ((int)level > log_level) return;
+    static const char letters[] = "NEWIDV";
+    char line[512];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "%c (%lld) %s: %s\n", letters[level],
+            (long long)(esp_timer_get_time() / 1000), tag, line);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+void host_error_check_failed(esp_err_t err, const char *expr, const char *file, int line)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: %s (0x%x) at %s:%d\n  %s\n",
+            esp_err_to_name(err), err, file, line, expr);
+    abort();
+}
+
+/* ---------- sections critiques ---------- */
+
+static pthread_mutex_t critical;
+
+__attribute__((constructor)) static void host_critical_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void host_critical_enter(void)
+{
+    pthread_mutex_lock(&critical);
+}
+
+void host_critical_exit(void)
+{
+    pthread_mutex_unlock(&critical);
+}
+
+/* ---------- tâches ---------- */
+
+struct host_task {
+    pthread_t thread;
+    char name[TASK_NAME_LEN];
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    uint32_t notify;
+    bool deleted;
+    struct host_task *next;
+};
+
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task *tasks = NULL;
+static __thread struct host_task *current_task = NULL;
+
+static struct host_task *task_new(const char *name)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    pthread_mutex_init(&t->m, NULL);
+    cond_init(&t->c);
+    pthread_mutex_lock(&tasks_lock);
+    t->next = tasks;
+    tasks = t;
+    pthread_mutex_unlock(&tasks_lock);
+    return t;
+}
+
+static void *task_entry(void *arg)
+{
+    struct host_task *t = arg;
+    current_task = t;
+    t->fn(t->arg);
+    // une tâche FreeRTOS ne doit pas retourner : on la traite comme vTaskDelete(NULL)
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    (void)stack;
+    (void)prio;
+    (void)core;
+    struct host_task *t = task_new(name);
+    if (!t) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    // le handle doit être rendu avant que la tâche ne s'en serve
+    if (out) *out = t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&t->thread, &attr, task_entry, t);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        t->deleted = true;
+        if (out) *out = NULL;
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!current_task) current_task = task_new("main");
+    return current_task;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task && task != current_task) {
+        ESP_LOGE("shim", "vTaskDelete(%s) from another task is not supported", task->name);
+        return;
+    }
+    if (current_task) current_task->deleted = true;
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = { .tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000 };
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    struct host_task *found = NULL;
+    pthread_mutex_lock(&tasks_lock);
+    for (struct host_task *t = tasks; t && !found; t = t->next) {
+        if (!t->deleted && strncmp(t->name, name, TASK_NAME_LEN - 1) == 0) found = t;
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    return found;
+}
+
+unsigned host_task_count(void)
+{
+    unsigned n = 0;
+    pthread_mutex_lock(&tasks_lock);
+    for (struct host_task *t = tasks; t; t = t->next) n += t->fn && !t->deleted;
+    pthread_mutex_unlock(&tasks_lock);
+    return n;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    (void)task;
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->m);
+    task->notify++;
+    pthread_cond_signal(&task->c);
+    pthread_mutex_unlock(&task->m);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t timeout)
+{
+    struct host_task *t = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = deadline_after(timeout);
+    pthread_mutex_lock(&t->m);
+    while (t->notify == 0 && cond_wait(&t->c, &t->m, timeout, &deadline)) {
+    }
+    uint32_t value = t->notify;
+    if (value) t->notify = clear_on_exit ? 0 : value - 1;
+    pthread_mutex_unlock(&t->m);
+    return value;
+}
+
+/* ---------- files et sémaphores ---------- */
+
+// Un sémaphore est une file d'éléments de taille nulle : seul `count` compte
+struct host_queue {
+    pthread_mutex_t m;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *items;
+    size_t item_size;
+    size_t len;
+    size_t head;
+    size_t count;
+};
+
+static struct host_queue *queue_new(size_t len, size_t item_size, size_t initial)
+{
+    struct host_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    if (item_size && !(q->items = malloc(len * item_size))) {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->m, NULL);
+    cond_init(&q->not_empty);
+    cond_init(&q->not_full);
+    q->item_size = item_size;
+    q->len = len;
+    q->count = initial;
+    return q;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+    return len ? queue_new(len, item_size, 0) : NULL;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!q) return;
+    pthread_mutex_destroy(&q->m);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->items);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t timeout)
+{
+    struct timespec deadline = deadline_after(timeout);
+    pthread_mutex_lock(&q->m);
+    while (q->count == q->len && cond_wait(&q->not_full, &q->m, timeout, &deadline)) {
+    }
+    bool ok = q->count < q->len;
+    if (ok) {
+        if (q->item_size) {
+            memcpy(q->items + (q->head + q->count) % q->len * q->item_size, item, q->item_size);
+        }
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->m);
+    return ok ? pdPASS : pdFAIL;
+}
+
+static BaseType_t queue_get(QueueHandle_t q, void *item, TickType_t timeout, bool remove)
+{
+    struct timespec deadline = deadline_after(timeout);
+    pthread_mutex_lock(&q->m);
+    while (q->count == 0 && cond_wait(&q->not_empty, &q->m, timeout, &deadline)) {
+    }
+    bool ok = q->count > 0;
+    if (ok) {
+        if (q->item_size && item) memcpy(item, q->items + q->head * q->item_size, q->item_size);
+        if (remove) {
+            q->head = (q->head + 1) % q->len;
+            q->count--;
+            pthread_cond_signal(&q->not_full);
+        } else {
+            // les autres lecteurs peuvent aussi voir l'élément
+            pthread_cond_signal(&q->not_empty);
+        }
+    }
+    pthread_mutex_unlock(&q->m);
+    return ok ? pdPASS : pdFAIL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t timeout)
+{
+    return queue_get(q, item, timeout, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t timeout)
+{
+    return queue_get(q, item, timeout, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->m);
+    size_t n = q->count;
+    pthread_mutex_unlock(&q->m);
+    return n;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return queue_new(1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return queue_new(1, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    return max && initial <= max ? queue_new(max, 0, initial) : NULL;
+}
+
+/* ---------- groupes d'événements ---------- */
+
+struct host_event_group {
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *g = calloc(1, sizeof(*g));
+    if (!g) return NULL;
+    pthread_mutex_init(&g->m, NULL);
+    cond_init(&g->c);
+    return g;
+}
+
+void vEventGroupDelete(EventGroupHandle_t g)
+{
+    if (!g) return;
+    pthread_mutex_destroy(&g->m);
+    pthread_cond_destroy(&g->c);
+    free(g);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->m);
+    g->bits |= bits;
+    EventBits_t now = g->bits;
+    pthread_cond_broadcast(&g->c);
+    pthread_mutex_unlock(&g->m);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->m);
+    EventBits_t before = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&g->m);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g)
+{
+    pthread_mutex_lock(&g->m);
+    EventBits_t now = g->bits;
+    pthread_mutex_unlock(&g->m);
+    return now;
+}
+
+static bool bits_ready(EventBits_t have, EventBits_t want, BaseType_t all)
+{
+    return all ? (have & want) == want : (have & want) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t timeout)
+{
+    struct timespec deadline = deadline_after(timeout);
+    pthread_mutex_lock(&g->m);
+    while (!bits_ready(g->bits, bits, all) && cond_wait(&g->c, &g->m, timeout, &deadline)) {
+    }
+    EventBits_t now = g->bits;
+    if (clear && bits_ready(now, bits, all)) g->bits &= ~bits;
+    pthread_mutex_unlock(&g->m);
+    return now;
+}
+
+/* ---------- esp_timer ---------- */
+
+struct host_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    pthread_t thread;
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    int64_t deadline_us;        // -1 : arrêtée
+    int64_t period_us;          // 0 : une seule fois
+    bool deleted;
+};
+
+static void *timer_thread(void *arg)
+{
+    struct host_timer *t = arg;
+    pthread_mutex_lock(&t->m);
+    while (!t->deleted) {
+        if (t->deadline_us < 0) {
+            pthread_cond_wait(&t->c, &t->m);
+            continue;
+        }
+        int64_t wait = t->deadline_us - esp_timer_get_time();
+        if (wait > 0) {
+            struct timespec deadline = deadline_after((TickType_t)((wait + 999) / 1000));
+            pthread_cond_timedwait(&t->c, &t->m, &deadline);
+            continue;
+        }
+        t->deadline_us = t->period_us ? t->deadline_us + t->period_us : -1;
+        pthread_mutex_unlock(&t->m);
+        t->callback(t->arg);
+        pthread_mutex_lock(&t->m);
+    }
+    pthread_mutex_unlock(&t->m);
+    pthread_mutex_destroy(&t->m);
+    pthread_cond_destroy(&t->c);
+    free(t);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (!args || !args->callback || !out) return ESP_ERR_INVALID_ARG;
+    struct host_timer *t = calloc(1, sizeof(*t));
+    if (!t) return ESP_ERR_NO_MEM;
+    t->callback = args->callback;
+    t->arg = args->arg;
+    t->deadline_us = -1;
+    pthread_mutex_init(&t->m, NULL);
+    cond_init(&t->c);
+    if (pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(t->thread);
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_arm(esp_timer_handle_t t, uint64_t delay_us, uint64_t period_us)
+{
+    pthread_mutex_lock(&t->m);
+    esp_err_t err = t->deadline_us >= 0 ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (err == ESP_OK) {
+        t->deadline_us = esp_timer_get_time() + (int64_t)delay_us;
+        t->period_us = (int64_t)period_us;
+        pthread_cond_signal(&t->c);
+    }
+    pthread_mutex_unlock(&t->m);
+    return err;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us)
+{
+    return timer_arm(t, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us)
+{
+    return period_us ? timer_arm(t, period_us, period_us) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    pthread_mutex_lock(&t->m);
+    esp_err_t err = t->deadline_us < 0 ? ESP_ERR_INVALID_STATE : ESP_OK;
+    t->deadline_us = -1;
+    pthread_cond_signal(&t->c);
+    pthread_mutex_unlock(&t->m);
+    return err;
+}
+
+// Le thread libère la minuterie lui-même : on peut l'appeler depuis son callback
+esp_err_t esp_timer_delete(esp_timer_handle_t t)
+{
+    pthread_mutex_lock(&t->m);
+    esp_err_t err = t->deadline_us >= 0 ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (err == ESP_OK) {
+        t->deleted = true;
+        pthread_cond_signal(&t->c);
+    }
+    pthread_mutex_unlock(&t->m);
+    return err;
+}
+
+/* ---------- aléa, CRC, tas ---------- */
+
+static uint32_t random_state = 0x2545f491;
+
+void host_random_seed(uint32_t seed)
+{
+    taskENTER_CRITICAL(NULL);
+    random_state = seed ? seed : 1;
+    taskEXIT_CRITICAL(NULL);
+}
+
+uint32_t esp_random(void)
+{
+    taskENTER_CRITICAL(NULL);
+    uint32_t x = random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random_state = x;
+    taskEXIT_CRITICAL(NULL);
+    return x;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    while (len--) crc = table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+typedef struct {
+    size_t total;
+    size_t free;
+    size_t min_free;
+    size_t largest_block;
+} host_heap_t;
+
+static host_heap_t heaps[2];    // 0 : interne, 1 : PSRAM
+
+static host_heap_t *heap_for(uint32_t caps)
+{
+    return &heaps[(caps & MALLOC_CAP_SPIRAM) ? 1 : 0];
+}
+
+void host_heap_set(uint32_t caps, size_t total, size_t free, size_t largest_block)
+{
+    host_heap_t *h = heap_for(caps);
+    taskENTER_CRITICAL(NULL);
+    h->total = total;
+    h->free = free;
+    h->largest_block = largest_block;
+    if (!h->min_free || free < h->min_free) h->min_free = free;
+    taskEXIT_CRITICAL(NULL);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return heap_for(caps)->free;
+}
+
+size_t heap_caps_get_total_size(uint32_t caps)
+{
+    return heap_for(caps)->total;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return heap_for(caps)->min_free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_for(caps)->largest_block;
+}
+
+/* ---------- NVS en mémoire ---------- */
+
+typedef enum { NVS_TYPE_U8, NVS_TYPE_U32, NVS_TYPE_STR, NVS_TYPE_BLOB } nvs_type_t;
+
+typedef struct nvs_item {
+    char ns[NVS_KEY_LEN];
+    char key[NVS_KEY_LEN];
+    nvs_type_t type;
+    size_t len;
+    struct nvs_item *next;
+    uint8_t data[];
+} nvs_item_t;
+
+typedef struct {
+    bool used;
+    bool writable;
+    char ns[NVS_KEY_LEN];
+} nvs_open_t;
+
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static nvs_item_t *nvs_items = NULL;
+static nvs_open_t nvs_handles[NVS_MAX_HANDLES];
+static char nvs_file[256];              // vide : rien n'est gardé
+static unsigned nvs_writes = 0;
+
+static nvs_item_t *nvs_find(const char *ns, const char *key)
+{
+    for (nvs_item_t *it = nvs_items; it; it = it->next) {
+        if (strcmp(it->ns, ns) == 0 && (!key || strcmp(it->key, key) == 0)) return it;
+    }
+    return NULL;
+}
+
+static const nvs_open_t *nvs_handle_get(nvs_handle_t h)
+{
+    return h > 0 && h <= NVS_MAX_HANDLES && nvs_handles[h - 1].used ? &nvs_handles[h - 1] : NULL;
+}
+
+static void nvs_clear(void)
+{
+    while (nvs_items) {
+        nvs_item_t *next = nvs_items->next;
+        free(nvs_items);
+        nvs_items = next;
+    }
+}
+
+// Réécrit tout le stockage dans nvs_file, sous nvs_lock
+static esp_err_t nvs_save(void)
+{
+    if (!nvs_file[0]) return ESP_OK;
+    FILE *fp = fopen(nvs_file, "wb");
+    if (!fp) return ESP_FAIL;
+    bool ok = true;
+    for (nvs_item_t *it = nvs_items; it && ok; it = it->next) {
+        uint32_t head[2] = { it->type, it->len };
+        ok = fwrite(it->ns, sizeof(it->ns), 1, fp) == 1 && fwrite(it->key, sizeof(it->key), 1, fp) == 1 &&
+             fwrite(head, sizeof(head), 1, fp) == 1 && fwrite(it->data, 1, it->len, fp) == it->len;
+    }
+    return fclose(fp) == 0 && ok ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t host_nvs_set_file(const char *path)
+{
+    if (strlen(path) >= sizeof(nvs_file)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&nvs_lock);
+    nvs_clear();
+    strcpy(nvs_file, path);
+    FILE *fp = fopen(path, "rb");
+    esp_err_t err = ESP_OK;
+    char ns[NVS_KEY_LEN], key[NVS_KEY_LEN];
+    uint32_t head[2];
+    while (fp && fread(ns, sizeof(ns), 1, fp) == 1) {
+        nvs_item_t *item = NULL;
+        if (fread(key, sizeof(key), 1, fp) != 1 || fread(head, sizeof(head), 1, fp) != 1 ||
+            !(item = malloc(sizeof(*item) + head[1])) || fread(item->data, 1, head[1], fp) != head[1]) {
+            free(item);
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        memcpy(item->ns, ns, sizeof(ns));
+        memcpy(item->key, key, sizeof(key));
+        item->type = head[0];
+        item->len = head[1];
+        item->next = nvs_items;
+        nvs_items = item;
+    }
+    if (fp) fclose(fp);
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+unsigned host_nvs_write_count(void)
+{
+    pthread_mutex_lock(&nvs_lock);
+    unsigned n = nvs_writes;
+    pthread_mutex_unlock(&nvs_lock);
+    return n;
+}
+
+void host_nvs_erase_all(void)
+{
+    pthread_mutex_lock(&nvs_lock);
+    nvs_clear();
+    nvs_save();
+    pthread_mutex_unlock(&nvs_lock);
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    if (!ns || strlen(ns) >= NVS_KEY_LEN || !out) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&nvs_lock);
+    if (mode == NVS_READONLY && !nvs_find(ns, NULL)) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        for (int i = 0; i < NVS_MAX_HANDLES; i++) {
+            if (nvs_handles[i].used) continue;
+            nvs_handles[i].used = true;
+            nvs_handles[i].writable = mode == NVS_READWRITE;
+            strcpy(nvs_handles[i].ns, ns);
+            *out = i + 1;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t h)
+{
+    pthread_mutex_lock(&nvs_lock);
+    if (nvs_handle_get(h)) nvs_handles[h - 1].used = false;
+    pthread_mutex_unlock(&nvs_lock);
+}
+
+// Les écritures sont déjà visibles ; le fichier, s'il y en a un, est réécrit
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t err = nvs_handle_get(h) ? nvs_save() : ESP_ERR_NVS_NOT_INITIALIZED;
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+static void nvs_unlink(nvs_item_t *item)
+{
+    for (nvs_item_t **p = &nvs_items; *p; p = &(*p)->next) {
+        if (*p == item) {
+            *p = item->next;
+            free(item);
+            return;
+        }
+    }
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key)
+{
+    pthread_mutex_lock(&nvs_lock);
+    const nvs_open_t *o = nvs_handle_get(h);
+    nvs_item_t *item = o && o->writable ? nvs_find(o->ns, key) : NULL;
+    esp_err_t err = !o ? ESP_ERR_NVS_NOT_INITIALIZED : item ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+    if (item) nvs_unlink(item);
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+static esp_err_t nvs_set(nvs_handle_t h, const char *key, nvs_type_t type, const void *value,
+                         size_t len)
+{
+    if (!key || strlen(key) >= NVS_KEY_LEN) return ESP_ERR_INVALID_ARG;
+    nvs_item_t *item = malloc(sizeof(*item) + len);
+    if (!item) return ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&nvs_lock);
+    const nvs_open_t *o = nvs_handle_get(h);
+    esp_err_t err = !o ? ESP_ERR_NVS_NOT_INITIALIZED : !o->writable ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (err == ESP_OK) {
+        nvs_item_t *old = nvs_find(o->ns, key);
+        if (old) nvs_unlink(old);
+        strcpy(item->ns, o->ns);
+        strcpy(item->key, key);
+        item->type = type;
+        item->len = len;
+        memcpy(item->data, value, len);
+        item->next = nvs_items;
+        nvs_items = item;
+        nvs_writes++;
+    } else {
+        free(item);
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+// out NULL : rend seulement la taille dans *len, comme nvs_get_blob/str
+static esp_err_t nvs_get(nvs_handle_t h, const char *key, nvs_type_t type, void *out, size_t *len)
+{
+    pthread_mutex_lock(&nvs_lock);
+    const nvs_open_t *o = nvs_handle_get(h);
+    nvs_item_t *item = o ? nvs_find(o->ns, key) : NULL;
+    esp_err_t err = !o ? ESP_ERR_NVS_NOT_INITIALIZED :
+                    !item || item->type != type ? ESP_ERR_NVS_NOT_FOUND : ESP_OK;
+    if (err == ESP_OK) {
+        if (out && *len < item->len) {
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else if (out) {
+            memcpy(out, item->data, item->len);
+        }
+        *len = item->len;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    return nvs_set(h, key, NVS_TYPE_BLOB, value, len);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    return nvs_get(h, key, NVS_TYPE_BLOB, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value)
+{
+    return nvs_set(h, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len)
+{
+    return nvs_get(h, key, NVS_TYPE_STR, out, len);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t value)
+{
+    return nvs_set(h, key, NVS_TYPE_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out)
+{
+    size_t len = sizeof(*out);
+    return nvs_get(h, key, NVS_TYPE_U8, out, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t value)
+{
+    return nvs_set(h, key, NVS_TYPE_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out)
+{
+    size_t len = sizeof(*out);
+    return nvs_get(h, key, NVS_TYPE_U32, out, &len);
+}
+
+/* ---------- carte SD et HTTP ---------- */
+
+esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path, const sdmmc_host_t *host,
+                                  const void *slot, const esp_vfs_fat_mount_config_t *cfg,
+                                  sdmmc_card_t **out_card)
+{
+    (void)slot;
+    (void)cfg;
+    static sdmmc_card_t card;
+    struct stat st;
+    if (stat(base_path, &st) != 0 || !S_ISDIR(st.st_mode)) return ESP_ERR_NOT_FOUND;
+    card.real_freq_khz = host->max_freq_khz;
+    *out_card = &card;
+    return ESP_OK;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *req)
+{
+    return req->query ? strlen(req->query) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *req, char *buf, size_t buf_len)
+{
+    if (!req->query) return ESP_ERR_NOT_FOUND;
+    strlcpy(buf, req->query, buf_len);
+    return strlen(req->query) < buf_len ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+// Copie tronquée de la valeur [v, v + n) dans val
+static esp_err_t copy_value(const char *v, size_t n, char *val, size_t val_size)
+{
+    size_t m = n < val_size ? n : val_size - 1;
+    memcpy(val, v, m);
+    val[m] = '\0';
+    return n < val_size ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size)
+{
+    size_t klen = strlen(key);
+    for (const char *p = qry; p && *p; p = strchr(p, '&') ? strchr(p, '&') + 1 : NULL) {
+        if (strncmp(p, key, klen) == 0 && p[klen] == '=') {
+            const char *v = p + klen + 1;
+            return copy_value(v, strcspn(v, "&"), val, val_size);
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size)
+{
+    size_t flen = strlen(field);
+    for (const char *p = req->headers; p && *p; p = strchr(p, '\n') ? strchr(p, '\n') + 1 : NULL) {
+        if (strncasecmp(p, field, flen) == 0 && p[flen] == ':') {
+            const char *v = p + flen + 1;
+            while (*v == ' ') v++;
+            return copy_value(v, strcspn(v, "\r\n"), val, val_size);
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status)
+{
+    req->status = atoi(status);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t len)
+{
+    if (buf && len != 0) httpd_resp_send_chunk(req, buf, len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t len)
+{
+    if (!buf) return ESP_OK;        // fin de la réponse
+    if (len < 0) len = strlen(buf);
+    if (req->body && req->sent + len < req->body_size) {
+        memcpy(req->body + req->sent, buf, len);
+        req->body[req->sent + len] = '\0';
+    }
+    req->sent += len;
+    req->chunks++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type)
+{
+    req->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value)
+{
+    (void)req;
+    (void)field;
+    (void)value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_500(httpd_req_t *req)
+{
+    req->status = 500;
+    return ESP_OK;
+}
+
+static httpd_uri_t uri_handlers[32];
+static size_t uri_handler_count;
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t server, const httpd_uri_t *uri)
+{
+    (void)server;
+    if (host_httpd_find(uri->uri, uri->method)) return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    if (uri_handler_count == sizeof(uri_handlers) / sizeof(uri_handlers[0])) {
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    uri_handlers[uri_handler_count++] = *uri;
+    return ESP_OK;
+}
+
+const httpd_uri_t *host_httpd_find(const char *uri, httpd_method_t method)
+{
+    for (size_t i = 0; i < uri_handler_count; i++) {
+        if (uri_handlers[i].method == method && strcmp(uri_handlers[i].uri, uri) == 0) {
+            return &uri_handlers[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,37 @@
+// test.h
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+/*
+ * Vérifications des tests hôte : une vérification ratée est affichée et
+ * comptée, le test continue ; TEST_END() rend le code de sortie.
+ */
+#include <errno.h>
+#include <stdio.h>
+
+static int test_failures = 0;
+static int test_checks = 0;
+
+#define CHECK(cond) do {                                                        \
+        test_checks++;                                                          \
+        if (!(cond)) {                                                          \
+            test_failures++;                                                    \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        }                                                                       \
+    } while (0)
+
+// Comme CHECK, avec un message formaté en cas d'échec
+#define CHECKF(cond, fmt, ...) do {                                             \
+        test_checks++;                                                          \
+        if (!(cond)) {                                                          \
+            test_failures++;                                                    \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed: " fmt "\n", __FILE__,     \
+                    __LINE__, #cond, ##__VA_ARGS__);                            \
+        }                                                                       \
+    } while (0)
+
+#define TEST_END() (printf("%s: %d checks, %d failed\n", program_invocation_short_name, \
+                            test_checks, test_failures),                             \
+                    test_failures ? 1 : 0)
+
+#endif // HOST_TEST_H
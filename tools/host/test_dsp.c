@@ -0,0 +1,448 @@
+// test_dsp.c
+/*
+ * Voie esp-dsp et voie C de main/audio_dsp.c (conversion de fréquence,
+ * égaliseur, volume et limiteur) et de main/audio_eq.c : sur le même flux,
+ * découpé de la même façon et avec les mêmes réglages changés en cours de
+ * route, les deux voies doivent sortir les mêmes octets. La voie esp-dsp
+ * appelle ici la version de référence de la bibliothèque (shim/dsps_*.h) ;
+ * la voie C est la seconde compilation des deux modules, API préfixée par
+ * ref_ (dsp_ref.h). Puis la réponse de l'égaliseur, mesurée sur des
+ * sinusoïdes, et son passage par le limiteur.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "audio_dsp.h"
+#include "audio_eq.h"
+#include "audio_pipeline.h"
+#include "esp_timer.h"
+#include "test.h"
+
+#define FINISH_TIMEOUT_US 5000000
+#define FRAME_SLACK 16          // retard du filtre de conversion, en trames
+
+// Voie C (dsp_ref.h)
+audio_element_handle_t ref_audio_dsp_init(audio_dsp_cfg_t *config);
+esp_err_t ref_audio_dsp_set_src_info(audio_element_handle_t self, int src_rate, int src_ch);
+esp_err_t ref_audio_dsp_set_volume(audio_element_handle_t self, int volume);
+esp_err_t ref_audio_dsp_set_track_gain(audio_element_handle_t self, float gain_db);
+audio_eq_handle_t ref_audio_eq_create(void);
+esp_err_t ref_audio_eq_set(audio_eq_handle_t eq, const audio_eq_settings_t *settings);
+
+typedef struct {
+    const char *name;
+    audio_element_handle_t (*dsp_init)(audio_dsp_cfg_t *config);
+    esp_err_t (*set_src_info)(audio_element_handle_t self, int src_rate, int src_ch);
+    esp_err_t (*set_volume)(audio_element_handle_t self, int volume);
+    esp_err_t (*set_track_gain)(audio_element_handle_t self, float gain_db);
+    audio_eq_handle_t (*eq_create)(void);
+    esp_err_t (*eq_set)(audio_eq_handle_t eq, const audio_eq_settings_t *settings);
+} dsp_path_t;
+
+static const dsp_path_t esp_dsp_path = {
+    "esp-dsp", audio_dsp_init, audio_dsp_set_src_info, audio_dsp_set_volume,
+    audio_dsp_set_track_gain, audio_eq_create, audio_eq_set,
+};
+
+static const dsp_path_t c_path = {
+    "C", ref_audio_dsp_init, ref_audio_dsp_set_src_info, ref_audio_dsp_set_volume,
+    ref_audio_dsp_set_track_gain, ref_audio_eq_create, ref_audio_eq_set,
+};
+
+/* ---------- flux d'entrée et réglages en cours de route ---------- */
+
+typedef enum {
+    EV_END,
+    EV_VOLUME,
+    EV_GAIN,
+    EV_FORMAT,
+    EV_EQ,
+} event_kind_t;
+
+typedef struct {
+    size_t at;                  // octet d'entrée à partir duquel le réglage s'applique
+    event_kind_t kind;
+    int a, b;                   // volume, ou fréquence et canaux
+    float db;
+    const audio_eq_settings_t *eq;
+} event_t;
+
+typedef struct {
+    const dsp_path_t *path;
+    audio_element_handle_t el;
+    audio_eq_handle_t eq;
+    const char *pcm;
+    size_t len;
+    size_t pos;
+    unsigned reads;
+    const event_t *next_event;
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+} run_t;
+
+// Lectures de tailles irrégulières, trames coupées comprises
+static const int chunks[] = { 1024, 333, 4096, 2, 777, 1500, 64 };
+
+static void apply_event(run_t *r, const event_t *ev)
+{
+    switch (ev->kind) {
+    case EV_VOLUME:
+        r->path->set_volume(r->el, ev->a);
+        break;
+    case EV_GAIN:
+        r->path->set_track_gain(r->el, ev->db);
+        break;
+    case EV_FORMAT:
+        r->path->set_src_info(r->el, ev->a, ev->b);
+        break;
+    case EV_EQ:
+        r->path->eq_set(r->eq, ev->eq);
+        break;
+    case EV_END:
+        break;
+    }
+}
+
+static bool event_due(const run_t *r, size_t before)
+{
+    return r->next_event && r->next_event->kind != EV_END && r->next_event->at < before;
+}
+
+/*
+ * Un réglage est posé dès que la lecture atteint son octet : l'élément le
+ * prend au process() suivant, avant de lire la suite.
+ */
+static int feed(audio_element_handle_t el, char *buf, int len, TickType_t wait, void *ctx)
+{
+    run_t *r = ctx;
+    while (event_due(r, r->pos + 1)) apply_event(r, r->next_event++);
+    size_t n = r->len - r->pos;
+    if (n == 0) return AEL_IO_DONE;
+    if (n > (size_t)len) n = len;
+    size_t chunk = chunks[r->reads++ % (sizeof(chunks) / sizeof(chunks[0]))];
+    if (n > chunk) n = chunk;
+    // la lecture s'arrête sur l'octet du réglage suivant
+    if (event_due(r, r->pos + n)) n = r->next_event->at - r->pos;
+    memcpy(buf, r->pcm + r->pos, n);
+    r->pos += n;
+    while (event_due(r, r->pos + 1)) apply_event(r, r->next_event++);
+    return (int)n;
+}
+
+static int collect(audio_element_handle_t el, char *buf, int len, TickType_t wait, void *ctx)
+{
+    run_t *r = ctx;
+    if (r->out_len + len > r->out_cap) {
+        size_t cap = r->out_cap ? r->out_cap * 2 : 64 * 1024;
+        while (cap < r->out_len + len) cap *= 2;
+        char *out = realloc(r->out, cap);
+        if (!out) return AEL_IO_FAIL;
+        r->out = out;
+        r->out_cap = cap;
+    }
+    memcpy(r->out + r->out_len, buf, len);
+    r->out_len += len;
+    return len;
+}
+
+// Fait passer tout le flux dans l'élément, seul dans son pipeline
+static bool run_element(run_t *r)
+{
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    audio_pipeline_handle_t pipeline = audio_pipeline_init(&pipeline_cfg);
+    audio_element_set_read_cb(r->el, feed, r);
+    audio_element_set_write_cb(r->el, collect, r);
+    if (!pipeline || audio_pipeline_register(pipeline, r->el, "dut") != ESP_OK ||
+        audio_pipeline_link(pipeline, (const char *[]){ "dut" }, 1) != ESP_OK ||
+        audio_pipeline_run(pipeline) != ESP_OK) {
+        return false;
+    }
+    int64_t t0 = esp_timer_get_time();
+    audio_element_state_t st;
+    while ((st = audio_element_get_state(r->el)) == AEL_STATE_RUNNING) {
+        if (esp_timer_get_time() - t0 > FINISH_TIMEOUT_US) return false;
+        usleep(100);
+    }
+    // le pipeline et la tâche restent : l'ADF de l'hôte ne les détruit pas
+    return st == AEL_STATE_FINISHED;
+}
+
+/* ---------- signaux ---------- */
+
+static uint32_t lcg = 0x1234567;
+
+// Sinusoïde et bruit, crête à environ peak ; len en échantillons
+static int16_t *make_signal(size_t len, int peak)
+{
+    int16_t *pcm = malloc(len * sizeof(int16_t));
+    if (!pcm) abort();
+    for (size_t i = 0; i < len; i++) {
+        lcg = lcg * 1103515245 + 12345;
+        int noise = (int)((lcg >> 16) & 0x7fff) - 0x4000;
+        double s = 0.8 * sin(i * 0.0731) + 0.2 * noise / (double)0x4000;
+        pcm[i] = (int16_t)(s * peak);
+    }
+    return pcm;
+}
+
+static size_t first_difference(const run_t *a, const run_t *b)
+{
+    size_t n = a->out_len < b->out_len ? a->out_len : b->out_len;
+    size_t i = 0;
+    while (i < n && a->out[i] == b->out[i]) i++;
+    return i / 2;
+}
+
+static void compare(const char *name, run_t *esp, run_t *ref)
+{
+    CHECKF(esp->out_len == ref->out_len && memcmp(esp->out, ref->out, esp->out_len) == 0,
+           "%s: %zu and %zu bytes, first difference at sample %zu", name, esp->out_len,
+           ref->out_len, first_difference(esp, ref));
+    free(esp->out);
+    free(ref->out);
+}
+
+/* ---------- DSP ---------- */
+
+typedef struct {
+    const char *name;
+    int rate;
+    int ch;
+    int volume;
+    float gain_db;
+    int peak;
+    size_t frames;
+    const event_t *events;
+    bool passthrough;           // sortie identique à l'entrée
+} dsp_case_t;
+
+static const event_t volume_ramp[] = {
+    { .at = 20000, .kind = EV_VOLUME, .a = 100 },
+    { .at = 50001, .kind = EV_VOLUME, .a = 35 },
+    { .at = 80000, .kind = EV_GAIN, .db = 6 },
+    { .kind = EV_END },
+};
+
+// 22,05 kHz mono puis 48 kHz stéréo dans le même flux
+static const event_t format_change[] = {
+    { .at = 44100, .kind = EV_FORMAT, .a = 48000, .b = 2 },
+    { .kind = EV_END },
+};
+
+static const dsp_case_t dsp_cases[] = {
+    { "22050 mono", 22050, 1, 70, 3, 12000, 40000, volume_ramp, false },
+    { "48000 stereo, limiter", 48000, 2, 100, 6, 32000, 48000, NULL, false },
+    { "32000 stereo", 32000, 2, 100, 0, 20000, 32000, NULL, false },
+    { "44100 mono", 44100, 1, 100, 0, 20000, 44100, NULL, false },
+    { "44100 stereo, volume", 44100, 2, 60, -2, 20000, 44100, volume_ramp, false },
+    { "44100 stereo, unity", 44100, 2, 100, 0, 20000, 44100, NULL, true },
+    { "format change", 22050, 1, 90, 0, 20000, 48000, format_change, false },
+};
+
+static void run_dsp(const dsp_path_t *path, const dsp_case_t *c, const int16_t *pcm, size_t len,
+                    run_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    audio_dsp_cfg_t cfg = DEFAULT_AUDIO_DSP_CONFIG();
+    cfg.src_rate = c->rate;
+    cfg.src_ch = c->ch;
+    cfg.volume = c->volume;
+    r->path = path;
+    r->el = path->dsp_init(&cfg);
+    r->pcm = (const char *)pcm;
+    r->len = len;
+    r->next_event = c->events;
+    CHECKF(r->el && path->set_track_gain(r->el, c->gain_db) == ESP_OK, "%s: init", c->name);
+    CHECKF(r->el && run_element(r), "%s: %s path did not finish", c->name, path->name);
+}
+
+static void test_dsp_case(const dsp_case_t *c)
+{
+    size_t len = c->frames * c->ch * sizeof(int16_t);
+    int16_t *pcm = make_signal(len / 2, c->peak);
+    run_t esp, ref;
+    run_dsp(&esp_dsp_path, c, pcm, len, &esp);
+    run_dsp(&c_path, c, pcm, len, &ref);
+
+    if (!c->events || c->events[0].kind != EV_FORMAT) {
+        size_t expect = (size_t)((uint64_t)c->frames * AUDIO_DSP_OUT_RATE / c->rate);
+        size_t frames = esp.out_len / (AUDIO_DSP_OUT_CHANNELS * sizeof(int16_t));
+        CHECKF(frames + FRAME_SLACK >= expect && frames <= expect + FRAME_SLACK,
+               "%s: %zu frames out, %zu expected", c->name, frames, expect);
+    }
+    if (c->passthrough) {
+        CHECKF(esp.out_len == len && memcmp(esp.out, pcm, len) == 0, "%s: not passed through",
+               c->name);
+    }
+    compare(c->name, &esp, &ref);
+    free(pcm);
+}
+
+/* ---------- égaliseur ---------- */
+
+static const audio_eq_settings_t eq_flat = { 0 };
+
+static const audio_eq_settings_t eq_three = {
+    .preamp_db = -4,
+    .bands = {
+        { AUDIO_EQ_LOW_SHELF, 120, 5, 0.7f },
+        { AUDIO_EQ_PEAKING, 1000, 6, 1.2f },
+        { AUDIO_EQ_HIGH_SHELF, 8000, -3, 0.7f },
+    },
+};
+
+static const audio_eq_settings_t eq_five = {
+    .preamp_db = -6,
+    .bands = {
+        { AUDIO_EQ_PEAKING, 60, 4, 1 },
+        { AUDIO_EQ_PEAKING, 250, -3, 2 },
+        { AUDIO_EQ_PEAKING, 2500, 5, 0.5f },
+        { AUDIO_EQ_HIGH_SHELF, 6000, 4, 0.7f },
+        { AUDIO_EQ_LOW_SHELF, 300, -2, 0.7f },
+    },
+};
+
+// Réglages changés en cours de route : fondu d'un bloc à chaque fois
+static const event_t eq_changes[] = {
+    { .at = 0, .kind = EV_EQ, .eq = &eq_three },
+    { .at = 60000, .kind = EV_EQ, .eq = &eq_five },
+    { .at = 120003, .kind = EV_EQ, .eq = &eq_flat },
+    { .at = 150000, .kind = EV_EQ, .eq = &eq_three },
+    { .kind = EV_END },
+};
+
+// Égaliseur seul dans l'élément DSP : 44,1 kHz stéréo, volume maximal
+static void run_eq(const dsp_path_t *path, const event_t *events, const int16_t *pcm, size_t len,
+                   run_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    audio_dsp_cfg_t cfg = DEFAULT_AUDIO_DSP_CONFIG();
+    r->path = path;
+    r->eq = cfg.eq = path->eq_create();
+    r->el = r->eq ? path->dsp_init(&cfg) : NULL;
+    r->pcm = (const char *)pcm;
+    r->len = len;
+    r->next_event = events;
+    CHECKF(r->el && run_element(r), "eq: %s path did not finish", path->name);
+}
+
+static void test_eq(void)
+{
+    size_t len = AUDIO_EQ_RATE * 2 * sizeof(int16_t);
+    int16_t *pcm = make_signal(len / 2, 16000);
+    run_t esp, ref;
+
+    run_eq(&esp_dsp_path, eq_changes, pcm, len, &esp);
+    run_eq(&c_path, eq_changes, pcm, len, &ref);
+    CHECKF(esp.out_len == len, "eq: %zu bytes out of %zu", esp.out_len, len);
+    CHECK(esp.out_len < 60000 || memcmp(esp.out, pcm, 60000) != 0);
+    compare("eq", &esp, &ref);
+
+    // sans bande ni préampli : sortie identique à l'entrée
+    run_eq(&esp_dsp_path, NULL, pcm, len, &esp);
+    CHECK(esp.out_len == len && memcmp(esp.out, pcm, len) == 0);
+    free(esp.out);
+    free(pcm);
+}
+
+/* ---------- réponse de l'égaliseur sur des sinusoïdes ---------- */
+
+#define SINE_FRAMES 22050       // 0,5 s ; la mesure porte sur la seconde moitié
+#define SINE_PEAK 4000          // -18 dBFS : +6 dB restent sous le seuil du limiteur
+#define SINE_LOUD 30000         // renforcé de 6 dB, bien au-delà de la pleine échelle
+#define DB_TOLERANCE 0.1
+
+typedef struct {
+    const char *name;
+    audio_eq_band_t band;
+    float freq;
+    double expect_db;           // réponse du biquad RBJ à cette fréquence
+} response_case_t;
+
+// Bande en cloche : tout le gain à f0, presque rien loin de f0 ; plateau
+// grave : la moitié du gain (en dB) à f0, tout le gain en dessous
+static const response_case_t responses[] = {
+    { "peaking f0", { AUDIO_EQ_PEAKING, 1000, 6, 1 }, 1000, 6.0 },
+    { "peaking below", { AUDIO_EQ_PEAKING, 1000, 6, 1 }, 100, 0.065 },
+    { "peaking above", { AUDIO_EQ_PEAKING, 1000, 6, 1 }, 10000, 0.045 },
+    { "low shelf f0", { AUDIO_EQ_LOW_SHELF, 200, 6, 0.707f }, 200, 3.0 },
+    { "low shelf below", { AUDIO_EQ_LOW_SHELF, 200, 6, 0.707f }, 32, 5.996 },
+    { "low shelf above", { AUDIO_EQ_LOW_SHELF, 200, 6, 0.707f }, 5000, 0.0 },
+};
+
+static int16_t *make_sine(float freq, int peak)
+{
+    int16_t *pcm = malloc(SINE_FRAMES * 2 * sizeof(int16_t));
+    if (!pcm) abort();
+    for (size_t i = 0; i < SINE_FRAMES; i++) {
+        pcm[2 * i] = pcm[2 * i + 1] = (int16_t)lrint(peak * sin(2 * M_PI * freq * i / AUDIO_EQ_RATE));
+    }
+    return pcm;
+}
+
+// Rapport des valeurs efficaces de sortie et d'entrée, filtres établis
+static double gain_db(const run_t *r, const int16_t *pcm)
+{
+    const int16_t *out = (const int16_t *)r->out;
+    double in_sum = 0, out_sum = 0;
+    for (size_t i = SINE_FRAMES / 2; i < SINE_FRAMES; i++) {
+        in_sum += (double)pcm[2 * i] * pcm[2 * i];
+        out_sum += (double)out[2 * i] * out[2 * i];
+    }
+    return 10 * log10(out_sum / in_sum);
+}
+
+static void test_eq_response(void)
+{
+    for (size_t i = 0; i < sizeof(responses) / sizeof(responses[0]); i++) {
+        const response_case_t *c = &responses[i];
+        audio_eq_settings_t eq = { .bands = { c->band } };
+        event_t events[] = { { .at = 0, .kind = EV_EQ, .eq = &eq }, { .kind = EV_END } };
+        int16_t *pcm = make_sine(c->freq, SINE_PEAK);
+        run_t r;
+        run_eq(&esp_dsp_path, events, pcm, SINE_FRAMES * 2 * sizeof(int16_t), &r);
+        if (r.out_len == SINE_FRAMES * 2 * sizeof(int16_t)) {
+            double db = gain_db(&r, pcm);
+            CHECKF(fabs(db - c->expect_db) < DB_TOLERANCE, "%s: %.3f dB at %.0f Hz, %.3f expected",
+                   c->name, db, c->freq, c->expect_db);
+        } else {
+            CHECKF(false, "%s: %zu bytes out", c->name, r.out_len);
+        }
+        if (i == 0) {
+            printf("eq: %u cycles/sample/band (host)\n", (unsigned)audio_eq_get_cycles_per_sample_band(r.eq));
+        }
+        free(r.out);
+        free(pcm);
+    }
+
+    // renforcement au-delà de la pleine échelle : le limiteur le prend, rien n'est écrêté
+    audio_eq_settings_t boost = { .bands = { { AUDIO_EQ_PEAKING, 1000, 6, 1 } } };
+    event_t events[] = { { .at = 0, .kind = EV_EQ, .eq = &boost }, { .kind = EV_END } };
+    int16_t *pcm = make_sine(1000, SINE_LOUD);
+    run_t r;
+    run_eq(&esp_dsp_path, events, pcm, SINE_FRAMES * 2 * sizeof(int16_t), &r);
+    const int16_t *out = (const int16_t *)r.out;
+    int peak = 0;
+    size_t clipped = 0;
+    for (size_t i = 0; i < r.out_len / sizeof(int16_t); i++) {
+        int a = abs(out[i]);
+        if (a > peak) peak = a;
+        if (a >= 32767) clipped++;
+    }
+    CHECKF(peak > SINE_LOUD && clipped == 0, "boost: peak %d, %zu samples clipped", peak, clipped);
+    free(r.out);
+    free(pcm);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(dsp_cases) / sizeof(dsp_cases[0]); i++) {
+        test_dsp_case(&dsp_cases[i]);
+    }
+    test_eq();
+    test_eq_response();
+    return TEST_END();
+}
@@ -0,0 +1,200 @@
+// test_mem_budget.c
+/*
+ * Budgets mémoire (main/mem_budget.c) : comptes par différence du tas et
+ * par source, pic, dépassement et fragmentation ; puis l'occupation réelle
+ * de la playlist, index, ordre de lecture et un gain ReplayGain par piste,
+ * pour une bibliothèque de LIBRARY_LEN pistes, face à
+ * CONFIG_MEM_BUDGET_PLAYLIST_KB. Le pipeline audio est confronté à son
+ * budget par test_pipeline ; le serveur HTTP et Bluedroid ne tournent que
+ * sur la carte.
+ */
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "library_scanner.h"
+#include "path_config.h"
+#include "playlist_manager.h"
+#include "freertos/task.h"
+#include "replaygain.h"
+#include "test.h"
+
+#include "mem_budget.c"
+
+#define LIBRARY_LEN 15000       // bibliothèque prévue par le budget par défaut (Kconfig)
+
+// Cache ReplayGain, format décrit dans replaygain.c
+#define RG_MAGIC 0x31434752
+#define RG_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+} rg_header_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    int16_t gain_cdb;
+    uint16_t reserved;
+} rg_record_t;
+
+/* ---------- mécanique des comptes ---------- */
+
+static size_t source_bytes;
+
+static size_t fake_source(void)
+{
+    return source_bytes;
+}
+
+static void test_accounting(void)
+{
+    mem_budget_entry_t e;
+    size_t budget = CONFIG_MEM_BUDGET_HTTP_KB * 1024;
+
+    // différence du tas, interne et PSRAM
+    host_heap_set(MALLOC_CAP_INTERNAL, 300000, 200000, 150000);
+    host_heap_set(MALLOC_CAP_SPIRAM, 4 << 20, 3 << 20, 2 << 20);
+    mem_budget_begin(MEM_SUBSYS_HTTP);
+    host_heap_set(MALLOC_CAP_INTERNAL, 300000, 170000, 120000);
+    host_heap_set(MALLOC_CAP_SPIRAM, 4 << 20, (3 << 20) - 10000, 2 << 20);
+    mem_budget_end(MEM_SUBSYS_HTTP);
+    CHECK(!mem_budget_get(MEM_SUBSYS_HTTP, &e));
+    CHECKF(e.bytes == 40000 && e.internal == 30000 && e.spiram == 10000 && e.peak == 40000 &&
+           e.budget == budget, "http: %zu B (%zu + %zu), peak %zu, budget %zu", e.bytes,
+           e.internal, e.spiram, e.peak, e.budget);
+
+    // au-delà du budget, puis arrêté : le pic reste
+    mem_budget_begin(MEM_SUBSYS_HTTP);
+    host_heap_set(MALLOC_CAP_INTERNAL, 300000, 170000 - budget - 1, 100000);
+    mem_budget_end(MEM_SUBSYS_HTTP);
+    CHECK(mem_budget_get(MEM_SUBSYS_HTTP, &e) && e.bytes == budget + 1 && e.peak == budget + 1);
+    CHECK(mem_budget_report() == 1);
+    mem_budget_release(MEM_SUBSYS_HTTP);
+    CHECK(!mem_budget_get(MEM_SUBSYS_HTTP, &e) && e.bytes == 0 && e.peak == budget + 1);
+
+    // tas rendu entre-temps : rien n'est attribué
+    mem_budget_begin(MEM_SUBSYS_HTTP);
+    host_heap_set(MALLOC_CAP_INTERNAL, 300000, 250000, 200000);
+    mem_budget_end(MEM_SUBSYS_HTTP);
+    CHECK(!mem_budget_get(MEM_SUBSYS_HTTP, &e) && e.bytes == 0);
+    mem_budget_release(MEM_SUBSYS_HTTP);
+
+    // source relue à chaque consultation
+    budget = CONFIG_MEM_BUDGET_BT_KB * 1024;
+    mem_budget_set_source(MEM_SUBSYS_BT, fake_source);
+    source_bytes = budget;
+    CHECK(!mem_budget_get(MEM_SUBSYS_BT, &e) && e.bytes == budget);
+    source_bytes = budget + 1;
+    CHECK(mem_budget_get(MEM_SUBSYS_BT, &e) && e.peak == budget + 1);
+    source_bytes = 1000;
+    CHECK(!mem_budget_get(MEM_SUBSYS_BT, &e) && e.bytes == 1000 && e.peak == budget + 1);
+    CHECK(mem_budget_report() == 0);
+    mem_budget_set_source(MEM_SUBSYS_BT, NULL);
+
+    // fragmentation : 100 - plus grand bloc / libre
+    mem_heap_stats_t h;
+    host_heap_set(MALLOC_CAP_INTERNAL, 300000, 120000, 30000);
+    mem_budget_heap(MALLOC_CAP_INTERNAL, &h);
+    CHECKF(h.total == 300000 && h.free == 120000 && h.largest_block == 30000 && h.frag_pct == 75,
+           "internal: free %zu, largest %zu, %u%%", h.free, h.largest_block, (unsigned)h.frag_pct);
+    CHECK(h.min_free <= h.free);
+    host_heap_set(MALLOC_CAP_INTERNAL, 300000, 0, 0);
+    mem_budget_heap(MALLOC_CAP_INTERNAL, &h);
+    CHECK(h.frag_pct == 0);
+
+    CHECK(!mem_budget_get(MEM_SUBSYS_MAX, &e));
+}
+
+/* ---------- playlist sur une bibliothèque réelle ---------- */
+
+static int make_dir(const char *path)
+{
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+static int make_library(void)
+{
+    char path[TRACK_PATH_MAX];
+    for (size_t i = 0; i < LIBRARY_LEN; i++) {
+        int n = snprintf(path, sizeof(path), "%s/Artist %03zu", MP3_DIR, i / 20);
+        if (i % 20 == 0 && make_dir(path)) return -1;
+        snprintf(path + n, sizeof(path) - n, "/%02zu - Track title %05zu.mp3", i % 20, i);
+        FILE *fp = fopen(path, "wb");
+        if (!fp || fclose(fp) != 0) return -1;
+    }
+    return 0;
+}
+
+// Un gain par piste dans le cache
+static int write_gain_cache(void)
+{
+    FILE *fp = fopen(REPLAYGAIN_CACHE_PATH, "wb");
+    if (!fp) return -1;
+    rg_header_t h = { .magic = RG_MAGIC, .version = RG_VERSION, .record_size = sizeof(rg_record_t) };
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    for (uint32_t i = 0; ok && i < LIBRARY_LEN; i++) {
+        rg_record_t r = { .hash = i * 2654435761u, .size = 4000000 + i, .gain_cdb = -600 };
+        ok = fwrite(&r, sizeof(r), 1, fp) == 1;
+    }
+    return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+// Même somme que la source de la playlist dans main.c
+static size_t playlist_memory(void)
+{
+    return playlist_manager_get_memory_usage() + replaygain_memory_usage();
+}
+
+static void test_playlist_budget(void)
+{
+    CHECK(write_gain_cache() == 0);
+    CHECK(replaygain_init() == ESP_OK);
+    CHECK(playlist_manager_init() == ESP_OK);
+    library_scan_status_t st;
+    for (library_scanner_get_status(&st); !st.done; library_scanner_get_status(&st)) {
+        vTaskDelay(1);
+    }
+    CHECKF(playlist_manager_get_track_count() == LIBRARY_LEN, "%zu tracks scanned",
+           playlist_manager_get_track_count());
+    // l'ordre de lecture est tiré au premier passage
+    CHECK(playlist_manager_get_next() != NULL);
+
+    mem_budget_entry_t e;
+    mem_budget_set_source(MEM_SUBSYS_PLAYLIST, playlist_memory);
+    bool over = mem_budget_get(MEM_SUBSYS_PLAYLIST, &e);
+    CHECKF(!over && e.budget == CONFIG_MEM_BUDGET_PLAYLIST_KB * 1024,
+           "playlist: %zu B for %u tracks, budget %zu B", e.bytes, LIBRARY_LEN, e.budget);
+    CHECKF(replaygain_memory_usage() >= LIBRARY_LEN * sizeof(rg_record_t),
+           "gain cache: %zu B", replaygain_memory_usage());
+    printf("playlist: %zu B for %u tracks (%zu B/track), budget %zu B\n", e.bytes, LIBRARY_LEN,
+           e.bytes / LIBRARY_LEN, e.budget);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+int main(void)
+{
+    test_accounting();
+
+    char tmpl[] = "/tmp/lecteur_budget.XXXXXX";
+    if (!mkdtemp(tmpl) || chdir(tmpl) != 0 || make_dir(SD_MOUNT_POINT) || make_dir(MP3_DIR) ||
+        make_library() != 0) {
+        perror(tmpl);
+        return 1;
+    }
+    test_playlist_budget();
+    chdir("/");
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return TEST_END();
+}
@@ -0,0 +1,285 @@
+// test_metrics.c
+/*
+ * Tests de main/metrics.c : quantiles des changements de piste (rang le
+ * plus proche, pour chaque remplissage de la fenêtre) et validité du texte
+ * Prometheus de /metrics. Les modules mesurés sont remplacés par des
+ * fonctions qui rendent les valeurs fixées par le test.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+#include "metrics.c"
+
+static audio_pipeline_stats_t pipe_stats;
+static link_q_stats_t link_stats;
+
+void audio_manager_get_pipeline_stats(audio_pipeline_stats_t *out)
+{
+    *out = pipe_stats;
+}
+
+void audio_manager_get_link_stats(link_q_stats_t *out)
+{
+    *out = link_stats;
+}
+
+void audio_manager_get_cmd_stats(audio_cmd_type_t type, audio_cmd_stats_t *out)
+{
+    *out = (audio_cmd_stats_t){ .count = 10 + type, .coalesced = type == AUDIO_CMD_NEXT ? 3 : 0,
+                                .last_us = 800, .max_us = 1500 + type };
+}
+
+const char *audio_manager_cmd_name(audio_cmd_type_t type)
+{
+    static const char *const names[AUDIO_CMD_MAX] = {
+        "start", "stop", "play", "next", "prev", "pause", "resume", "track_end", "format",
+        "seek", "sink",
+    };
+    return names[type];
+}
+
+void audio_manager_get_rsp_stats(audio_rsp_stats_t *out)
+{
+    *out = (audio_rsp_stats_t){ 12, 3, 2400000, 600000 };
+}
+
+uint32_t audio_manager_get_eq_cycles(void)
+{
+    return 21;
+}
+
+void sd_readahead_get_stats(sd_readahead_stats_t *st)
+{
+    *st = (sd_readahead_stats_t){ 65536, 32768, 2, 15000, 123456789, 2500000 };
+}
+
+void bt_control_get_stats(bt_connect_stats_t *out)
+{
+    *out = (bt_connect_stats_t){ .connects = 3, .page_connects = 2, .inquiries = 1,
+                                 .last_connect_ms = 1800, .max_connect_ms = 4200,
+                                 .total_connect_ms = 7500 };
+}
+
+bool bt_control_is_connected(void)
+{
+    return true;
+}
+
+static char body[64 * 1024];
+
+static httpd_req_t render(void)
+{
+    httpd_req_t req = { .body = body, .body_size = sizeof(body) };
+    body[0] = '\0';
+    const httpd_uri_t *uri = host_httpd_find("/metrics", HTTP_GET);
+    CHECK(uri && uri->handler(&req) == ESP_OK);
+    CHECK(req.sent < sizeof(body));
+    return req;
+}
+
+// Valeur de l'échantillon quantile="label", -1 s'il est absent
+static double quantile_value(const char *label)
+{
+    char key[96];
+    snprintf(key, sizeof(key), "audio_track_switch_seconds{quantile=\"%s\"} ", label);
+    const char *p = strstr(body, key);
+    return p ? strtod(p + strlen(key), NULL) : -1;
+}
+
+/*
+ * Pour chaque remplissage n de la fenêtre, les n derniers changements
+ * valent 1 à n ms dans le désordre : la valeur du quantile q est le rang
+ * attendu, le plus petit r tel que r / n >= q.
+ */
+static void test_quantiles(void)
+{
+    static const struct { const char *label; uint32_t permille; } q[] = {
+        { "0.5", 500 }, { "0.9", 900 }, { "0.99", 990 },
+    };
+    for (uint32_t n = 0; n <= AUDIO_SWITCH_WINDOW; n++) {
+        memset(&pipe_stats, 0, sizeof(pipe_stats));
+        for (uint32_t i = 0; i < n; i++) {
+            // décroissant avec une rotation : ni trié ni trié à l'envers
+            uint32_t ms = n - (i + n / 3) % n;
+            pipe_stats.switch_recent_us[i] = ms * 1000;
+            pipe_stats.switch_total_us += ms * 1000;
+        }
+        pipe_stats.switch_recent_len = n;
+        pipe_stats.switch_count = n + 100;    // fenêtre pleine depuis longtemps ou non
+        render();
+
+        for (size_t k = 0; k < sizeof(q) / sizeof(q[0]); k++) {
+            double v = quantile_value(q[k].label);
+            if (n == 0) {
+                CHECKF(v < 0, "n=0: quantile %s present", q[k].label);
+                continue;
+            }
+            uint32_t rank = 1;
+            while (rank * 1000 < q[k].permille * n) rank++;
+            CHECKF(v == rank / 1000.0, "n=%u q=%s: %.4f s, rank %u expected", (unsigned)n,
+                   q[k].label, v, (unsigned)rank);
+        }
+        char line[96];
+        snprintf(line, sizeof(line), "audio_track_switch_seconds_count %u\n", (unsigned)n + 100);
+        CHECKF(strstr(body, line) != NULL, "n=%u: count missing", (unsigned)n);
+    }
+}
+
+static bool is_name(const char *s, size_t len)
+{
+    if (len == 0 || isdigit((unsigned char)s[0])) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)s[i]) && s[i] != '_' && s[i] != ':') return false;
+    }
+    return true;
+}
+
+typedef struct {
+    char name[64];
+    const char *type;   // NULL avant la ligne TYPE
+    bool closed;        // d'autres familles ont suivi ses échantillons
+} family_t;
+
+static family_t families[64];
+static size_t family_count;
+static family_t *open_family;
+
+static family_t *family_get(const char *name, size_t len)
+{
+    for (size_t i = 0; i < family_count; i++) {
+        if (strlen(families[i].name) == len && memcmp(families[i].name, name, len) == 0) {
+            return &families[i];
+        }
+    }
+    return NULL;
+}
+
+// Famille d'un échantillon : son nom, ou pour un résumé le nom sans _sum/_count
+static family_t *sample_family(const char *name, size_t len)
+{
+    family_t *f = family_get(name, len);
+    if (f) return f;
+    static const char *const suffixes[] = { "_sum", "_count" };
+    for (size_t i = 0; i < 2; i++) {
+        size_t sl = strlen(suffixes[i]);
+        if (len > sl && memcmp(name + len - sl, suffixes[i], sl) == 0) {
+            f = family_get(name, len - sl);
+            if (f && f->type && strcmp(f->type, "summary") == 0) return f;
+        }
+    }
+    return NULL;
+}
+
+// Étiquettes {nom="valeur",...} ; rend la fin ou NULL si mal formées
+static const char *parse_labels(const char *p)
+{
+    if (*p != '{') return p;
+    p++;
+    while (*p != '}') {
+        const char *n = p;
+        while (isalnum((unsigned char)*p) || *p == '_') p++;
+        if (!is_name(n, p - n) || p[0] != '=' || p[1] != '"') return NULL;
+        for (p += 2; *p != '"'; p++) {
+            if (*p == '\n' || *p == '\0') return NULL;
+            if (*p == '\\') p++;
+        }
+        p++;
+        if (*p == ',') p++;
+        else if (*p != '}') return NULL;
+    }
+    return p + 1;
+}
+
+// Une ligne du format texte 0.0.4 ; rend un message d'erreur ou NULL
+static const char *check_line(const char *line, size_t len)
+{
+    char copy[256];
+    if (len >= sizeof(copy)) return "line too long";
+    memcpy(copy, line, len);
+    copy[len] = '\0';
+
+    if (copy[0] == '#') {
+        char kind[8], name[64], rest[128];
+        if (sscanf(copy, "# %7s %63s %127[^\n]", kind, name, rest) != 3) return "bad comment";
+        if (!is_name(name, strlen(name))) return "bad family name";
+        family_t *f = family_get(name, strlen(name));
+        if (strcmp(kind, "HELP") == 0) {
+            if (f) return "HELP after its family";
+            if (family_count == sizeof(families) / sizeof(families[0])) return "too many families";
+            f = &families[family_count++];
+            snprintf(f->name, sizeof(f->name), "%s", name);
+            return NULL;
+        }
+        if (strcmp(kind, "TYPE") != 0) return "unknown comment";
+        if (!f || f->type) return "TYPE without HELP, or twice";
+        static const char *const types[] = { "counter", "gauge", "summary" };
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+            if (strcmp(rest, types[i]) == 0) f->type = types[i];
+        }
+        return f->type ? NULL : "unknown type";
+    }
+
+    const char *p = copy;
+    while (*p && *p != '{' && *p != ' ') p++;
+    if (!is_name(copy, p - copy)) return "bad metric name";
+    family_t *f = sample_family(copy, p - copy);
+    if (!f || !f->type) return "sample without HELP/TYPE";
+    if (f->closed) return "family split";
+    if (open_family && open_family != f) open_family->closed = true;
+    open_family = f;
+    if (*p == '{' && strcmp(f->type, "summary") == 0 && strncmp(p, "{quantile=\"", 11) != 0) {
+        return "summary sample without quantile";
+    }
+    if (!(p = parse_labels(p)) || *p != ' ') return "bad labels";
+    char *end;
+    strtod(p + 1, &end);
+    if (end == p + 1 || *end != '\0') return "bad value";
+    return NULL;
+}
+
+static void test_exposition(void)
+{
+    // valeurs de toutes les sections, dont le signal qui n'est publié que s'il est connu
+    memset(&pipe_stats, 0, sizeof(pipe_stats));
+    pipe_stats.links[0] = (audio_link_stats_t){ "mp3", 16384, 4096, 1 };
+    pipe_stats.links[1] = (audio_link_stats_t){ "filter", 8192, 0, 4 };
+    pipe_stats.switch_recent_us[0] = 25000;
+    pipe_stats.switch_recent_len = 1;
+    pipe_stats.switch_count = 1;
+    pipe_stats.switch_total_us = 25000;
+    link_stats = (link_q_stats_t){ .level = LINK_Q_DEGRADED, .rssi_delta = -6,
+                                   .rssi_delta_min = -11, .send_pct = 97, .send_pct_min = 80 };
+    host_heap_set(MALLOC_CAP_INTERNAL, 300000, 120000, 60000);
+    host_heap_set(MALLOC_CAP_SPIRAM, 4 << 20, 3 << 20, 2 << 20);
+
+    httpd_req_t req = render();
+    CHECK(req.status == 0);
+    CHECK(req.type && strcmp(req.type, "text/plain; version=0.0.4") == 0);
+    CHECK(req.sent > 0 && body[req.sent - 1] == '\n');
+    CHECK(strstr(body, "bt_link_rssi_delta_db -6\n") != NULL);
+
+    size_t lines = 0;
+    for (const char *line = body; *line; lines++) {
+        const char *eol = strchr(line, '\n');
+        if (!eol) break;
+        const char *err = check_line(line, eol - line);
+        CHECKF(!err, "line %zu: %s: %.*s", lines + 1, err, (int)(eol - line), line);
+        line = eol + 1;
+    }
+    CHECK(lines > 100);
+    for (size_t i = 0; i < family_count; i++) {
+        CHECKF(families[i].type, "%s: HELP without TYPE", families[i].name);
+    }
+}
+
+int main(void)
+{
+    CHECK(metrics_register(NULL) == ESP_OK);
+    CHECK(metrics_register(NULL) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    test_quantiles();
+    test_exposition();
+    return TEST_END();
+}
@@ -0,0 +1,329 @@
+// test_pipeline.c
+/*
+ * Pipeline persistant de main/audio_manager.c, sur l'ADF factice de
+ * shim/adf.c : des milliers de pauses/reprises, d'arrêts/redémarrages et
+ * de changements de piste doivent réutiliser le pipeline, ses éléments,
+ * ses anneaux et ses tâches, sans que le tas ne grossisse, et chaque
+ * commande doit être prise en moins de 50 ms. Le lecteur de piste, la
+ * playlist et le Bluetooth sont remplacés par des fonctions du test ; le
+ * DSP, l'égaliseur et l'état de lecture sont les vrais. L'occupation du
+ * pipeline est confrontée à CONFIG_MEM_BUDGET_AUDIO_KB.
+ */
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "mem_budget.h"
+#include "test.h"
+
+#include "audio_manager.c"
+
+#define TRACK_MS 2000
+#define BYTE_RATE (44100 * 2 * 2)
+#define TRACK_BYTES (TRACK_MS * (BYTE_RATE / 1000))
+#define MAX_LATENCY_US 50000
+#define STATE_TIMEOUT_US 2000000
+#define HEAP_SLACK (16 * 1024)     // une fuite d'un bloc par cycle la dépasse
+
+// track_reader sur la carte, réglages par défaut : deux têtes de préchargement
+// de 16 Ko et un anneau de lecture anticipée de 8 blocs de 16 Ko
+#define READER_MEMORY ((2 + 8) * 16 * 1024)
+
+#define PAUSE_CYCLES 2000
+#define STOP_CYCLES 500
+#define SKIPS 200
+
+/* ---------- lecteur de piste : PCM 44,1 kHz stéréo de TRACK_MS ---------- */
+
+static char cur_uri[TRACK_PATH_MAX];
+static long track_pos;              // lu par la tâche de contrôle pendant la lecture
+static unsigned tracks_opened;
+static volatile bool pause_at_end;  // pause postée par le décodeur, avant sa fin de piste
+
+esp_err_t track_reader_open(const char *uri)
+{
+    strlcpy(cur_uri, uri, sizeof(cur_uri));
+    __atomic_store_n(&track_pos, 0, __ATOMIC_RELAXED);
+    tracks_opened++;
+    return ESP_OK;
+}
+
+int track_reader_read(char *buf, size_t len)
+{
+    long pos = __atomic_load_n(&track_pos, __ATOMIC_RELAXED);
+    size_t n = TRACK_BYTES - pos < (long)len ? (size_t)(TRACK_BYTES - pos) : len;
+    // signal non nul, pour que le DSP ne voie pas de silence
+    for (size_t i = 0; i < n; i++) buf[i] = (char)((pos + i) * 7 + 1);
+    __atomic_store_n(&track_pos, pos + (long)n, __ATOMIC_RELAXED);
+    if (n == 0 && pause_at_end) {
+        pause_at_end = false;
+        audio_manager_pause();
+    }
+    return (int)n;
+}
+
+esp_err_t track_reader_prepare_next(const char *uri) { return ESP_ERR_NOT_SUPPORTED; }
+bool track_reader_wants_next(void) { return false; }
+const char *track_reader_get_pending_uri(void) { return NULL; }
+bool track_reader_take_cut(track_cut_t *out) { return false; }
+const char *track_reader_get_current_uri(void) { return cur_uri[0] ? cur_uri : NULL; }
+bool track_reader_get_tag_gain(float *gain_db) { *gain_db = 0; return true; }
+uint32_t track_reader_get_duration_ms(void) { return TRACK_MS; }
+long track_reader_get_offset(void) { return __atomic_load_n(&track_pos, __ATOMIC_RELAXED); }
+size_t track_reader_get_memory_usage(void) { return READER_MEMORY; }
+
+bool track_reader_get_format(int *sample_rate, int *channels)
+{
+    *sample_rate = 44100;
+    *channels = 2;
+    return true;
+}
+
+uint32_t track_reader_get_position_ms(void)
+{
+    return (uint32_t)(track_reader_get_offset() / (BYTE_RATE / 1000));
+}
+
+esp_err_t track_reader_seek_offset(long offset)
+{
+    if (offset < 0 || offset > TRACK_BYTES) return ESP_ERR_INVALID_ARG;
+    __atomic_store_n(&track_pos, offset & ~3L, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t track_reader_seek_ms(uint32_t ms)
+{
+    return track_reader_seek_offset((long)ms * (BYTE_RATE / 1000));
+}
+
+/* ---------- playlist, ReplayGain, Bluetooth, push ---------- */
+
+static unsigned playlist_pos;
+static char playlist_uri[TRACK_PATH_MAX];
+
+static const char *playlist_uri_at(unsigned pos)
+{
+    snprintf(playlist_uri, sizeof(playlist_uri), MP3_DIR "/%04u.mp3", pos % 1000);
+    return playlist_uri;
+}
+
+const char *playlist_manager_get_next(void) { return playlist_uri_at(++playlist_pos); }
+const char *playlist_manager_get_prev(void) { return playlist_uri_at(--playlist_pos); }
+
+esp_err_t playlist_manager_set_current_by_name(const char *filename)
+{
+    unsigned pos;
+    if (sscanf(filename, "%4u.mp3", &pos) != 1) return ESP_ERR_NOT_FOUND;
+    playlist_pos = pos;
+    return ESP_OK;
+}
+
+bool replaygain_lookup(const char *name, uint32_t size, float *gain_db) { return false; }
+void replaygain_analysis_begin(const char *name, uint32_t size) {}
+void replaygain_analysis_feed(int64_t sum_squares, int frames, void *ctx) {}
+void replaygain_analysis_end(bool complete) {}
+
+bool bt_control_is_connected(void) { return true; }
+int8_t bt_control_poll_rssi_delta(void) { return 0; }
+void bt_control_a2dp_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param) {}
+
+void status_push_notify(void) {}
+
+/* ---------- mesures ---------- */
+
+static size_t heap_used(void)
+{
+    return mallinfo2().uordblks;
+}
+
+// Attend l'état voulu ; délai en µs depuis t0, ou -1 s'il n'est pas atteint
+static int64_t wait_state(int64_t t0, const char *state)
+{
+    while (strcmp(audio_manager_get_state_name(), state) != 0) {
+        if (esp_timer_get_time() - t0 > STATE_TIMEOUT_US) return -1;
+        usleep(50);
+    }
+    return esp_timer_get_time() - t0;
+}
+
+// Poste une commande et attend que l'état voulu soit visible
+static int64_t timed(esp_err_t (*cmd)(void), const char *state)
+{
+    int64_t t0 = esp_timer_get_time();
+    return cmd() == ESP_OK ? wait_state(t0, state) : -1;
+}
+
+static int64_t max_latency;
+static unsigned missed;
+
+static void step(esp_err_t (*cmd)(void), const char *state)
+{
+    int64_t us = timed(cmd, state);
+    if (us < 0) missed++;
+    if (us > max_latency) max_latency = us;
+}
+
+static uint32_t switch_count(void)
+{
+    audio_pipeline_stats_t st;
+    audio_manager_get_pipeline_stats(&st);
+    return st.switch_count;
+}
+
+// Attend un changement de piste après before et la lecture ; -1 si aucun
+static int64_t wait_switch(int64_t t0, uint32_t before)
+{
+    while (switch_count() == before || !audio_manager_is_playing()) {
+        if (esp_timer_get_time() - t0 > STATE_TIMEOUT_US) return -1;
+        usleep(50);
+    }
+    return esp_timer_get_time() - t0;
+}
+
+static int64_t timed_next(void)
+{
+    uint32_t before = switch_count();
+    int64_t t0 = esp_timer_get_time();
+    return audio_manager_next() == ESP_OK ? wait_switch(t0, before) : -1;
+}
+
+// Attend que le lecteur de piste soit à ms ; false s'il n'y arrive pas
+static bool wait_position(uint32_t ms)
+{
+    int64_t t0 = esp_timer_get_time();
+    while (track_reader_get_position_ms() != ms) {
+        if (esp_timer_get_time() - t0 > STATE_TIMEOUT_US) return false;
+        usleep(50);
+    }
+    return true;
+}
+
+// Octets consommés par l'émetteur pendant ms millisecondes
+static uint64_t sink_bytes_during(unsigned ms)
+{
+    host_adf_stats_t a, b;
+    host_adf_get_stats(&a);
+    usleep(ms * 1000);
+    host_adf_get_stats(&b);
+    return b.sink_bytes - a.sink_bytes;
+}
+
+static void cycles(unsigned pauses, unsigned stops, unsigned skips)
+{
+    for (unsigned i = 0; i < pauses; i++) {
+        step(audio_manager_pause, "paused");
+        step(audio_manager_resume, "playing");
+    }
+    for (unsigned i = 0; i < stops; i++) {
+        step(audio_manager_stop, "stopped");
+        step(audio_manager_start, "playing");
+    }
+    for (unsigned i = 0; i < skips; i++) {
+        int64_t us = timed_next();
+        if (us < 0) missed++;
+        if (us > max_latency) max_latency = us;
+    }
+}
+
+static void check_cmd_latency(audio_cmd_type_t type)
+{
+    audio_cmd_stats_t st;
+    audio_manager_get_cmd_stats(type, &st);
+    CHECKF(st.count > 0 && st.max_us < MAX_LATENCY_US, "%s: %u commands, max %u us",
+           audio_manager_cmd_name(type), (unsigned)st.count, (unsigned)st.max_us);
+}
+
+int main(void)
+{
+    // premier démarrage : le pipeline est construit, la lecture commence
+    CHECK(timed(audio_manager_start, "playing") >= 0);
+    CHECK(sink_bytes_during(100) > 0);
+
+    // les allocations paresseuses (journal, NVS, tas par thread) ont lieu ici
+    cycles(50, 20, 20);
+    max_latency = 0;
+    missed = 0;
+    host_adf_stats_t adf;
+    unsigned tasks0 = host_task_count();
+    size_t heap0 = heap_used();
+    uint32_t switches0 = switch_count();
+    unsigned opened0 = tracks_opened;
+
+    cycles(PAUSE_CYCLES, STOP_CYCLES, SKIPS);
+
+    size_t heap1 = heap_used();
+    host_adf_get_stats(&adf);
+    CHECKF(missed == 0, "%u commands without the expected state", missed);
+    CHECKF(max_latency < MAX_LATENCY_US, "max latency %lld us", (long long)max_latency);
+    CHECK(adf.pipelines == 1 && adf.elements == 3 && adf.ringbufs == 2);
+    CHECKF(adf.element_tasks == 3 && host_task_count() == tasks0,
+           "element tasks %u, tasks %u then %u", adf.element_tasks, tasks0, host_task_count());
+    CHECKF(heap1 <= heap0 + HEAP_SLACK, "heap %zu then %zu bytes", heap0, heap1);
+    CHECKF(switch_count() - switches0 >= SKIPS && tracks_opened - opened0 >= SKIPS,
+           "%u switches, %u tracks opened", (unsigned)(switch_count() - switches0),
+           tracks_opened - opened0);
+    check_cmd_latency(AUDIO_CMD_PAUSE);
+    check_cmd_latency(AUDIO_CMD_RESUME);
+    check_cmd_latency(AUDIO_CMD_STOP);
+    check_cmd_latency(AUDIO_CMD_START);
+    check_cmd_latency(AUDIO_CMD_NEXT);
+
+    mem_budget_entry_t mem;
+    mem_budget_set_source(MEM_SUBSYS_AUDIO, audio_manager_get_memory_usage);
+    bool over = mem_budget_get(MEM_SUBSYS_AUDIO, &mem);
+    CHECKF(!over && mem.bytes > READER_MEMORY, "audio: %zu B, budget %zu B", mem.bytes, mem.budget);
+
+    // toujours du son après le soak, et plus rien en pause
+    uint64_t playing = sink_bytes_during(100);
+    CHECKF(playing > BYTE_RATE / 20, "%llu bytes in 100 ms", (unsigned long long)playing);
+    CHECK(timed(audio_manager_pause, "paused") >= 0);
+    usleep(20000);
+    CHECK(sink_bytes_during(100) == 0);
+    CHECK(timed(audio_manager_resume, "playing") >= 0);
+
+    // fin de piste signalée après une pause : la pause tient, la suivante part à la reprise
+    uint32_t before_end = switch_count();
+    pause_at_end = true;
+    CHECK(audio_manager_seek(TRACK_MS - 1) == ESP_OK);
+    CHECK(wait_state(esp_timer_get_time(), "paused") >= 0);
+    usleep(50000);
+    CHECK(strcmp(audio_manager_get_state_name(), "paused") == 0 && switch_count() == before_end);
+    int64_t t0 = esp_timer_get_time();
+    CHECK(audio_manager_resume() == ESP_OK && wait_switch(t0, before_end) >= 0);
+    CHECK(switch_count() == before_end + 1);
+
+    // seek en pause (/seek, AVRCP avance et retour rapides) : la position
+    // change, la pause tient jusqu'à la reprise, sur la même piste
+    uint32_t before_seek = switch_count();
+    CHECK(timed(audio_manager_pause, "paused") >= 0);
+    CHECK(audio_manager_seek(TRACK_MS / 2) == ESP_OK && wait_position(TRACK_MS / 2));
+    CHECK(audio_manager_seek_relative(-500) == ESP_OK && wait_position(TRACK_MS / 2 - 500));
+    CHECK(sink_bytes_during(100) == 0);
+    CHECKF(strcmp(audio_manager_get_state_name(), "paused") == 0 &&
+           track_reader_get_position_ms() == TRACK_MS / 2 - 500, "%s at %u ms after a paused seek",
+           audio_manager_get_state_name(), (unsigned)track_reader_get_position_ms());
+    CHECK(timed(audio_manager_resume, "playing") >= 0 && sink_bytes_during(100) > 0);
+    CHECK(switch_count() == before_seek);
+
+    // lecture d'un fichier : la playlist s'y place, "suivant" repart de là
+    uint32_t before_play = switch_count();
+    t0 = esp_timer_get_time();
+    CHECK(audio_manager_play(MP3_DIR "/0500.mp3") == ESP_OK && wait_switch(t0, before_play) >= 0);
+    CHECKF(strcmp(cur_uri, MP3_DIR "/0500.mp3") == 0, "playing %s", cur_uri);
+    CHECK(timed_next() >= 0);
+    CHECKF(strcmp(cur_uri, MP3_DIR "/0501.mp3") == 0, "next is %s", cur_uri);
+
+    // commandes répétées sans effet
+    CHECK(timed(audio_manager_start, "playing") >= 0);
+    CHECK(timed(audio_manager_stop, "stopped") >= 0);
+    CHECK(timed(audio_manager_stop, "stopped") >= 0);
+    CHECK(timed(audio_manager_pause, "stopped") >= 0);
+    CHECK(timed(audio_manager_start, "playing") >= 0);
+    host_adf_get_stats(&adf);
+    CHECK(adf.pipelines == 1 && adf.element_tasks == 3);
+
+    printf("%u pause/resume, %u stop/start, %u next: max %lld us, heap %+lld bytes, audio %zu B\n",
+           PAUSE_CYCLES, STOP_CYCLES, SKIPS, (long long)max_latency,
+           (long long)heap1 - (long long)heap0, mem.bytes);
+    return TEST_END();
+}
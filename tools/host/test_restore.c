@@ -0,0 +1,273 @@
+// test_restore.c
+/*
+ * Reprise après redémarrage (main/playback_state.c et
+ * playlist_manager_restore()) : chaque démarrage tourne dans un processus
+ * fils, comme app_main(), sur la même bibliothèque et un NVS adossé à un
+ * fichier. Un démarrage sur la même liste de pistes doit redonner la piste,
+ * la position et toute la suite de l'ordre aléatoire, y compris au-delà
+ * d'un nouveau tirage ; les écritures NVS doivent être regroupées.
+ */
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "esp_random.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "track_list.h"
+#include "test.h"
+
+#include "playlist_manager.c"
+
+#define LIBRARY_LEN 300
+#define FOLLOW 40               // pistes comparées après la piste reprise
+#define NVS_FILE "nvs.bin"
+
+typedef struct {
+    int load_err;               // playback_state_load() au démarrage
+    int restore_err;
+    uint32_t resume_offset;
+    size_t played;
+    char seq[FOLLOW][TRACK_PATH_MAX];   // premières pistes jouées après le démarrage
+    char last[TRACK_PATH_MAX];          // piste en cours à l'arrêt
+    char next[FOLLOW][TRACK_PATH_MAX];  // suite de l'ordre après l'arrêt
+    unsigned writes[4];         // écritures NVS des vérifications d'usure
+    size_t tracks;              // playlist_manager_get_track_count() après le scan
+    size_t missing_played;      // pistes rendues absentes de la carte
+    size_t listed;              // noms rendus par /list, page par page
+    size_t missing_listed;
+} boot_t;
+
+static int make_dir(const char *path)
+{
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+static int add_file(size_t i)
+{
+    char path[TRACK_PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/Artist %02zu", MP3_DIR, i / 20);
+    if (make_dir(path)) return -1;
+    snprintf(path + n, sizeof(path) - n, "/%03zu.mp3", i);
+    FILE *fp = fopen(path, "wb");
+    return fp && fclose(fp) == 0 ? 0 : -1;
+}
+
+static bool on_card(const char *name)
+{
+    char path[TRACK_PATH_MAX];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", MP3_DIR, name);
+    return stat(path, &st) == 0;
+}
+
+// Noms rendus par /list en pages de page pistes, comme www/app.js
+static void list_tracks(boot_t *r, size_t page)
+{
+    if (track_list_register(NULL) != ESP_OK) return;
+    const httpd_uri_t *list = host_httpd_find("/list", HTTP_GET);
+    static char body[64 * 1024];
+    size_t got = page;
+    for (size_t offset = 0; got == page; offset += page) {
+        char query[48];
+        snprintf(query, sizeof(query), "offset=%zu&limit=%zu", offset, page);
+        httpd_req_t req = { .query = query, .body = body, .body_size = sizeof(body) };
+        body[0] = '\0';
+        if (list->handler(&req) != ESP_OK || req.status != 0) return;
+        got = 0;
+        for (char *p = strchr(body, '"'); p; p = strchr(p + 1, '"')) {
+            char *end = strchr(p + 1, '"');
+            *end = '\0';
+            got++;
+            if (!on_card(p + 1)) r->missing_listed++;
+            p = end;
+        }
+        r->listed += got;
+    }
+}
+
+static void wait_scan(void)
+{
+    library_scan_status_t st;
+    for (library_scanner_get_status(&st); !st.done; library_scanner_get_status(&st)) {
+        vTaskDelay(1);
+    }
+}
+
+/*
+ * Un démarrage : même séquence que app_main() puis audio_manager, played
+ * pistes jouées, arrêt à offset dans la dernière.
+ */
+static void boot(boot_t *r, size_t played, uint32_t offset)
+{
+    playback_state_t saved;
+    if (host_nvs_set_file(NVS_FILE) != ESP_OK || playlist_manager_init() != ESP_OK) return;
+    r->load_err = playback_state_load(&saved);
+    if (r->load_err == ESP_OK) {
+        r->restore_err = playlist_manager_restore(&saved);
+        r->resume_offset = saved.offset;
+    }
+    wait_scan();
+
+    for (size_t i = 0; i < played; i++) {
+        const char *path = playlist_manager_get_next();
+        playback_state_set_track(path, 0);
+        if (i < FOLLOW) strlcpy(r->seq[i], path, TRACK_PATH_MAX);
+        strlcpy(r->last, path, TRACK_PATH_MAX);
+    }
+    r->played = played;
+    playback_state_set_offset(offset);
+    playback_state_flush(true);
+
+    // usure : rien sans changement, ni avant CONFIG_PLAYBACK_STATE_SAVE_SEC
+    unsigned w0 = host_nvs_write_count();
+    playback_state_flush(true);
+    r->writes[0] = host_nvs_write_count() - w0;
+    playback_state_set_offset(offset + 1);
+    playback_state_flush(false);
+    r->writes[1] = host_nvs_write_count() - w0;
+    // une avance de la position ne réécrit pas le nom de la piste
+    playback_state_flush(true);
+    r->writes[2] = host_nvs_write_count() - w0;
+    playback_state_set_offset(offset);
+    playback_state_flush(true);
+    r->writes[3] = host_nvs_write_count() - w0;
+
+    for (size_t i = 0; i < FOLLOW; i++) {
+        strlcpy(r->next[i], playlist_manager_get_next(), TRACK_PATH_MAX);
+    }
+
+    // pistes supprimées de la carte : ni jouées ni listées
+    r->tracks = playlist_manager_get_track_count();
+    for (size_t i = 0; i < 2 * LIBRARY_LEN; i++) {
+        const char *path = playlist_manager_get_next();
+        if (!path || !on_card(path + strlen(MP3_DIR) + 1)) r->missing_played++;
+    }
+    list_tracks(r, 64);
+}
+
+static boot_t *result;
+static uint32_t boot_seed = 0x2545f491;
+
+static int run_boot(size_t played, uint32_t offset)
+{
+    memset(result, 0, sizeof(*result));
+    result->load_err = result->restore_err = -1;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        host_random_seed(boot_seed);
+        boot(result, played, offset);
+        _exit(0);
+    }
+    boot_seed = boot_seed * 1103515245 + 12345;    // autre tirage à chaque démarrage
+    int status;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static void check_writes(const char *name)
+{
+    CHECKF(result->writes[0] == 0 && result->writes[1] == 0 && result->writes[2] == 1 &&
+           result->writes[3] == 2, "%s: NVS writes %u %u %u %u", name, result->writes[0],
+           result->writes[1], result->writes[2], result->writes[3]);
+}
+
+/*
+ * La piste reprise est celle de l'arrêt ; avec same_order, les suivantes
+ * sont celles que le démarrage précédent aurait jouées.
+ */
+static void check_resumed(const boot_t *before, uint32_t offset, bool same_order, const char *name)
+{
+    CHECKF(result->load_err == ESP_OK && result->restore_err == ESP_OK, "%s: load %d restore %d",
+           name, result->load_err, result->restore_err);
+    CHECKF(result->resume_offset == offset, "%s: offset %u", name, (unsigned)result->resume_offset);
+    CHECKF(strcmp(result->seq[0], before->last) == 0, "%s: resumed %s instead of %s", name,
+           result->seq[0], before->last);
+    size_t same = 1;
+    size_t n = result->played < FOLLOW ? result->played : FOLLOW;
+    while (same < n && strcmp(result->seq[same], before->next[same - 1]) == 0) same++;
+    if (same_order) CHECKF(same == n, "%s: order differs at track %zu of %zu", name, same, n);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+int main(void)
+{
+    char tmpl[] = "/tmp/lecteur_restore.XXXXXX";
+    if (!mkdtemp(tmpl) || chdir(tmpl) != 0 || make_dir(SD_MOUNT_POINT) || make_dir(MP3_DIR)) {
+        perror(tmpl);
+        return 1;
+    }
+    for (size_t i = 0; i < LIBRARY_LEN; i++) {
+        if (add_file(i) != 0) {
+            perror("add_file");
+            return 1;
+        }
+    }
+    result = mmap(NULL, 2 * sizeof(boot_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (result == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    boot_t *before = result + 1;
+
+    // premier démarrage : ni index ni état, parcours complet
+    CHECK(run_boot(7, 1000) == 0);
+    CHECK(result->load_err == ESP_ERR_NOT_FOUND);
+    check_writes("cold");
+    *before = *result;
+
+    // la piste et la position sont reprises, même si l'ordre tiré pendant
+    // le parcours ne peut pas être reproduit
+    CHECK(run_boot(2, 2000) == 0);
+    check_resumed(before, 1000, false, "after cold scan");
+    check_writes("resumed");
+    *before = *result;
+
+    // même bibliothèque : même ordre ; l'arrêt tombe après un nouveau tirage
+    CHECK(run_boot(LIBRARY_LEN, 3000) == 0);
+    check_resumed(before, 2000, true, "warm");
+    *before = *result;
+
+    CHECK(run_boot(FOLLOW, 4000) == 0);
+    check_resumed(before, 3000, true, "after reshuffle");
+    *before = *result;
+
+    // bibliothèque modifiée : la piste est reprise, l'ordre est tiré à nouveau
+    CHECK(add_file(LIBRARY_LEN) == 0);
+    CHECK(run_boot(1, 5000) == 0);
+    check_resumed(before, 4000, false, "library changed");
+    CHECK(result->tracks == LIBRARY_LEN + 1 && result->listed == LIBRARY_LEN + 1);
+    *before = *result;
+
+    // pistes supprimées, dont celle de l'arrêt : encore dans l'index chargé,
+    // retirées par le scanner sans attendre le démarrage suivant
+    size_t live = LIBRARY_LEN + 1;
+    live -= remove(before->last) == 0;
+    for (size_t i = 0; i < LIBRARY_LEN; i += 25) {
+        char path[TRACK_PATH_MAX];
+        snprintf(path, sizeof(path), "%s/Artist %02zu/%03zu.mp3", MP3_DIR, i / 20, i);
+        live -= remove(path) == 0;
+    }
+    CHECK(run_boot(3, 6000) == 0);
+    CHECKF(result->tracks == live && result->missing_played == 0, "deleted: %zu tracks of %zu, "
+           "%zu deleted played", result->tracks, live, result->missing_played);
+    CHECKF(result->listed == live && result->missing_listed == 0, "deleted: %zu listed, %zu deleted",
+           result->listed, result->missing_listed);
+
+    chdir("/");
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return TEST_END();
+}
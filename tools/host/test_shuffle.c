@@ -0,0 +1,246 @@
+// test_shuffle.c
+/*
+ * Tests statistiques du tirage aléatoire de main/playlist_manager.c :
+ * tirage borné sans biais, permutations uniformes, reproductibilité par la
+ * graine, pas de répétition à la jointure de deux tirages, historique de
+ * "précédent". Compilé deux fois (voir Makefile) : uniforme, et avec
+ * CONFIG_PLAYLIST_SHUFFLE_ARTIST_SPREAD pour les artistes espacés.
+ *
+ * Les seuils du χ² sont ceux de p = 0,001 : les graines étant fixes, un
+ * test qui passe passe toujours, et un biais réel les dépasse largement.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+
+#include "playlist_manager.c"
+
+#define ARTISTS 40
+#define TRACKS_PER_ARTIST 25
+#define LIBRARY_LEN (ARTISTS * TRACKS_PER_ARTIST)
+
+static uint32_t seed_state = 0x9e3779b9;
+
+// splitmix32 : graines indépendantes, comme celles d'esp_random() sur la carte
+static uint32_t next_seed(void)
+{
+    uint32_t z = (seed_state += 0x9e3779b9);
+    z = (z ^ (z >> 16)) * 0x85ebca6b;
+    z = (z ^ (z >> 13)) * 0xc2b2ae35;
+    return z ^ (z >> 16);
+}
+
+static double chi_square(const uint32_t *counts, size_t n, double expected)
+{
+    double chi2 = 0;
+    for (size_t i = 0; i < n; i++) {
+        double d = counts[i] - expected;
+        chi2 += d * d / expected;
+    }
+    return chi2;
+}
+
+// Pistes "Artist NN/Album/TTT.mp3", identifiants groupés par artiste
+static void make_library(void)
+{
+    char name[64];
+    for (size_t a = 0; a < ARTISTS; a++) {
+        for (size_t t = 0; t < TRACKS_PER_ARTIST; t++) {
+            snprintf(name, sizeof(name), "Artist %02zu/Album/%03zu.mp3", a, t);
+            track_index_append(name, 0, 0);
+        }
+    }
+}
+
+// La playlist porte sur les n premières pistes de l'index
+static void use_tracks(size_t n)
+{
+    reserve_order(n);
+    track_count = n;
+    current_index = 0;
+    history_len = history_cur = 0;
+}
+
+static void test_bounded(void)
+{
+    static const struct { uint32_t n; double limit; } cases[] = {
+        { 3, 13.82 }, { 7, 22.46 }, { 10, 27.88 },
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        uint32_t counts[10] = { 0 };
+        uint32_t draws = 100000 * cases[c].n;
+        rng_state = next_seed();
+        for (uint32_t i = 0; i < draws; i++) counts[bounded(cases[c].n, rng_next)]++;
+        double chi2 = chi_square(counts, cases[c].n, draws / (double)cases[c].n);
+        CHECKF(chi2 < cases[c].limit, "n=%u chi2=%.2f", (unsigned)cases[c].n, chi2);
+    }
+
+    // n = 3 * 2^30 : un modulo donnerait une chance sur deux au premier tiers
+    uint32_t n = 0xc0000000u, low = 0, out = 0, draws = 300000;
+    rng_state = next_seed();
+    for (uint32_t i = 0; i < draws; i++) {
+        uint32_t v = bounded(n, rng_next);
+        out += v >= n;
+        low += v < 0x40000000u;
+    }
+    CHECK(out == 0);
+    double frac = low / (double)draws;
+    CHECKF(frac > 1 / 3.0 - 0.005 && frac < 1 / 3.0 + 0.005, "first third %.4f", frac);
+}
+
+static bool is_permutation(void)
+{
+    for (size_t i = 0; i < track_count; i++) {
+        if (shuffle_order[i] >= track_count || order_pos[shuffle_order[i]] != i) return false;
+    }
+    return true;
+}
+
+#if !CONFIG_PLAYLIST_SHUFFLE_ARTIST_SPREAD
+// Rang de la permutation courante de 4 pistes (code de Lehmer), 0 à 23
+static unsigned perm_rank4(void)
+{
+    unsigned rank = 0;
+    for (size_t i = 0; i < 4; i++) {
+        unsigned smaller = 0;
+        for (size_t j = i + 1; j < 4; j++) smaller += shuffle_order[j] < shuffle_order[i];
+        rank = rank * (4 - i) + smaller;
+    }
+    return rank;
+}
+
+static void test_uniform_permutations(void)
+{
+    uint32_t counts[24] = { 0 };
+    uint32_t runs = 240000;
+    use_tracks(4);
+    for (uint32_t i = 0; i < runs; i++) {
+        build_order(next_seed());
+        counts[perm_rank4()]++;
+    }
+    double chi2 = chi_square(counts, 24, runs / 24.0);
+    CHECKF(chi2 < 49.73, "chi2=%.2f", chi2);
+}
+#endif
+
+static void test_reproducible(void)
+{
+    static track_id_t first[LIBRARY_LEN];
+    use_tracks(LIBRARY_LEN);
+    uint32_t seed = next_seed(), prev = next_seed();
+    shuffle_with_seed(seed, prev);
+    CHECK(is_permutation());
+    memcpy(first, shuffle_order, sizeof(first));
+    shuffle_with_seed(next_seed(), 0);
+    CHECK(memcmp(first, shuffle_order, sizeof(first)) != 0);
+    shuffle_with_seed(seed, prev);
+    CHECK(memcmp(first, shuffle_order, sizeof(first)) == 0);
+    CHECK(is_permutation());
+}
+
+/*
+ * Enchaîne des tirages comme get_next() et vérifie qu'aucune des k
+ * dernières pistes d'un tirage ne revient parmi les k premières du suivant.
+ */
+static void test_no_repeat(void)
+{
+    static const size_t sizes[] = { 4, 5, 8, 13, 32, 100, LIBRARY_LEN };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        size_t k = CONFIG_PLAYLIST_NO_REPEAT < n / 4 ? CONFIG_PLAYLIST_NO_REPEAT : n / 4;
+        track_id_t tail[CONFIG_PLAYLIST_NO_REPEAT + 1];
+        unsigned repeats = 0, invalid = 0;
+        uint32_t prev = 0;
+        use_tracks(n);
+        for (int cycle = 0; cycle < 5000; cycle++) {
+            uint32_t seed = next_seed();
+            shuffle_with_seed(seed, prev);
+            invalid += !is_permutation();
+            for (size_t i = 0; prev && i < k; i++) repeats += is_recent(shuffle_order[i], tail, k);
+            memcpy(tail, &shuffle_order[n - k], k * sizeof(tail[0]));
+            prev = seed;
+        }
+        CHECKF(repeats == 0 && invalid == 0, "%zu tracks: %u repeats, %u invalid", n, repeats,
+               invalid);
+    }
+}
+
+static void test_history(void)
+{
+    size_t played[120];
+    use_tracks(10);
+    shuffle_with_seed(next_seed(), 0);
+    // 15 pistes : la onzième vient d'un nouveau tirage
+    for (size_t i = 0; i < 15; i++) {
+        played[i] = track_index_find(playlist_manager_get_next() + strlen(MP3_DIR) + 1);
+    }
+    for (size_t i = 13; i >= 7; i--) {
+        CHECK(track_index_find(playlist_manager_get_prev() + strlen(MP3_DIR) + 1) == (int)played[i]);
+    }
+    // en avant : l'historique est rejoué avant de reprendre le tirage
+    for (size_t i = 8; i < 15; i++) {
+        CHECK(track_index_find(playlist_manager_get_next() + strlen(MP3_DIR) + 1) == (int)played[i]);
+    }
+    CHECK(history_cur == history_len - 1);
+
+    // historique borné : on s'arrête sur la plus ancienne piste gardée
+    use_tracks(LIBRARY_LEN);
+    shuffle_with_seed(next_seed(), 0);
+    for (size_t i = 0; i < 120; i++) {
+        played[i] = track_index_find(playlist_manager_get_next() + strlen(MP3_DIR) + 1);
+    }
+    const char *path = NULL;
+    for (int i = 0; i < 200; i++) path = playlist_manager_get_prev();
+    CHECK(track_index_find(path + strlen(MP3_DIR) + 1) ==
+          (int)played[120 - CONFIG_PLAYLIST_HISTORY_LEN]);
+}
+
+static size_t artist_of(track_id_t id)
+{
+    return id / TRACKS_PER_ARTIST;
+}
+
+/*
+ * Paires de pistes consécutives du même artiste, en moyenne par tirage ;
+ * celles qui finissent sur la dernière piste sont comptées dans *last.
+ */
+static double adjacent_same_artist(double *last)
+{
+    size_t same = 0, at_end = 0, runs = 200;
+    use_tracks(LIBRARY_LEN);
+    for (size_t r = 0; r < runs; r++) {
+        shuffle_with_seed(next_seed(), 0);
+        for (size_t i = 1; i < track_count; i++) {
+            bool pair = artist_of(shuffle_order[i]) == artist_of(shuffle_order[i - 1]);
+            same += pair;
+            at_end += pair && i == track_count - 1;
+        }
+    }
+    *last = at_end / (double)runs;
+    return same / (double)runs;
+}
+
+int main(void)
+{
+    playlist_lock = xSemaphoreCreateMutex();
+    make_library();
+    CHECK(track_index_count() == LIBRARY_LEN);
+
+    test_bounded();
+    test_reproducible();
+    test_no_repeat();
+    test_history();
+
+    double last;
+    double same = adjacent_same_artist(&last);
+#if CONFIG_PLAYLIST_SHUFFLE_ARTIST_SPREAD
+    // il ne reste que la dernière piste, qui n'a plus de suivante à échanger
+    CHECKF(same == last && last < 0.1, "%.2f same-artist neighbours per shuffle, %.2f last",
+           same, last);
+#else
+    // uniforme : (n - 1) * (25 - 1) / (n - 1) = 24 en moyenne
+    CHECKF(same > 22 && same < 26, "%.2f same-artist neighbours per shuffle", same);
+    test_uniform_permutations();
+#endif
+    return TEST_END();
+}
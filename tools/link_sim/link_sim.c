@@ -0,0 +1,121 @@
+// link_sim.c
+/*
+ * Rejoue une trace de lien A2DP dans l'estimation de main/link_quality.c,
+ * au rythme des mesures du pipeline (100 ms), et affiche les changements
+ * de niveau puis le bilan. Sur la machine hôte :
+ *
+ *   cc -O2 -I main -o link_sim tools/link_sim/link_sim.c main/link_quality.c
+ *   ./link_sim tools/link_sim/traces/wifi_load.csv
+ *
+ * Chaque ligne de la trace fixe l'état du lien à partir de t_ms, jusqu'à la
+ * ligne suivante :
+ *
+ *   t_ms,connected,playing,rssi_delta,send_pct,queue_pct,underruns
+ *
+ * rssi_delta vaut "na" sans mesure ; send_pct est le débit pris par la pile
+ * en % du temps réel ; underruns compte les passages à vide survenus au
+ * début du segment. Les lignes vides et celles commençant par # sont ignorées.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "link_quality.h"
+
+#define STEP_MS 100                 // AUDIO_STATS_PERIOD_MS
+#define BYTE_RATE (44100 * 2 * 2)
+#define QUEUE_SIZE 8192
+#define MAX_SEGMENTS 4096
+
+typedef struct {
+    uint32_t t_ms;
+    int connected;
+    int playing;
+    int rssi_delta;
+    double send_pct;
+    unsigned queue_pct;
+    unsigned underruns;
+} segment_t;
+
+static int load_trace(const char *path, segment_t *seg, int max)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    char line[256], rssi[16];
+    int n = 0, lineno = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+        segment_t *s = &seg[n];
+        if (n == max || sscanf(p, "%u,%d,%d,%15[^,],%lf,%u,%u", &s->t_ms, &s->connected,
+                               &s->playing, rssi, &s->send_pct, &s->queue_pct,
+                               &s->underruns) != 7) {
+            fprintf(stderr, "%s:%d: bad line\n", path, lineno);
+            fclose(fp);
+            return -1;
+        }
+        s->rssi_delta = strcmp(rssi, "na") == 0 ? LINK_Q_RSSI_UNKNOWN : atoi(rssi);
+        if (n > 0 && s->t_ms < seg[n - 1].t_ms) {
+            fprintf(stderr, "%s:%d: time goes backwards\n", path, lineno);
+            fclose(fp);
+            return -1;
+        }
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s trace.csv\n", argv[0]);
+        return 2;
+    }
+    static segment_t seg[MAX_SEGMENTS];
+    int n = load_trace(argv[1], seg, MAX_SEGMENTS);
+    if (n <= 0) return 1;
+
+    link_quality_t q;
+    link_quality_init(&q, BYTE_RATE);
+    link_q_sample_t s = { .queue_size = QUEUE_SIZE };
+    double sent = 0;
+    int cur = 0;
+    uint32_t end_ms = seg[n - 1].t_ms + LINK_Q_WINDOW_MS;
+
+    for (uint32_t t = seg[0].t_ms; t <= end_ms; t += STEP_MS) {
+        while (cur + 1 < n && seg[cur + 1].t_ms <= t) {
+            cur++;
+            s.underruns += seg[cur].underruns;
+        }
+        if (t == seg[0].t_ms) s.underruns += seg[0].underruns;
+        const segment_t *g = &seg[cur];
+        if (g->connected && g->playing) sent += BYTE_RATE * g->send_pct / 100.0 * STEP_MS / 1000.0;
+        s.now_ms = t;
+        s.connected = g->connected;
+        s.playing = g->playing;
+        s.rssi_delta = (int8_t)g->rssi_delta;
+        s.sent_bytes = (uint64_t)sent;
+        s.queue_fill = QUEUE_SIZE * g->queue_pct / 100;
+
+        link_q_level_t before = q.stats.level;
+        if (link_quality_update(&q, &s)) {
+            printf("%8.1f s  %-9s -> %-9s (rssi %d dB, sent %u%%, queue %u%%)\n", t / 1000.0,
+                   link_quality_level_name(before), link_quality_level_name(q.stats.level),
+                   q.stats.rssi_delta == LINK_Q_RSSI_UNKNOWN ? 0 : q.stats.rssi_delta,
+                   q.stats.send_pct, q.stats.queue_pct);
+        }
+    }
+
+    const link_q_stats_t *st = &q.stats;
+    printf("\nwindows    %u (good %u, degraded %u, congested %u)\n", st->windows,
+           st->level_windows[LINK_Q_GOOD], st->level_windows[LINK_Q_DEGRADED],
+           st->level_windows[LINK_Q_CONGESTED]);
+    printf("transitions %u\ndropouts   %u\n", st->transitions, st->dropouts);
+    printf("send min   %u%%\n", st->send_pct_min);
+    if (st->rssi_delta_min != LINK_Q_RSSI_UNKNOWN) printf("rssi min   %d dB\n", st->rssi_delta_min);
+    return 0;
+}
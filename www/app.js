@@ -5,32 +5,108 @@ function sendCommand(cmd) {
     .then(txt => console.log(txt));
 }
 
+function formatTime(ms) {
+  const s = Math.floor(ms / 1000);
+  return Math.floor(s / 60) + ':' + String(s % 60).padStart(2, '0');
+}
+
+let seeking = false;
+let lastBt = null;
+
+function showStatus(data) {
+  document.getElementById('current').textContent = data.track;
+  const seek = document.getElementById('seek');
+  seek.max = data.duration_ms;
+  if (!seeking) seek.value = data.pos_ms;
+  document.getElementById('status').textContent =
+    data.state + ' ' + formatTime(data.pos_ms) +
+    (data.bt ? '' : ' (Bluetooth déconnecté)');
+  if (data.bt !== lastBt) {
+    lastBt = data.bt;
+    loadSinks();
+  }
+}
+
 function updateCurrent() {
   fetch('/current')
     .then(res => res.json())
-    .then(data => {
-      document.getElementById('current').textContent = data.track;
-    });
+    .then(showStatus);
+}
+
+// L'état est poussé par le serveur ; reconnexion automatique si le lien tombe
+function connectStatus() {
+  const ws = new WebSocket('ws://' + location.host + '/ws');
+  ws.onmessage = ev => showStatus(JSON.parse(ev.data));
+  ws.onclose = () => setTimeout(connectStatus, 2000);
 }
 
+const PAGE_SIZE = 200;
+
+// Charge la liste page par page ; le navigateur revalide chaque page par ETag
 function loadPlaylist() {
-  fetch('/list')
+  const list = document.getElementById('playlist');
+  const items = document.createDocumentFragment();
+  const loadPage = offset =>
+    fetch('/list?offset=' + offset + '&limit=' + PAGE_SIZE)
+      .then(res => res.json())
+      .then(files => {
+        files.forEach(file => {
+          const li = document.createElement('li');
+          li.textContent = file;
+          li.onclick = () => {
+            fetch('/play?file=' + encodeURIComponent(file));
+          };
+          items.appendChild(li);
+        });
+        if (files.length === PAGE_SIZE) {
+          return loadPage(offset + PAGE_SIZE);
+        }
+      });
+  loadPage(0).then(() => {
+    list.innerHTML = '';
+    list.appendChild(items);
+  });
+}
+// Enceinte active en gras ; un clic sur une autre y bascule la lecture
+function loadSinks() {
+  fetch('/sinks')
     .then(res => res.json())
-    .then(files => {
-      const list = document.getElementById('playlist');
+    .then(sinks => {
+      const list = document.getElementById('sinks');
       list.innerHTML = '';
-      files.forEach(file => {
+      sinks.forEach(sink => {
         const li = document.createElement('li');
-        li.textContent = file;
-        li.onclick = () => {
-          fetch('/play?file=' + encodeURIComponent(file));
-        };
-      list.appendChild(li);
+        li.textContent = (sink.name || sink.addr) +
+          (sink.rssi === null ? '' : ' (' + sink.rssi + ' dBm)');
+        if (sink.active) li.className = 'active';
+        li.onclick = () => fetch('/sinks/select?addr=' + sink.addr);
+        list.appendChild(li);
+      });
     });
-  });
 }
+
+// La recherche dure environ 6 s
+function scanSinks() {
+  fetch('/sinks/scan').then(() => setTimeout(loadSinks, 7000));
+}
+
+// Le curseur n'est plus mis à jour par le statut tant qu'on le déplace
+function initSeek() {
+  const seek = document.getElementById('seek');
+  seek.oninput = () => { seeking = true; };
+  seek.onchange = () => {
+    seeking = false;
+    fetch('/seek?ms=' + seek.value);
+  };
+}
+
 window.onload = () => {
   loadPlaylist();
-  updateCurrent();
-  setInterval(updateCurrent, 5000);
+  initSeek();
+  if ('WebSocket' in window) {
+    connectStatus();
+  } else {
+    updateCurrent();
+    setInterval(updateCurrent, 5000);
+  }
 };